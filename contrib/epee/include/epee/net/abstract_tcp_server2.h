@@ -40,6 +40,7 @@
 #include <string>
 #include <vector>
 #include <atomic>
+#include <chrono>
 #include <cassert>
 #include <map>
 #include <memory>
@@ -54,6 +55,14 @@
 #define LOKI_DEFAULT_LOG_CATEGORY "net"
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+#define ABSTRACT_SERVER_SEND_QUE_FULL_TIMEOUT std::chrono::seconds(5)
+// Limits on how much of the send queue gets gathered into a single write
+#define ABSTRACT_SERVER_SEND_GATHER_MAX_CHUNKS 64
+#define ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES (1024 * 1024)
+// send_priority::coalesce messages up to this size, sent to an idle connection, wait this long for
+// more messages to share the write
+#define ABSTRACT_SERVER_SEND_COALESCE_MAX_BYTES 4096
+#define ABSTRACT_SERVER_SEND_COALESCE_WINDOW std::chrono::milliseconds(5)
 
 namespace epee
 {
@@ -127,6 +136,8 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(shared_sv message); ///< (see do_send from i_service_endpoint)
+    virtual bool do_send_prioritized(shared_sv message, send_priority priority); ///< (see do_send_prioritized from i_service_endpoint)
+    virtual bool do_send_parts(shared_sv header, shared_sv body); ///< (see do_send_parts from i_service_endpoint)
     virtual bool send_done();
     virtual bool close();
     virtual bool call_run_once_service_io();
@@ -135,7 +146,8 @@ namespace net_utils
     virtual bool add_ref();
     virtual bool release();
     //------------------------------------------------------
-    bool do_send_chunk(shared_sv chunk); ///< will send (or queue) a part of data. internal use only
+    void split_message(shared_sv message, std::vector<shared_sv>& chunks); ///< appends the chunks `message` gets queued as
+    bool queue_chunks(std::vector<shared_sv> chunks, send_priority priority); ///< queues (and starts sending) the chunks of one message
 
     std::shared_ptr<connection<t_protocol_handler> > safe_shared_from_this();
     bool shutdown();
@@ -150,6 +162,11 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Starts the next read, after `delay` if we are over the download limit
+    void start_read(std::chrono::milliseconds timeout, std::chrono::steady_clock::duration delay);
+    /// Starts writing the front of the send queue, after `delay` if we are over the upload limit
+    void start_write(std::chrono::steady_clock::duration delay);
+
     /// reset connection timeout timer and callback
     void reset_timer(std::chrono::milliseconds ms, bool add);
     std::chrono::milliseconds get_default_timeout();
@@ -158,9 +175,6 @@ namespace net_utils
     /// host connection count tracking
     unsigned int host_count(const std::string &host, int delta = 0);
 
-    /// Buffer for incoming data.
-    std::array<char, 8192> buffer_;
-
     t_connection_context context;
 
 	// TODO what do they mean about wait on destructor?? --rfree :
@@ -170,7 +184,6 @@ namespace net_utils
     size_t m_reference_count = 0; // reference count managed through add_ref/release support
     std::shared_ptr<connection<t_protocol_handler> > m_self_ref; // the reference to hold
     std::mutex m_self_refs_lock;
-    std::mutex m_chunking_lock; // held while we add small chunks of the big do_send() to small do_send_chunk()
     std::mutex m_shutdown_lock; // held while shutting down
     
     t_connection_type m_connection_type;
@@ -182,6 +195,14 @@ namespace net_utils
     std::mutex m_throttle_speed_out_mutex;
 
     boost::asio::steady_timer m_timer;
+    boost::asio::steady_timer m_read_throttle_timer;  // defers reads when over the download limit
+    boost::asio::steady_timer m_write_throttle_timer; // defers writes when over the upload limit
+    std::chrono::steady_clock::time_point m_send_que_full_since; // guarded by m_send_que_lock
+    size_t m_send_que_writing = 0; // number of m_send_que chunks in the current write; guarded by m_send_que_lock
+    size_t m_send_que_priority_end = 0; // where the next high priority message goes in m_send_que; guarded by m_send_que_lock
+    bool m_send_que_front_partial = false; // the front of m_send_que is the rest of a partly written message; guarded by m_send_que_lock
+    bool m_send_coalescing = false; // the next write is being held back for coalescing; guarded by m_send_que_lock
+    std::chrono::steady_clock::time_point m_send_que_busy_since; // when m_send_que last became non-empty; guarded by m_send_que_lock
     bool m_local;
     bool m_ready_to_close;
     std::string m_host;
@@ -100,6 +100,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		m_throttle_speed_in("speed_in", "throttle_speed_in"),
 		m_throttle_speed_out("speed_out", "throttle_speed_out"),
 		m_timer(GET_IO_SERVICE(socket_)),
+		m_read_throttle_timer(GET_IO_SERVICE(socket_)),
+		m_write_throttle_timer(GET_IO_SERVICE(socket_)),
 		m_local(false),
 		m_ready_to_close(false)
   {
@@ -198,7 +200,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     reset_timer(std::chrono::milliseconds(m_local ? NEW_CONNECTION_TIMEOUT_LOCAL : NEW_CONNECTION_TIMEOUT_REMOTE), false);
 
-    socket().async_read_some(boost::asio::buffer(buffer_),
+    socket().async_read_some(boost::asio::buffer(m_recv_buffer),
       strand_.wrap(
         boost::bind(&connection<t_protocol_handler>::handle_read, self,
           boost::asio::placeholders::error,
@@ -334,32 +336,19 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 			epee::net_utils::network_throttle_manager::network_throttle_manager::get_global_throttle_in().handle_trafic_exact(bytes_transferred);
 		}
 
-		double delay=0; // will be calculated - how much we should sleep to obey speed limit etc
-
-
-		if (speed_limit_is_enabled()) {
-			do // keep sleeping if we should sleep
-			{
-				{
-					std::lock_guard lock{epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in};
-					delay = epee::net_utils::network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( bytes_transferred );
-				}
-				
-				delay *= 0.5;
-				long int ms = (long int)(delay * 100);
-				if (ms > 0) {
-					reset_timer(std::chrono::milliseconds(ms + 1), true);
-					std::this_thread::sleep_for(std::chrono::milliseconds{ms});
-				}
-			} while(delay > 0);
-		} // any form of sleeping
-		
+		// Rather than sleeping (and stalling every other connection on this io thread) when over the
+		// download limit, the next read on this connection gets deferred; see start_read().
+		std::chrono::steady_clock::duration delay{};
+		if (speed_limit_is_enabled())
+			delay = throttle_read(bytes_transferred);
+
       //MINFO("[sock " << socket().native_handle() << "] RECV " << bytes_transferred);
       logger_handle_net_read(bytes_transferred);
       context.m_last_recv = std::chrono::steady_clock::now();
       context.m_recv_cnt += bytes_transferred;
       m_ready_to_close = false;
-      bool recv_res = m_protocol_handler.handle_recv(buffer_.data(), bytes_transferred);
+      bool recv_res = m_protocol_handler.handle_recv(m_recv_buffer.data(), bytes_transferred);
+      adapt_recv_buffer(bytes_transferred);
       if(!recv_res)
       {  
         //MINFO("[sock " << socket().native_handle() << "] protocol_want_close");
@@ -375,12 +364,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
           shutdown();
       }else
       {
-        reset_timer(get_timeout_from_bytes_read(bytes_transferred), false);
-        socket().async_read_some(boost::asio::buffer(buffer_),
-          strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
-              boost::asio::placeholders::error,
-              boost::asio::placeholders::bytes_transferred)));
+        start_read(get_timeout_from_bytes_read(bytes_transferred), delay);
         //MINFO("[sock " << socket().native_handle() << "]Async read requested.");
       }
     }else
@@ -413,6 +397,81 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_read(std::chrono::milliseconds timeout, std::chrono::steady_clock::duration delay)
+  {
+    auto self = connection<t_protocol_handler>::shared_from_this();
+    auto read = [this, self] {
+      socket().async_read_some(boost::asio::buffer(m_recv_buffer),
+        strand_.wrap(
+          boost::bind(&connection<t_protocol_handler>::handle_read, self,
+            boost::asio::placeholders::error,
+            boost::asio::placeholders::bytes_transferred)));
+    };
+    if (delay <= delay.zero())
+    {
+      reset_timer(timeout, false);
+      read();
+      return;
+    }
+
+    const auto delay_ms = std::chrono::ceil<std::chrono::milliseconds>(delay);
+    MTRACE("[sock " << socket().native_handle() << "] Deferring read by " << delay_ms.count() << "ms for the download limit");
+    reset_timer(timeout + delay_ms, false);
+    m_read_throttle_timer.expires_from_now(delay);
+    m_read_throttle_timer.async_wait(strand_.wrap([this, self, read](const boost::system::error_code& ec) {
+      if (ec == boost::asio::error::operation_aborted || m_was_shutdown)
+        return;
+      read();
+    }));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write(std::chrono::steady_clock::duration delay)
+  {
+    // m_send_que_lock is held by the caller, and m_send_que is not empty
+    auto self = connection<t_protocol_handler>::shared_from_this();
+    if (delay <= delay.zero())
+    {
+      // Gather as much of the queue as we reasonably can into a single (writev) write.  The
+      // buffers stay valid until handle_write pops them: the queued shared_svs own the data.
+      std::vector<boost::asio::const_buffer> buffers;
+      size_t bytes = 0;
+      for (const auto& chunk : m_send_que)
+      {
+        if (buffers.size() >= ABSTRACT_SERVER_SEND_GATHER_MAX_CHUNKS ||
+            (!buffers.empty() && bytes + chunk.data.size() > ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES))
+          break;
+        buffers.emplace_back(chunk.data.data(), chunk.data.size());
+        bytes += chunk.data.size();
+      }
+      m_send_que_writing = buffers.size();
+      m_send_coalescing = false;
+
+      reset_timer(get_default_timeout(), false);
+      using namespace boost::placeholders;
+      boost::asio::async_write(socket(), buffers,
+          strand_.wrap(
+            boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
+          )
+        );
+      return;
+    }
+
+    const auto delay_ms = std::chrono::ceil<std::chrono::milliseconds>(delay);
+    MTRACE("[sock " << socket().native_handle() << "] Deferring write by " << delay_ms.count() << "ms" << (m_send_coalescing ? " to coalesce messages" : " for the upload limit"));
+    reset_timer(get_default_timeout() + delay_ms, false);
+    m_write_throttle_timer.expires_from_now(delay);
+    m_write_throttle_timer.async_wait(strand_.wrap([this, self](const boost::system::error_code& ec) {
+      if (ec == boost::asio::error::operation_aborted || m_was_shutdown)
+        return;
+      std::lock_guard lock{m_send_que_lock};
+      // A high priority message can cut a coalescing delay short, so the write may already be going
+      if (!m_send_que.empty() && m_send_que_writing == 0)
+        start_write(std::chrono::steady_clock::duration::zero());
+    }));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   bool connection<t_protocol_handler>::call_run_once_service_io()
   {
     TRY_ENTRY();
@@ -440,163 +499,174 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   //---------------------------------------------------------------------------------
     template<class t_protocol_handler>
   bool connection<t_protocol_handler>::do_send(shared_sv message) {
+    return do_send_prioritized(std::move(message), send_priority::normal);
+	} // do_send()
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_prioritized(shared_sv message, send_priority priority) {
     TRY_ENTRY();
 
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
     auto self = safe_shared_from_this();
     if (!self) return false;
     if (m_was_shutdown) return false;
-		// TODO avoid copy
 
+    std::vector<shared_sv> chunks;
+    split_message(std::move(message), chunks);
+    return queue_chunks(std::move(chunks), priority);
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_prioritized", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_parts(shared_sv header, shared_sv body) {
+    TRY_ENTRY();
+
+    auto self = safe_shared_from_this();
+    if (!self) return false;
+    if (m_was_shutdown) return false;
+
+    // Both parts are queued as one message so that nothing else can get between them
+    std::vector<shared_sv> chunks;
+    split_message(std::move(header), chunks);
+    split_message(std::move(body), chunks);
+    return queue_chunks(std::move(chunks), send_priority::normal);
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_parts", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::split_message(shared_sv message, std::vector<shared_sv>& chunks) {
 		const double factor = 32; // TODO config
 		typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
 		const t_safe chunksize_good = (t_safe)( 1024 * std::max(1.0,factor) );
         const t_safe chunksize_max = chunksize_good * 2 ;
 		const bool allow_split = (m_connection_type == e_connection_type_RPC) ? false : true; // do not split RPC data
 
-        CHECK_AND_ASSERT_MES(! (chunksize_max<0), false, "Negative chunksize_max" ); // make sure it is unsigned before removin sign with cast:
         long long unsigned int chunksize_max_unsigned = static_cast<long long unsigned int>( chunksize_max ) ;
 
         if (allow_split && (message.size() > chunksize_max_unsigned)) {
-            { // LOCK: chunking
-                std::lock_guard send_guard{m_chunking_lock};
-
+                // The chunks share the message's buffer (no copies), and get gathered back into
+                // large writes by start_write()
                 MDEBUG("do_send() will SPLIT into small chunks, from packet="<<message.size()<<" B for ptr="<<(void*)message.ptr.get());
-
-                while (!message.view.empty()) {
-                    bool ok = do_send_chunk(message.extract_prefix(chunksize_good));
-
-                    if (!ok) {
-                        MDEBUG("do_send() DONE ***FAILED***");
-                        MDEBUG("do_send() SEND was aborted in middle of big package - this is probably harmless (e.g. peer closed connection)");
-                        return false; // partial failure in sending
-                    }
-                }
-
-				MDEBUG("do_send() DONE SPLIT send");
-                MDEBUG("do_send() m_connection_type = " << m_connection_type);
-
-				return true; // done - e.g. queued - all the chunks of current do_send call
-			} // LOCK: chunking
-		} // a big block (to be chunked) - all chunks
+                while (!message.view.empty())
+                    chunks.push_back(message.extract_prefix(chunksize_good));
+		}
 		else { // small block
-			return do_send_chunk(std::move(message)); // just send as 1 big chunk
+			chunks.push_back(std::move(message)); // just send as 1 big chunk
 		}
-
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
-	} // do_send()
+	}
 
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send_chunk(shared_sv chunk)
+  bool connection<t_protocol_handler>::queue_chunks(std::vector<shared_sv> chunks, send_priority priority)
   {
     TRY_ENTRY();
-    // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
-    auto self = safe_shared_from_this();
-    if(!self)
-      return false;
-    if(m_was_shutdown)
-      return false;
+    if (chunks.empty())
+      return true;
+    size_t bytes = 0;
+    for (const auto& chunk : chunks)
+      bytes += chunk.size();
+
     double current_speed_up;
     {
 		std::lock_guard lock{m_throttle_speed_out_mutex};
-		m_throttle_speed_out.handle_trafic_exact(chunk.size());
+		m_throttle_speed_out.handle_trafic_exact(bytes);
 		current_speed_up = m_throttle_speed_out.get_current_speed();
 	}
     context.m_current_speed_up = current_speed_up;
     context.m_max_speed_up = std::max(context.m_max_speed_up, current_speed_up);
 
-    //MINFO("[sock " << socket().native_handle() << "] SEND " << cb);
     context.m_last_send = std::chrono::steady_clock::now();
-    context.m_send_cnt += chunk.size();
-    //some data should be wrote to stream
-    //request complete
-    
-    // No sleeping here; sleeping is done once and for all in "handle_write"
+    context.m_send_cnt += bytes;
+
+    // No throttling here; that is done once and for all when starting the write (see start_write)
 
     std::unique_lock queue_lock{m_send_que_lock};
 
-    long int retry=0;
-    const long int retry_limit = 5*4;
-    while (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+    // Producers are never put to sleep when the queue is full: a peer that doesn't drain its queue
+    // within ABSTRACT_SERVER_SEND_QUE_FULL_TIMEOUT (or lets it grow to twice the maximum) gets
+    // dropped instead.
+    if (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
     {
-        retry++;
-
-        /* if ( ::cryptonote::core::get_is_stopping() ) { // TODO re-add fast stop
-            MDEBUG("ABORT queue wait due to stopping");
-            return false; // aborted
-        }*/
-
-        using engine           = std::mt19937;
-        static bool initialized = false;
-        static engine rng;
-        if (!initialized)
-        {
-          initialized = true;
-          std::random_device dev;
-          std::seed_seq::result_type rand[engine::state_size]{}; // Use complete bit space
-          std::generate_n(rand, engine::state_size, std::ref(dev));
-          std::seed_seq seed(rand, rand + engine::state_size);
-          rng.seed(seed);
-        }
-
-        int ms = std::uniform_int_distribution<>{250, 299}(rng);
-        MDEBUG("Sleeping because QUEUE is FULL, in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<chunk.size()); // XXX debug sleep
+      const auto now = std::chrono::steady_clock::now();
+      if (m_send_que_full_since == std::chrono::steady_clock::time_point{})
+      {
+        MDEBUG("Send queue is full (" << m_send_que.size() << " chunks) at packet_size=" << bytes);
+        m_send_que_full_since = now;
+      }
+      else if (now - m_send_que_full_since > ABSTRACT_SERVER_SEND_QUE_FULL_TIMEOUT
+          || m_send_que.size() > 2 * ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+      {
+        MWARNING("send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
         queue_lock.unlock();
-        std::this_thread::sleep_for(std::chrono::milliseconds{ms});
-        queue_lock.lock();
-        MDEBUG("sleep for queue: " << ms);
-
-        if (retry > retry_limit) {
-            MWARNING("send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
-            shutdown();
-            return false;
-        }
+        shutdown();
+        return false;
+      }
     }
 
-    m_send_que.push_back(std::move(chunk));
+    const bool idle = m_send_que.empty();
 
-    if(m_send_que.size() > 1)
-    { // active operation should be in progress, nothing to do, just wait last operation callback
-        auto size_now = m_send_que.back().size();
-        MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
-        //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
-      
-      LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
+    // High priority messages go ahead of everything except what is being written right now,
+    // earlier high priority messages, and the rest of whatever message those leave us in the
+    // middle of (chunks of one message are never interleaved with another's).
+    size_t pos = m_send_que.size();
+    if (priority == send_priority::high)
+    {
+      pos = std::max(m_send_que_priority_end, m_send_que_writing);
+      // At the front of the queue we can only be inside a message if an earlier write stopped
+      // partway through one (and the rest of it is waiting on the upload limit).
+      while (pos < m_send_que.size() && (pos > 0 ? !m_send_que[pos - 1].message_end : m_send_que_front_partial))
+        pos++;
     }
-    else
-    { // no active operation
-
-        if(m_send_que.size()!=1)
-        {
-            MERROR("Looks like no active operations, but send que size != 1!!");
-            return false;
-        }
-
-        auto size_now = m_send_que.front().size();
-        MDEBUG("do_send_chunk() NOW SENSD: packet="<<size_now<<" B");
+    const size_t count = chunks.size();
+    auto it = m_send_que.begin() + pos;
+    for (size_t i = 0; i < count; i++)
+      it = std::next(m_send_que.insert(it, queued_chunk{std::move(chunks[i]), i == count - 1}));
+    if (priority == send_priority::high)
+      m_send_que_priority_end = pos + count;
+    if (idle)
+      m_send_que_busy_since = std::chrono::steady_clock::now();
+    context.m_send_queue_chunks = m_send_que.size();
+    context.m_send_queue_peak = std::max(context.m_send_queue_peak, m_send_que.size());
+
+    const auto throttle_delay = speed_limit_is_enabled() ? write_delay() : std::chrono::steady_clock::duration::zero();
+    if (idle)
+    {
+      if (priority == send_priority::coalesce && m_connection_type != e_connection_type_RPC
+          && bytes <= ABSTRACT_SERVER_SEND_COALESCE_MAX_BYTES)
+      {
+        // Hold back small notifications briefly so that whatever else gets sent in the meantime
+        // goes out in the same write
+        m_send_coalescing = true;
+        start_write(std::max<std::chrono::steady_clock::duration>(ABSTRACT_SERVER_SEND_COALESCE_WINDOW, throttle_delay));
+      }
+      else
+      {
+        MDEBUG("queue_chunks() NOW SENDS: packet=" << bytes << " B");
         if (speed_limit_is_enabled())
-			do_send_handler_write( m_send_que.back().data(), m_send_que.back().size() ); // (((H)))
-
-        CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
-        reset_timer(get_default_timeout(), false);
-        using namespace boost::placeholders;
-        boost::asio::async_write(socket(), boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 )
-                                 );
-        //MTRACE("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //MINFO("[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
+          do_send_handler_write(m_send_que.front().data.data(), m_send_que.front().data.size()); // (((H)))
+        start_write(throttle_delay);
+      }
+    }
+    else if (priority == send_priority::high && m_send_coalescing)
+    {
+      // Don't make a high priority message wait out the coalescing window
+      m_send_coalescing = false;
+      m_write_throttle_timer.cancel();
+      start_write(throttle_delay);
+    }
+    else
+    {
+      // active operation should be in progress, nothing to do, just wait last operation callback
+      MDEBUG("queue_chunks() NOW just queues: packet=" << bytes << " B, is added to queue-size=" << m_send_que.size());
+      LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().data.size());
     }
-    
-    //do_send_handler_stop( ptr , cb ); // empty function
 
     return true;
 
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_chunk", false);
-  } // do_send_chunk
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::queue_chunks", false);
+  } // queue_chunks
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   std::chrono::milliseconds connection<t_protocol_handler>::get_default_timeout()
@@ -684,6 +754,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     m_was_shutdown = true;
     // Initiate graceful connection closure.
     m_timer.cancel();
+    m_read_throttle_timer.cancel();
+    m_write_throttle_timer.cancel();
     boost::system::error_code ignored_ec;
     socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
     if (!m_host.empty())
@@ -749,10 +821,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }
     logger_handle_net_write(cb);
 
-                // The single sleeping that is needed for correctly handling "out" speed throttling
-		if (speed_limit_is_enabled()) {
-			sleep_before_packet(cb, 1, 1);
-		}
+    // Over the upload limit the next write gets deferred (see start_write()) rather than sleeping here
+    std::chrono::steady_clock::duration delay{};
+    if (speed_limit_is_enabled())
+      delay = throttle_write(cb);
 
     bool do_shutdown = false;
     std::unique_lock lock{m_send_que_lock};
@@ -762,9 +834,20 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
 
-    m_send_que.pop_front();
+    for (; m_send_que_writing > 0 && !m_send_que.empty(); m_send_que_writing--)
+    {
+      m_send_que_front_partial = !m_send_que.front().message_end;
+      m_send_que.pop_front();
+      if (m_send_que_priority_end > 0)
+        m_send_que_priority_end--;
+    }
+    m_send_que_writing = 0;
+    if (m_send_que.size() <= ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+      m_send_que_full_since = {};
+    context.m_send_queue_chunks = m_send_que.size();
     if(m_send_que.empty())
     {
+      context.m_send_stall_time += std::chrono::steady_clock::now() - m_send_que_busy_since;
       if(m_want_close_connection)
       {
         do_shutdown = true;
@@ -772,18 +855,11 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }else
     {
       //have more data to send
-		reset_timer(get_default_timeout(), false);
-		auto size_now = m_send_que.front().size();
+		auto size_now = m_send_que.front().data.size();
 		MDEBUG("handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
 		if (speed_limit_is_enabled())
-			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-        using namespace boost::placeholders;
-        boost::asio::async_write(socket(), boost::asio::buffer(m_send_que.front().data(), size_now) , 
-           strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-			  )
-          );
+			do_send_handler_write_from_queue(e, m_send_que.front().data.size() , m_send_que.size()); // (((H)))
+		start_write(delay);
       //MTRACE("(normal)" << size_now);
     }
     lock.unlock();
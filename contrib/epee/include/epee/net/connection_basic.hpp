@@ -47,6 +47,8 @@
 #include <atomic>
 #include <memory>
 #include <deque>
+#include <vector>
+#include <chrono>
 
 #include <boost/asio.hpp>
 
@@ -76,6 +78,23 @@ namespace net_utils
 
 class connection_basic_pimpl; // PIMPL for this class
 
+  /// Pool of connection receive buffers shared by all connections.  Buffers come in power-of-two
+  /// sizes from MIN_SIZE to MAX_SIZE, and up to MAX_POOLED buffers of each size are kept around for
+  /// reuse when connections grow, shrink or go away.
+  class recv_buffer_pool
+  {
+  public:
+    static constexpr size_t MIN_SIZE = 8 * 1024;
+    static constexpr size_t MAX_SIZE = 256 * 1024;
+    static constexpr size_t MAX_POOLED = 64;
+
+    /// Returns a buffer of `size` bytes; `size` must be a power of two in [MIN_SIZE, MAX_SIZE].
+    static std::vector<char> get(size_t size);
+
+    /// Gives a buffer back to the pool (or frees it, if there are enough of its size pooled).
+    static void put(std::vector<char>&& buf);
+  };
+
   enum t_connection_type { // type of the connection (of this server), e.g. so that we will know how to limit it
 	  e_connection_type_NET = 0, // default (not used?)
 	  e_connection_type_RPC = 1, // the rpc commands  (probably not rate limited, not chunked, etc)
@@ -95,12 +114,21 @@ class connection_basic { // not-templated base class for rapid developmet of som
     std::atomic<bool> m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     std::mutex m_send_que_lock;
-    std::deque<shared_sv> m_send_que;
+    /// A queued piece of an outgoing message; large messages are queued as several chunks.
+    struct queued_chunk
+    {
+      shared_sv data;
+      bool message_end; ///< last chunk of its message, so another message may be queued after it
+    };
+    std::deque<queued_chunk> m_send_que;
     std::atomic<bool> m_is_multithreaded;
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
     /// Socket for the connection.
     boost::asio::ip::tcp::socket socket_;
+    /// Buffer for incoming data; resized by adapt_recv_buffer() to suit the traffic.
+    std::vector<char> m_recv_buffer = recv_buffer_pool::get(recv_buffer_pool::MIN_SIZE);
+    int m_recv_small_reads = 0;
 
 	public:
 		// first counter is the ++/-- count of current sockets, the other socket_number is only-increasing ++ number generator
@@ -133,8 +161,17 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		static void set_tos_flag(int tos); // ToS / QoS flag
 		static int get_tos_flag();
 
-		// handlers and sleep
-		void sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?)
+		/// Called after each read of `bytes_read` bytes: grows the receive buffer when reads fill it
+		/// (so bulk transfers such as block sync use fewer, larger reads) and shrinks it again once
+		/// reads stay small.
+		void adapt_recv_buffer(size_t bytes_read);
+
+		// rate limiting: charge a transfer to the global limits and return how long the connection
+		// should defer its next read (write); never sleeps
+		static std::chrono::steady_clock::duration throttle_read(size_t packet_size);
+		static std::chrono::steady_clock::duration throttle_write(size_t packet_size);
+		/// How long a write started now would have to wait for the global upload limit
+		static std::chrono::steady_clock::duration write_delay();
 		static void save_limit_to_file(int limit); ///< for dr-monero
 		static double get_sleep_time(size_t cb);
 };
@@ -93,6 +93,9 @@ namespace levin
 
     virtual void on_connection_new(t_connection_context& context){};
     virtual void on_connection_close(t_connection_context& context){};
+    /// Called for every levin message sent or received (after reassembly, if fragmented); `bytes`
+    /// includes the levin header.  May be called from any thread.
+    virtual void on_levin_message(int command, size_t bytes, bool outgoing, t_connection_context& context){};
 
     virtual ~levin_commands_handler(){}
   };
@@ -29,6 +29,7 @@
 #include <boost/uuid/uuid_generators.hpp>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <atomic>
 #include <memory>
@@ -91,6 +92,9 @@ public:
   typedef t_connection_context connection_context;
   uint64_t m_max_packet_size; 
   uint64_t m_invoke_timeout;
+  /// Commands whose requests, notifications and responses jump ahead of other queued traffic
+  /// (see net_utils::send_priority::high).  Must be set before any connections are made.
+  std::unordered_set<int> m_priority_commands;
 
   int invoke(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, boost::uuids::uuid connection_id);
   template<class callback_t>
@@ -133,8 +137,13 @@ class async_protocol_handler
     data.reserve(sizeof(head) + in_buff.size());
     data.append(reinterpret_cast<const char*>(&head), sizeof(head));
     data.append(reinterpret_cast<const char*>(in_buff.data()), in_buff.size());
-    if(!m_pservice_endpoint->do_send(shared_sv{std::move(data)}))
+    // Small fire-and-forget notifications can wait a moment to share a write with whatever follows
+    const auto priority = m_config.m_priority_commands.count(command) ? net_utils::send_priority::high
+        : !expect_response && flags == LEVIN_PACKET_REQUEST ? net_utils::send_priority::coalesce
+        : net_utils::send_priority::normal;
+    if(!m_pservice_endpoint->do_send_prioritized(shared_sv{std::move(data)}, priority))
       return false;
+    m_config.m_pcommands_handler->on_levin_message(command, sizeof(head) + in_buff.size(), true, m_connection_context);
 
     MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
         << ", flags" << head.m_flags
@@ -485,6 +494,7 @@ public:
             << ", r?=" << m_current_head.m_have_to_return_data 
             <<", cmd = " << m_current_head.m_command 
             << ", v=" << m_current_head.m_protocol_version);
+          m_config.m_pcommands_handler->on_levin_message(m_current_head.m_command, sizeof(bucket_head2) + buff_to_invoke.size(), false, m_connection_context);
 
           if(is_response)
           {//response to some invoke 
@@ -530,9 +540,23 @@ public:
 
               bucket_head2 head = make_header(m_current_head.m_command, return_buff.size(), LEVIN_PACKET_RESPONSE, false);
               head.m_return_code = SWAP32LE(return_code);
-              return_buff.insert(0, reinterpret_cast<const char*>(&head), sizeof(head));
+              m_config.m_pcommands_handler->on_levin_message(m_current_head.m_command, sizeof(head) + return_buff.size(), true, m_connection_context);
 
-              if(!m_pservice_endpoint->do_send(shared_sv{std::move(return_buff)}))
+              if (m_config.m_priority_commands.count(m_current_head.m_command))
+              {
+                // Priority responses (handshakes, pings, ...) are small, so just build them whole
+                std::string data;
+                data.reserve(sizeof(head) + return_buff.size());
+                data.append(reinterpret_cast<const char*>(&head), sizeof(head));
+                data += return_buff;
+                if(!m_pservice_endpoint->do_send_prioritized(shared_sv{std::move(data)}, net_utils::send_priority::high))
+                  return false;
+              }
+              // Responses (e.g. blocks for a syncing peer) can be large: queue the header separately
+              // rather than shifting the whole response along to make room for it.
+              else if(!m_pservice_endpoint->do_send_parts(
+                    shared_sv{std::string{reinterpret_cast<const char*>(&head), sizeof(head)}},
+                    shared_sv{std::move(return_buff)}))
                 return false;
 
               MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
@@ -758,11 +782,22 @@ public:
       return LEVIN_ERROR_CONNECTION_DESTROYED;
 
     const std::size_t length = message.view.size();
+    int command = 0;
+    if (length >= sizeof(bucket_head2))
+    {
+      bucket_head2 head;
+      std::memcpy(&head, message.data(), sizeof(head));
+      // A fragmented message carries its real header at the start of the first fragment's payload
+      if ((SWAP32LE(head.m_flags) & (LEVIN_PACKET_BEGIN | LEVIN_PACKET_END)) == LEVIN_PACKET_BEGIN && length >= 2 * sizeof(head))
+        std::memcpy(&head, message.data() + sizeof(head), sizeof(head));
+      command = SWAP32LE(head.m_command);
+    }
     if (!m_pservice_endpoint->do_send(std::move(message)))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to send message, dropping it");
       return -1;
     }
+    m_config.m_pcommands_handler->on_levin_message(command, length, true, m_connection_context);
 
     MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << (length - sizeof(bucket_head2)) << ", r?=0]");
     return 1;
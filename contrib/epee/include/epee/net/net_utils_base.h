@@ -277,14 +277,14 @@ namespace net_utils
 
 		// Const: we're serializing
 		template<typename T, typename t_storage>
-		bool serialize_addr(t_storage& stg, epee::serialization::section* parent) const
+		bool serialize_addr(t_storage& stg, typename t_storage::section_type* parent) const
 		{
 		  return epee::serialization::perform_serialize<true>(as<T>(), stg, parent, "addr");
 		}
 
 		// Non-const: we're deserializing
 		template<typename T, typename t_storage>
-		bool serialize_addr(t_storage& stg, epee::serialization::section* parent)
+		bool serialize_addr(t_storage& stg, typename t_storage::section_type* parent)
 		{
 			T addr{};
 			if (!epee::serialization::perform_serialize<false>(addr, stg, parent, "addr"))
@@ -358,6 +358,9 @@ namespace net_utils
     double m_current_speed_up;
     double m_max_speed_down;
     double m_max_speed_up;
+    size_t m_send_queue_chunks; // chunks currently waiting in (or being written from) the send queue
+    size_t m_send_queue_peak;   // the most chunks the send queue has held at once
+    std::chrono::steady_clock::duration m_send_stall_time; // total time the send queue has been non-empty
 
     connection_context_base(boost::uuids::uuid connection_id,
                             const network_address &remote_address, bool is_income,
@@ -375,7 +378,10 @@ namespace net_utils
                                             m_current_speed_down(0),
                                             m_current_speed_up(0),
                                             m_max_speed_down(0),
-                                            m_max_speed_up(0)
+                                            m_max_speed_up(0),
+                                            m_send_queue_chunks(0),
+                                            m_send_queue_peak(0),
+                                            m_send_stall_time(0)
     {}
 
     connection_context_base(): m_connection_id(),
@@ -389,7 +395,10 @@ namespace net_utils
                                m_current_speed_down(0),
                                m_current_speed_up(0),
                                m_max_speed_down(0),
-                               m_max_speed_up(0)
+                               m_max_speed_up(0),
+                               m_send_queue_chunks(0),
+                               m_send_queue_peak(0),
+                               m_send_stall_time(0)
     {}
 
     connection_context_base(const connection_context_base& a): connection_context_base()
@@ -417,9 +426,33 @@ namespace net_utils
 	/************************************************************************/
 	/*                                                                      */
 	/************************************************************************/
+	/// How a message is ordered against the others queued on the same connection.
+	enum class send_priority : uint8_t
+	{
+		normal,   ///< queued in order
+		coalesce, ///< queued in order, but a small message may wait briefly to share a write with the ones after it
+		high,     ///< queued ahead of normal messages (at a message boundary), in order with other high ones
+	};
+
 	struct i_service_endpoint
 	{
     virtual bool do_send(shared_sv message)=0;
+    /// Sends `message` with the given send_priority.  The default implementation ignores the
+    /// priority.
+    virtual bool do_send_prioritized(shared_sv message, send_priority priority)
+    {
+      return do_send(std::move(message));
+    }
+    /// Sends `header` immediately followed by `body`.  The default implementation concatenates the
+    /// two; connections queue both pieces as they are, without copying `body`.
+    virtual bool do_send_parts(shared_sv header, shared_sv body)
+    {
+      std::string message;
+      message.reserve(header.size() + body.size());
+      message.append(header.view);
+      message.append(body.view);
+      return do_send(shared_sv{std::move(message)});
+    }
     virtual bool close()=0;
     virtual bool send_done()=0;
     virtual bool call_run_once_service_io()=0;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace epee
+{
+namespace net_utils
+{
+
+  /// Thread-safe token bucket used to pace network traffic without blocking.  Tokens (bytes) refill
+  /// continuously at the configured rate up to `burst`; a transfer always takes its tokens, possibly
+  /// putting the bucket into debt, and consume() returns how long the caller should hold off its
+  /// next transfer so that the debt is repaid.  Callers are expected to defer (e.g. with an asio
+  /// timer) rather than sleep.
+  class token_bucket
+  {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    /// Sets the refill rate in bytes per second (0 disables limiting) and the maximum number of
+    /// tokens that can accumulate while idle (0 means one second's worth).
+    void set_rate(uint64_t bytes_per_second, uint64_t burst = 0);
+
+    /// Returns the refill rate in bytes per second, 0 if unlimited.
+    uint64_t rate() const;
+
+    /// Takes `bytes` tokens and returns how long to wait before the next transfer (zero if the
+    /// bucket still has tokens left, or if unlimited).
+    clock::duration consume(size_t bytes);
+
+    /// Returns how long a transfer started now would have to wait, without taking any tokens.
+    clock::duration delay() const;
+
+  private:
+    void refill(clock::time_point now) const;
+    clock::duration debt_delay() const;
+
+    mutable std::mutex m_mutex;
+    double m_rate = 0;   // bytes per second
+    double m_burst = 0;  // bytes
+    mutable double m_tokens = 0;
+    mutable clock::time_point m_last = clock::now();
+  };
+
+}
+}
@@ -29,6 +29,7 @@
 #include "../misc_log_ex.h"
 #include "keyvalue_serialization_overloads.h"
 #include "../storages/portable_storage.h"
+#include "../storages/portable_storage_flat.h"
 
 #undef LOKI_DEFAULT_LOG_CATEGORY
 #define LOKI_DEFAULT_LOG_CATEGORY "serialization"
@@ -56,7 +57,9 @@ public: \
   bool store(epee::serialization::portable_storage& st, epee::serialization::section* parent_section = nullptr) const; \
   bool _load(epee::serialization::portable_storage& st, epee::serialization::section* parent_section = nullptr); \
   bool load(epee::serialization::portable_storage& st, epee::serialization::section* parent_section = nullptr); \
-  template <bool is_store> bool _serialize_map(epee::serialization::portable_storage& stg, epee::serialization::section* parent_section) const;
+  bool _load(epee::serialization::flat_storage& st, const epee::serialization::flat_entry* parent_section = nullptr); \
+  bool load(epee::serialization::flat_storage& st, const epee::serialization::flat_entry* parent_section = nullptr); \
+  template <bool is_store, typename Storage> bool _serialize_map(Storage& stg, typename Storage::section_type* parent_section) const;
 
 #define KV_SERIALIZE_MAP_CODE_BEGIN(Class) \
   bool Class::store(epee::serialization::portable_storage& st, epee::serialization::section* parent_section) const \
@@ -70,8 +73,17 @@ public: \
     catch (...) { LOG_ERROR("Unknown deserialization exception"); } \
     return false; \
   } \
-  template <bool is_store> \
-  bool Class::_serialize_map(epee::serialization::portable_storage& stg, epee::serialization::section* parent_section) const { \
+  bool Class::_load(epee::serialization::flat_storage& st, const epee::serialization::flat_entry* parent_section) \
+  { return _serialize_map<false>(st, parent_section); } \
+  bool Class::load(epee::serialization::flat_storage& st, const epee::serialization::flat_entry* parent_section) \
+  { \
+    try { return _load(st, parent_section); } \
+    catch (const std::exception& err) { LOG_ERROR("Deserialization exception: " << err.what()); } \
+    catch (...) { LOG_ERROR("Unknown deserialization exception"); } \
+    return false; \
+  } \
+  template <bool is_store, typename Storage> \
+  bool Class::_serialize_map(Storage& stg, typename Storage::section_type* parent_section) const { \
     /* de-const if we're being called (from the above non-const _load method) to deserialize */ \
     auto& this_ref = const_cast<std::conditional_t<is_store, const Class, Class>&>(*this);
 
@@ -102,8 +114,24 @@ public: \
       return false; \
     }\
   }\
+  bool _load( epee::serialization::flat_storage& stg, const epee::serialization::flat_entry* parent_section = nullptr)\
+  {\
+    return serialize_map<false>(*this, stg, parent_section);\
+  }\
+  bool load( epee::serialization::flat_storage& stg, const epee::serialization::flat_entry* parent_section = nullptr)\
+  {\
+    try{\
+    return serialize_map<false>(*this, stg, parent_section);\
+    }\
+    catch(const std::exception& err) \
+    { \
+      (void)(err); \
+      LOG_ERROR("Exception on deserializing: " << err.what());\
+      return false; \
+    }\
+  }\
   template<bool is_store, class this_type, class t_storage> \
-  static bool serialize_map(this_type& this_ref,  t_storage& stg, epee::serialization::section* parent_section) \
+  static bool serialize_map(this_type& this_ref,  t_storage& stg, typename t_storage::section_type* parent_section) \
   { 
 
 #define KV_SERIALIZE_VALUE(variable) \
@@ -33,6 +33,7 @@
 #include <vector>
 #include <deque>
 #include <array>
+#include <cstring>
 #include "../span.h"
 #include "../storages/portable_storage_base.h"
 
@@ -81,19 +82,19 @@ namespace epee
 
     //-------------------------------------------------------------------------------------------------------------------
     template<class t_type, class t_storage>
-    static bool serialize_t_val(const t_type& d, t_storage& stg, section* parent_section, const char* pname)
+    static bool serialize_t_val(const t_type& d, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       return stg.set_value(pname, d, parent_section);
     }
     //-------------------------------------------------------------------------------------------------------------------
     template<class t_type, class t_storage>
-    static bool unserialize_t_val(t_type& d, t_storage& stg, section* parent_section, const char* pname)
+    static bool unserialize_t_val(t_type& d, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       return stg.get_value(pname, d, parent_section);
     } 
     //-------------------------------------------------------------------------------------------------------------------
     template<class t_type, class t_storage>
-    static bool serialize_t_val_as_blob(const t_type& d, t_storage& stg, section* parent_section, const char* pname)
+    static bool serialize_t_val_as_blob(const t_type& d, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       assert_blob_serializable<t_type>();
       std::string blob((const char *)&d, sizeof(d));
@@ -101,35 +102,36 @@ namespace epee
     }
     //-------------------------------------------------------------------------------------------------------------------
     template<class t_type, class t_storage>
-    static bool unserialize_t_val_as_blob(t_type& d, t_storage& stg, section* parent_section, const char* pname)
+    static bool unserialize_t_val_as_blob(t_type& d, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       assert_blob_serializable<t_type>();
-      std::string blob;
+      typename t_storage::blob_type blob;
       if(!stg.get_value(pname, blob, parent_section))
         return false;
       CHECK_AND_ASSERT_MES(blob.size() == sizeof(d), false, "unserialize_t_val_as_blob: size of " << typeid(t_type).name() << " = " << sizeof(t_type) << ", but stored blod size = " << blob.size() << ", value name = " << pname);
-      d = *(const t_type*)blob.data();
+      // memcpy rather than a cast: a blob inside a loaded buffer has no alignment guarantee
+      std::memcpy((void*) &d, blob.data(), sizeof(d));
       return true;
     } 
     //-------------------------------------------------------------------------------------------------------------------
     template<class serializible_type, class t_storage>
-    static bool serialize_t_obj(const serializible_type& obj, t_storage& stg, section* parent_section, const char* pname)
+    static bool serialize_t_obj(const serializible_type& obj, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
-      section* child_section = stg.open_section(pname, parent_section, true);
+      auto* child_section = stg.open_section(pname, parent_section, true);
       CHECK_AND_ASSERT_MES(child_section, false, "serialize_t_obj: failed to open/create section " << pname);
       return obj.store(stg, child_section);
     }
     //-------------------------------------------------------------------------------------------------------------------
     template<class serializible_type, class t_storage>
-    static bool unserialize_t_obj(serializible_type& obj, t_storage& stg, section* parent_section, const char* pname)
+    static bool unserialize_t_obj(serializible_type& obj, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
-      section* child_section = stg.open_section(pname, parent_section, false);
+      auto* child_section = stg.open_section(pname, parent_section, false);
       if(!child_section) return false;
       return obj._load(stg, child_section);
     }
     //-------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
-    static bool serialize_stl_container_t_val(const stl_container& container, t_storage& stg, section* parent_section, const char* pname)
+    static bool serialize_stl_container_t_val(const stl_container& container, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       using T = typename stl_container::value_type;
       if(!container.size()) return true;
@@ -141,7 +143,7 @@ namespace epee
     }
     //--------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
-    static bool unserialize_stl_container_t_val(stl_container& container, t_storage& stg, section* parent_section, const char* pname)
+    static bool unserialize_stl_container_t_val(stl_container& container, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       using T = typename stl_container::value_type;
       container.clear();
@@ -157,7 +159,7 @@ namespace epee
     }
     //--------------------------------------------------------------------------------------------------------------------
     template<typename T, size_t Size, class t_storage>
-    static bool unserialize_stl_container_t_val(std::array<T, Size>& array, t_storage& stg, section* parent_section, const char* pname)
+    static bool unserialize_stl_container_t_val(std::array<T, Size>& array, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       static_assert(Size > 0, "cannot deserialize empty std::array");
       size_t next_i = 0;
@@ -170,7 +172,7 @@ namespace epee
     }
     //--------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
-    static bool serialize_stl_container_pod_val_as_blob(const stl_container& container, t_storage& stg, section* parent_section, const char* pname)
+    static bool serialize_stl_container_pod_val_as_blob(const stl_container& container, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       using T = typename stl_container::value_type;
       assert_blob_serializable<T>();
@@ -189,13 +191,13 @@ namespace epee
     }
     //--------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
-    static bool unserialize_stl_container_pod_val_as_blob(stl_container& container, t_storage& stg, section* parent_section, const char* pname)
+    static bool unserialize_stl_container_pod_val_as_blob(stl_container& container, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       using T = typename stl_container::value_type;
       assert_blob_serializable<T>();
 
       container.clear();
-      std::string buff;
+      typename t_storage::blob_type buff;
       if (!stg.get_value(pname, buff, parent_section))
         return false;
 
@@ -219,7 +221,7 @@ namespace epee
     }
     //--------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
-    static bool serialize_stl_container_t_obj(const stl_container& container, t_storage& stg, section* parent_section, const char* pname)
+    static bool serialize_stl_container_t_obj(const stl_container& container, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       if (container.empty()) return true;
       auto* sec_array = stg.template make_array_t<section>(pname, parent_section);
@@ -232,7 +234,7 @@ namespace epee
     }
     //--------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
-    static bool unserialize_stl_container_t_obj(stl_container& container, t_storage& stg, section* parent_section, const char* pname)
+    static bool unserialize_stl_container_t_obj(stl_container& container, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       container.clear();
       auto* arr = stg.template get_array<section>(pname, parent_section);
@@ -244,7 +246,7 @@ namespace epee
     }
     //--------------------------------------------------------------------------------------------------------------------
     template<typename T, size_t Size, class t_storage>
-    static bool unserialize_stl_container_t_obj(std::array<T, Size>& out, t_storage& stg, section* parent_section, const char* pname)
+    static bool unserialize_stl_container_t_obj(std::array<T, Size>& out, t_storage& stg, typename t_storage::section_type* parent_section, const char* pname)
     {
       static_assert(Size > 0, "cannot deserialize empty std::array");
       auto* arr = stg.template get_array<section>(pname, parent_section);
@@ -258,7 +260,7 @@ namespace epee
     }
     //--------------------------------------------------------------------------------------------------------------------
     template <bool Serializing, typename T, typename Storage>
-    bool perform_serialize(T& d, Storage& stg, section* parent_section, const char* pname)
+    bool perform_serialize(T& d, Storage& stg, typename Storage::section_type* parent_section, const char* pname)
     {
       if constexpr (Serializing)
         return kv_serialize(d, stg, parent_section, pname);
@@ -267,7 +269,7 @@ namespace epee
     }
 
     template <bool Serializing, typename T, typename Storage>
-    bool perform_serialize_blob(T& d, Storage& stg, section* parent_section, const char* pname)
+    bool perform_serialize_blob(T& d, Storage& stg, typename Storage::section_type* parent_section, const char* pname)
     {
       if constexpr (Serializing)
         return serialize_t_val_as_blob(d, stg, parent_section, pname);
@@ -276,7 +278,7 @@ namespace epee
     }
 
     template <bool Serializing, typename T, typename Storage>
-    bool perform_serialize_blob_container(T& d, Storage& stg, section* parent_section, const char* pname)
+    bool perform_serialize_blob_container(T& d, Storage& stg, typename Storage::section_type* parent_section, const char* pname)
     {
       if constexpr (Serializing)
         return serialize_stl_container_pod_val_as_blob(d, stg, parent_section, pname);
@@ -285,7 +287,7 @@ namespace epee
     }
 
     template<class T, class Storage>
-    bool kv_serialize(const T& d, Storage& stg, section* parent_section, const char* pname)
+    bool kv_serialize(const T& d, Storage& stg, typename Storage::section_type* parent_section, const char* pname)
     {
       if constexpr (is_std_optional<T>)
         // Optional: only serialize if non-empty
@@ -307,7 +309,7 @@ namespace epee
         return serialize_stl_container_t_obj(d, stg, parent_section, pname);
     }
     template<class T, class Storage>
-    bool kv_unserialize(T& d, Storage& stg, section* parent_section, const char* pname)
+    bool kv_unserialize(T& d, Storage& stg, typename Storage::section_type* parent_section, const char* pname)
     {
       if constexpr (is_std_optional<T>) {
         // Emplace a new value and try to deserialize into it
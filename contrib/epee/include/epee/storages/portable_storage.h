@@ -47,6 +47,11 @@ namespace epee
     class portable_storage
     {
     public:
+      // Section handle and blob read types used by the keyvalue_serialization overloads; see
+      // flat_storage for the read-only counterpart.
+      using section_type = section;
+      using blob_type = std::string;
+
       portable_storage() = default;
       virtual ~portable_storage() = default;
       section*   open_section(const std::string& section_name,  section* parent_section, bool create_if_notexist = false);
@@ -137,9 +142,13 @@ namespace epee
 
       //-------------------------------------------------------------------------------
       bool store_to_binary(std::string& target);
+      /// Same as above, but writes the binary data to an output stream rather than building a string
+      bool store_to_binary(std::ostream& target);
       bool load_from_binary(const epee::span<const uint8_t> target);
       bool load_from_binary(std::string_view target) { return load_from_binary(epee::strspan<uint8_t>(target)); }
       bool dump_as_json(std::string& targetObj, size_t indent = 0, bool insert_newlines = true);
+      /// Same as above, but writes the json to an output stream rather than building a string
+      bool dump_as_json(std::ostream& target, size_t indent = 0, bool insert_newlines = true);
       bool load_from_json(std::string_view source);
 
       /// Lets you store a pointer to some arbitrary context object; typically used to pass some
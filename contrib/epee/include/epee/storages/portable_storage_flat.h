@@ -0,0 +1,267 @@
+#pragma once
+
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <typeinfo>
+#include <variant>
+#include <vector>
+#include "portable_storage_base.h"
+#include "portable_storage_val_converters.h"
+#include "../span.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /// One node of a parsed flat_storage.  The nodes of a payload live in a single vector, in the
+    /// order they appear on the wire: a section or an array of strings/sections is followed
+    /// directly by its children, and `span` lets you hop over an entry's whole subtree.
+    ///
+    /// Names and string values point into the buffer given to flat_storage::load_from_binary, so
+    /// that buffer has to outlive the storage (and anything loaded as a std::string_view from it).
+    struct flat_entry
+    {
+      std::string_view name;
+      // String value; for arrays of fixed-width values, the packed little-endian elements.
+      std::string_view str;
+      // Integer or bool value
+      uint64_t bits = 0;
+      // Number of entries in a section, or elements in an array
+      uint32_t count = 0;
+      // Number of nodes in this entry's subtree, including itself
+      uint32_t span = 1;
+      // SERIALIZE_TYPE_TAG of the value, with SERIALIZE_FLAG_ARRAY set for arrays
+      uint8_t type = 0;
+
+      bool is_array() const { return type & SERIALIZE_FLAG_ARRAY; }
+      bool is_section() const { return type == SERIALIZE_TYPE_TAG<section>; }
+      const flat_entry* next() const { return this + span; }
+
+      // Iterates through the entries of a section, or the elements of an array of strings or
+      // sections.  (Arrays of fixed-width values have no child nodes; use
+      // flat_storage::converting_array_range for those).
+      class child_iterator {
+        const flat_entry* p;
+      public:
+        using value_type = flat_entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const flat_entry*;
+        using reference = const flat_entry&;
+        using iterator_category = std::forward_iterator_tag;
+
+        explicit child_iterator(const flat_entry* p) : p{p} {}
+        reference operator*() const { return *p; }
+        pointer operator->() const { return p; }
+        child_iterator& operator++() { p = p->next(); return *this; }
+        child_iterator operator++(int) { auto old = *this; ++*this; return old; }
+        bool operator==(const child_iterator& other) const { return p == other.p; }
+        bool operator!=(const child_iterator& other) const { return p != other.p; }
+      };
+      child_iterator begin() const { return child_iterator{this + 1}; }
+      child_iterator end() const { return child_iterator{next()}; }
+      size_t size() const { return count; }
+    };
+
+    /// Read-only replacement for portable_storage when loading binary payloads.  Loading is two
+    /// passes over flat data rather than a streaming parse: load_from_binary first parses the whole
+    /// payload into a flat vector of flat_entry nodes that reference the buffer in place (instead
+    /// of a tree of std::map sections holding copies of every name and value), and then a
+    /// KV_SERIALIZE'd struct's load walks those nodes, converting only the values it asks for.  A
+    /// struct thus loads with a single copy of each field it keeps, and blob fields are copied
+    /// straight out of the input buffer.
+    ///
+    /// There is no writer counterpart: storing still goes through portable_storage.
+    ///
+    /// The lookup/iteration interface mirrors the read side of portable_storage so that the
+    /// keyvalue_serialization overloads work unchanged against either storage.
+    class flat_storage
+    {
+    public:
+      using section_type = const flat_entry;
+      using blob_type = std::string_view;
+
+      flat_storage();
+      ~flat_storage();
+      flat_storage(const flat_storage&) = delete;
+      flat_storage& operator=(const flat_storage&) = delete;
+
+      /// Parses a binary portable storage payload.  The buffer is referenced, not copied.
+      bool load_from_binary(const epee::span<const uint8_t> source);
+      bool load_from_binary(std::string_view source) { return load_from_binary(epee::strspan<uint8_t>(source)); }
+
+      /// Returns the named child section, or nullptr if there isn't one.  The storage is
+      /// read-only, so create_if_notexist only exists for interface compatibility and must be
+      /// false.
+      const flat_entry* open_section(std::string_view section_name, const flat_entry* parent_section, bool create_if_notexist = false);
+
+      /// Converts the named value into `val`, with the same conversion rules (and exceptions) as
+      /// portable_storage::get_value.  Strings may also be fetched as a std::string_view pointing
+      /// into the loaded buffer.
+      template <typename T>
+      bool get_value(std::string_view value_name, T& val, const flat_entry* parent_section)
+      {
+        const flat_entry* e = find_entry(value_name, parent_section);
+        if (!e)
+          return false;
+        convert(*e, val);
+        return true;
+      }
+
+      // Input iterator through an array value that converts each element to `T` on dereference.
+      template <typename T>
+      class converting_array_iterator {
+        const flat_entry* array;
+        const flat_entry* node;
+        size_t index = 0;
+      public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T;
+        using iterator_category = std::input_iterator_tag;
+
+        explicit converting_array_iterator(const flat_entry& array, bool end = false)
+          : array{&array}, node{end ? array.next() : &array + 1}, index{end ? array.count : 0} {}
+        T operator*() const {
+          T val;
+          uint8_t elem_type = array->type & ~SERIALIZE_FLAG_ARRAY;
+          if (fixed_width(elem_type))
+            convert_bits(elem_type, read_element(*array, index), val);
+          else
+            convert(*node, val);
+          return val;
+        }
+        bool operator==(const converting_array_iterator& other) const { return array == other.array && index == other.index; }
+        bool operator!=(const converting_array_iterator& other) const { return !(*this == other); }
+        converting_array_iterator& operator++() {
+          if (!fixed_width(array->type & ~SERIALIZE_FLAG_ARRAY))
+            node = node->next();
+          ++index;
+          return *this;
+        }
+        converting_array_iterator operator++(int) {
+          auto old = *this;
+          ++*this;
+          return old;
+        }
+      };
+
+      // Returns an input iterator pair for an array with automatic value conversion to T.  Throws
+      // std::out_of_range if the member doesn't exist or std::bad_variant_access if the member
+      // isn't an array, just like portable_storage.
+      template <typename T>
+      std::pair<converting_array_iterator<T>, converting_array_iterator<T>>
+      converting_array_range(std::string_view value_name, const flat_entry* parent_section)
+      {
+        const flat_entry* e = find_entry(value_name, parent_section);
+        if (!e)
+          throw std::out_of_range{std::string{value_name} + " does not exist"};
+        if (!e->is_array())
+          throw std::bad_variant_access{};
+        return {converting_array_iterator<T>{*e}, converting_array_iterator<T>{*e, true}};
+      }
+
+      // Returns the named array of sections (iterable as flat_entry sections), or nullptr if the
+      // value doesn't exist or isn't an array of sections.
+      template <typename T>
+      const flat_entry* get_array(std::string_view value_name, const flat_entry* parent_section)
+      {
+        static_assert(std::is_same_v<T, section>, "flat_storage only supports get_array of sections");
+        const flat_entry* e = find_entry(value_name, parent_section);
+        if (e && e->type == (SERIALIZE_TYPE_TAG<section> | SERIALIZE_FLAG_ARRAY))
+          return e;
+        return nullptr;
+      }
+
+      /// Width in bytes of a fixed-width value type (i.e. one stored packed in arrays), or 0.
+      static constexpr size_t fixed_width(uint8_t type)
+      {
+        switch (type)
+        {
+          case SERIALIZE_TYPE_TAG<int64_t>: case SERIALIZE_TYPE_TAG<uint64_t>: return 8;
+          case SERIALIZE_TYPE_TAG<int32_t>: case SERIALIZE_TYPE_TAG<uint32_t>: return 4;
+          case SERIALIZE_TYPE_TAG<int16_t>: case SERIALIZE_TYPE_TAG<uint16_t>: return 2;
+          case SERIALIZE_TYPE_TAG<int8_t>: case SERIALIZE_TYPE_TAG<uint8_t>: case SERIALIZE_TYPE_TAG<bool>: return 1;
+          default: return 0;
+        }
+      }
+
+      /// Builds an owning storage_entry copy of a node (and its subtree).
+      static storage_entry materialize(const flat_entry& e);
+
+      /// Context pointer support; see portable_storage::set_context.
+      template <typename T> void set_context(const T* obj) { context_type = &typeid(T); context = obj; }
+      void clear_context() { context_type = nullptr; context = nullptr; }
+      template <typename T> const T* get_context() {
+        return (context && context_type && *context_type == typeid(T))
+            ? static_cast<const T*>(context)
+            : nullptr;
+      }
+
+    private:
+      const flat_entry* find_entry(std::string_view name, const flat_entry* parent_section) const;
+
+      static uint64_t read_element(const flat_entry& array, size_t index);
+
+      template <typename From, typename T>
+      static void assign(const From& from, T& val)
+      {
+        if constexpr (std::is_same_v<T, storage_entry>)
+          val = from;
+        else
+          convert_t(from, val);
+      }
+
+      template <typename T>
+      static void convert_bits(uint8_t type, uint64_t bits, T& val)
+      {
+        switch (type)
+        {
+          case SERIALIZE_TYPE_TAG<int64_t>:  return assign(static_cast<int64_t>(bits), val);
+          case SERIALIZE_TYPE_TAG<int32_t>:  return assign(static_cast<int32_t>(bits), val);
+          case SERIALIZE_TYPE_TAG<int16_t>:  return assign(static_cast<int16_t>(bits), val);
+          case SERIALIZE_TYPE_TAG<int8_t>:   return assign(static_cast<int8_t>(bits), val);
+          case SERIALIZE_TYPE_TAG<uint64_t>: return assign(static_cast<uint64_t>(bits), val);
+          case SERIALIZE_TYPE_TAG<uint32_t>: return assign(static_cast<uint32_t>(bits), val);
+          case SERIALIZE_TYPE_TAG<uint16_t>: return assign(static_cast<uint16_t>(bits), val);
+          case SERIALIZE_TYPE_TAG<uint8_t>:  return assign(static_cast<uint8_t>(bits), val);
+          case SERIALIZE_TYPE_TAG<bool>:     return assign(bits != 0, val);
+          default: ASSERT_MES_AND_THROW("flat_storage: unexpected value type " << +type);
+        }
+      }
+
+      template <typename T>
+      static void convert(const flat_entry& e, T& val)
+      {
+        if constexpr (std::is_same_v<T, storage_entry>)
+        {
+          val = materialize(e);
+          return;
+        }
+        else
+        {
+          if (e.type == SERIALIZE_TYPE_TAG<std::string>)
+          {
+            if constexpr (std::is_same_v<T, std::string>)
+              val.assign(e.str.data(), e.str.size());
+            else if constexpr (std::is_same_v<T, std::string_view>)
+              val = e.str;
+            else
+              convert_t(std::string{e.str}, val);
+          }
+          else
+          {
+            CHECK_AND_ASSERT_THROW_MES(!e.is_section() && !e.is_array(),
+                "WRONG DATA CONVERSION: " << (e.is_array() ? "array" : "section") << " value " << e.name << " to " << typeid(T).name());
+            convert_bits(e.type, e.bits, val);
+          }
+        }
+      }
+
+      std::vector<flat_entry> m_entries;
+      const void* context = nullptr;
+      const std::type_info* context_type = nullptr;
+    };
+  }
+}
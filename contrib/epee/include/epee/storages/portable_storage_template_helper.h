@@ -31,6 +31,7 @@
 
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
+#include "portable_storage_flat.h"
 
 namespace epee
 {
@@ -58,6 +59,14 @@ namespace epee
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
+    bool store_t_to_json(t_struct& str_in, std::ostream& json_out, size_t indent = 0, bool insert_newlines = true)
+    {
+      portable_storage ps;
+      str_in.store(ps);
+      return ps.dump_as_json(json_out, indent, insert_newlines);
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
     std::string store_t_to_json(t_struct& str_in, size_t indent = 0, bool insert_newlines = true)
     {
       std::string json_buff;
@@ -65,10 +74,17 @@ namespace epee
       return json_buff;
     }
     //-----------------------------------------------------------------------------------------------------------
+    // True if `T` can load itself straight from a flat_storage (i.e. everything using the KV
+    // serialization macros); types with hand-written portable_storage loaders can't.
+    template <typename T, typename = void>
+    constexpr bool is_flat_loadable = false;
+    template <typename T>
+    constexpr bool is_flat_loadable<T, std::void_t<decltype(std::declval<T&>().load(std::declval<flat_storage&>()))>> = true;
+    //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, const epee::span<const uint8_t> binary_buff)
     {
-      portable_storage ps;
+      std::conditional_t<is_flat_loadable<t_struct>, flat_storage, portable_storage> ps;
       bool rs = ps.load_from_binary(binary_buff);
       if(!rs)
         return false;
@@ -79,11 +95,7 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, std::string_view binary_buff)
     {
-      portable_storage ps;
-      if (!ps.load_from_binary(binary_buff))
-        return false;
-
-      return out.load(ps);
+      return load_t_from_binary(out, epee::strspan<uint8_t>(binary_buff));
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
@@ -95,6 +107,14 @@ namespace epee
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
+    bool store_t_to_binary(t_struct& str_in, std::ostream& binary_out)
+    {
+      portable_storage ps;
+      str_in.store(ps);
+      return ps.store_to_binary(binary_out);
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
     std::string store_t_to_binary(t_struct& str_in, size_t indent = 0)
     {
       std::string binary_buff;
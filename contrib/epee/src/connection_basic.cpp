@@ -41,11 +41,15 @@
 #include "epee/misc_language.h"
 #include "epee/pragma_comp_defs.h"
 #include <iomanip>
+#include <array>
+#include <algorithm>
+#include <cassert>
 
 #include <boost/asio/basic_socket.hpp>
 
 // TODO:
 #include "epee/net/network_throttle-detail.hpp"
+#include "epee/net/token_bucket.h"
 
 #if BOOST_VERSION >= 107000
 #define GET_IO_SERVICE(s) ((boost::asio::io_context&)(s).get_executor().context())
@@ -166,17 +170,93 @@ connection_basic::connection_basic(boost::asio::io_service &io_service, std::sha
 
 connection_basic::~connection_basic() noexcept(false) {
 	--(m_state->sock_count);
+	recv_buffer_pool::put(std::move(m_recv_buffer));
 
 	std::string remote_addr_str = "?";
 	try { boost::system::error_code e; remote_addr_str = socket().remote_endpoint(e).address().to_string(); } catch(...){} ;
 	MDEBUG("Destructing connection #"<<mI->m_peer_number << " to " << remote_addr_str);
 }
 
+namespace {
+	constexpr size_t RECV_BUFFER_SIZES = 6; // 8kB ... 256kB
+	static_assert(recv_buffer_pool::MIN_SIZE << (RECV_BUFFER_SIZES - 1) == recv_buffer_pool::MAX_SIZE);
+
+	std::mutex recv_buffer_pool_mutex;
+	std::array<std::vector<std::vector<char>>, RECV_BUFFER_SIZES> recv_buffer_pool_free;
+
+	size_t recv_buffer_size_index(size_t size) {
+		size_t i = 0;
+		while ((recv_buffer_pool::MIN_SIZE << i) < size)
+			++i;
+		return i;
+	}
+}
+
+std::vector<char> recv_buffer_pool::get(size_t size) {
+	assert(size >= MIN_SIZE && size <= MAX_SIZE && (size & (size - 1)) == 0);
+	{
+		std::lock_guard lock{recv_buffer_pool_mutex};
+		auto& free = recv_buffer_pool_free[recv_buffer_size_index(size)];
+		if (!free.empty()) {
+			std::vector<char> buf = std::move(free.back());
+			free.pop_back();
+			return buf;
+		}
+	}
+	return std::vector<char>(size);
+}
+
+void recv_buffer_pool::put(std::vector<char>&& buf) {
+	const size_t size = buf.size();
+	if (size < MIN_SIZE || size > MAX_SIZE || (size & (size - 1)) != 0)
+		return;
+	std::lock_guard lock{recv_buffer_pool_mutex};
+	auto& free = recv_buffer_pool_free[recv_buffer_size_index(size)];
+	if (free.size() < MAX_POOLED)
+		free.push_back(std::move(buf));
+}
+
+void connection_basic::adapt_recv_buffer(size_t bytes_read) {
+	const size_t size = m_recv_buffer.size();
+	size_t new_size = size;
+	if (bytes_read >= size) {
+		// Filled the whole buffer, so there is likely more waiting: read in bigger pieces
+		new_size = std::min(size * 2, recv_buffer_pool::MAX_SIZE);
+		m_recv_small_reads = 0;
+	}
+	else if (size > recv_buffer_pool::MIN_SIZE && bytes_read <= size / 8) {
+		if (++m_recv_small_reads >= 4) {
+			new_size = size / 2;
+			m_recv_small_reads = 0;
+		}
+	}
+	else
+		m_recv_small_reads = 0;
+
+	if (new_size != size) {
+		MTRACE("Resizing receive buffer from " << size << " to " << new_size << " bytes");
+		recv_buffer_pool::put(std::move(m_recv_buffer));
+		m_recv_buffer = recv_buffer_pool::get(new_size);
+	}
+}
+
+// Token buckets enforcing the global --limit-rate-up/down limits (in bytes per second)
+static token_bucket& global_bucket_in() {
+	static token_bucket bucket;
+	return bucket;
+}
+
+static token_bucket& global_bucket_out() {
+	static token_bucket bucket;
+	return bucket;
+}
+
 void connection_basic::set_rate_up_limit(uint64_t limit) {
 	{
 		std::lock_guard lock{network_throttle_manager::m_lock_get_global_throttle_out};
 		network_throttle_manager::get_global_throttle_out().set_target_speed(limit);
 	}
+	global_bucket_out().set_rate(limit * 1024);
 	save_limit_to_file(limit);
 }
 
@@ -190,6 +270,7 @@ void connection_basic::set_rate_down_limit(uint64_t limit) {
 	  std::lock_guard lock{network_throttle_manager::m_lock_get_global_throttle_inreq};
 		network_throttle_manager::get_global_throttle_inreq().set_target_speed(limit);
 	}
+	global_bucket_in().set_rate(limit * 1024);
     save_limit_to_file(limit);
 }
 
@@ -222,34 +303,20 @@ int connection_basic::get_tos_flag() {
 	return connection_basic_pimpl::m_default_tos;
 }
 
-void connection_basic::sleep_before_packet(size_t packet_size, int phase,  int q_len) {
-	double delay=0; // will be calculated
-	do
-	{ // rate limiting
-		if (m_was_shutdown) { 
-			MDEBUG("m_was_shutdown - so abort sleep");
-			return;
-		}
-
-		{ 
-			std::lock_guard lock{network_throttle_manager::m_lock_get_global_throttle_out};
-			delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size );
-		}
-
-		delay *= 0.50;
-		if (delay > 0) {
-            long int ms = (long int)(delay * 1000);
-			MTRACE("Sleeping in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
-			std::this_thread::sleep_for(std::chrono::milliseconds{ms});
-		}
-	} while(delay > 0);
+std::chrono::steady_clock::duration connection_basic::throttle_read(size_t packet_size) {
+	return global_bucket_in().consume(packet_size);
+}
 
-// XXX LATER XXX
+std::chrono::steady_clock::duration connection_basic::throttle_write(size_t packet_size) {
 	{
 	  std::lock_guard lock{network_throttle_manager::m_lock_get_global_throttle_out};
 		network_throttle_manager::get_global_throttle_out().handle_trafic_exact( packet_size ); // increase counter - global
 	}
+	return global_bucket_out().consume(packet_size);
+}
 
+std::chrono::steady_clock::duration connection_basic::write_delay() {
+	return global_bucket_out().delay();
 }
 
 void connection_basic::do_send_handler_write(const void* ptr , size_t cb ) {
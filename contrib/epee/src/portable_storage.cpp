@@ -92,6 +92,14 @@ namespace epee {
       CATCH_ENTRY("portable_storage::dump_as_json", false)
     }
 
+    bool portable_storage::dump_as_json(std::ostream& target, size_t indent, bool insert_newlines)
+    {
+      TRY_ENTRY();
+      epee::serialization::dump_as_json(target, m_root, indent, insert_newlines);
+      return true;
+      CATCH_ENTRY("portable_storage::dump_as_json", false)
+    }
+
     bool portable_storage::load_from_json(std::string_view source)
     {
       TRY_ENTRY();
@@ -114,6 +122,19 @@ namespace epee {
       CATCH_ENTRY("portable_storage::store_to_binary", false)
     }
 
+    bool portable_storage::store_to_binary(std::ostream& target)
+    {
+      TRY_ENTRY();
+      storage_block_header sbh{};
+      sbh.m_signature_a = PORTABLE_STORAGE_SIGNATUREA;
+      sbh.m_signature_b = PORTABLE_STORAGE_SIGNATUREB;
+      sbh.m_ver = PORTABLE_STORAGE_FORMAT_VER;
+      target.write(reinterpret_cast<const char*>(&sbh), sizeof(storage_block_header));
+      pack_entry_to_buff(target, m_root);
+      return true;
+      CATCH_ENTRY("portable_storage::store_to_binary", false)
+    }
+
     bool portable_storage::load_from_binary(const epee::span<const uint8_t> source)
     {
       m_root.m_entries.clear();
@@ -0,0 +1,300 @@
+#include "epee/storages/portable_storage_flat.h"
+#include "epee/storages/portable_storage.h"
+#include <boost/endian/conversion.hpp>
+#include <oxenmq/variant.h>
+#include <cstring>
+#include <limits>
+
+#undef LOKI_DEFAULT_LOG_CATEGORY
+#define LOKI_DEFAULT_LOG_CATEGORY "serialization"
+
+namespace epee
+{
+  namespace serialization
+  {
+    namespace
+    {
+      // Entry vectors are handed back to a per-thread cache when a storage is destroyed, so that
+      // steady-state loads (one levin message after another on the same io thread) reuse the
+      // capacity of earlier ones instead of allocating.
+      constexpr size_t MAX_SPARE_VECTORS = 4;
+      constexpr size_t MAX_SPARE_CAPACITY = 1 << 16;
+      thread_local std::vector<std::vector<flat_entry>> spare_entries;
+
+      uint64_t read_le(const uint8_t* p, size_t width)
+      {
+        switch (width)
+        {
+          case 1: return *p;
+          case 2: { uint16_t v; std::memcpy(&v, p, 2); return boost::endian::little_to_native(v); }
+          case 4: { uint32_t v; std::memcpy(&v, p, 4); return boost::endian::little_to_native(v); }
+          case 8: { uint64_t v; std::memcpy(&v, p, 8); return boost::endian::little_to_native(v); }
+        }
+        ASSERT_MES_AND_THROW("flat_storage: invalid value width " << width);
+      }
+
+      // Same wire format and sanity limits as throwable_buffer_reader, but producing flat_entry
+      // nodes that reference the input rather than a tree of owned values.
+      class flat_reader
+      {
+      public:
+        flat_reader(const uint8_t* ptr, size_t sz, std::vector<flat_entry>& out) : m_ptr{ptr}, m_count{sz}, m_out{out} {}
+
+        void read_section(size_t idx)
+        {
+          uint64_t count = read_varint();
+          CHECK_AND_ASSERT_THROW_MES(count <= m_count, "Size sanity check failed");
+          m_out[idx].type = SERIALIZE_TYPE_TAG<section>;
+          m_out[idx].count = static_cast<uint32_t>(count);
+          while (count--)
+          {
+            uint8_t name_len = take(1)[0];
+            auto name = take(name_len);
+            size_t child = m_out.size();
+            m_out.emplace_back().name = {reinterpret_cast<const char*>(name), name_len};
+            read_entry(child);
+          }
+          finish(idx);
+        }
+
+      private:
+        struct [[nodiscard]] recursion_limiter
+        {
+          size_t& m_counter_ref;
+          recursion_limiter(size_t& counter) : m_counter_ref(counter)
+          {
+            ++m_counter_ref;
+            CHECK_AND_ASSERT_THROW_MES(m_counter_ref < RECURSION_LIMIT, "Wrong blob data in portable storage: recursion limit (" << RECURSION_LIMIT << ") exceeded");
+          }
+          ~recursion_limiter() { --m_counter_ref; }
+        };
+
+        const uint8_t* take(size_t count)
+        {
+          CHECK_AND_ASSERT_THROW_MES(m_count >= count, " attempt to read " << count << " bytes from buffer with " << m_count << " bytes remained");
+          const uint8_t* p = m_ptr;
+          m_ptr += count;
+          m_count -= count;
+          return p;
+        }
+
+        uint64_t read_varint()
+        {
+          CHECK_AND_ASSERT_THROW_MES(m_count >= 1, "empty buff, expected place for varint");
+          size_t width = size_t{1} << (*m_ptr & PORTABLE_RAW_SIZE_MARK_MASK);
+          return read_le(take(width), width) >> 2;
+        }
+
+        void finish(size_t idx)
+        {
+          size_t span = m_out.size() - idx;
+          CHECK_AND_ASSERT_THROW_MES(span <= std::numeric_limits<uint32_t>::max(), "Too many entries in portable storage");
+          m_out[idx].span = static_cast<uint32_t>(span);
+        }
+
+        void read_entry(size_t idx)
+        {
+          recursion_limiter lim{m_recursion_count};
+          uint8_t type = take(1)[0];
+          if (type & SERIALIZE_FLAG_ARRAY)
+            read_array(idx, type);
+          else
+            read_value(idx, type);
+        }
+
+        void read_value(size_t idx, uint8_t type)
+        {
+          if (type == SERIALIZE_TYPE_TAG<section>)
+            return read_section(idx);
+
+          auto& e = m_out[idx];
+          e.type = type;
+          if (type == SERIALIZE_TYPE_TAG<std::string>)
+          {
+            uint64_t len = read_varint();
+            CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+            CHECK_AND_ASSERT_THROW_MES(m_count >= len, "string len count value " << len << " goes out of remain storage len " << m_count);
+            e.str = {reinterpret_cast<const char*>(take(len)), len};
+          }
+          else if (size_t width = flat_storage::fixed_width(type))
+            e.bits = read_le(take(width), width);
+          else
+            ASSERT_MES_AND_THROW("unknown entry_type code = " << +type);
+        }
+
+        void read_array(size_t idx, uint8_t type)
+        {
+          recursion_limiter lim{m_recursion_count};
+          uint8_t elem_type = type & ~SERIALIZE_FLAG_ARRAY;
+          uint64_t size = read_varint();
+          CHECK_AND_ASSERT_THROW_MES(size <= m_count, "Size sanity check failed");
+          m_out[idx].type = type;
+          m_out[idx].count = static_cast<uint32_t>(size);
+          if (size_t width = flat_storage::fixed_width(elem_type))
+          {
+            CHECK_AND_ASSERT_THROW_MES(m_count / width >= size, " attempt to read " << size << " array values from buffer with " << m_count << " bytes remained");
+            m_out[idx].str = {reinterpret_cast<const char*>(take(size * width)), size * width};
+          }
+          else if (elem_type == SERIALIZE_TYPE_TAG<std::string> || elem_type == SERIALIZE_TYPE_TAG<section>)
+          {
+            while (size--)
+            {
+              size_t child = m_out.size();
+              m_out.emplace_back();
+              read_value(child, elem_type);
+            }
+          }
+          else
+            ASSERT_MES_AND_THROW("unknown entry_type code = " << +elem_type);
+          finish(idx);
+        }
+
+        const uint8_t* m_ptr;
+        size_t m_count;
+        size_t m_recursion_count = 0;
+        std::vector<flat_entry>& m_out;
+      };
+
+      template <typename T>
+      storage_entry materialize_array(const flat_entry& e)
+      {
+        storage_entry se{std::in_place_type<array_entry>, std::in_place_type<array_t<T>>};
+        auto& arr = var::get<array_t<T>>(var::get<array_entry>(se));
+        if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, section>)
+        {
+          for (auto& child : e)
+          {
+            auto v = flat_storage::materialize(child);
+            arr.push_back(std::move(var::get<T>(v)));
+          }
+        }
+        else
+        {
+          for (size_t i = 0; i < e.count; i++)
+          {
+            uint64_t bits = read_le(reinterpret_cast<const uint8_t*>(e.str.data()) + i * sizeof(T), sizeof(T));
+            if constexpr (std::is_same_v<T, bool>)
+              arr.push_back(bits != 0);
+            else
+              arr.push_back(static_cast<T>(bits));
+          }
+        }
+        return se;
+      }
+    }
+
+    flat_storage::flat_storage()
+    {
+      if (!spare_entries.empty())
+      {
+        m_entries = std::move(spare_entries.back());
+        spare_entries.pop_back();
+      }
+    }
+
+    flat_storage::~flat_storage()
+    {
+      if (spare_entries.size() < MAX_SPARE_VECTORS && m_entries.capacity() <= MAX_SPARE_CAPACITY)
+      {
+        m_entries.clear();
+        spare_entries.push_back(std::move(m_entries));
+      }
+    }
+
+    bool flat_storage::load_from_binary(const epee::span<const uint8_t> source)
+    {
+      m_entries.clear();
+      constexpr size_t header_size = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+      if (source.size() < header_size)
+      {
+        LOG_ERROR("flat_storage: wrong binary format, packet size = " << source.size() << " less than expected header size " << header_size);
+        return false;
+      }
+      uint32_t sig_a, sig_b;
+      std::memcpy(&sig_a, source.data(), sizeof(sig_a));
+      std::memcpy(&sig_b, source.data() + sizeof(sig_a), sizeof(sig_b));
+      if (sig_a != PORTABLE_STORAGE_SIGNATUREA || sig_b != PORTABLE_STORAGE_SIGNATUREB)
+      {
+        LOG_ERROR("flat_storage: wrong binary format - signature mismatch");
+        return false;
+      }
+      if (uint8_t ver = source.data()[2 * sizeof(uint32_t)]; ver != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("flat_storage: wrong binary format - unknown format ver = " << +ver);
+        return false;
+      }
+      TRY_ENTRY();
+      flat_reader reader{source.data() + header_size, source.size() - header_size, m_entries};
+      m_entries.emplace_back();
+      reader.read_section(0);
+      return true;
+      CATCH_ENTRY("flat_storage::load_from_binary", (m_entries.clear(), false));
+    }
+
+    const flat_entry* flat_storage::find_entry(std::string_view name, const flat_entry* parent_section) const
+    {
+      if (!parent_section)
+      {
+        if (m_entries.empty())
+          return nullptr;
+        parent_section = &m_entries.front();
+      }
+      for (auto& e : *parent_section)
+        if (e.name == name)
+          return &e;
+      return nullptr;
+    }
+
+    const flat_entry* flat_storage::open_section(std::string_view section_name, const flat_entry* parent_section, bool create_if_notexist)
+    {
+      CHECK_AND_ASSERT_MES(!create_if_notexist, nullptr, "flat_storage is read-only");
+      const flat_entry* e = find_entry(section_name, parent_section);
+      return e && e->is_section() ? e : nullptr;
+    }
+
+    uint64_t flat_storage::read_element(const flat_entry& array, size_t index)
+    {
+      size_t width = fixed_width(array.type & ~SERIALIZE_FLAG_ARRAY);
+      return read_le(reinterpret_cast<const uint8_t*>(array.str.data()) + index * width, width);
+    }
+
+    storage_entry flat_storage::materialize(const flat_entry& e)
+    {
+      switch (e.type)
+      {
+        case SERIALIZE_TYPE_TAG<int64_t>:     return static_cast<int64_t>(e.bits);
+        case SERIALIZE_TYPE_TAG<int32_t>:     return static_cast<int32_t>(e.bits);
+        case SERIALIZE_TYPE_TAG<int16_t>:     return static_cast<int16_t>(e.bits);
+        case SERIALIZE_TYPE_TAG<int8_t>:      return static_cast<int8_t>(e.bits);
+        case SERIALIZE_TYPE_TAG<uint64_t>:    return static_cast<uint64_t>(e.bits);
+        case SERIALIZE_TYPE_TAG<uint32_t>:    return static_cast<uint32_t>(e.bits);
+        case SERIALIZE_TYPE_TAG<uint16_t>:    return static_cast<uint16_t>(e.bits);
+        case SERIALIZE_TYPE_TAG<uint8_t>:     return static_cast<uint8_t>(e.bits);
+        case SERIALIZE_TYPE_TAG<bool>:        return e.bits != 0;
+        case SERIALIZE_TYPE_TAG<std::string>: return std::string{e.str};
+        case SERIALIZE_TYPE_TAG<section>:
+        {
+          section sec;
+          for (auto& child : e)
+            sec.m_entries.emplace(child.name, materialize(child));
+          return sec;
+        }
+      }
+      switch (e.type & ~SERIALIZE_FLAG_ARRAY)
+      {
+        case SERIALIZE_TYPE_TAG<int64_t>:     return materialize_array<int64_t>(e);
+        case SERIALIZE_TYPE_TAG<int32_t>:     return materialize_array<int32_t>(e);
+        case SERIALIZE_TYPE_TAG<int16_t>:     return materialize_array<int16_t>(e);
+        case SERIALIZE_TYPE_TAG<int8_t>:      return materialize_array<int8_t>(e);
+        case SERIALIZE_TYPE_TAG<uint64_t>:    return materialize_array<uint64_t>(e);
+        case SERIALIZE_TYPE_TAG<uint32_t>:    return materialize_array<uint32_t>(e);
+        case SERIALIZE_TYPE_TAG<uint16_t>:    return materialize_array<uint16_t>(e);
+        case SERIALIZE_TYPE_TAG<uint8_t>:     return materialize_array<uint8_t>(e);
+        case SERIALIZE_TYPE_TAG<bool>:        return materialize_array<bool>(e);
+        case SERIALIZE_TYPE_TAG<std::string>: return materialize_array<std::string>(e);
+        case SERIALIZE_TYPE_TAG<section>:     return materialize_array<section>(e);
+      }
+      ASSERT_MES_AND_THROW("flat_storage: unexpected value type " << +e.type);
+    }
+  }
+}
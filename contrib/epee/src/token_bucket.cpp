@@ -0,0 +1,60 @@
+#include "epee/net/token_bucket.h"
+#include <algorithm>
+
+namespace epee
+{
+namespace net_utils
+{
+
+  void token_bucket::set_rate(uint64_t bytes_per_second, uint64_t burst)
+  {
+    std::lock_guard lock{m_mutex};
+    refill(clock::now());
+    m_rate = bytes_per_second;
+    m_burst = burst ? burst : bytes_per_second;
+    m_tokens = std::min(m_tokens, m_burst);
+  }
+
+  uint64_t token_bucket::rate() const
+  {
+    std::lock_guard lock{m_mutex};
+    return m_rate;
+  }
+
+  void token_bucket::refill(clock::time_point now) const
+  {
+    if (now > m_last)
+    {
+      m_tokens = std::min(m_burst, m_tokens + m_rate * std::chrono::duration<double>(now - m_last).count());
+      m_last = now;
+    }
+  }
+
+  token_bucket::clock::duration token_bucket::debt_delay() const
+  {
+    if (m_tokens >= 0 || m_rate <= 0)
+      return clock::duration::zero();
+    return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(-m_tokens / m_rate));
+  }
+
+  token_bucket::clock::duration token_bucket::consume(size_t bytes)
+  {
+    std::lock_guard lock{m_mutex};
+    if (m_rate <= 0)
+      return clock::duration::zero();
+    refill(clock::now());
+    m_tokens -= bytes;
+    return debt_delay();
+  }
+
+  token_bucket::clock::duration token_bucket::delay() const
+  {
+    std::lock_guard lock{m_mutex};
+    if (m_rate <= 0)
+      return clock::duration::zero();
+    refill(clock::now());
+    return debt_delay();
+  }
+
+}
+}
@@ -427,52 +427,26 @@ bool BlockchainDB::get_alt_block_header(const crypto::hash &blkid, alt_block_dat
   return true;
 }
 
-void BlockchainDB::fill_timestamps_and_difficulties_for_pow(cryptonote::network_type nettype,
-                                                            std::vector<uint64_t> &timestamps,
-                                                            std::vector<uint64_t> &difficulties,
-                                                            uint64_t chain_height,
-                                                            uint64_t timestamps_difficulty_height) const
+void BlockchainDB::fill_difficulty_window(difficulty_window& window, uint64_t height, uint64_t block_count) const
 {
-  constexpr uint64_t MIN_CHAIN_HEIGHT = 2;
-  if (chain_height < MIN_CHAIN_HEIGHT)
-    return;
-
-  uint64_t const top_block_height   = chain_height - 1;
-  static const uint64_t hf16_height = HardFork::get_hardcoded_hard_fork_height(nettype, cryptonote::network_version_16_pulse);
-  bool const before_hf16            = chain_height < hf16_height;
-  uint64_t const block_count        = DIFFICULTY_BLOCKS_COUNT(before_hf16);
-
-  timestamps.reserve(block_count);
-  difficulties.reserve(block_count);
-
-  if (timestamps_difficulty_height == 0 ||
-      (chain_height - timestamps_difficulty_height) != 1 ||
-      timestamps.size()   > block_count ||
-      difficulties.size() > block_count)
+  // The genesis block never takes part in difficulty calculations
+  uint64_t const start_height = std::max<uint64_t>(height - std::min(height, block_count), 1);
+  if (height <= start_height)
   {
-    // Cache invalidated.
-    timestamps.clear();
-    difficulties.clear();
-
-    // Fill missing timestamps/difficulties, up to one before the latest (latest is added below).
-    uint64_t start_height = chain_height - std::min<size_t>(chain_height, block_count);
-    start_height          = std::max<uint64_t>(start_height, 1);
-
-    for (uint64_t block_height = start_height; block_height < (chain_height - 1) /*skip latest block*/; block_height++)
-    {
-      timestamps.push_back(get_block_timestamp(block_height));
-      difficulties.push_back(get_block_cumulative_difficulty(block_height));
-    }
+    window.reset(height);
+    return;
   }
 
-  // Add latest timestamp/difficulty
-  add_timestamp_and_difficulty(nettype,
-                               chain_height,
-                               timestamps,
-                               difficulties,
-                               get_block_timestamp(top_block_height),
-                               get_block_cumulative_difficulty(top_block_height));
+  window.truncate(height);
+  // If the window ends before the blocks we need start then there's nothing in it we can reuse
+  if (window.height() < start_height)
+    window.reset(start_height);
+
+  for (uint64_t block_height = window.height(); block_height < height; block_height++)
+    window.push_back(get_block_timestamp(block_height), get_block_cumulative_difficulty(block_height));
 
+  for (uint64_t block_height = window.start_height(); block_height > start_height; block_height--)
+    window.push_front(get_block_timestamp(block_height - 1), get_block_cumulative_difficulty(block_height - 1));
 }
 
 
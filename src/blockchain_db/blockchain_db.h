@@ -1860,32 +1860,15 @@ public:
   /// found, false if not found.
   virtual bool remove_masternode_proof(const crypto::public_key &pubkey) = 0;
 
-  // This function accepts an empty timestamps/difficulties array to fill, or
-  // a prior timestamps/difficulties array that was filled by a previous call to
-  // this same function in which case it will optimally insert and remove the
-  // new data instead of reconstructing the entrie array.
+  // Loads the timestamps and cumulative difficulties of the main chain blocks that the
+  // difficulty of the block at `height` is calculated from into `window`: the `block_count` blocks
+  // below `height`, or every block after the genesis block if there are fewer than that.
   //
-  // timestamps: On return, timestamps of the last loaded
-  // 'DIFFICULTY_WINDOW' blocks starting from top_block_height stored in
-  // ascending block height order.
-  //
-  // difficulties: On return, cumulative difficulties of the last loaded
-  // DIFFICULTY_WINDOW blocks starting from 'top_block_height' stored in
-  // ascending block height order
-  //
-  // chain_height: The blockchain height, (next height a block will be added
-  // at). The input arrays will be filled with the prior `timestamps` and
-  // `difficulties` DIFFICULTY_WINDOW worth of values.
-  //
-  // timestamps_difficulty_height: The last 'chain_height' that this function
-  // was invoked and loaded historical timestamp/difficulties into (allowing
-  // this function to be called iteratively on the same input arrays over time).
-  // This should be set to 0 on the initial call.
-  void fill_timestamps_and_difficulties_for_pow(cryptonote::network_type nettype,
-                                                std::vector<uint64_t> &timestamps,
-                                                std::vector<uint64_t> &difficulties,
-                                                uint64_t chain_height,
-                                                uint64_t timestamps_difficulty_height) const;
+  // Blocks that `window` already holds are not reloaded, so calling this repeatedly on the same
+  // window as the chain grows only reads the new blocks.  The caller is responsible for `window`
+  // only holding main chain blocks (i.e. for truncating it when blocks are popped), and for
+  // trimming it if it shouldn't hold more blocks than needed.
+  void fill_difficulty_window(difficulty_window& window, uint64_t height, uint64_t block_count) const;
 
   /**
    * @brief set whether or not to automatically remove logs
@@ -40,6 +40,7 @@
 #include "common/file.h"
 #include "common/pruning.h"
 #include "common/hex.h"
+#include "common/trace.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "epee/profile_tools.h"
@@ -528,6 +529,7 @@ void mdb_txn_safe::commit(std::string message)
     message = "Failed to commit a transaction to the db";
   }
 
+  TRACE_SPAN(lmdb_commit);
   if (auto result = mdb_txn_commit(m_txn))
   {
     m_txn = nullptr;
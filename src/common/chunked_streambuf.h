@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace tools {
+
+/// Output stream buffer that writes into a list of fixed-size string chunks rather than one
+/// contiguous, repeatedly reallocated string.  This is used to serialize large values (such as big
+/// RPC responses) without ever holding a second full copy of the output, and so that the consumer
+/// can hand the pieces off (and free them) one at a time.
+///
+///     tools::chunked_streambuf buf{65536};
+///     std::ostream out{&buf};
+///     out << ...;
+///     std::vector<std::string> pieces = buf.release();
+///
+/// Every returned chunk except the last is exactly `chunk_size` bytes long.
+class chunked_streambuf : public std::streambuf {
+public:
+  explicit chunked_streambuf(size_t chunk_size) : chunk_size_{chunk_size > 0 ? chunk_size : 1} {}
+
+  chunked_streambuf(const chunked_streambuf&) = delete;
+  chunked_streambuf& operator=(const chunked_streambuf&) = delete;
+
+  /// Extracts the written chunks, resetting this buffer to empty.
+  std::vector<std::string> release() {
+    if (!chunks_.empty())
+      chunks_.back().resize(pptr() - pbase());
+    setp(nullptr, nullptr);
+    return std::move(chunks_);
+  }
+
+protected:
+  int_type overflow(int_type ch) override {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+      return traits_type::not_eof(ch);
+    next_chunk();
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+    return ch;
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    std::streamsize written = 0;
+    while (written < n) {
+      if (pptr() == epptr())
+        next_chunk();
+      auto len = std::min<std::streamsize>(n - written, epptr() - pptr());
+      traits_type::copy(pptr(), s + written, static_cast<size_t>(len));
+      // pbump takes an int, but len is bounded by chunk_size_ here
+      pbump(static_cast<int>(len));
+      written += len;
+    }
+    return written;
+  }
+
+private:
+  void next_chunk() {
+    auto& c = chunks_.emplace_back();
+    c.resize(chunk_size_);
+    setp(c.data(), c.data() + c.size());
+  }
+
+  size_t chunk_size_;
+  std::vector<std::string> chunks_;
+};
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace tools {
+
+/// Histogram of durations with power-of-two microsecond buckets: bucket 0 counts durations under
+/// 1µs, bucket i (for i > 0) counts durations in [2^(i-1), 2^i) µs, and the last bucket also takes
+/// everything longer.  All updates are lock-free (relaxed atomics) so it can be fed from any number
+/// of threads; a snapshot taken while updates are happening may be very slightly inconsistent
+/// (e.g. the count may be one ahead of the buckets), which is fine for monitoring purposes.
+class latency_histogram {
+public:
+  static constexpr size_t BUCKETS = 32; // The last regular bucket boundary is 2^30µs ≈ 18 minutes
+
+  /// Returns the bucket index for a duration of `us` microseconds
+  static constexpr size_t bucket_for(uint64_t us) {
+    size_t b = 0;
+    while (us) { us >>= 1; b++; }
+    return b < BUCKETS ? b : BUCKETS - 1;
+  }
+
+  /// Returns the (exclusive) upper bound, in microseconds, of values counted in bucket `b`.  The
+  /// last bucket is unbounded; for it we return its lower bound.
+  static constexpr uint64_t bucket_upper_us(size_t b) {
+    return uint64_t{1} << (b < BUCKETS - 1 ? b : BUCKETS - 2);
+  }
+
+  /// A point-in-time copy of the histogram values
+  struct snapshot {
+    uint64_t count = 0;
+    uint64_t sum_us = 0;
+    uint64_t max_us = 0;
+    std::array<uint64_t, BUCKETS> buckets{};
+
+    /// Estimates the value at the given quantile (0 < q <= 1) as the upper bound of the bucket
+    /// containing it, capped at the maximum observed value.  Returns 0 if there are no values.
+    uint64_t quantile_us(double q) const {
+      if (count == 0) return 0;
+      uint64_t target = static_cast<uint64_t>(q * count + 0.5);
+      if (target < 1) target = 1;
+      uint64_t seen = 0;
+      for (size_t b = 0; b < BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= target)
+          return std::min(bucket_upper_us(b), max_us);
+      }
+      return max_us;
+    }
+
+    uint64_t mean_us() const { return count ? sum_us / count : 0; }
+
+    snapshot& operator+=(const snapshot& o) {
+      count += o.count;
+      sum_us += o.sum_us;
+      if (o.max_us > max_us) max_us = o.max_us;
+      for (size_t b = 0; b < BUCKETS; b++)
+        buckets[b] += o.buckets[b];
+      return *this;
+    }
+  };
+
+  void add_us(uint64_t us) {
+    buckets_[bucket_for(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max = max_us_.load(std::memory_order_relaxed);
+    while (us > max && !max_us_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {}
+  }
+
+  template <typename Rep, typename Period>
+  void add(std::chrono::duration<Rep, Period> d) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    add_us(us > 0 ? static_cast<uint64_t>(us) : 0);
+  }
+
+  snapshot get() const {
+    snapshot s;
+    s.count = count_.load(std::memory_order_relaxed);
+    s.sum_us = sum_us_.load(std::memory_order_relaxed);
+    s.max_us = max_us_.load(std::memory_order_relaxed);
+    for (size_t b = 0; b < BUCKETS; b++)
+      s.buckets[b] = buckets_[b].load(std::memory_order_relaxed);
+    return s;
+  }
+
+  void reset() {
+    for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_us_.store(0, std::memory_order_relaxed);
+    max_us_.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_us_{0};
+  std::atomic<uint64_t> max_us_{0};
+};
+
+}
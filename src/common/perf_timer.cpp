@@ -27,6 +27,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "epee/misc_os_dependent.h"
 #include "perf_timer.h"
@@ -48,6 +52,101 @@ el::Level performance_timer_log_level = el::Level::Info;
 
 static thread_local std::vector<LoggingPerformanceTimer*> *performance_timers = NULL;
 
+namespace
+{
+  // Each thread records into its own histograms so that timers never contend with each other.  The
+  // owning thread only takes `lock` when adding a new timer name; readers hold it while walking
+  // the histograms.
+  struct thread_perf_stats
+  {
+    std::mutex lock;
+    std::unordered_map<std::string, latency_histogram> timers;
+
+    thread_perf_stats();
+    ~thread_perf_stats();
+
+    latency_histogram& get(const std::string& name)
+    {
+      if (auto it = timers.find(name); it != timers.end())
+        return it->second;
+      std::lock_guard l{lock};
+      return timers.try_emplace(name).first->second;
+    }
+  };
+
+  struct perf_stats_registry
+  {
+    std::mutex lock;
+    std::unordered_set<thread_perf_stats*> threads;
+    std::unordered_map<std::string, latency_histogram::snapshot> exited; // Stats of threads that have finished
+  };
+
+  perf_stats_registry& registry()
+  {
+    // Never destroyed: threads can still be exiting (and folding in their stats) during static
+    // destruction.
+    static auto* r = new perf_stats_registry;
+    return *r;
+  }
+
+  thread_perf_stats::thread_perf_stats()
+  {
+    auto& r = registry();
+    std::lock_guard l{r.lock};
+    r.threads.insert(this);
+  }
+
+  thread_perf_stats::~thread_perf_stats()
+  {
+    auto& r = registry();
+    std::lock_guard l{r.lock};
+    r.threads.erase(this);
+    for (auto& [name, h] : timers)
+      r.exited[name] += h.get();
+  }
+
+  void record_perf_timer(const std::string& name, uint64_t ns)
+  {
+    thread_local thread_perf_stats stats;
+    stats.get(name).add_us(ns / 1000);
+  }
+}
+
+std::vector<perf_timer_stats> get_perf_timer_stats()
+{
+  std::map<std::string, latency_histogram::snapshot> sums;
+  {
+    auto& r = registry();
+    std::lock_guard l{r.lock};
+    sums.insert(r.exited.begin(), r.exited.end());
+    for (auto* t : r.threads)
+    {
+      std::lock_guard tl{t->lock};
+      for (auto& [name, h] : t->timers)
+        sums[name] += h.get();
+    }
+  }
+  std::vector<perf_timer_stats> result;
+  result.reserve(sums.size());
+  for (auto& [name, timing] : sums)
+    if (timing.count > 0)
+      result.push_back({name, timing});
+  return result;
+}
+
+void reset_perf_timer_stats()
+{
+  auto& r = registry();
+  std::lock_guard l{r.lock};
+  r.exited.clear();
+  for (auto* t : r.threads)
+  {
+    std::lock_guard tl{t->lock};
+    for (auto& [name, h] : t->timers)
+      h.reset();
+  }
+}
+
 void set_performance_timer_log_level(el::Level level)
 {
   if (level != el::Level::Debug && level != el::Level::Trace && level != el::Level::Info
@@ -96,6 +195,7 @@ LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std
 LoggingPerformanceTimer::~LoggingPerformanceTimer()
 {
   pause();
+  record_perf_timer(name, ticks);
   performance_timers->pop_back();
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (log)
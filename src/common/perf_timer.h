@@ -32,7 +32,9 @@
 #include <string>
 #include <cstdio>
 #include <cstdint>
+#include <vector>
 #include "epee/misc_log_ex.h"
+#include "latency_histogram.h"
 
 namespace tools
 {
@@ -72,6 +74,31 @@ private:
 
 void set_performance_timer_log_level(el::Level level);
 
+/// Timings of one PERF_TIMER name, summed over all threads
+struct perf_timer_stats
+{
+  std::string name;
+  latency_histogram::snapshot timing;
+};
+
+/// Returns the timings of every PERF_TIMER that has finished since startup (or the last reset),
+/// sorted by name.  Timers record these whether or not their perf.* log category is enabled;
+/// each thread records into its own histograms, which are only summed up here.
+std::vector<perf_timer_stats> get_perf_timer_stats();
+void reset_perf_timer_stats();
+
+#ifdef QUENERO_DISABLE_PERF_TIMERS
+// Built with -DPERF_TIMERS=OFF: the timers (and so their logging and stats) are compiled out
+#define PERF_TIMER_UNIT(name, unit) do {} while(0)
+#define PERF_TIMER_UNIT_L(name, unit, l) do {} while(0)
+#define PERF_TIMER(name) do {} while(0)
+#define PERF_TIMER_L(name, l) do {} while(0)
+#define PERF_TIMER_START_UNIT(name, unit) do {} while(0)
+#define PERF_TIMER_START(name) do {} while(0)
+#define PERF_TIMER_STOP(name) do {} while(0)
+#define PERF_TIMER_PAUSE(name) do {} while(0)
+#define PERF_TIMER_RESUME(name) do {} while(0)
+#else
 #define PERF_TIMER_UNIT(name, unit) tools::LoggingPerformanceTimer pt_##name(#name, "perf." QUENERO_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level)
 #define PERF_TIMER_UNIT_L(name, unit, l) tools::LoggingPerformanceTimer pt_##name(#name, "perf." QUENERO_DEFAULT_LOG_CATEGORY, unit, l)
 #define PERF_TIMER(name) PERF_TIMER_UNIT(name, 1000000)
@@ -81,5 +108,6 @@ void set_performance_timer_log_level(el::Level level);
 #define PERF_TIMER_STOP(name) do { pt_##name.reset(NULL); } while(0)
 #define PERF_TIMER_PAUSE(name) pt_##name->pause()
 #define PERF_TIMER_RESUME(name) pt_##name->resume()
+#endif
 
 }
@@ -31,23 +31,129 @@
 #include "cryptonote_config.h"
 #include "common/util.h"
 
-static thread_local int depth = 0;
-static thread_local bool is_leaf = false;
-
 namespace tools
 {
-threadpool::threadpool(unsigned int max_threads) : running(true), active(0) {
+namespace
+{
+  thread_local bool is_leaf = false;
+  // The pool (if any) the current thread is a worker of, and its index there
+  thread_local const threadpool* worker_of = nullptr;
+  thread_local size_t worker_index = 0;
+  constexpr size_t NO_WORKER = static_cast<size_t>(-1);
+
+  // Idle workers retry this many times before going to sleep
+  constexpr int SPIN_TRIES = 64;
+  // Most tasks a worker moves from the shared queue onto its own deque at once
+  constexpr size_t MAX_INJECTED_BATCH = 32;
+
+  size_t random_index(size_t n)
+  {
+    thread_local uint32_t x = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x % n;
+  }
+}
+
+// Chase-Lev work-stealing deque (with the memory orderings of Lê et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models").  Only the owning worker pushes and pops, at the
+// bottom; other threads steal from the top.  Arrays replaced when growing are kept until the
+// deque is destroyed since a thief may still be reading them.
+class threadpool::work_deque
+{
+  struct array
+  {
+    explicit array(int64_t size) : size{size}, slots{new std::atomic<task*>[size]} {}
+    task* get(int64_t i) const { return slots[i & (size - 1)].load(std::memory_order_relaxed); }
+    void put(int64_t i, task* t) { slots[i & (size - 1)].store(t, std::memory_order_relaxed); }
+    const int64_t size;
+    std::unique_ptr<std::atomic<task*>[]> slots;
+  };
+
+  std::atomic<int64_t> top{0}, bottom{0};
+  std::atomic<array*> current;
+  std::vector<std::unique_ptr<array>> arrays;
+
+public:
+  work_deque() : arrays{} {
+    arrays.push_back(std::make_unique<array>(256));
+    current.store(arrays.back().get(), std::memory_order_relaxed);
+  }
+
+  void push(task* t)
+  {
+    const int64_t b = bottom.load(std::memory_order_relaxed);
+    const int64_t tp = top.load(std::memory_order_acquire);
+    array* a = current.load(std::memory_order_relaxed);
+    if (b - tp > a->size - 1)
+    {
+      auto bigger = std::make_unique<array>(a->size * 2);
+      for (int64_t i = tp; i < b; i++)
+        bigger->put(i, a->get(i));
+      a = bigger.get();
+      arrays.push_back(std::move(bigger));
+      current.store(a, std::memory_order_release);
+    }
+    a->put(b, t);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  task* pop()
+  {
+    const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    array* a = current.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t tp = top.load(std::memory_order_relaxed);
+    if (tp > b)
+    {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    task* t = a->get(b);
+    if (tp == b)
+    {
+      // Last one: race the thieves for it
+      if (!top.compare_exchange_strong(tp, tp + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        t = nullptr;
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return t;
+  }
+
+  task* steal()
+  {
+    int64_t tp = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom.load(std::memory_order_acquire);
+    if (tp >= b)
+      return nullptr;
+    task* t = current.load(std::memory_order_acquire)->get(tp);
+    if (!top.compare_exchange_strong(tp, tp + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return nullptr;
+    return t;
+  }
+};
+
+threadpool::threadpool(unsigned int max_threads) : n_injected(0), queued(0), sleeping(0), running(true) {
   create(max_threads);
 }
 
 threadpool::~threadpool() {
   destroy();
+  for (task* t : injected)
+  {
+    t->invoke(*t, false);
+    delete t;
+  }
 }
 
 void threadpool::destroy() {
   try
   {
-    const std::unique_lock lock{mutex};
+    const std::unique_lock lock{sleep_mutex};
     running = false;
     has_work.notify_all();
   }
@@ -63,6 +169,14 @@ void threadpool::destroy() {
     catch (...) { /* ignore */ }
   }
   threads.clear();
+  // Keep whatever the workers left behind for the next set of threads
+  for (auto& d : deques)
+    while (task* t = d->steal())
+    {
+      injected.push_back(t);
+      ++n_injected;
+    }
+  deques.clear();
 }
 
 void threadpool::recycle() {
@@ -71,37 +185,142 @@ void threadpool::recycle() {
 }
 
 void threadpool::create(unsigned int max_threads) {
-  const std::unique_lock lock{mutex};
-  max = max_threads ? max_threads : tools::get_max_concurrency();
+  max = max_threads ? max_threads : tools::get_thread_budget().verify;
   running = true;
-  for (size_t i = max ? max : 1; i > 0; i--) {
-    threads.emplace_back([this] { run(false); });
+  const size_t count = max ? max : 1;
+  for (size_t i = 0; i < count; i++)
+    deques.push_back(std::make_unique<work_deque>());
+  for (size_t i = 0; i < count; i++)
+    threads.emplace_back([this, i] { run(i); });
+}
+
+// Finished tasks are kept on a per-thread free list, so that tasks spawned by tasks are
+// recycled instead of going through the allocator each time.
+struct threadpool::task_cache
+{
+  static constexpr size_t MAX_SIZE = 256;
+  task* head = nullptr;
+  size_t size = 0;
+  ~task_cache() {
+    while (head)
+      delete std::exchange(head, head->next);
   }
+};
+
+threadpool::task_cache& threadpool::local_task_cache() {
+  thread_local task_cache cache;
+  return cache;
 }
 
-void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
+threadpool::task* threadpool::allocate_task() {
+  auto& cache = local_task_cache();
+  if (!cache.head)
+    return new task;
+  cache.size--;
+  return std::exchange(cache.head, cache.head->next);
+}
+
+void threadpool::free_task(task* t) {
+  auto& cache = local_task_cache();
+  if (cache.size >= task_cache::MAX_SIZE)
+    return delete t;
+  t->next = std::exchange(cache.head, t);
+  cache.size++;
+}
+
+void threadpool::enqueue(task* t) {
+  if (is_leaf)
+  {
+    t->invoke(*t, false);
+    free_task(t);
+  }
   CHECK_AND_ASSERT_THROW_MES(!is_leaf, "A leaf routine is using a thread pool");
-  std::unique_lock lock{mutex};
-  if (!leaf && ((active == max && !queue.empty()) || depth > 0)) {
-    // if all available threads are already running
-    // and there's work waiting, just run in current thread
-    lock.unlock();
-    ++depth;
-    is_leaf = leaf;
-    f();
-    --depth;
-    is_leaf = false;
-  } else {
-    if (obj)
-      obj->inc();
-    if (leaf)
-      queue.push_front({obj, f, leaf});
+  if (t->wo)
+    t->wo->inc();
+  ++queued;
+  if (worker_of == this)
+    deques[worker_index]->push(t);
+  else
+  {
+    std::lock_guard lock{inject_mutex};
+    if (t->leaf)
+      injected.push_front(t);
     else
-      queue.push_back({obj, f, leaf});
+      injected.push_back(t);
+    ++n_injected;
+  }
+  if (sleeping > 0)
+  {
+    // Taking the lock makes sure a worker that just found nothing to do is either already
+    // waiting (and gets the notification) or will see `queued` when it checks before waiting.
+    { std::lock_guard lock{sleep_mutex}; }
     has_work.notify_one();
   }
 }
 
+threadpool::task* threadpool::take_injected(size_t self) {
+  if (n_injected.load(std::memory_order_relaxed) == 0)
+    return nullptr;
+  std::lock_guard lock{inject_mutex};
+  if (injected.empty())
+    return nullptr;
+  task* t = injected.front();
+  injected.pop_front();
+  --n_injected;
+  if (self != NO_WORKER)
+  {
+    // Move our share of the rest to our own deque, where it can also be stolen from
+    for (size_t n = std::min(injected.size() / deques.size(), MAX_INJECTED_BATCH); n > 0; n--)
+    {
+      deques[self]->push(injected.front());
+      injected.pop_front();
+      --n_injected;
+    }
+  }
+  return t;
+}
+
+threadpool::task* threadpool::find_work(size_t self) {
+  task* t = nullptr;
+  if (self != NO_WORKER)
+    t = deques[self]->pop();
+  if (!t)
+    t = take_injected(self);
+  if (!t && !deques.empty())
+  {
+    for (size_t i = 0, n = deques.size(), start = random_index(n); i < n && !t; i++)
+    {
+      const size_t victim = (start + i) % n;
+      if (victim != self)
+        t = deques[victim]->steal();
+    }
+  }
+  if (t)
+    --queued;
+  return t;
+}
+
+void threadpool::execute(task* t) {
+  struct restore {
+    task* t;
+    bool was_leaf;
+    ~restore() { free_task(t); is_leaf = was_leaf; }
+  } r{t, is_leaf};
+  waiter* wo = t->wo;
+  is_leaf = t->leaf;
+  t->invoke(*t, true);
+  if (wo)
+    wo->dec();
+}
+
+bool threadpool::help() {
+  task* t = find_work(worker_of == this ? worker_index : NO_WORKER);
+  if (!t)
+    return false;
+  execute(t);
+  return true;
+}
+
 unsigned int threadpool::get_max_concurrency() const {
   return max;
 }
@@ -110,7 +329,6 @@ threadpool::waiter::~waiter()
 {
   try
   {
-    std::unique_lock lock{mt};
     if (num)
       MERROR("wait should have been called before waiter dtor - waiting now");
   }
@@ -127,50 +345,55 @@ threadpool::waiter::~waiter()
 
 void threadpool::waiter::wait(threadpool *tpool) {
   if (tpool)
-    tpool->run(true);
+    while (num > 0 && tpool->help()) {}
   std::unique_lock lock{mt};
-  while(num)
-    cv.wait(lock);
+  cv.wait(lock, [this] { return num == 0; });
 }
 
 void threadpool::waiter::inc() {
-  const std::unique_lock lock{mt};
-  num++;
+  ++num;
 }
 
 void threadpool::waiter::dec() {
-  const std::unique_lock lock{mt};
-  num--;
-  if (!num)
-    cv.notify_all();
+  int n = num.load();
+  for (;;)
+  {
+    if (n == 1)
+    {
+      // The last task finishing takes the lock before dropping the count to zero, so wait()
+      // can't see zero and destroy the waiter while we are still using it.
+      const std::unique_lock lock{mt};
+      if (num.compare_exchange_strong(n, 0))
+      {
+        cv.notify_all();
+        return;
+      }
+    }
+    else if (num.compare_exchange_weak(n, n - 1))
+      return;
+  }
 }
 
-void threadpool::run(bool flush) {
-  std::unique_lock lock{mutex};
+void threadpool::run(size_t index) {
+  worker_of = this;
+  worker_index = index;
   while (running) {
-    entry e;
-    while(queue.empty() && running)
+    task* t = find_work(index);
+    for (int i = 0; !t && i < SPIN_TRIES && running; i++)
     {
-      if (flush)
-        return;
-      has_work.wait(lock);
+      std::this_thread::yield();
+      t = find_work(index);
+    }
+    if (t)
+    {
+      execute(t);
+      continue;
     }
-    if (!running) break;
-
-    active++;
-    e = std::move(queue.front());
-    queue.pop_front();
-    lock.unlock();
-    ++depth;
-    is_leaf = e.leaf;
-    e.f();
-    --depth;
-    is_leaf = false;
-
-    if (e.wo)
-      e.wo->dec();
-    lock.lock();
-    active--;
+    std::unique_lock lock{sleep_mutex};
+    ++sleeping;
+    has_work.wait(lock, [this] { return queued > 0 || !running; });
+    --sleeping;
   }
+  worker_of = nullptr;
 }
 }
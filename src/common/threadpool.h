@@ -25,21 +25,32 @@
 // INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
-#include <functional>
-#include <utility>
-#include <vector>
 #include <deque>
-#include <stdexcept>
-#include <thread>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <condition_variable>
 
 namespace tools
 {
 //! A global thread pool
+//!
+//! Each worker thread has its own lock-free deque: tasks submitted from a worker go onto its own
+//! deque, which it works through newest first, while idle workers steal the oldest tasks from
+//! the others.  Tasks submitted from outside the pool go through a shared queue that workers
+//! take batches from.  Waiting on a waiter runs queued tasks rather than blocking, so tasks can
+//! fan out and wait for sub-tasks of their own.
 class threadpool
 {
 public:
@@ -56,19 +67,98 @@ public:
   class waiter {
     std::mutex mt;
     std::condition_variable cv;
-    int num;
+    std::atomic<int> num;
     public:
     void inc();
     void dec();
-    void wait(threadpool *tpool);  //! Wait for a set of tasks to finish.
+    void wait(threadpool *tpool);  //! Wait for a set of tasks to finish, running queued tasks meanwhile.
     waiter() : num(0){}
     ~waiter();
   };
 
   // Submit a task to the pool. The waiter pointer may be
   // NULL if the caller doesn't care to wait for the
-  // task to finish.
-  void submit(waiter *waiter, std::function<void()> f, bool leaf = false);
+  // task to finish.  Callables of up to 64 bytes are stored
+  // inline in the task, without a separate allocation.
+  template <typename F>
+  void submit(waiter *waiter, F&& f, bool leaf = false)
+  {
+    using Fn = std::decay_t<F>;
+    task* t = allocate_task();
+    try
+    {
+      if constexpr (sizeof(Fn) <= sizeof(task::storage) && alignof(Fn) <= alignof(std::max_align_t))
+      {
+        new (t->storage) Fn(std::forward<F>(f));
+        t->invoke = [](task& self, bool run) {
+          struct destroy { Fn& fn; ~destroy() { fn.~Fn(); } } d{*std::launder(reinterpret_cast<Fn*>(self.storage))};
+          if (run)
+            d.fn();
+        };
+      }
+      else
+      {
+        new (t->storage) Fn*(new Fn(std::forward<F>(f)));
+        t->invoke = [](task& self, bool run) {
+          std::unique_ptr<Fn> fn{*std::launder(reinterpret_cast<Fn**>(self.storage))};
+          if (run)
+            (*fn)();
+        };
+      }
+    }
+    catch (...)
+    {
+      free_task(t);
+      throw;
+    }
+    t->wo = waiter;
+    t->leaf = leaf;
+    enqueue(t);
+  }
+
+  // Calls f(i) for each i in [begin, end), in chunks of at least
+  // `grain` indices, and returns once every call has finished.
+  template <typename Index, typename F>
+  void parallel_for(Index begin, Index end, F&& f, Index grain = 1)
+  {
+    if (!(begin < end))
+      return;
+    const size_t n = end - begin, chunks = chunk_count(n, grain);
+    auto run_chunk = [&f](Index b, Index e) { for (Index i = b; i < e; ++i) f(i); };
+    if (chunks == 1)
+      return run_chunk(begin, end);
+    waiter waiter;
+    Index first_end = begin;
+    for_each_chunk(begin, n, chunks, [&](size_t c, Index b, Index e) {
+      if (c == 0)
+        first_end = e;
+      else
+        submit(&waiter, [&run_chunk, b, e] { run_chunk(b, e); });
+    });
+    // The caller does the first chunk itself
+    run_chunk(begin, first_end);
+    waiter.wait(this);
+  }
+
+  // Maps each chunk [b, e) of [begin, end) to map(b, e), then folds
+  // the chunk results in order with reduce(acc, result) starting
+  // from init, so the result doesn't depend on the scheduling.
+  template <typename T, typename Index, typename Map, typename Reduce>
+  T parallel_reduce(Index begin, Index end, T init, Map&& map, Reduce&& reduce, Index grain = 1)
+  {
+    if (!(begin < end))
+      return init;
+    const size_t n = end - begin, chunks = chunk_count(n, grain);
+    std::vector<std::optional<T>> results(chunks);
+    waiter waiter;
+    for_each_chunk(begin, n, chunks, [&](size_t c, Index b, Index e) {
+      submit(&waiter, [&map, &result = results[c], b, e] { result.emplace(map(b, e)); });
+    });
+    waiter.wait(this);
+    for (auto& r : results)
+      init = reduce(std::move(init), std::move(*r));
+    return init;
+  }
 
   // destroy and recreate threads
   void recycle();
@@ -83,19 +173,66 @@ public:
     threadpool(unsigned int max_threads = 0);
     void destroy();
     void create(unsigned int max_threads);
-    typedef struct entry {
+
+    struct task {
+      alignas(std::max_align_t) unsigned char storage[64];
+      void (*invoke)(task& t, bool run); // Runs the callable if `run` is set, and destroys it
       waiter *wo;
-      std::function<void()> f;
       bool leaf;
-    } entry;
-    std::deque<entry> queue;
+      task *next; // Free list link
+    };
+    struct task_cache;
+    static task_cache& local_task_cache();
+    static task* allocate_task();
+    static void free_task(task* t);
+    void enqueue(task* t);
+
+    size_t chunk_count(size_t n, size_t grain) const {
+      return std::clamp<size_t>((n + std::max<size_t>(grain, 1) - 1) / std::max<size_t>(grain, 1), 1, std::max(max, 1u) * 4);
+    }
+    template <typename Index, typename F>
+    static void for_each_chunk(Index begin, size_t n, size_t chunks, F&& f) {
+      for (size_t c = 0; c < chunks; ++c) {
+        const Index end = begin + (n / chunks + (c < n % chunks ? 1 : 0));
+        f(c, begin, end);
+        begin = end;
+      }
+    }
+
+    class work_deque;
+    std::vector<std::unique_ptr<work_deque>> deques;
+    std::mutex inject_mutex;
+    std::deque<task*> injected;
+    std::atomic<size_t> n_injected;
+    std::atomic<size_t> queued; // Tasks submitted but not yet taken to run
+    std::mutex sleep_mutex;
     std::condition_variable has_work;
-    std::mutex mutex;
+    std::atomic<unsigned int> sleeping;
     std::vector<std::thread> threads;
-    unsigned int active;
     unsigned int max;
-    bool running;
-    void run(bool flush = false);
+    std::atomic<bool> running;
+    task* find_work(size_t self);
+    task* take_injected(size_t self);
+    void execute(task* t);
+    bool help();
+    void run(size_t index);
+};
+
+//! A set of tasks that can be waited for together.  Waiting (which the destructor also does)
+//! runs queued tasks of any group rather than blocking, so groups can be nested inside tasks.
+class task_group
+{
+public:
+  explicit task_group(threadpool& tpool = threadpool::getInstance()) : tpool{tpool} {}
+  ~task_group() { wait(); }
+
+  template <typename F>
+  void run(F&& f, bool leaf = false) { tpool.submit(&w, std::forward<F>(f), leaf); }
+  void wait() { w.wait(&tpool); }
+
+private:
+  threadpool& tpool;
+  threadpool::waiter w;
 };
 
 }
@@ -0,0 +1,148 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace tools::trace
+{
+  namespace detail
+  {
+    std::atomic<bool> enabled{false};
+  }
+
+  namespace
+  {
+    // One recorded event.  The fields are written and read as relaxed atomics, guarded by `seq` in
+    // the manner of a seqlock: it is 2i+1 while event i is being written and 2i+2 once it is
+    // complete, so a reader can tell (and skip) slots that are mid-write or have been reused.
+    struct event_slot
+    {
+      std::atomic<uint64_t> seq{0};
+      std::atomic<const char*> name{nullptr};
+      std::atomic<const char*> cat{nullptr};
+      std::atomic<uint64_t> time_ns{0};
+      std::atomic<uint32_t> name_size{0};
+      std::atomic<uint32_t> thread{0};
+      std::atomic<char> phase{0};
+    };
+
+    std::mutex enable_lock;
+    std::atomic<event_slot*> buffer{nullptr}; // Never freed once allocated: writers don't lock
+    std::atomic<uint64_t> next_event{0};
+    std::atomic<uint64_t> first_event{0}; // Events before this have been cleared
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    uint32_t thread_number()
+    {
+      static std::atomic<uint32_t> next{1};
+      thread_local const uint32_t number = next++;
+      return number;
+    }
+
+    void append_json_string(std::string& out, std::string_view s)
+    {
+      out += '"';
+      for (char c : s)
+      {
+        if (c == '"' || c == '\\')
+        {
+          out += '\\';
+          out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+          char esc[8];
+          std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+          out += esc;
+        }
+        else
+          out += c;
+      }
+      out += '"';
+    }
+  }
+
+  void detail::record(std::string_view name, const char* cat, char phase)
+  {
+    event_slot* buf = buffer.load(std::memory_order_acquire);
+    if (!buf)
+      return;
+    const uint64_t time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+    const uint64_t i = next_event.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = buf[i % BUFFER_EVENTS];
+    slot.seq.store(2*i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name.data(), std::memory_order_relaxed);
+    slot.name_size.store(name.size(), std::memory_order_relaxed);
+    slot.cat.store(cat, std::memory_order_relaxed);
+    slot.time_ns.store(time_ns, std::memory_order_relaxed);
+    slot.thread.store(thread_number(), std::memory_order_relaxed);
+    slot.phase.store(phase, std::memory_order_relaxed);
+    slot.seq.store(2*i + 2, std::memory_order_release);
+  }
+
+  void set_enabled(bool enable)
+  {
+    std::lock_guard lock{enable_lock};
+    if (enable && !buffer.load(std::memory_order_relaxed))
+      buffer.store(new event_slot[BUFFER_EVENTS], std::memory_order_release);
+    detail::enabled.store(enable, std::memory_order_relaxed);
+  }
+
+  void clear()
+  {
+    first_event.store(next_event.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+
+  size_t event_count()
+  {
+    const uint64_t end = next_event.load(std::memory_order_relaxed);
+    const uint64_t begin = std::max<uint64_t>(first_event.load(std::memory_order_relaxed), end > BUFFER_EVENTS ? end - BUFFER_EVENTS : 0);
+    return end > begin ? end - begin : 0;
+  }
+
+  std::string dump_chrome_json()
+  {
+    std::string out = R"({"displayTimeUnit":"ms","traceEvents":[)";
+    if (event_slot* buf = buffer.load(std::memory_order_acquire))
+    {
+      const uint64_t end = next_event.load(std::memory_order_acquire);
+      const uint64_t begin = std::max<uint64_t>(first_event.load(std::memory_order_relaxed), end > BUFFER_EVENTS ? end - BUFFER_EVENTS : 0);
+      bool first = true;
+      for (uint64_t i = begin; i < end; i++)
+      {
+        const auto& slot = buf[i % BUFFER_EVENTS];
+        const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq != 2*i + 2)
+          continue;
+        const char* name = slot.name.load(std::memory_order_relaxed);
+        const uint32_t name_size = slot.name_size.load(std::memory_order_relaxed);
+        const char* cat = slot.cat.load(std::memory_order_relaxed);
+        const uint64_t time_ns = slot.time_ns.load(std::memory_order_relaxed);
+        const uint32_t thread = slot.thread.load(std::memory_order_relaxed);
+        const char phase = slot.phase.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq)
+          continue;
+
+        if (!first)
+          out += ',';
+        first = false;
+        out += R"({"name":)";
+        append_json_string(out, {name, name_size});
+        out += R"(,"cat":)";
+        append_json_string(out, cat);
+        char rest[96];
+        std::snprintf(rest, sizeof(rest), R"(,"ph":"%c","ts":%llu.%03u,"pid":1,"tid":%u})",
+            phase, static_cast<unsigned long long>(time_ns / 1000), static_cast<unsigned>(time_ns % 1000), thread);
+        out += rest;
+      }
+    }
+    out += "]}";
+    return out;
+  }
+}
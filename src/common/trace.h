@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/// Opt-in timeline tracing of daemon internals.  While tracing is enabled, spans record begin and
+/// end events, tagged with the recording thread, into a fixed-size lock-free ring buffer that
+/// overwrites the oldest events once full.  dump_chrome_json() turns the buffered events into a
+/// Chrome trace event document, which chrome://tracing and https://ui.perfetto.dev can display.
+///
+/// While disabled, a span costs one relaxed atomic load.
+namespace tools::trace
+{
+  /// Number of events the ring buffer holds (48 bytes each); it is allocated the first time
+  /// tracing is enabled and kept from then on.
+  constexpr size_t BUFFER_EVENTS = 1 << 18;
+
+  namespace detail
+  {
+    extern std::atomic<bool> enabled;
+    void record(std::string_view name, const char* cat, char phase);
+  }
+
+  inline bool enabled() { return detail::enabled.load(std::memory_order_relaxed); }
+
+  /// Starts or stops recording.  Stopping keeps the recorded events so they can still be dumped.
+  void set_enabled(bool enable);
+
+  /// Discards all recorded events.
+  void clear();
+
+  /// Returns the number of events currently held in the buffer.
+  size_t event_count();
+
+  /// Returns the recorded events as a Chrome trace event JSON document.
+  std::string dump_chrome_json();
+
+  /// Records a span on the current thread from construction until end() or destruction.  `name`
+  /// and `cat` are stored by pointer and so must live as long as the process: string literals,
+  /// log categories and RPC command names all do.
+  class span
+  {
+  public:
+    span(std::string_view name, const char* cat) : name{name}, cat{cat}, active{enabled()}
+    {
+      if (active)
+        detail::record(name, cat, 'B');
+    }
+    ~span() { end(); }
+    span(const span&) = delete;
+    span& operator=(const span&) = delete;
+
+    void end()
+    {
+      if (active)
+        detail::record(name, cat, 'E');
+      active = false;
+    }
+
+  private:
+    std::string_view name;
+    const char* cat;
+    bool active;
+  };
+}
+
+#define TRACE_SPAN(name) tools::trace::span trace_##name{#name, QUENERO_DEFAULT_LOG_CATEGORY}
+#define TRACE_SPAN_END(name) trace_##name.end()
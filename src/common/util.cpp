@@ -29,6 +29,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <algorithm>
 #include <string>
 #include <iomanip>
 #include <thread>
@@ -185,6 +186,27 @@ namespace tools
     return max_concurrency;
   }
 
+  thread_budget get_thread_budget(unsigned total)
+  {
+    total = std::max(total, 1u);
+    thread_budget b;
+    // Verification is the only CPU-bound pool, and the p2p and OMQ threads that hand it work block
+    // until it is done, so it gets the whole budget.  Everything else mostly waits on sockets or
+    // on the blockchain lock: a few threads each (on top of OxenMQ's per-category reserved
+    // threads) keep them responsive without piling runnable threads onto a small machine.
+    b.verify = total;
+    b.p2p = std::clamp(total / 2, 2u, 10u);
+    b.omq = std::max(total / 2, 1u);
+#ifdef __linux__
+    // Only Linux load balances new connections across SO_REUSEPORT listeners; elsewhere the
+    // extra loops would just sit idle.
+    b.http = std::clamp(total / 4, 1u, 8u);
+#else
+    b.http = 1;
+#endif
+    return b;
+  }
+
   bool is_local_address(const std::string &address)
   {
     return address == "localhost"sv
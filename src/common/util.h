@@ -56,6 +56,22 @@ namespace tools
   void set_max_concurrency(unsigned n);
   unsigned get_max_concurrency();
 
+  /// How the daemon's thread pools are sized from `--max-concurrency`.  The pools can't share
+  /// threads (asio, OxenMQ and uWS each run their own loops) so they are instead all scaled from
+  /// the one value: lowering it shrinks every pool rather than just the verification threadpool.
+  /// Verification gets the whole value and the mostly idle I/O pools come on top of it, so the
+  /// pools (counting both HTTP RPC listeners) add up to about 2.5 times `total` for typical core
+  /// counts, plus OxenMQ's reserved category threads.
+  struct thread_budget
+  {
+    unsigned p2p;    // asio io_service threads of the p2p server
+    unsigned omq;    // OxenMQ general workers (quorumnet and RPC jobs)
+    unsigned http;   // uWS event loops of each HTTP RPC listener
+    unsigned verify; // tools::threadpool workers (batch and signature verification)
+  };
+  thread_budget get_thread_budget(unsigned total);
+  inline thread_budget get_thread_budget() { return get_thread_budget(get_max_concurrency()); }
+
   bool is_local_address(const std::string &address);
   int vercmp(std::string_view v0, std::string_view v1); // returns < 0, 0, > 0, similar to strcmp, but more human friendly than lexical - does not attempt to validate
 
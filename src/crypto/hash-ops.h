@@ -79,4 +79,9 @@ void rx_slow_hash_free_state(void);
 uint64_t rx_seedheight(const uint64_t height);
 void rx_seedheights(const uint64_t height, uint64_t *seed_height, uint64_t *next_height);
 void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length, char *hash, int miners, int is_alt);
+/* Hashes `count` nonces of a block hashing blob through RandomX's pipelined API: nonce
+ * `nonce + i*nonce_step` is written (little-endian) at `nonce_offset` of `data` before computing
+ * the i-th 32-byte hash into `hashes`.  `data` is left holding the last nonce. */
+void rx_slow_hash_nonces(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, void *data, size_t length,
+  size_t nonce_offset, uint32_t nonce, uint32_t nonce_step, size_t count, char *hashes, int miners);
 void rx_reorg(const uint64_t split_height);
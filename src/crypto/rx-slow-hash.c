@@ -189,8 +189,12 @@ static void rx_initdata(randomx_cache *rs_cache, const int miners, const uint64_
   rx_dataset_height = seedheight;
 }
 
-void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length,
-  char *hash, int miners, int is_alt) {
+/* Sets up this thread's VM for hashing with the given seed and returns the seed slot it uses,
+ * with the slot's mutex held.  *is_alt is updated to say whether the caller must keep holding
+ * the mutex while hashing (alt chain slots) or can release it first (mainchain). */
+static rx_state *rx_prepare_vm(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash,
+  int miners, int *is_alt_out) {
+  int is_alt = *is_alt_out;
   uint64_t s_height = rx_seedheight(mainheight);
   int toggle = (s_height & SEEDHASH_EPOCH_BLOCKS) != 0;
   randomx_flags flags = enabled_flags() & ~disabled_flags();
@@ -291,6 +295,13 @@ void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const ch
     /* this is a no-op if the cache hasn't changed */
     randomx_vm_set_cache(rx_vm, rx_sp->rs_cache);
   }
+  *is_alt_out = is_alt;
+  return rx_sp;
+}
+
+void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length,
+  char *hash, int miners, int is_alt) {
+  rx_state *rx_sp = rx_prepare_vm(mainheight, seedheight, seedhash, miners, &is_alt);
   /* mainchain users can run in parallel */
   if (!is_alt)
     CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
@@ -300,6 +311,41 @@ void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const ch
     CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
 }
 
+static inline void rx_write_nonce(unsigned char *p, uint32_t nonce) {
+  p[0] = nonce & 0xff;
+  p[1] = (nonce >> 8) & 0xff;
+  p[2] = (nonce >> 16) & 0xff;
+  p[3] = (nonce >> 24) & 0xff;
+}
+
+void rx_slow_hash_nonces(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, void *data, size_t length,
+  size_t nonce_offset, uint32_t nonce, uint32_t nonce_step, size_t count, char *hashes, int miners) {
+  unsigned char *blob = data;
+  int is_alt = 0;
+  rx_state *rx_sp;
+  size_t i;
+
+  if (count == 0 || nonce_offset + 4 > length)
+    return;
+
+  rx_sp = rx_prepare_vm(mainheight, seedheight, seedhash, miners, &is_alt);
+  if (!is_alt)
+    CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
+  /* RandomX reads each input as soon as it's handed over (the next input's initial hash is
+   * computed while the previous program's result is finalized), so we can keep patching the
+   * nonce of the same buffer. */
+  rx_write_nonce(blob + nonce_offset, nonce);
+  randomx_calculate_hash_first(rx_vm, blob, length);
+  for (i = 1; i < count; i++) {
+    nonce += nonce_step;
+    rx_write_nonce(blob + nonce_offset, nonce);
+    randomx_calculate_hash_next(rx_vm, blob, length, hashes + (i - 1) * HASH_SIZE);
+  }
+  randomx_calculate_hash_last(rx_vm, hashes + (count - 1) * HASH_SIZE);
+  if (is_alt)
+    CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
+}
+
 void rx_slow_hash_allocate_state(void) {
 }
 
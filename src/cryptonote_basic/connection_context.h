@@ -32,13 +32,54 @@
 #include <unordered_set>
 #include <atomic>
 #include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
 #include "epee/net/net_utils_base.h"
 #include "epee/copyable_atomic.h"
 #include "crypto/hash.h"
+#include "common/latency_histogram.h"
 
 namespace cryptonote
 {
 
+  /// Traffic statistics of a single peer connection.  A connection context's copies all share the
+  /// same connection_stats, so it can be updated from whichever thread sends or receives.
+  struct connection_stats
+  {
+    struct command_counters
+    {
+      uint64_t msgs_in = 0;
+      uint64_t bytes_in = 0;
+      uint64_t msgs_out = 0;
+      uint64_t bytes_out = 0;
+    };
+
+    /// Counts a levin message (including its header) of the given command
+    void record(int command, size_t bytes, bool outgoing)
+    {
+      std::lock_guard lock{m_mutex};
+      auto& c = m_commands[command];
+      (outgoing ? c.msgs_out : c.msgs_in)++;
+      (outgoing ? c.bytes_out : c.bytes_in) += bytes;
+    }
+
+    /// Returns a copy of the per-command counters
+    std::map<int, command_counters> commands() const
+    {
+      std::lock_guard lock{m_mutex};
+      return m_commands;
+    }
+
+    /// Time from sending NOTIFY_REQUEST_GET_BLOCKS/NOTIFY_REQUEST_CHAIN to receiving the response
+    tools::latency_histogram get_blocks_rtt;
+    tools::latency_histogram chain_rtt;
+
+  private:
+    mutable std::mutex m_mutex;
+    std::map<int, command_counters> m_commands;
+  };
+
   struct cryptonote_connection_context: public epee::net_utils::connection_context_base
   {
     enum state
@@ -64,6 +105,7 @@ namespace cryptonote
     uint32_t m_pruning_seed{0};
     uint16_t m_rpc_port{0};
     bool m_anchor{false};
+    std::shared_ptr<connection_stats> m_stats{std::make_shared<connection_stats>()};
     //size_t m_score{0};  TODO: add score calculations
   };
 
@@ -1408,6 +1408,15 @@ namespace cryptonote
     return blob;
   }
   //---------------------------------------------------------------
+  size_t get_block_hashing_blob_nonce_offset(const block& b)
+  {
+    // The header starts with the varint versions and timestamp, followed by prev_id and the nonce
+    return tools::get_varint_data(b.major_version).size() +
+           tools::get_varint_data(b.minor_version).size() +
+           tools::get_varint_data(b.timestamp).size() +
+           sizeof(b.prev_id);
+  }
+  //---------------------------------------------------------------
   bool calculate_block_hash(const block& b, crypto::hash& res)
   {
     bool hash_result = get_object_hash(get_block_hashing_blob(b), res);
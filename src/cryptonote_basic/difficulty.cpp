@@ -30,6 +30,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <algorithm>
+#include <cassert>
 
 #include "common/quenero.h"
 #include "epee/int-util.h"
@@ -131,11 +132,12 @@ namespace cryptonote {
     bool const before_hf16            = chain_height < hf16_height;
 
     // Trim down arrays
-    while (timestamps.size() > DIFFICULTY_BLOCKS_COUNT(before_hf16))
-      timestamps.erase(timestamps.begin());
+    size_t const block_count = DIFFICULTY_BLOCKS_COUNT(before_hf16);
+    if (timestamps.size() > block_count)
+      timestamps.erase(timestamps.begin(), timestamps.end() - block_count);
 
-    while (difficulties.size() > DIFFICULTY_BLOCKS_COUNT(before_hf16))
-      difficulties.erase(difficulties.begin());
+    if (difficulties.size() > block_count)
+      difficulties.erase(difficulties.begin(), difficulties.end() - block_count);
   }
 
   //---------------------------------------------------------------
@@ -251,4 +253,53 @@ namespace cryptonote {
 
     return next_difficulty;
   }
+
+  void difficulty_window::reset(uint64_t height)
+  {
+    m_blocks.clear();
+    m_height = height;
+  }
+
+  void difficulty_window::push_back(uint64_t timestamp, difficulty_type cumulative_difficulty)
+  {
+    m_blocks.push_back({timestamp, cumulative_difficulty});
+    m_height++;
+  }
+
+  void difficulty_window::push_front(uint64_t timestamp, difficulty_type cumulative_difficulty)
+  {
+    assert(start_height() > 0);
+    m_blocks.push_front({timestamp, cumulative_difficulty});
+  }
+
+  void difficulty_window::truncate(uint64_t height)
+  {
+    if (height >= m_height)
+      return;
+    if (height <= start_height())
+      return reset(height);
+    m_blocks.erase(m_blocks.end() - (m_height - height), m_blocks.end());
+    m_height = height;
+  }
+
+  void difficulty_window::trim(size_t count)
+  {
+    if (m_blocks.size() > count)
+      m_blocks.erase(m_blocks.begin(), m_blocks.end() - count);
+  }
+
+  difficulty_type difficulty_window::next_difficulty(size_t block_count, size_t target_seconds, difficulty_calc_mode mode) const
+  {
+    size_t const count = std::min(block_count, m_blocks.size());
+    std::vector<uint64_t> timestamps;
+    std::vector<difficulty_type> cumulative_difficulties;
+    timestamps.reserve(count);
+    cumulative_difficulties.reserve(count);
+    for (auto it = m_blocks.end() - count; it != m_blocks.end(); ++it)
+    {
+      timestamps.push_back(it->timestamp);
+      cumulative_difficulties.push_back(it->cumulative_difficulty);
+    }
+    return next_difficulty_v2(std::move(timestamps), std::move(cumulative_difficulties), target_seconds, mode);
+  }
 }
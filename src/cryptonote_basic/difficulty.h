@@ -32,6 +32,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <deque>
 #include <vector>
 #include "cryptonote_config.h"
 #include "common/util.h"
@@ -80,4 +81,56 @@ namespace cryptonote
                                        std::vector<difficulty_type> cumulative_difficulties,
                                        size_t target_second,
                                        difficulty_calc_mode mode);
+
+    // Sliding window of the timestamps and cumulative difficulties of a run of consecutive blocks,
+    // kept so that next_difficulty_v2's inputs can be maintained a block at a time as a chain
+    // grows and shrinks instead of being reloaded from the database for every block.  Blocks can
+    // be added or removed at either end in O(1).  A window is small (a few dozen blocks), so
+    // copying one is cheap: alt chain difficulty calculations copy the main chain's window, cut it
+    // back to the fork point and push the alt blocks onto the copy.
+    class difficulty_window
+    {
+    public:
+      // How many blocks beyond the difficulty window the main chain window keeps around so that
+      // popping a few blocks (or forking a short alt chain) doesn't leave it short.
+      static constexpr size_t SPARE_BLOCKS = 16;
+
+      // The height of the block after the last block in the window; for an empty window this is
+      // the height at which the next block pushed onto it goes.
+      uint64_t height() const { return m_height; }
+      // The height of the first block in the window
+      uint64_t start_height() const { return m_height - m_blocks.size(); }
+      size_t size() const { return m_blocks.size(); }
+      bool empty() const { return m_blocks.empty(); }
+
+      // Empties the window and sets the height of the next block to be pushed onto it.
+      void reset(uint64_t height);
+
+      // Adds the next block on top of the window.
+      void push_back(uint64_t timestamp, difficulty_type cumulative_difficulty);
+      // Adds the block before start_height() to the front of the window.  Must not be called when
+      // start_height() is 0.
+      void push_front(uint64_t timestamp, difficulty_type cumulative_difficulty);
+
+      // Removes every block at or above `height` from the window.  If that empties it, the window
+      // is reset to `height`.
+      void truncate(uint64_t height);
+      // Drops blocks from the front of the window until at most `count` remain.
+      void trim(size_t count);
+
+      // Calculates the difficulty of the block at height() from (up to) the last `block_count`
+      // blocks in the window using next_difficulty_v2.  The window must already hold the blocks
+      // that next_difficulty_v2 should see: the last `block_count` blocks (or, near the start of
+      // the chain, every block after the genesis block).
+      difficulty_type next_difficulty(size_t block_count, size_t target_seconds, difficulty_calc_mode mode) const;
+
+    private:
+      struct entry
+      {
+        uint64_t timestamp;
+        difficulty_type cumulative_difficulty;
+      };
+      std::deque<entry> m_blocks;
+      uint64_t m_height = 0;
+    };
 }
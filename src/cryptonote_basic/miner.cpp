@@ -30,8 +30,14 @@
 //
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <array>
+#include <cstring>
 #include <numeric>
 #include <oxenmq/base64.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include "epee/misc_language.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "epee/misc_os_dependent.h"
@@ -48,6 +54,7 @@
 
 #define AUTODETECT_WINDOW 10 // seconds
 #define AUTODETECT_GAIN_THRESHOLD 1.02f  // 2%
+#define MINING_BATCH_HASHES 8 // nonces hashed per pass; the template is only rechecked between passes
 
 #include "miner.h"
 
@@ -62,10 +69,41 @@ namespace cryptonote
     const command_line::arg_descriptor<std::string> arg_extra_messages =  {"extra-messages-file", "Specify file for extra messages to include into coinbase transactions", "", true};
     const command_line::arg_descriptor<std::string> arg_start_mining =    {"start-mining", "Specify wallet address to mining for", "", true};
     const command_line::arg_descriptor<uint32_t>      arg_mining_threads =  {"mining-threads", "Specify mining threads count", 0, true};
+    const command_line::arg_descriptor<bool>          arg_mining_pin_threads = {"mining-pin-threads", "Pin each mining thread to its own CPU, filling one NUMA node before the next", false};
+
+    // Pins the calling thread to the index'th (wrapping around) of the CPUs we may run on.  CPUs are
+    // numbered node by node, so this keeps low numbered threads together on the first NUMA node;
+    // since a thread's RandomX VM and scratchpad are only allocated on its first hash, they then
+    // end up in that node's memory.
+    void pin_thread(uint32_t index)
+    {
+#ifdef __linux__
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+      if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+        return;
+      int n = index % CPU_COUNT(&allowed);
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      {
+        if (!CPU_ISSET(cpu, &allowed) || n-- > 0)
+          continue;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+          MWARNING("Failed to pin miner thread " << index << " to CPU " << cpu << ": " << strerror(err));
+        else
+          MDEBUG("Pinned miner thread " << index << " to CPU " << cpu);
+        return;
+      }
+#else
+      MWARNING("Pinning miner threads is not supported on this platform");
+#endif
+    }
   }
 
 
-  miner::miner(i_miner_handler* phandler, const get_block_hash_t &gbh):m_stop(1),
+  miner::miner(i_miner_handler* phandler, const get_block_hash_t &gbh, const get_block_hashes_t &gbhs):m_stop(1),
     m_template{},
     m_template_no(0),
     m_diffic(0),
@@ -82,7 +120,9 @@ namespace cryptonote
     m_do_print_hashrate(false),
     m_do_mining(false),
     m_current_hash_rate(0),
-    m_block_reward(0)
+    m_block_reward(0),
+    m_gbhs(gbhs),
+    m_pin_threads(false)
   {}
   //-----------------------------------------------------------------------------------------------------
   miner::~miner()
@@ -160,10 +200,18 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------------
   void miner::merge_hr()
   {
-    if(m_last_hr_merge_time && is_mining())
+    std::unique_lock lock{m_last_hash_rates_lock};
+    const uint64_t dt = epee::misc_utils::get_tick_count() - m_last_hr_merge_time + 1;
+    const bool merge = m_last_hr_merge_time && is_mining();
+    for (auto& t : m_thread_stats)
     {
-      m_current_hash_rate = m_hashes * 1000 / ((epee::misc_utils::get_tick_count() - m_last_hr_merge_time + 1));
-      std::unique_lock lock{m_last_hash_rates_lock};
+      uint64_t hashes = t.hashes.load(std::memory_order_relaxed);
+      t.hash_rate = merge ? (hashes - t.last_hashes) * 1000 / dt : 0;
+      t.last_hashes = hashes;
+    }
+    if(merge)
+    {
+      m_current_hash_rate = m_hashes * 1000 / dt;
       m_last_hash_rates.push_back(m_current_hash_rate);
       if(m_last_hash_rates.size() > 19)
         m_last_hash_rates.pop_front();
@@ -229,15 +277,35 @@ namespace cryptonote
     m_threads.clear();
     m_stop = false;
     m_thread_index = 0;
+    reset_thread_stats();
     for(size_t i = 0; i != m_threads_total; i++)
       m_threads.emplace_back([this] { return worker_thread(false); });
   }
   //-----------------------------------------------------------------------------------------------------
+  void miner::reset_thread_stats()
+  {
+    std::unique_lock lock{m_last_hash_rates_lock};
+    m_thread_stats = std::vector<thread_stats>(m_threads_total);
+  }
+  //-----------------------------------------------------------------------------------------------------
+  std::vector<uint64_t> miner::get_thread_speeds() const
+  {
+    std::vector<uint64_t> speeds;
+    if (!is_mining())
+      return speeds;
+    std::unique_lock lock{m_last_hash_rates_lock};
+    speeds.reserve(m_thread_stats.size());
+    for (const auto& t : m_thread_stats)
+      speeds.push_back(t.hash_rate);
+    return speeds;
+  }
+  //-----------------------------------------------------------------------------------------------------
   void miner::init_options(boost::program_options::options_description& desc)
   {
     command_line::add_arg(desc, arg_extra_messages);
     command_line::add_arg(desc, arg_start_mining);
     command_line::add_arg(desc, arg_mining_threads);
+    command_line::add_arg(desc, arg_mining_pin_threads);
   }
   //-----------------------------------------------------------------------------------------------------
   bool miner::init(const boost::program_options::variables_map& vm, network_type nettype)
@@ -277,6 +345,8 @@ namespace cryptonote
       MINFO("Loaded " << m_extra_messages.size() << " extra messages, current index " << m_config.current_extra_message_index);
     }
 
+    m_pin_threads = command_line::get_arg(vm, arg_mining_pin_threads);
+
     if(command_line::has_arg(vm, arg_start_mining))
     {
       address_parse_info info;
@@ -342,7 +412,8 @@ namespace cryptonote
     m_stop_height = stop_after ? m_height + stop_after : std::numeric_limits<uint64_t>::max();
     if (stop_after)
       MGINFO("Mining until height " << m_stop_height);
-    
+
+    reset_thread_stats();
     for(size_t i = 0; i != m_threads_total; i++)
     {
       m_threads.emplace_back([=] { return worker_thread(slow_mining); });
@@ -445,11 +516,19 @@ namespace cryptonote
     uint32_t th_local_index = m_thread_index++;
     MLOG_SET_THREAD_NAME(std::string("[miner ") + std::to_string(th_local_index) + "]");
     MGINFO("Miner thread was started ["<< th_local_index << "]");
+    if (m_pin_threads)
+      pin_thread(th_local_index);
+    thread_stats& stats = m_thread_stats[th_local_index];
     uint32_t nonce = m_starter_nonce + th_local_index;
     uint64_t height = 0;
     difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
     block b;
+    // The hashing blob only changes in its nonce from one hash to the next, so we build it once
+    // per template and then just patch the nonce.
+    std::string blob;
+    size_t nonce_offset = 0;
+    std::array<crypto::hash, MINING_BATCH_HASHES> hashes;
     rx_slow_hash_allocate_state();
     bool call_stop = false;
 
@@ -471,6 +550,8 @@ namespace cryptonote
         }
         local_template_ver = m_template_no;
         nonce = m_starter_nonce + th_local_index;
+        blob = get_block_hashing_blob(b);
+        nonce_offset = get_block_hashing_blob_nonce_offset(b);
       }
 
       if(!local_template_ver)//no any set_block_template call
@@ -488,13 +569,28 @@ namespace cryptonote
         break;
       }
 
-      b.nonce = nonce;
-      crypto::hash h;
-      m_gbh(b, height, slow_mining ? 0 : tools::get_max_concurrency(), h);
+      const uint32_t nonce_step = m_threads_total;
+      const size_t count = slow_mining ? 1 : hashes.size();
+      const unsigned int threads = slow_mining ? 0 : tools::get_max_concurrency();
+      if (m_gbhs)
+        m_gbhs(b, height, threads, blob, nonce_offset, nonce, nonce_step, hashes.data(), count);
+      else
+      {
+        for (size_t i = 0; i < count; i++)
+        {
+          b.nonce = nonce + static_cast<uint32_t>(i) * nonce_step;
+          m_gbh(b, height, threads, hashes[i]);
+        }
+      }
 
-      if(check_hash(h, local_diff))
+      for (size_t i = 0; i < count; i++)
       {
+        if(!check_hash(hashes[i], local_diff))
+          continue;
+
         //we lucky!
+        b.nonce = nonce + static_cast<uint32_t>(i) * nonce_step;
+        b.invalidate_hashes();
         ++m_config.current_extra_message_index;
         MGINFO_GREEN("Found block " << get_block_hash(b) << " at height " << height << " for difficulty: " << local_diff);
         cryptonote::block_verification_context bvc;
@@ -504,11 +600,14 @@ namespace cryptonote
           //success update, lets update config
           if (std::string json; epee::serialization::store_t_to_json(m_config, json))
             tools::dump_file(m_config_dir / fs::u8path(MINER_CONFIG_FILE_NAME), json);
+        // Any further solutions in this batch would be for the same height, so don't bother
+        break;
       }
 
-      nonce+=m_threads_total;
-      ++m_hashes;
-      ++m_total_hashes;
+      nonce += nonce_step * static_cast<uint32_t>(count);
+      m_hashes += count;
+      m_total_hashes += count;
+      stats.hashes.fetch_add(count, std::memory_order_relaxed);
     }
     rx_slow_hash_free_state();
     MGINFO("Miner thread stopped ["<< th_local_index << "]");
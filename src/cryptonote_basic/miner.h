@@ -58,13 +58,19 @@ namespace cryptonote
 
   typedef std::function<bool(const cryptonote::block&, uint64_t, unsigned int, crypto::hash&)> get_block_hash_t;
 
+  // Computes the PoW hashes of a run of nonces of a block in one go: given the block, its height,
+  // the mining thread count, its hashing blob, the offset of the nonce in that blob, the first
+  // nonce, the nonce step and the number of nonces, fills in one hash per nonce.  The blob is
+  // updated in place (only the nonce bytes change).
+  typedef std::function<void(const cryptonote::block&, uint64_t, unsigned int, std::string&, size_t, uint32_t, uint32_t, crypto::hash*, size_t)> get_block_hashes_t;
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
   class miner
   {
   public: 
-    miner(i_miner_handler* phandler, const get_block_hash_t& gbh);
+    miner(i_miner_handler* phandler, const get_block_hash_t& gbh, const get_block_hashes_t& gbhs = {});
     ~miner();
     bool init(const boost::program_options::variables_map& vm, network_type nettype);
     static void init_options(boost::program_options::options_description& desc);
@@ -72,6 +78,8 @@ namespace cryptonote
     bool on_block_chain_update();
     bool start(const account_public_address& adr, size_t threads_count, uint64_t stop_after = 0, bool slow_mining = false);
     uint64_t get_speed() const;
+    // Returns the hash rate of each mining thread as of the last hash rate update
+    std::vector<uint64_t> get_thread_speeds() const;
     uint32_t get_threads_count() const;
     bool stop();
     bool is_mining() const;
@@ -129,8 +137,21 @@ namespace cryptonote
     std::atomic<uint64_t> m_hashes;
     std::atomic<uint64_t> m_total_hashes;
     std::atomic<uint64_t> m_current_hash_rate;
-    std::mutex m_last_hash_rates_lock;
+    mutable std::mutex m_last_hash_rates_lock;
     std::list<uint64_t> m_last_hash_rates;
+
+    // Per mining thread counters, each on its own cache line so that the threads don't contend.
+    // Only (re)created while no mining threads are running, under m_last_hash_rates_lock.
+    struct alignas(64) thread_stats
+    {
+      std::atomic<uint64_t> hashes{0};
+      uint64_t last_hashes = 0; // `hashes` as of the last merge_hr()
+      uint64_t hash_rate = 0;
+    };
+    std::vector<thread_stats> m_thread_stats;
+    void reset_thread_stats();
+    get_block_hashes_t m_gbhs;
+    bool m_pin_threads;
     bool m_do_print_hashrate;
     bool m_do_mining;
     std::vector<std::pair<uint64_t, uint64_t>> m_threads_autodetect;
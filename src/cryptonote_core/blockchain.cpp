@@ -31,6 +31,8 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <unordered_set>
 #include <boost/endian/conversion.hpp>
 
 #include "common/rules.h"
@@ -55,6 +57,7 @@
 #include "cryptonote_core.h"
 #include "ringct/rctSigs.h"
 #include "common/perf_timer.h"
+#include "common/trace.h"
 #include "common/notify.h"
 #include "masternode_voting.h"
 #include "masternode_list.h"
@@ -555,7 +558,7 @@ bool Blockchain::init(BlockchainDB* db, sqlite3 *ons_db, const network_type nett
   }
   if (num_popped_blocks > 0)
   {
-    m_cache.m_timestamps_and_difficulties_height = 0;
+    m_cache.m_difficulty_window.truncate(m_db->height());
     m_hardfork->reorganize_from_chain_height(get_current_blockchain_height());
     m_tx_pool.on_blockchain_dec();
   }
@@ -725,7 +728,9 @@ block Blockchain::pop_block_from_blockchain()
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::unique_lock lock{*this};
 
-  m_cache.m_timestamps_and_difficulties_height = 0;
+  // Drop the block from the difficulty window before popping it; if the pop fails, the window
+  // simply reloads the block the next time it's needed.
+  m_cache.m_difficulty_window.truncate(m_db->height() - 1);
 
   block popped_block;
   std::vector<transaction> popped_txs;
@@ -789,6 +794,7 @@ block Blockchain::pop_block_from_blockchain()
   m_blocks_longhash_table.clear();
   m_scan_table.clear();
   m_blocks_txs_check.clear();
+  clear_checkpoint_trusted_sync();
 
   CHECK_AND_ASSERT_THROW_MES(update_next_cumulative_weight_limit(), "Error updating next cumulative weight limit");
   m_tx_pool.on_blockchain_dec();
@@ -800,7 +806,7 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::unique_lock lock{*this};
-  m_cache.m_timestamps_and_difficulties_height = 0;
+  m_cache.m_difficulty_window.reset(0);
   invalidate_block_template_cache();
   m_db->reset();
   m_db->drop_alt_blocks();
@@ -984,14 +990,17 @@ difficulty_type Blockchain::get_difficulty_for_next_block(bool pulse)
   top_hash                  = get_tail_id(top_block_height); // get it again now that we have the lock
   uint64_t chain_height     = top_block_height + 1;
 
-  m_db->fill_timestamps_and_difficulties_for_pow(
-      m_nettype, m_cache.m_timestamps, m_cache.m_difficulties, chain_height, m_cache.m_timestamps_and_difficulties_height);
-  uint64_t diff = next_difficulty_v2(m_cache.m_timestamps,
-                                     m_cache.m_difficulties,
-                                     tools::to_seconds(TARGET_BLOCK_TIME),
-                                     difficulty_mode(m_nettype, hf_version, chain_height));
+  static const uint64_t hf16_height = HardFork::get_hardcoded_hard_fork_height(m_nettype, cryptonote::network_version_16_pulse);
+  uint64_t const block_count        = DIFFICULTY_BLOCKS_COUNT(chain_height < hf16_height);
 
-  m_cache.m_timestamps_and_difficulties_height = chain_height;
+  // Only reads the blocks added since the last call (e.g. just the new top block, or the Pulse
+  // blocks since the last PoW block) from the db.
+  auto& window = m_cache.m_difficulty_window;
+  m_db->fill_difficulty_window(window, chain_height, block_count);
+  window.trim(block_count + difficulty_window::SPARE_BLOCKS);
+  uint64_t diff = window.next_difficulty(block_count,
+                                         tools::to_seconds(TARGET_BLOCK_TIME),
+                                         difficulty_mode(m_nettype, hf_version, chain_height));
 
   std::unique_lock diff_lock{m_cache.m_difficulty_lock};
   m_cache.m_difficulty_for_next_block_top_hash = top_hash;
@@ -1024,8 +1033,6 @@ bool Blockchain::rollback_blockchain_switching(const std::list<block_and_checkpo
     return true;
   }
 
-  m_cache.m_timestamps_and_difficulties_height = 0;
-
   // remove blocks from blockchain until we get back to where we should be.
   while (m_db->height() != rollback_height)
   {
@@ -1075,8 +1082,6 @@ bool Blockchain::switch_to_alternative_blockchain(const std::list<block_extended
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::unique_lock lock{*this};
 
-  m_cache.m_timestamps_and_difficulties_height = 0;
-
   // if empty alt chain passed (not sure how that could happen), return false
   CHECK_AND_ASSERT_MES(alt_chain.size(), false, "switch_to_alternative_blockchain: empty chain passed");
 
@@ -1204,65 +1209,31 @@ difficulty_type Blockchain::get_difficulty_for_alternative_chain(const std::list
     block_count = DIFFICULTY_BLOCKS_COUNT(before_hf16);
   }
 
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> cumulative_difficulties;
-  // if the alt chain isn't long enough to calculate the difficulty target
-  // based on its blocks alone, need to get more blocks from the main chain
-  if(alt_chain.size() < block_count)
+  // if the alt chain isn't long enough to calculate the difficulty target based on its blocks
+  // alone, we also need the main chain blocks below the fork point.  Start from a copy of the main
+  // chain's difficulty window, which normally already holds them, so that an alt chain doesn't
+  // cost a reload of the whole window from the db for every block added to it.
+  uint64_t const fork_height = alt_chain.size() ? alt_chain.front().height : alt_block_height;
+  difficulty_window window;
+  if (alt_chain.size() < block_count)
   {
     std::unique_lock lock{*this};
-
-    // Figure out start and stop offsets for main chain blocks
-    size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front().height : alt_block_height;
-    size_t main_chain_count = block_count - std::min(static_cast<size_t>(block_count), alt_chain.size());
-    main_chain_count = std::min(main_chain_count, main_chain_stop_offset);
-    size_t main_chain_start_offset = main_chain_stop_offset - main_chain_count;
-
-    if(!main_chain_start_offset)
-      ++main_chain_start_offset; //skip genesis block
-
-    // get difficulties and timestamps from relevant main chain blocks
-    for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
-    {
-      timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
-      cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(main_chain_start_offset));
-    }
-
-    // make sure we haven't accidentally grabbed too many blocks...maybe don't need this check?
-    CHECK_AND_ASSERT_MES((alt_chain.size() + timestamps.size()) <= block_count, false, "Internal error, alt_chain.size()[" << alt_chain.size() << "] + vtimestampsec.size()[" << timestamps.size() << "] NOT <= DIFFICULTY_WINDOW[]" << block_count);
-
-    for (const auto &bei : alt_chain)
-    {
-      timestamps.push_back(bei.bl.timestamp);
-      cumulative_difficulties.push_back(bei.cumulative_difficulty);
-    }
+    window = m_cache.m_difficulty_window;
+    m_db->fill_difficulty_window(window, fork_height, block_count - alt_chain.size());
   }
-  // if the alt chain is long enough for the difficulty calc, grab difficulties
-  // and timestamps from it alone
   else
   {
-    timestamps.resize(static_cast<size_t>(block_count));
-    cumulative_difficulties.resize(static_cast<size_t>(block_count));
-    size_t count = 0;
-    size_t max_i = timestamps.size()-1;
-    // get difficulties and timestamps from most recent blocks in alt chain
-    for (auto it = alt_chain.rbegin(); it != alt_chain.rend(); ++it)
-    {
-      const auto& bei = *it;
-      timestamps[max_i - count] = bei.bl.timestamp;
-      cumulative_difficulties[max_i - count] = bei.cumulative_difficulty;
-      count++;
-      if(count >= block_count)
-        break;
-    }
+    window.reset(fork_height);
   }
 
+  for (const auto &bei : alt_chain)
+    window.push_back(bei.bl.timestamp, bei.cumulative_difficulty);
+
   // calculate the difficulty target for the block and return it
-  uint64_t height = (alt_chain.size() ? alt_chain.front().height : alt_block_height) + alt_chain.size() + 1;
-  return next_difficulty_v2(timestamps,
-                            cumulative_difficulties,
-                            tools::to_seconds(TARGET_BLOCK_TIME),
-                            difficulty_mode(m_nettype, get_current_hard_fork_version(), height));
+  uint64_t height = fork_height + alt_chain.size() + 1;
+  return window.next_difficulty(block_count,
+                                tools::to_seconds(TARGET_BLOCK_TIME),
+                                difficulty_mode(m_nettype, get_current_hard_fork_version(), height));
 }
 //------------------------------------------------------------------
 // This function does a sanity check on basic things that all miner
@@ -1877,9 +1848,6 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     return false;
   }
 
-  // NOTE: Reset timestamp/difficulty cache
-  m_cache.m_timestamps_and_difficulties_height = 0;
-
   // NOTE: Build the alternative chain for checking reorg-ability
   std::list<block_extended_info> alt_chain;
   std::vector<uint64_t> timestamps;
@@ -3384,6 +3352,9 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
       return false;
     }
 
+    const crypto::hash tx_hash = get_transaction_hash(tx);
+    const bool skip_signatures = checkpoint_trusted_skip(tx_hash);
+
     // from version 2, check ringct signatures
     // obviously, the original and simple rct APIs use a mixRing that's indexes
     // in opposite orders, because it'd be too simple otherwise...
@@ -3454,11 +3425,18 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRctNonSemanticsSimple(rv))
+      const crypto::hash ring = verified_signature_cache::ring_digest(rv.mixRing);
+      if (skip_signatures)
+        MTRACE("Skipping ringct signature check of tx " << tx_hash << ": covered by a masternode checkpoint");
+      else if (m_verified_signatures.contains(tx_hash, ring))
+        MTRACE("Skipping ringct signature check of tx " << tx_hash << ": already verified against the same ring");
+      else if (!rct::verRctNonSemanticsSimple(rv))
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
       }
+      else
+        m_verified_signatures.add(tx_hash, ring);
       break;
     }
     case rct::RCTType::Full:
@@ -3513,11 +3491,18 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRct(rv, false))
+      const crypto::hash ring = verified_signature_cache::ring_digest(rv.mixRing);
+      if (skip_signatures)
+        MTRACE("Skipping ringct signature check of tx " << tx_hash << ": covered by a masternode checkpoint");
+      else if (m_verified_signatures.contains(tx_hash, ring))
+        MTRACE("Skipping ringct signature check of tx " << tx_hash << ": already verified against the same ring");
+      else if (!rct::verRct(rv, false))
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
       }
+      else
+        m_verified_signatures.add(tx_hash, ring);
       break;
     }
     default:
@@ -4195,6 +4180,7 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 
+  TRACE_SPAN(handle_block_to_main_chain);
   TIME_MEASURE_START(block_processing_time);
   std::unique_lock lock{*this};
   db_rtxn_guard rtxn_guard(m_db);
@@ -4229,6 +4215,7 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
     miner.difficulty_calc_time = epee::misc_utils::get_tick_count();
     miner.difficulty_calc_time = epee::misc_utils::get_tick_count() - miner.difficulty_calc_time;
 
+    TRACE_SPAN(verify_block_pow);
     miner.verify_pow_time = epee::misc_utils::get_tick_count();
     miner.blk_pow         = verify_block_pow(bl, current_diffic, chain_height, false /*alt_block*/);
     miner.verify_pow_time = epee::misc_utils::get_tick_count() - miner.verify_pow_time;
@@ -4257,6 +4244,7 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
 
 // XXX old code adds miner tx here
 
+  TRACE_SPAN(check_block_txs);
   size_t tx_index = 0;
   // Iterate over the block's transaction hashes, grabbing each
   // from the tx_pool and validating them.  Each is then added
@@ -4361,6 +4349,7 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
   }
 
   m_blocks_txs_check.clear();
+  TRACE_SPAN_END(check_block_txs);
 
   TIME_MEASURE_START(vmt);
   uint64_t base_reward = 0;
@@ -4397,6 +4386,7 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
   {
     try
     {
+      TRACE_SPAN(db_add_block);
       uint64_t long_term_block_weight = get_next_long_term_block_weight(block_weight);
       cryptonote::blobdata bd = cryptonote::block_to_blob(bl);
       new_height = m_db->add_block(std::make_pair(std::move(bl), std::move(bd)), block_weight, long_term_block_weight, cumulative_difficulty, already_generated_coins, txs);
@@ -4443,6 +4433,7 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
   for (std::pair<transaction, blobdata> const &tx_pair : txs)
     only_txs.push_back(tx_pair.first);
 
+  TRACE_SPAN(block_added_hooks);
   if (!m_masternode_list.block_added(bl, only_txs, checkpoint))
   {
     MGINFO_RED("Failed to add block to Masternode List.");
@@ -4467,8 +4458,16 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
     }
   }
 
+  TRACE_SPAN_END(block_added_hooks);
   TIME_MEASURE_FINISH(addblock);
 
+  // Mined txs won't be verified again (unless popped back into the pool, which re-verifies them)
+  for (const crypto::hash &tx_hash : bl.tx_hashes)
+    m_verified_signatures.remove(tx_hash);
+
+  // The masternode list now knows the next quorums, which may let us verify more checkpoints
+  update_checkpoint_trusted_sync();
+
   // do this after updating the hard fork state since the weight limit may change due to fork
   if (!update_next_cumulative_weight_limit())
   {
@@ -4796,6 +4795,7 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   bool success = false;
 
   MTRACE("Blockchain::" << __func__);
+  TRACE_SPAN(cleanup_handle_incoming_blocks);
   TIME_MEASURE_START(t1);
 
   try
@@ -4811,6 +4811,13 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
     MERROR("Exception in cleanup_handle_incoming_blocks: " << e.what());
   }
 
+  // The aborted blocks may have been loaded into the difficulty window.  Filling the window only
+  // drops blocks above the current height, and Pulse blocks don't fill it at all, so if replacement
+  // blocks took the chain back past them the next PoW difficulty would be based on blocks that no
+  // longer exist.
+  if (!m_batch_success)
+    m_cache.m_difficulty_window.truncate(m_db->height());
+
   if (success && m_sync_counter > 0)
   {
     if (force_sync)
@@ -5038,6 +5045,7 @@ bool Blockchain::calc_batched_governance_reward(uint64_t height, uint64_t &rewar
 bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry, std::vector<block> &blocks)
 {
   MTRACE("Blockchain::" << __func__);
+  TRACE_SPAN(prepare_handle_incoming_blocks);
   TIME_MEASURE_START(prepare);
   uint64_t bytes = 0;
   size_t total_txs = 0;
@@ -5081,6 +5089,8 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   }
   m_batch_success = true;
 
+  queue_checkpoint_trusted_sync(blocks_entry);
+
   const uint64_t height = m_db->height();
   if ((height + blocks_entry.size()) < m_blocks_hash_check.size())
     return true;
@@ -5635,6 +5645,228 @@ bool Blockchain::is_within_compiled_block_hash_area(uint64_t height) const
 #endif
 }
 
+void Blockchain::set_checkpoint_trusted_sync(checkpoint_trust mode, uint8_t sample_percent)
+{
+  std::unique_lock lock{*this};
+  m_checkpoint_trust = mode;
+  m_checkpoint_trust_sample_percent = std::min<uint8_t>(sample_percent, 100);
+  m_checkpoint_trust_salt = crypto::rand<uint64_t>();
+  clear_checkpoint_trusted_sync();
+  if (mode == checkpoint_trust::skip)
+    MGINFO("Checkpoint-trusted sync enabled: skipping signature and range proof checks of transactions in blocks covered by masternode checkpoints");
+  else if (mode == checkpoint_trust::sample)
+    MGINFO("Checkpoint-trusted sync enabled: only verifying signatures and range proofs of " << +m_checkpoint_trust_sample_percent
+        << "% of the transactions in blocks covered by masternode checkpoints");
+}
+
+void Blockchain::clear_checkpoint_trusted_sync()
+{
+  m_checkpoint_trust_pending_blocks.clear();
+  m_checkpoint_trust_pending_txs.clear();
+  m_checkpoint_trust_pending_checkpoints.clear();
+  std::lock_guard lock{m_checkpoint_trust_mutex};
+  m_checkpoint_trusted_txs.clear();
+}
+
+bool Blockchain::checkpoint_trust_sampled(const crypto::hash &txid) const
+{
+  if (m_checkpoint_trust != checkpoint_trust::sample)
+    return false;
+  uint64_t v;
+  std::memcpy(&v, txid.data, sizeof(v));
+  return (v ^ m_checkpoint_trust_salt) % 100 < m_checkpoint_trust_sample_percent;
+}
+
+bool Blockchain::checkpoint_trusted_skip(const crypto::hash &txid) const
+{
+  if (m_checkpoint_trust == checkpoint_trust::off)
+    return false;
+  {
+    std::lock_guard lock{m_checkpoint_trust_mutex};
+    if (m_checkpoint_trusted_txs.count(txid) == 0)
+      return false;
+  }
+  return !checkpoint_trust_sampled(txid);
+}
+
+bool Blockchain::precheck_tx_signatures(const transaction& tx, const crypto::hash& txid) const
+{
+  PERF_TIMER(precheck_tx_signatures);
+  if (!tx.is_transfer() || tx.pruned || tx.vin.empty() ||
+      !tools::equals_any(tx.rct_signatures.type, rct::RCTType::Simple, rct::RCTType::Bulletproof, rct::RCTType::Bulletproof2, rct::RCTType::CLSAG))
+    return false;
+
+  // Do the cheap key image checks before fetching rings and verifying signatures, so that
+  // resending transactions that are already spent can't be used to burn our CPU.
+  std::unordered_set<crypto::key_image> key_images;
+  for (const auto &in : tx.vin)
+  {
+    const auto *in_to_key = std::get_if<txin_to_key>(&in);
+    if (!in_to_key || in_to_key->key_offsets.empty() || !key_images.insert(in_to_key->k_image).second)
+      return false;
+  }
+
+  std::vector<std::vector<rct::ctkey>> pubkeys(tx.vin.size());
+  try
+  {
+    db_rtxn_guard rtxn_guard(m_db);
+    for (const auto &key_image : key_images)
+    {
+      if (m_db->has_key_image(key_image))
+      {
+        MDEBUG("Not prechecking tx " << txid << ": key image " << key_image << " is already spent");
+        return false;
+      }
+    }
+
+    for (size_t i = 0; i < tx.vin.size(); i++)
+    {
+      const auto *in_to_key = std::get_if<txin_to_key>(&tx.vin[i]);
+      const std::vector<uint64_t> offsets = relative_output_offsets_to_absolute(in_to_key->key_offsets);
+      std::vector<output_data_t> outputs;
+      m_db->get_output_key(epee::span<const uint64_t>(&in_to_key->amount, 1), offsets, outputs, true);
+      if (outputs.size() != offsets.size())
+        return false; // Ring references outputs we don't (yet) have; check_tx_inputs will deal with it
+
+      pubkeys[i].reserve(outputs.size());
+      for (const auto &out : outputs)
+        pubkeys[i].push_back(rct::ctkey{rct::pk2rct(out.pubkey), out.commitment});
+    }
+  }
+  catch (const std::exception &e)
+  {
+    MDEBUG("Unable to look up ring members of tx " << txid << ": " << e.what());
+    return false;
+  }
+
+  transaction expanded{tx};
+  if (!expand_transaction_2(expanded, get_transaction_prefix_hash(tx), pubkeys))
+    return false;
+  if (!rct::verRctNonSemanticsSimple(expanded.rct_signatures))
+  {
+    MDEBUG("Ringct signatures of tx " << txid << " failed to verify ahead of admission");
+    return false;
+  }
+
+  m_verified_signatures.add(txid, verified_signature_cache::ring_digest(expanded.rct_signatures.mixRing));
+  return true;
+}
+
+
+void Blockchain::queue_checkpoint_trusted_sync(const std::vector<block_complete_entry> &blocks_entry)
+{
+  const uint64_t height = m_db->height();
+  m_checkpoint_trust_pending_blocks.clear();
+  m_checkpoint_trust_pending_txs.clear();
+  m_checkpoint_trust_pending_checkpoints.clear();
+  {
+    // Anything covering blocks we have already added is no longer needed
+    std::lock_guard lock{m_checkpoint_trust_mutex};
+    for (auto it = m_checkpoint_trusted_txs.begin(); it != m_checkpoint_trusted_txs.end(); )
+    {
+      if (it->second < height)
+        it = m_checkpoint_trusted_txs.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  if (m_checkpoint_trust == checkpoint_trust::off || is_within_compiled_block_hash_area(height + blocks_entry.size()) ||
+      get_current_hard_fork_version() < network_version_13_enforce_checkpoints)
+    return;
+
+  std::vector<checkpoint_t> checkpoints;
+  for (const auto &entry : blocks_entry)
+  {
+    if (entry.checkpoint.empty())
+      continue;
+    checkpoint_t checkpoint;
+    if (!t_serializable_object_from_blob(checkpoint, entry.checkpoint) || checkpoint.type != checkpoint_type::masternode)
+      continue;
+    checkpoints.push_back(std::move(checkpoint));
+  }
+  if (checkpoints.empty())
+    return;
+
+  // The checkpoints only vouch for the blocks in front of them if the batch extends our chain
+  std::vector<crypto::hash> hashes;
+  std::vector<std::vector<crypto::hash>> txs;
+  hashes.reserve(blocks_entry.size());
+  txs.reserve(blocks_entry.size());
+  crypto::hash prev_hash = m_db->top_block_hash();
+  for (const auto &entry : blocks_entry)
+  {
+    block b;
+    crypto::hash hash;
+    if (!parse_and_validate_block_from_blob(entry.block, b, hash) || b.prev_id != prev_hash)
+    {
+      MDEBUG("Not using the checkpoints of this sync batch: its blocks don't extend our chain");
+      return;
+    }
+    hashes.push_back(hash);
+    txs.push_back(std::move(b.tx_hashes));
+    prev_hash = hash;
+  }
+
+  std::sort(checkpoints.begin(), checkpoints.end(), [](const auto &a, const auto &b) { return a.height < b.height; });
+  m_checkpoint_trust_pending_height = height;
+  m_checkpoint_trust_pending_blocks = std::move(hashes);
+  m_checkpoint_trust_pending_txs = std::move(txs);
+  m_checkpoint_trust_pending_checkpoints = std::move(checkpoints);
+  update_checkpoint_trusted_sync();
+}
+
+void Blockchain::update_checkpoint_trusted_sync()
+{
+  if (m_checkpoint_trust_pending_checkpoints.empty())
+    return;
+
+  const uint64_t height = m_db->height();
+  auto &checkpoints = m_checkpoint_trust_pending_checkpoints;
+  size_t verified = 0;
+  for (; verified < checkpoints.size(); verified++)
+  {
+    const auto &checkpoint = checkpoints[verified];
+    if (checkpoint.height < height)
+      continue; // Covers nothing we haven't already added
+
+    // A checkpoint's quorum only gets determined REORG_SAFETY_BUFFER_BLOCKS_POST_HF12 blocks before
+    // it, so this (and every later checkpoint) has to wait until we have added more blocks.
+    auto quorum = m_masternode_list.get_quorum(masternodes::quorum_type::checkpointing, checkpoint.height);
+    if (!quorum)
+      break;
+
+    const uint64_t index = checkpoint.height - m_checkpoint_trust_pending_height;
+    if (index >= m_checkpoint_trust_pending_blocks.size() || m_checkpoint_trust_pending_blocks[index] != checkpoint.block_hash ||
+        !masternodes::verify_checkpoint(get_ideal_hard_fork_version(checkpoint.height), checkpoint, *quorum))
+    {
+      MWARNING("Masternode checkpoint at height " << checkpoint.height << " in the sync batch does not verify or does not match its block; verifying the batch fully");
+      m_checkpoint_trust_pending_checkpoints.clear();
+      return;
+    }
+
+    size_t num_txs = 0, num_sampled = 0;
+    {
+      std::lock_guard lock{m_checkpoint_trust_mutex};
+      for (uint64_t i = height - m_checkpoint_trust_pending_height; i <= index; i++)
+      {
+        for (const auto &txid : m_checkpoint_trust_pending_txs[i])
+        {
+          if (!m_checkpoint_trusted_txs.emplace(txid, checkpoint.height).second)
+            continue; // Already covered by an earlier checkpoint
+          num_txs++;
+          if (checkpoint_trust_sampled(txid))
+            num_sampled++;
+        }
+      }
+    }
+    MINFO("Masternode checkpoint for block " << checkpoint.block_hash << " at height " << checkpoint.height << " verified; "
+        << (m_checkpoint_trust == checkpoint_trust::sample ? "sampling " + std::to_string(num_sampled) + " of " : "skipping ")
+        << num_txs << " transactions' signature and range proof checks up to that height");
+  }
+  checkpoints.erase(checkpoints.begin(), checkpoints.begin() + verified);
+}
+
 bool Blockchain::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
 {
   return m_db->for_all_key_images(f);
@@ -46,6 +46,7 @@
 #include <boost/multi_index/member.hpp>
 #include <atomic>
 #include <functional>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -65,6 +66,7 @@
 #include "blockchain_db/blockchain_db.h"
 #include "cryptonote_core/quenero_name_system.h"
 #include "pulse.h"
+#include "verified_signature_cache.h"
 
 struct sqlite3;
 namespace masternodes { class masternode_list; };
@@ -625,6 +627,28 @@ namespace cryptonote
      */
     bool check_tx_inputs(transaction& tx, uint64_t& pmax_used_block_height, crypto::hash& max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false, std::unordered_set<crypto::key_image>* key_image_conflicts = nullptr);
 
+    /**
+     * @brief verifies a transaction's ringct signatures ahead of check_tx_inputs
+     *
+     * Fetches the ring members referenced by the transaction's inputs and verifies its
+     * (non-semantic) ringct signatures without taking the blockchain lock, so that it can be
+     * run for a batch of incoming transactions in parallel.  On success the verified ring is
+     * recorded in the verified signature cache and a later check_tx_inputs() of the same
+     * transaction skips the signature check if it rebuilds an identical ring; key images, ring
+     * member unlock times and everything else are still checked there, under the lock.
+     *
+     * Only Simple/Bulletproof/Bulletproof2/CLSAG transfers are handled; anything else (or a
+     * ring referencing outputs we don't have yet) is left entirely to check_tx_inputs().  So are
+     * transactions with duplicate or already spent key images, which are rejected before any ring
+     * lookups or signature verification.
+     *
+     * @param tx the (unpruned) transaction to check
+     * @param txid the transaction's hash
+     *
+     * @return true if the signatures were verified and recorded, false otherwise
+     */
+    bool precheck_tx_signatures(const transaction& tx, const crypto::hash& txid) const;
+
     /**
      * @brief get fee quantization mask
      *
@@ -789,6 +813,42 @@ namespace cryptonote
     void set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold,
         blockchain_db_sync_mode sync_mode, bool fast_sync);
 
+    /// How transactions in blocks covered by a verified masternode checkpoint are verified while
+    /// syncing.  See set_checkpoint_trusted_sync().
+    enum class checkpoint_trust : uint8_t
+    {
+      off,    ///< verify everything (default)
+      sample, ///< fully verify only a random sample of the covered transactions
+      skip,   ///< skip the signature and range proof checks of all covered transactions
+    };
+
+    /**
+     * @brief sets the checkpoint-trusted sync mode
+     *
+     * When a batch of synced blocks includes a masternode checkpoint, and that checkpoint (once its
+     * quorum is known) verifies and commits to the batch's block at its height, every block
+     * between our chain tip and the checkpoint is fixed by the checkpoint quorum's signatures.  The
+     * ring signatures and range proofs of the transactions in those blocks can then be skipped
+     * (or only checked for a sample of them); all other checks (key images, ring member outputs,
+     * unlock times, masternode rules, ...) still run.
+     *
+     * @param mode which transactions to skip the signature and range proof checks of
+     * @param sample_percent the percentage of covered transactions to still fully verify in
+     * `sample` mode
+     */
+    void set_checkpoint_trusted_sync(checkpoint_trust mode, uint8_t sample_percent);
+
+    /**
+     * @brief checks whether a transaction's ring signatures and range proofs need not be verified
+     * because it is part of an upcoming block covered by a verified masternode checkpoint (and,
+     * in `sample` mode, wasn't picked for full verification).  Safe to call from any thread.
+     *
+     * @param txid the transaction hash
+     *
+     * @return true if the signature and range proof checks can be skipped
+     */
+    bool checkpoint_trusted_skip(const crypto::hash &txid) const;
+
     /**
      * @brief sets a block notify object to call for every new block
      *
@@ -1144,6 +1204,25 @@ namespace cryptonote
     std::vector<crypto::hash> m_blocks_hash_check;
     std::vector<crypto::hash> m_blocks_txs_check;
 
+    // Checkpoint-trusted sync state.  The pending_* fields describe the sync batch currently being
+    // added (and are only touched with the blockchain lock held); the transactions of the blocks
+    // covered by a verified checkpoint go into m_checkpoint_trusted_txs (guarded by its own mutex,
+    // since the tx pool side looks it up without the blockchain lock).
+    checkpoint_trust m_checkpoint_trust = checkpoint_trust::off;
+    uint8_t m_checkpoint_trust_sample_percent = 0;
+    uint64_t m_checkpoint_trust_salt = 0;                                 // Randomizes which txs get sampled
+    uint64_t m_checkpoint_trust_pending_height = 0;                       // Height of the first pending block
+    std::vector<crypto::hash> m_checkpoint_trust_pending_blocks;          // Pending block hashes
+    std::vector<std::vector<crypto::hash>> m_checkpoint_trust_pending_txs; // Pending blocks' tx hashes
+    std::vector<checkpoint_t> m_checkpoint_trust_pending_checkpoints;     // Not yet verified, in height order
+    mutable std::mutex m_checkpoint_trust_mutex;
+    std::unordered_map<crypto::hash, uint64_t> m_checkpoint_trusted_txs;  // tx hash -> covering checkpoint height
+
+    // Transactions whose ringct signatures have been verified (by precheck_tx_signatures() or
+    // when entering the tx pool) so that check_tx_inputs() doesn't verify them again when they
+    // get mined.  Internally locked: precheck_tx_signatures() fills it without the blockchain lock.
+    mutable verified_signature_cache m_verified_signatures;
+
     blockchain_db_sync_mode m_db_sync_mode;
     bool m_fast_sync;
     bool m_show_time_stats;
@@ -1170,12 +1249,11 @@ namespace cryptonote
     {
       std::mutex m_difficulty_lock;
 
-      // NOTE: PoW Difficulty Calculation Metadata
-      std::vector<uint64_t> m_timestamps;
-      std::vector<difficulty_type> m_difficulties;
+      // NOTE: PoW Difficulty Calculation Metadata.  Only ever holds main chain blocks: it is
+      // truncated whenever blocks are popped, and topped up from the db as blocks are added.
+      difficulty_window m_difficulty_window;
 
       // NOTE: Cache Invalidation Checks
-      uint64_t m_timestamps_and_difficulties_height{0};
       crypto::hash m_difficulty_for_next_block_top_hash{crypto::null_hash};
       difficulty_type m_difficulty_for_next_miner_block{1};
     } m_cache;
@@ -1555,6 +1633,18 @@ namespace cryptonote
      */
     void load_compiled_in_block_hashes(const GetCheckpointsCallback& get_checkpoints);
 
+    // Picks up the masternode checkpoints of a sync batch for checkpoint-trusted sync
+    void queue_checkpoint_trusted_sync(const std::vector<block_complete_entry> &blocks_entry);
+
+    // Verifies the pending sync batch checkpoints whose quorums are now known, trusting the
+    // transactions of the blocks they cover
+    void update_checkpoint_trusted_sync();
+
+    // Returns true if `txid` gets fully verified despite being covered by a checkpoint
+    bool checkpoint_trust_sampled(const crypto::hash &txid) const;
+
+    void clear_checkpoint_trusted_sync();
+
     /**
      * @brief expands v2 transaction data from blockchain
      *
@@ -53,6 +53,8 @@ extern "C" {
 #include "common/file.h"
 #include "common/sha256sum.h"
 #include "common/threadpool.h"
+#include "common/trace.h"
+#include "common/util.h"
 #include "common/command_line.h"
 #include "common/hex.h"
 #include "common/base58.h"
@@ -155,6 +157,17 @@ namespace cryptonote
   , "Sync up most of the way by using embedded, known block hashes."
   , 1
   };
+  static const command_line::arg_descriptor<std::string> arg_checkpoint_trusted_sync = {
+    "checkpoint-trusted-sync"
+  , "When syncing blocks covered by a verified masternode checkpoint, skip (\"skip\") or only sample (\"sample\") the ring "
+    "signature and range proof checks of their transactions, or verify everything (\"off\")."
+  , "off"
+  };
+  static const command_line::arg_descriptor<uint32_t> arg_checkpoint_trusted_sample = {
+    "checkpoint-trusted-sample"
+  , "Percentage of the transactions in checkpoint-covered blocks to still fully verify with --checkpoint-trusted-sync=sample."
+  , 10
+  };
   static const command_line::arg_descriptor<uint64_t> arg_prep_blocks_threads = {
     "prep-blocks-threads"
   , "Max number of threads to use when preparing block hashes in groups."
@@ -274,6 +287,9 @@ namespace cryptonote
   , m_miner(this, [this](const cryptonote::block &b, uint64_t height, unsigned int threads, crypto::hash &hash) {
     hash = cryptonote::get_block_longhash_w_blockchain(m_nettype, &m_blockchain_storage, b, height, threads);
     return true;
+  }, [this](const cryptonote::block &b, uint64_t height, unsigned int threads, std::string &blob, size_t nonce_offset, uint32_t nonce, uint32_t nonce_step, crypto::hash *hashes, size_t count) {
+    cryptonote::get_block_longhashes(m_nettype, cryptonote::randomx_longhash_context(&m_blockchain_storage, b, height), b.major_version,
+        blob, nonce_offset, nonce, nonce_step, hashes, count, threads);
   })
   , m_pprotocol(&m_protocol_stub)
   , m_starter_message_showed(false)
@@ -336,6 +352,8 @@ namespace cryptonote
     command_line::add_arg(desc, arg_dev_allow_local);
     command_line::add_arg(desc, arg_prep_blocks_threads);
     command_line::add_arg(desc, arg_fast_block_sync);
+    command_line::add_arg(desc, arg_checkpoint_trusted_sync);
+    command_line::add_arg(desc, arg_checkpoint_trusted_sample);
     command_line::add_arg(desc, arg_show_time_stats);
     command_line::add_arg(desc, arg_block_sync_size);
     command_line::add_arg(desc, arg_offline);
@@ -757,6 +775,29 @@ namespace cryptonote
     m_blockchain_storage.set_user_options(blocks_threads,
         sync_on_blocks, sync_threshold, sync_mode, fast_sync);
 
+    {
+      auto trusted_sync = command_line::get_arg(vm, arg_checkpoint_trusted_sync);
+      auto trusted_sample = command_line::get_arg(vm, arg_checkpoint_trusted_sample);
+      Blockchain::checkpoint_trust mode;
+      if (trusted_sync == "off")
+        mode = Blockchain::checkpoint_trust::off;
+      else if (trusted_sync == "sample")
+        mode = Blockchain::checkpoint_trust::sample;
+      else if (trusted_sync == "skip")
+        mode = Blockchain::checkpoint_trust::skip;
+      else
+      {
+        MERROR("Invalid --" << arg_checkpoint_trusted_sync.name << " value '" << trusted_sync << "': expected off, sample or skip");
+        return false;
+      }
+      if (trusted_sample > 100)
+      {
+        MERROR("Invalid --" << arg_checkpoint_trusted_sample.name << " value " << trusted_sample << ": must be a percentage");
+        return false;
+      }
+      m_blockchain_storage.set_checkpoint_trusted_sync(mode, static_cast<uint8_t>(trusted_sample));
+    }
+
     try
     {
       if (!command_line::is_arg_defaulted(vm, arg_block_notify))
@@ -1050,6 +1091,8 @@ namespace cryptonote
         },
         oxenmq::LogLevel::trace
     );
+    // Reserved category threads come on top of these; see tools::get_thread_budget
+    m_omq->set_general_threads(tools::get_thread_budget().omq);
 
     // ping.ping: a simple debugging target for pinging the omq listener
     m_omq->add_category("ping", Access{AuthLevel::none})
@@ -1220,6 +1263,11 @@ namespace cryptonote
 
       if (!tx_info[n].tx.is_transfer())
         continue;
+      if (kept_by_block && get_blockchain_storage().checkpoint_trusted_skip(tx_info[n].tx_hash))
+      {
+        MTRACE("Skipping rct semantics check of tx " << tx_info[n].tx_hash << ": covered by a masternode checkpoint");
+        continue;
+      }
       const rct::rctSig &rv = tx_info[n].tx.rct_signatures;
       switch (rv.type) {
         case rct::RCTType::Null:
@@ -1333,6 +1381,39 @@ namespace cryptonote
 
     parse_incoming_tx_accumulated_batch(tx_info, opts.kept_by_block);
 
+    // Fetch the rings and verify the ringct signatures of everything that made it this far in
+    // parallel, without the blockchain lock: handle_parsed_txs then only has to re-check key
+    // images and ring members under the lock, reusing these results when the ring still matches.
+    const bool in_hash_area = opts.kept_by_block && m_blockchain_storage.is_within_compiled_block_hash_area();
+    for (auto &info : tx_info) {
+      if (in_hash_area || !info.result || info.already_have || !info.tx.is_transfer())
+        continue;
+      if (opts.kept_by_block && m_blockchain_storage.checkpoint_trusted_skip(info.tx_hash))
+        continue;
+      // Double spends of pool txs are left to handle_parsed_txs (which rejects them unless they
+      // replace the pool tx) rather than costing a signature verification here.  This is checked
+      // on this thread rather than in the workers: our caller may hold the pool lock.
+      std::vector<crypto::key_image> key_images;
+      for (const auto &in : info.tx.vin)
+        if (auto *in_to_key = std::get_if<txin_to_key>(&in))
+          key_images.push_back(in_to_key->k_image);
+      std::vector<bool> pool_spent;
+      m_mempool.check_for_key_images(key_images, pool_spent);
+      if (std::find(pool_spent.begin(), pool_spent.end(), true) != pool_spent.end())
+        continue;
+      tpool.submit(&waiter, [this, &info] {
+        try
+        {
+          m_blockchain_storage.precheck_tx_signatures(info.tx, info.tx_hash);
+        }
+        catch (const std::exception &e)
+        {
+          MDEBUG("Exception in precheck_tx_signatures: " << e.what());
+        }
+      });
+    }
+    waiter.wait(&tpool);
+
     return tx_info;
   }
 
@@ -2170,6 +2251,7 @@ namespace cryptonote
   bool core::handle_incoming_block(const blobdata& block_blob, const block *b, block_verification_context& bvc, checkpoint_t *checkpoint, bool update_miner_blocktemplate)
   {
     TRY_ENTRY();
+    TRACE_SPAN(handle_incoming_block);
     bvc = {};
 
     if (!check_incoming_block_size(block_blob))
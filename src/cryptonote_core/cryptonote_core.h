@@ -208,6 +208,10 @@ namespace cryptonote
       * already seen.  The result is intended to be passed onto handle_parsed_txs (possibly with a
       * remove_conflicting_txs() first).
       *
+      * The ringct signatures of the new transactions are also verified here, in parallel and
+      * without the blockchain lock (see Blockchain::precheck_tx_signatures), which keeps the
+      * locked part of handle_parsed_txs down to the key image and ring member checks.
+      *
       * m_incoming_tx_lock must already be held (i.e. via incoming_tx_lock()), and should be held
       * until the returned value is passed on to handle_parsed_txs.
       *
@@ -28,6 +28,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <cstring>
 #include <unordered_set>
 #include <random>
 #include "epee/string_tools.h"
@@ -1092,6 +1093,44 @@ namespace cryptonote
     return result;
   }
 
+  void get_block_longhashes(cryptonote::network_type nettype, randomx_longhash_context const &randomx_context, uint8_t major_version,
+      std::string& blob, size_t nonce_offset, uint32_t nonce, uint32_t nonce_step, crypto::hash* hashes, size_t count, int miners)
+  {
+    CHECK_AND_ASSERT_THROW_MES(nonce_offset + sizeof(nonce) <= blob.size(), "Invalid block hashing blob nonce offset");
+
+#if defined(QUENERO_INTEGRATION_TESTS)
+    miners = 0;
+#endif
+
+    if (nettype != FAKECHAIN && major_version >= network_version_12_checkpointing)
+    {
+      rx_slow_hash_nonces(randomx_context.current_blockchain_height,
+                          randomx_context.seed_height,
+                          randomx_context.seed_block_hash.data,
+                          blob.data(),
+                          blob.size(),
+                          nonce_offset,
+                          nonce,
+                          nonce_step,
+                          count,
+                          reinterpret_cast<char*>(hashes),
+                          miners);
+      return;
+    }
+
+    crypto::cn_slow_hash_type cn_type =
+        nettype == FAKECHAIN                                   ? cn_slow_hash_type::turtle_lite_v2 :
+        major_version >= network_version_11_infinite_staking   ? cn_slow_hash_type::turtle_lite_v2 :
+        major_version >= network_version_7                     ? cn_slow_hash_type::heavy_v2 :
+                                                                 cn_slow_hash_type::heavy_v1;
+    for (size_t i = 0; i < count; i++, nonce += nonce_step)
+    {
+      uint32_t le = swap32le(nonce);
+      std::memcpy(blob.data() + nonce_offset, &le, sizeof(le));
+      crypto::cn_slow_hash(blob.data(), blob.size(), hashes[i], cn_type);
+    }
+  }
+
   crypto::hash get_block_longhash_w_blockchain(cryptonote::network_type nettype, const Blockchain *pbc, const block& b, uint64_t height, int miners)
   {
     crypto::hash result = get_block_longhash(nettype,randomx_longhash_context(pbc, b, height), b, height, miners);
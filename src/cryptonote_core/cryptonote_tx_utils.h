@@ -256,6 +256,12 @@ namespace cryptonote
   crypto::hash get_block_longhash(cryptonote::network_type nettype, randomx_longhash_context const &randomx_context, const block& b, uint64_t height, int miners);
   crypto::hash get_altblock_longhash(cryptonote::network_type nettype, randomx_longhash_context const &randomx_context, const block& b, uint64_t height);
   crypto::hash get_block_longhash_w_blockchain(cryptonote::network_type nettype, const Blockchain *pb, const block& b, uint64_t height, int miners);
+  // Computes the PoW hashes of `count` nonces of a block whose hashing blob (see
+  // get_block_hashing_blob) is `blob`: nonce `nonce + i*nonce_step` is written into the blob at
+  // `nonce_offset` (see get_block_hashing_blob_nonce_offset) before computing hashes[i].  RandomX
+  // blocks go through the pipelined RandomX API; `blob` is left holding the last nonce.
+  void get_block_longhashes(cryptonote::network_type nettype, randomx_longhash_context const &randomx_context, uint8_t major_version,
+      std::string& blob, size_t nonce_offset, uint32_t nonce, uint32_t nonce_step, crypto::hash* hashes, size_t count, int miners);
   void get_block_longhash_reorg(const uint64_t split_height);
 
 }
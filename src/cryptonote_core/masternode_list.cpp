@@ -51,6 +51,7 @@ extern "C" {
 #include "common/random.h"
 #include "common/lock.h"
 #include "common/hex.h"
+#include "common/trace.h"
 #include "epee/misc_os_dependent.h"
 #include "blockchain.h"
 #include "masternode_quorum_cop.h"
@@ -1589,6 +1590,7 @@ namespace masternodes
     if (block.major_version < cryptonote::network_version_9_masternodes)
       return true;
 
+    TRACE_SPAN(masternode_list_block_added);
     std::lock_guard lock(m_sn_mutex);
     process_block(block, txs);
     bool result = verify_block(block, false /*alt_block*/, checkpoint);
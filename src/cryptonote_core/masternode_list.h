@@ -120,12 +120,12 @@ namespace masternodes
       write_index++;
     }
 
-    bool check_participation(uint16_t threshold)
+    bool check_participation(uint16_t threshold) const
     {
       if (this->write_index >= Count)
       {
         int failed_counter = 0;
-        for (ValueType &entry : array)
+        for (const ValueType &entry : array)
           if (!entry.pass()) failed_counter++;
 
         if (failed_counter > threshold)
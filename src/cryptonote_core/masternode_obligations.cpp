@@ -0,0 +1,221 @@
+#include "masternode_obligations.h"
+#include "masternode_quorum_cop.h"
+#include "masternode_voting.h"
+#include "uptime_proof.h"
+#include "cryptonote_config.h"
+#include "cryptonote_core.h"
+#include "common/util.h"
+#include "common/threadpool.h"
+#include <sstream>
+
+#include "common/quenero_integration_test_hooks.h"
+
+#undef QUENERO_DEFAULT_LOG_CATEGORY
+#define QUENERO_DEFAULT_LOG_CATEGORY "quorum_cop"
+
+// Like LOG_PRINT_L1/LOG_PRINT_L2, but holds the line in `log` (an obligations_log) until it is
+// flushed rather than writing it out immediately.
+#define OBLIGATIONS_LOG(log, level, x) do { \
+    if (ELPP->vRegistry()->allowed(level, LOKI_DEFAULT_LOG_CATEGORY)) { \
+      std::ostringstream obligations_log_line_; \
+      obligations_log_line_ << x; \
+      (log).lines.emplace_back(level, obligations_log_line_.str()); \
+    } \
+  } while (0)
+#define OBLIGATIONS_LOG_L1(log, x) OBLIGATIONS_LOG(log, el::Level::Info, x)
+#define OBLIGATIONS_LOG_L2(log, x) OBLIGATIONS_LOG(log, el::Level::Debug, x)
+
+namespace masternodes
+{
+  void obligations_log::flush()
+  {
+    for (const auto &line : lines)
+      MLOG(line.first, line.second);
+    lines.clear();
+  }
+
+  obligations_snapshot snapshot_obligations(cryptonote::core &core, uint8_t hf_version, const crypto::public_key &pubkey, const masternode_info &info)
+  {
+    const auto& netconf = core.get_net_config();
+
+    obligations_snapshot snapshot;
+    uint64_t timestamp = 0;
+    decltype(std::declval<proof_info>().public_ips) ips{};
+
+    constexpr std::array<uint16_t, 3> MIN_TIMESTAMP_VERSION{9,1,0};
+
+    core.get_masternode_list().access_proof(pubkey, [&](const proof_info &proof) {
+      snapshot.ss_reachable             = !proof.ss_unreachable_for(netconf.UPTIME_PROOF_VALIDITY - netconf.UPTIME_PROOF_FREQUENCY);
+      timestamp                         = std::max(proof.proof->timestamp, proof.effective_timestamp);
+      ips                               = proof.public_ips;
+      snapshot.checkpoint_participation = proof.checkpoint_participation;
+      snapshot.pulse_participation      = proof.pulse_participation;
+
+      // TODO: remove after HF18
+      if (proof.proof->version >= MIN_TIMESTAMP_VERSION && hf_version >= cryptonote::network_version_18) {
+        snapshot.timestamp_participation    = proof.timestamp_participation;
+        snapshot.timesync_status            = proof.timesync_status;
+        snapshot.check_timestamp_obligation = true;
+      }
+
+    });
+    snapshot.time_since_last_uptime_proof = std::chrono::seconds{std::time(nullptr) - timestamp};
+
+    // IP change checks
+    if (ips[0].first && ips[1].first) {
+      // Figure out when we last had a blockchain-level IP change penalty (or when we registered);
+      // we only consider IP changes starting two hours after the last IP penalty.
+      std::vector<cryptonote::block> blocks;
+      if (core.get_blocks(info.last_ip_change_height, 1, blocks)) {
+        uint64_t find_ips_used_since = std::max(
+            uint64_t(std::time(nullptr)) - std::chrono::seconds{IP_CHANGE_WINDOW}.count(),
+            uint64_t(blocks[0].timestamp) + std::chrono::seconds{IP_CHANGE_BUFFER}.count());
+        if (ips[0].second > find_ips_used_since && ips[1].second > find_ips_used_since)
+          snapshot.multiple_ips = true;
+      }
+    }
+
+    return snapshot;
+  }
+
+  masternode_test_results check_obligations(const cryptonote::network_config &netconf, uint8_t hf_version, const crypto::public_key &pubkey, const masternode_info &info, const obligations_snapshot &snapshot, obligations_log &log)
+  {
+    masternode_test_results result; // Defaults to true for individual tests
+
+    bool check_uptime_obligation     = true;
+    bool check_checkpoint_obligation = true;
+
+#if defined(QUENERO_ENABLE_INTEGRATION_TEST_HOOKS)
+    if (integration_test::state.disable_obligation_uptime_proof) check_uptime_obligation = false;
+    if (integration_test::state.disable_obligation_checkpointing) check_checkpoint_obligation = false;
+#endif
+
+    if (check_uptime_obligation && snapshot.time_since_last_uptime_proof > netconf.UPTIME_PROOF_VALIDITY)
+    {
+      OBLIGATIONS_LOG_L1(log,
+          "Masternode: " << pubkey << ", failed uptime proof obligation check: the last uptime proof (" <<
+          tools::get_human_readable_timespan(snapshot.time_since_last_uptime_proof) << ") was older than max validity (" <<
+          tools::get_human_readable_timespan(netconf.UPTIME_PROOF_VALIDITY) << ")");
+      result.uptime_proved = false;
+    }
+
+    if (!snapshot.ss_reachable)
+    {
+      OBLIGATIONS_LOG_L1(log, "Masternode storage server is not reachable for node: " << pubkey);
+      if (hf_version >= cryptonote::network_version_13_enforce_checkpoints)
+          result.storage_server_reachable = false;
+    }
+
+    if (snapshot.multiple_ips)
+      result.single_ip = false;
+
+    if (!info.is_decommissioned())
+    {
+      if (check_checkpoint_obligation)
+      {
+        if (!snapshot.checkpoint_participation.check_participation(CHECKPOINT_MAX_MISSABLE_VOTES) )
+        {
+          OBLIGATIONS_LOG_L1(log, "Masternode: " << pubkey << ", failed checkpoint obligation check");
+          if (hf_version >= cryptonote::network_version_13_enforce_checkpoints)
+            result.checkpoint_participation = false;
+        }
+      }
+
+      if (!snapshot.pulse_participation.check_participation(PULSE_MAX_MISSABLE_VOTES) )
+      {
+        OBLIGATIONS_LOG_L1(log, "Masternode: " << pubkey << ", failed pulse obligation check");
+        result.pulse_participation = false;
+      }
+
+      if (snapshot.check_timestamp_obligation){
+        if (!snapshot.timestamp_participation.check_participation(TIMESTAMP_MAX_MISSABLE_VOTES) )
+        {
+          OBLIGATIONS_LOG_L1(log, "Masternode: " << pubkey << ", failed timestamp obligation check");
+          result.timestamp_participation = false;
+        }
+        if (!snapshot.timesync_status.check_participation(TIMESYNC_MAX_UNSYNCED_VOTES) )
+        {
+          OBLIGATIONS_LOG_L1(log, "Masternode: " << pubkey << ", failed timesync obligation check");
+          result.timesync_status = false;
+        }
+      }
+    }
+
+    return result;
+  }
+
+  void vote_on_obligations(obligations_worker &worker, const cryptonote::network_config &netconf, uint8_t hf_version,
+      uint64_t obligations_height, uint64_t latest_height, uint16_t index_in_group, const masternode_keys &keys)
+  {
+    const auto &node_key = worker.pubkey;
+    const auto &info = *worker.info;
+
+    auto test_results = check_obligations(netconf, hf_version, node_key, info, worker.snapshot, worker.log);
+    bool passed       = test_results.passed();
+
+    new_state vote_for_state;
+    uint16_t reason = 0;
+    if (passed) {
+      if (info.is_decommissioned()) {
+        vote_for_state = new_state::recommission;
+        OBLIGATIONS_LOG_L2(worker.log, "Decommissioned masternode " << node_key << " is now passing required checks; voting to recommission");
+      } else if (!test_results.single_ip) {
+          // Don't worry about this if the SN is getting recommissioned (above) -- it'll
+          // already reenter at the bottom.
+          vote_for_state = new_state::ip_change_penalty;
+          OBLIGATIONS_LOG_L2(worker.log, "Masternode " << node_key << " was observed with multiple IPs recently; voting to reset reward position");
+      } else {
+          worker.good = true;
+          return;
+      }
+
+    }
+    else {
+      if (!test_results.uptime_proved) reason |= cryptonote::Decommission_Reason::missed_uptime_proof;
+      if (!test_results.checkpoint_participation) reason |= cryptonote::Decommission_Reason::missed_checkpoints;
+      if (!test_results.pulse_participation) reason |= cryptonote::Decommission_Reason::missed_pulse_participations;
+      if (!test_results.storage_server_reachable) reason |= cryptonote::Decommission_Reason::storage_server_unreachable;
+      if (!test_results.timestamp_participation) reason |= cryptonote::Decommission_Reason::timestamp_response_unreachable;
+      if (!test_results.timesync_status) reason |= cryptonote::Decommission_Reason::timesync_status_out_of_sync;
+      int64_t credit = quorum_cop::calculate_decommission_credit(info, latest_height);
+
+      if (info.is_decommissioned()) {
+        if (credit >= 0) {
+          OBLIGATIONS_LOG_L2(worker.log, "Decommissioned masternode "
+                       << node_key
+                       << " is still not passing required checks, but has remaining credit (" << credit
+                       << " blocks); abstaining (to leave decommissioned)");
+          return;
+        }
+
+        OBLIGATIONS_LOG_L2(worker.log, "Decommissioned masternode " << node_key << " has no remaining credit; voting to deregister");
+        vote_for_state = new_state::deregister; // Credit ran out!
+      } else {
+        if (credit >= DECOMMISSION_MINIMUM) {
+          vote_for_state = new_state::decommission;
+          OBLIGATIONS_LOG_L2(worker.log, "Masternode "
+                       << node_key
+                       << " has stopped passing required checks, but has sufficient earned credit (" << credit << " blocks) to avoid deregistration; voting to decommission");
+        } else {
+          vote_for_state = new_state::deregister;
+          OBLIGATIONS_LOG_L2(worker.log, "Masternode "
+                       << node_key
+                       << " has stopped passing required checks, but does not have sufficient earned credit ("
+                       << credit << " blocks, " << DECOMMISSION_MINIMUM
+                       << " required) to decommission; voting to deregister");
+        }
+      }
+    }
+
+    worker.vote = make_state_change_vote(obligations_height, index_in_group, worker.node_index, vote_for_state, reason, keys);
+  }
+
+  void vote_on_obligations(std::vector<obligations_worker> &workers, const cryptonote::network_config &netconf, uint8_t hf_version,
+      uint64_t obligations_height, uint64_t latest_height, uint16_t index_in_group, const masternode_keys &keys)
+  {
+    // Each task only touches its own worker (including its log), so no locking is needed
+    tools::threadpool::getInstance().parallel_for(size_t{0}, workers.size(), [&](size_t i) {
+      vote_on_obligations(workers[i], netconf, hf_version, obligations_height, latest_height, index_in_group, keys);
+    });
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "epee/misc_log_ex.h"
+#include "cryptonote_core/masternode_list.h"
+
+namespace cryptonote
+{
+  class core;
+  struct network_config;
+};
+
+namespace masternodes
+{
+  // Everything a masternode's obligation tests depend on.  It is gathered up front, on the thread
+  // processing the block (which may need the blockchain lock), so that the tests themselves don't
+  // take any locks and can run on the threadpool.
+  struct obligations_snapshot
+  {
+    bool ss_reachable = true;
+    std::chrono::seconds time_since_last_uptime_proof{0};
+    bool multiple_ips = false; // Seen on more than one IP since its last IP change penalty
+    bool check_timestamp_obligation = false;
+
+    participation_history<participation_entry> checkpoint_participation{};
+    participation_history<participation_entry> pulse_participation{};
+    participation_history<timestamp_participation_entry> timestamp_participation{};
+    participation_history<timesync_entry> timesync_status{};
+  };
+
+  // Log lines from testing a masternode, held back so that the lines of workers tested in parallel
+  // can be written out in worker order rather than in whatever order the threads ran.
+  struct obligations_log
+  {
+    std::vector<std::pair<el::Level, std::string>> lines;
+
+    // Writes out and clears the held lines.  Call this from one thread at a time.
+    void flush();
+  };
+
+  obligations_snapshot snapshot_obligations(cryptonote::core &core, uint8_t hf_version, const crypto::public_key &pubkey, const masternode_info &info);
+
+  // Runs the obligation tests against a snapshot; returns the same results as
+  // quorum_cop::check_masternode for the state the snapshot was taken from.
+  masternode_test_results check_obligations(const cryptonote::network_config &netconf, uint8_t hf_version, const crypto::public_key &pubkey, const masternode_info &info, const obligations_snapshot &snapshot, obligations_log &log);
+
+  // An obligations quorum worker that we are voting on, and the outcome of testing it
+  struct obligations_worker
+  {
+    size_t node_index;                 // Index in the quorum's workers
+    crypto::public_key pubkey;
+    const masternode_info *info;
+    obligations_snapshot snapshot;
+
+    bool good = false;                 // Passing its tests; no state change needed
+    std::optional<quorum_vote_t> vote; // Signed state change vote, if we are voting for one
+    obligations_log log;
+  };
+
+  // Tests a worker and signs the state change vote, if any, that its results call for
+  void vote_on_obligations(obligations_worker &worker, const cryptonote::network_config &netconf, uint8_t hf_version,
+      uint64_t obligations_height, uint64_t latest_height, uint16_t index_in_group, const masternode_keys &keys);
+
+  // The same for each of `workers`, tested in parallel on the threadpool.  The results (including
+  // each worker's log) are the same as testing the workers one at a time.
+  void vote_on_obligations(std::vector<obligations_worker> &workers, const cryptonote::network_config &netconf, uint8_t hf_version,
+      uint64_t obligations_height, uint64_t latest_height, uint16_t index_in_group, const masternode_keys &keys);
+}
@@ -27,6 +27,7 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "masternode_quorum_cop.h"
+#include "masternode_obligations.h"
 #include "masternode_voting.h"
 #include "masternode_list.h"
 #include "uptime_proof.h"
@@ -35,6 +36,7 @@
 #include "version.h"
 #include "common/quenero.h"
 #include "common/util.h"
+#include "common/trace.h"
 #include "epee/net/local_ip.h"
 #include <boost/endian/conversion.hpp>
 
@@ -84,109 +86,9 @@ namespace masternodes
   // has submitted uptime proofs, participated in required quorums, etc.
   masternode_test_results quorum_cop::check_masternode(uint8_t hf_version, const crypto::public_key &pubkey, const masternode_info &info) const
   {
-    const auto& netconf = m_core.get_net_config();
-
-    masternode_test_results result; // Defaults to true for individual tests
-    bool ss_reachable = true;
-    uint64_t timestamp = 0;
-    decltype(std::declval<proof_info>().public_ips) ips{};
-
-    masternodes::participation_history<masternodes::participation_entry> checkpoint_participation{};
-    masternodes::participation_history<masternodes::participation_entry> pulse_participation{};
-    masternodes::participation_history<masternodes::timestamp_participation_entry> timestamp_participation{};
-    masternodes::participation_history<masternodes::timesync_entry> timesync_status{};
-
-    constexpr std::array<uint16_t, 3> MIN_TIMESTAMP_VERSION{9,1,0};
-    bool check_timestamp_obligation = false;
-
-    m_core.get_masternode_list().access_proof(pubkey, [&](const proof_info &proof) {
-      ss_reachable             = !proof.ss_unreachable_for(netconf.UPTIME_PROOF_VALIDITY - netconf.UPTIME_PROOF_FREQUENCY);
-      timestamp                = std::max(proof.proof->timestamp, proof.effective_timestamp);
-      ips                      = proof.public_ips;
-      checkpoint_participation = proof.checkpoint_participation;
-      pulse_participation      = proof.pulse_participation;
-
-      // TODO: remove after HF18
-      if (proof.proof->version >= MIN_TIMESTAMP_VERSION && hf_version >= cryptonote::network_version_18) {
-        timestamp_participation  = proof.timestamp_participation;
-        timesync_status          = proof.timesync_status;
-        check_timestamp_obligation = true;
-      }
-
-    });
-    std::chrono::seconds time_since_last_uptime_proof{std::time(nullptr) - timestamp};
-
-    bool check_uptime_obligation     = true;
-    bool check_checkpoint_obligation = true;
-
-#if defined(QUENERO_ENABLE_INTEGRATION_TEST_HOOKS)
-    if (integration_test::state.disable_obligation_uptime_proof) check_uptime_obligation = false;
-    if (integration_test::state.disable_obligation_checkpointing) check_checkpoint_obligation = false;
-#endif
-
-    if (check_uptime_obligation && time_since_last_uptime_proof > netconf.UPTIME_PROOF_VALIDITY)
-    {
-      LOG_PRINT_L1(
-          "Masternode: " << pubkey << ", failed uptime proof obligation check: the last uptime proof (" <<
-          tools::get_human_readable_timespan(time_since_last_uptime_proof) << ") was older than max validity (" <<
-          tools::get_human_readable_timespan(netconf.UPTIME_PROOF_VALIDITY) << ")");
-      result.uptime_proved = false;
-    }
-
-    if (!ss_reachable)
-    {
-      LOG_PRINT_L1("Masternode storage server is not reachable for node: " << pubkey);
-      if (hf_version >= cryptonote::network_version_13_enforce_checkpoints)
-          result.storage_server_reachable = false;
-    }
-
-    // IP change checks
-    if (ips[0].first && ips[1].first) {
-      // Figure out when we last had a blockchain-level IP change penalty (or when we registered);
-      // we only consider IP changes starting two hours after the last IP penalty.
-      std::vector<cryptonote::block> blocks;
-      if (m_core.get_blocks(info.last_ip_change_height, 1, blocks)) {
-        uint64_t find_ips_used_since = std::max(
-            uint64_t(std::time(nullptr)) - std::chrono::seconds{IP_CHANGE_WINDOW}.count(),
-            uint64_t(blocks[0].timestamp) + std::chrono::seconds{IP_CHANGE_BUFFER}.count());
-        if (ips[0].second > find_ips_used_since && ips[1].second > find_ips_used_since)
-          result.single_ip = false;
-      }
-    }
-
-    if (!info.is_decommissioned())
-    {
-      if (check_checkpoint_obligation)
-      {
-        if (!checkpoint_participation.check_participation(CHECKPOINT_MAX_MISSABLE_VOTES) )
-        {
-          LOG_PRINT_L1("Masternode: " << pubkey << ", failed checkpoint obligation check");
-          if (hf_version >= cryptonote::network_version_13_enforce_checkpoints)
-            result.checkpoint_participation = false;
-        }
-      }
-
-      if (!pulse_participation.check_participation(PULSE_MAX_MISSABLE_VOTES) )
-      {
-        LOG_PRINT_L1("Masternode: " << pubkey << ", failed pulse obligation check");
-        result.pulse_participation = false;
-      }
-
-      if (check_timestamp_obligation){
-        if (!timestamp_participation.check_participation(TIMESTAMP_MAX_MISSABLE_VOTES) )
-        {
-          LOG_PRINT_L1("Masternode: " << pubkey << ", failed timestamp obligation check");
-          result.timestamp_participation = false;
-        }
-        if (!timesync_status.check_participation(TIMESYNC_MAX_UNSYNCED_VOTES) )
-        {
-          LOG_PRINT_L1("Masternode: " << pubkey << ", failed timesync obligation check");
-          result.timesync_status = false;
-        }
-      }
-    }
-
-
+    obligations_log log;
+    auto result = check_obligations(m_core.get_net_config(), hf_version, pubkey, info, snapshot_obligations(m_core, hf_version, pubkey, info), log);
+    log.flush();
     return result;
   }
 
@@ -244,6 +146,7 @@ namespace masternodes
     if (hf_version < cryptonote::network_version_9_masternodes)
       return;
 
+    TRACE_SPAN(process_quorums);
     const auto& netconf = m_core.get_net_config();
 
     uint64_t const REORG_SAFETY_BUFFER_BLOCKS = (hf_version >= cryptonote::network_version_12_checkpointing)
@@ -348,7 +251,13 @@ namespace masternodes
               auto worker_states = m_core.get_masternode_list_state(quorum->workers);
               auto worker_it = worker_states.begin();
               std::unique_lock lock{m_lock};
-              int good = 0, total = 0;
+
+              // Snapshot the test inputs of every worker we can vote on here, then run the tests
+              // and sign the resulting votes in parallel, then submit the votes (and write out
+              // the tests' logs) in worker order.
+              std::vector<obligations_worker> tested;
+              tested.reserve(worker_states.size());
+              int total = 0;
               for (size_t node_index = 0; node_index < quorum->workers.size(); ++worker_it, ++node_index)
               {
                 // If the SN no longer exists then it'll be omitted from the worker_states vector,
@@ -359,73 +268,25 @@ namespace masternodes
                   break;
                 total++;
 
-                const auto &node_key = worker_it->pubkey;
                 const auto &info = *worker_it->info;
-
                 if (!info.can_be_voted_on(m_obligations_height))
                   continue;
 
-                auto test_results = check_masternode(obligations_height_hf_version, node_key, info);
-                bool passed       = test_results.passed();
-
-                new_state vote_for_state;
-                uint16_t reason = 0;
-                if (passed) {
-                  if (info.is_decommissioned()) {
-                    vote_for_state = new_state::recommission;
-                    LOG_PRINT_L2("Decommissioned masternode " << quorum->workers[node_index] << " is now passing required checks; voting to recommission");
-                  } else if (!test_results.single_ip) {
-                      // Don't worry about this if the SN is getting recommissioned (above) -- it'll
-                      // already reenter at the bottom.
-                      vote_for_state = new_state::ip_change_penalty;
-                      LOG_PRINT_L2("Masternode " << quorum->workers[node_index] << " was observed with multiple IPs recently; voting to reset reward position");
-                  } else {
-                      good++;
-                      continue;
-                  }
+                tested.push_back({node_index, worker_it->pubkey, &info, snapshot_obligations(m_core, obligations_height_hf_version, worker_it->pubkey, info)});
+              }
 
-                }
-                else {
-                  if (!test_results.uptime_proved) reason |= cryptonote::Decommission_Reason::missed_uptime_proof;
-                  if (!test_results.checkpoint_participation) reason |= cryptonote::Decommission_Reason::missed_checkpoints;
-                  if (!test_results.pulse_participation) reason |= cryptonote::Decommission_Reason::missed_pulse_participations;
-                  if (!test_results.storage_server_reachable) reason |= cryptonote::Decommission_Reason::storage_server_unreachable;
-                  if (!test_results.timestamp_participation) reason |= cryptonote::Decommission_Reason::timestamp_response_unreachable;
-                  if (!test_results.timesync_status) reason |= cryptonote::Decommission_Reason::timesync_status_out_of_sync;
-                  int64_t credit = calculate_decommission_credit(info, latest_height);
-
-                  if (info.is_decommissioned()) {
-                    if (credit >= 0) {
-                      LOG_PRINT_L2("Decommissioned masternode "
-                                   << quorum->workers[node_index]
-                                   << " is still not passing required checks, but has remaining credit (" << credit
-                                   << " blocks); abstaining (to leave decommissioned)");
-                      continue;
-                    }
+              vote_on_obligations(tested, netconf, obligations_height_hf_version, m_obligations_height, latest_height, static_cast<uint16_t>(index_in_group), my_keys);
 
-                    LOG_PRINT_L2("Decommissioned masternode " << quorum->workers[node_index] << " has no remaining credit; voting to deregister");
-                    vote_for_state = new_state::deregister; // Credit ran out!
-                  } else {
-                    if (credit >= DECOMMISSION_MINIMUM) {
-                      vote_for_state = new_state::decommission;
-                      LOG_PRINT_L2("Masternode "
-                                   << quorum->workers[node_index]
-                                   << " has stopped passing required checks, but has sufficient earned credit (" << credit << " blocks) to avoid deregistration; voting to decommission");
-                    } else {
-                      vote_for_state = new_state::deregister;
-                      LOG_PRINT_L2("Masternode "
-                                   << quorum->workers[node_index]
-                                   << " has stopped passing required checks, but does not have sufficient earned credit ("
-                                   << credit << " blocks, " << DECOMMISSION_MINIMUM
-                                   << " required) to decommission; voting to deregister");
-                    }
-                  }
-                }
-
-                quorum_vote_t vote = masternodes::make_state_change_vote(m_obligations_height, static_cast<uint16_t>(index_in_group), node_index, vote_for_state, reason, my_keys);
+              int good = 0;
+              for (auto &worker : tested)
+              {
+                worker.log.flush();
+                good += worker.good;
+                if (!worker.vote)
+                  continue;
                 cryptonote::vote_verification_context vvc;
-                if (!handle_vote(vote, vvc))
-                  LOG_ERROR("Failed to add state change vote; reason: " << print_vote_verification_context(vvc, &vote));
+                if (!handle_vote(*worker.vote, vvc))
+                  LOG_ERROR("Failed to add state change vote; reason: " << print_vote_verification_context(vvc, &*worker.vote));
               }
               if (good > 0)
                 LOG_PRINT_L2(good << " of " << total << " masternodes are active and passing checks; no state change votes required");
@@ -1,6 +1,9 @@
 #include "masternode_swarm.h"
 #include "common/random.h"
 
+#include <optional>
+#include <set>
+
 #undef QUENERO_DEFAULT_LOG_CATEGORY
 #define QUENERO_DEFAULT_LOG_CATEGORY "masternodes"
 
@@ -60,8 +63,9 @@ namespace masternodes
     return all_ids[best_idx] + diff;
   }
 
+#ifdef UNIT_TEST
   /// The excess is calculated as the total number of snodes above MIN_SWARM_SIZE across all swarms
-  prod_static size_t calc_excess(const swarm_snode_map_t &swarm_to_snodes)
+  size_t calc_excess(const swarm_snode_map_t &swarm_to_snodes)
   {
     const size_t excess = std::accumulate(swarm_to_snodes.begin(),
                                           swarm_to_snodes.end(),
@@ -73,6 +77,7 @@ namespace masternodes
     LOG_PRINT_L2("Calculated excess: " << excess);
     return excess;
   };
+#endif
 
   /// Calculate threshold above which the excess should create a new swarm.
   /// The threshold should be such that
@@ -85,20 +90,21 @@ namespace masternodes
     return threshold;
   };
 
-  prod_static const excess_pool_snode& pick_from_excess_pool(const std::vector<excess_pool_snode>& excess_pool, std::mt19937_64 &mt)
+#ifdef UNIT_TEST
+  const excess_pool_snode& pick_from_excess_pool(const std::vector<excess_pool_snode>& excess_pool, std::mt19937_64 &mt)
   {
     /// Select random snode
     const auto idx = tools::uniform_distribution_portable(mt, excess_pool.size());
     return excess_pool.at(idx);
   }
 
-  prod_static void remove_excess_snode_from_swarm(const excess_pool_snode& excess_snode, swarm_snode_map_t &swarm_to_snodes)
+  void remove_excess_snode_from_swarm(const excess_pool_snode& excess_snode, swarm_snode_map_t &swarm_to_snodes)
   {
     auto &swarm_sn_vec = swarm_to_snodes.at(excess_snode.swarm_id);
     swarm_sn_vec.erase(std::remove(swarm_sn_vec.begin(), swarm_sn_vec.end(), excess_snode.public_key), swarm_sn_vec.end());
   }
 
-  prod_static void get_excess_pool(size_t threshold, const swarm_snode_map_t& swarm_to_snodes, std::vector<excess_pool_snode>& pool_snodes, size_t& excess)
+  void get_excess_pool(size_t threshold, const swarm_snode_map_t& swarm_to_snodes, std::vector<excess_pool_snode>& pool_snodes, size_t& excess)
   {
     /// Create a pool of all the masternodes belonging
     /// to the swarms that have excess. That way we naturally
@@ -122,49 +128,7 @@ namespace masternodes
       }
     }
   }
-
-  prod_static void create_new_swarm_from_excess(swarm_snode_map_t &swarm_to_snodes, std::mt19937_64 &mt)
-  {
-    const bool has_starving_swarms = std::any_of(swarm_to_snodes.begin(),
-                                                swarm_to_snodes.end(),
-                                                [](const swarm_snode_map_t::value_type& pair) {
-                                                  return pair.second.size() < MIN_SWARM_SIZE;
-                                                });
-    if (has_starving_swarms)
-      return;
-
-    std::vector<excess_pool_snode> pool_snodes;
-
-    while (calc_excess(swarm_to_snodes) >= calc_threshold(swarm_to_snodes))
-    {
-      LOG_PRINT_L2("New swarm creation");
-      std::vector<crypto::public_key> new_swarm_snodes;
-      new_swarm_snodes.reserve(NEW_SWARM_SIZE);
-      while (new_swarm_snodes.size() < NEW_SWARM_SIZE)
-      {
-        size_t excess;
-        get_excess_pool(EXCESS_BASE, swarm_to_snodes, pool_snodes, excess);
-        if (pool_snodes.size() == 0)
-        {
-          MERROR("Error while getting excess pool for new swarm creation");
-          return;
-        }
-        const auto& random_excess_snode = pick_from_excess_pool(pool_snodes, mt);
-        new_swarm_snodes.push_back(random_excess_snode.public_key);
-        remove_excess_snode_from_swarm(random_excess_snode, swarm_to_snodes);
-      }
-      const auto new_swarm_id = get_new_swarm_id(swarm_to_snodes);
-      if (auto [it, ins] = swarm_to_snodes.emplace(new_swarm_id, std::move(new_swarm_snodes));
-              !ins) {
-          MFATAL("New swarm ID gave a swarm id (" << new_swarm_id << ") that already exists -- this is a bug!");
-          // If we actually abort() here then hitting this would potentially kill the whole network
-          // if we hit this bug, so just warn very loudly and move on; if it happens we'll have to
-          // track down the bug and fix it separately.
-      } else {
-          LOG_PRINT_L2("Created new swarm from excess: " << new_swarm_id);
-      }
-    }
-  }
+#endif
 
   prod_static void calc_swarm_sizes(const swarm_snode_map_t &swarm_to_snodes, std::vector<swarm_size> &sorted_swarm_sizes)
   {
@@ -174,6 +138,9 @@ namespace masternodes
     {
       sorted_swarm_sizes.push_back({entry.first, entry.second.size()});
     }
+    /// N.B. this is not a stable sort, and the order it leaves equal-sized swarms in decides which
+    /// swarm new snodes are assigned to, so it must not be replaced by anything that could order
+    /// them differently.
     std::sort(sorted_swarm_sizes.begin(),
               sorted_swarm_sizes.end(),
               [](const swarm_size &a, const swarm_size &b) {
@@ -181,34 +148,209 @@ namespace masternodes
               });
   }
 
-  /// Assign each snode from snode_pubkeys into the FILL_SWARM_LOWER_PERCENTILE percentile of swarms
-  /// and run the excess/threshold logic after each assignment to ensure new swarms are generated when required.
-  prod_static void assign_snodes(const std::vector<crypto::public_key> &snode_pubkeys, swarm_snode_map_t &swarm_to_snodes, std::mt19937_64 &mt, size_t percentile)
+  namespace
   {
-    std::vector<swarm_size> sorted_swarm_sizes;
-    for (const auto &sn_pk : snode_pubkeys)
+    /// Wraps the swarm map being rebalanced and keeps the aggregates the rebalancing rounds query
+    /// after every snode move (the total excess, a histogram of swarm sizes and the starving swarms)
+    /// up to date as snodes move, instead of rescanning every swarm (or every snode) for each move.
+    /// All changes to the swarms made by calc_swarm_changes go through this class.
+    class swarm_index
     {
-      calc_swarm_sizes(swarm_to_snodes, sorted_swarm_sizes);
-      const size_t percentile_index = percentile * (sorted_swarm_sizes.size() - 1) / 100;
-      const size_t percentile_value = sorted_swarm_sizes.at(percentile_index).size;
-      /// Find last occurence of percentile_value
-      size_t upper_index = sorted_swarm_sizes.size() - 1;
-      for (size_t i = percentile_index; i < sorted_swarm_sizes.size(); ++i)
+    public:
+      explicit swarm_index(swarm_snode_map_t &swarms) : swarms{swarms}
       {
-        if (sorted_swarm_sizes[i].size > percentile_value)
+        for (const auto &[id, snodes] : swarms)
+          add_stats(id, snodes.size());
+      }
+
+      const swarm_snode_map_t& map() const { return swarms; }
+
+      /// Same as calc_excess(map())
+      size_t excess() const { return total_excess; }
+
+      /// The starving swarm (i.e. below MIN_SWARM_SIZE) with the lowest id, if any
+      std::optional<swarm_id_t> first_starving() const
+      {
+        if (starving.empty())
+          return std::nullopt;
+        return *starving.begin();
+      }
+
+      /// Returns the size of, and the excess in, the excess pool that get_excess_pool(threshold)
+      /// would build (i.e. from the swarms larger than `threshold`); `threshold` must be at least
+      /// MIN_SWARM_SIZE.
+      std::pair<size_t, size_t> excess_pool_stats(size_t threshold) const
+      {
+        size_t pool_size = 0, excess = 0;
+        for (size_t size = threshold + 1; size < size_count.size(); size++)
         {
-          /// Would never happen for i == 0
-          upper_index = i - 1;
-          break;
+          pool_size += size * size_count[size];
+          excess += (size - MIN_SWARM_SIZE) * size_count[size];
+        }
+        return {pool_size, excess};
+      }
+
+      /// Picks a random snode from the excess pool for `threshold` and removes it from its swarm.
+      /// Draws and picks exactly as pick_from_excess_pool() on the pool from get_excess_pool()
+      /// would, without building the pool.  Returns std::nullopt (without drawing) if the pool is
+      /// empty.
+      std::optional<crypto::public_key> take_from_excess_pool(size_t threshold, std::mt19937_64 &mt)
+      {
+        const size_t pool_size = excess_pool_stats(threshold).first;
+        if (pool_size == 0)
+          return std::nullopt;
+
+        size_t idx = tools::uniform_distribution_portable(mt, pool_size);
+        for (auto &[id, snodes] : swarms)
+        {
+          if (snodes.size() <= threshold)
+            continue;
+          if (idx < snodes.size())
+          {
+            const auto size = snodes.size();
+            crypto::public_key snode = snodes[idx];
+            snodes.erase(snodes.begin() + idx);
+            update_stats(id, size, snodes.size());
+            return snode;
+          }
+          idx -= snodes.size();
+        }
+        assert(false); // Unreachable: the sizes add up to pool_size
+        return std::nullopt;
+      }
+
+      void add_snode(swarm_id_t id, const crypto::public_key &snode)
+      {
+        auto &snodes = swarms.at(id);
+        snodes.push_back(snode);
+        update_stats(id, snodes.size() - 1, snodes.size());
+      }
+
+      /// Adds a new swarm; returns false (and leaves the swarms untouched) if the id is already used
+      bool add_swarm(swarm_id_t id, std::vector<crypto::public_key> snodes)
+      {
+        auto [it, inserted] = swarms.emplace(id, std::move(snodes));
+        if (inserted)
+          add_stats(id, it->second.size());
+        return inserted;
+      }
+
+      /// Removes a swarm, returning its snodes
+      std::vector<crypto::public_key> remove_swarm(swarm_id_t id)
+      {
+        auto it = swarms.find(id);
+        std::vector<crypto::public_key> snodes = std::move(it->second);
+        swarms.erase(it);
+        remove_stats(id, snodes.size());
+        return snodes;
+      }
+
+    private:
+      void add_stats(swarm_id_t id, size_t size)
+      {
+        total_excess += size > EXCESS_BASE ? size - EXCESS_BASE : 0;
+        if (size >= size_count.size())
+          size_count.resize(size + 1);
+        size_count[size]++;
+        if (size < MIN_SWARM_SIZE)
+          starving.insert(id);
+      }
+
+      void remove_stats(swarm_id_t id, size_t size)
+      {
+        total_excess -= size > EXCESS_BASE ? size - EXCESS_BASE : 0;
+        size_count[size]--;
+        if (size < MIN_SWARM_SIZE)
+          starving.erase(id);
+      }
+
+      void update_stats(swarm_id_t id, size_t old_size, size_t new_size)
+      {
+        remove_stats(id, old_size);
+        add_stats(id, new_size);
+      }
+
+      swarm_snode_map_t &swarms;
+      size_t total_excess = 0;
+      std::vector<size_t> size_count; // Number of swarms of each size
+      std::set<swarm_id_t> starving;
+    };
+
+    void create_new_swarm_from_excess(swarm_index &swarms, std::mt19937_64 &mt)
+    {
+      if (swarms.first_starving())
+        return;
+
+      while (swarms.excess() >= calc_threshold(swarms.map()))
+      {
+        LOG_PRINT_L2("New swarm creation");
+        std::vector<crypto::public_key> new_swarm_snodes;
+        new_swarm_snodes.reserve(NEW_SWARM_SIZE);
+        while (new_swarm_snodes.size() < NEW_SWARM_SIZE)
+        {
+          auto snode = swarms.take_from_excess_pool(EXCESS_BASE, mt);
+          if (!snode)
+          {
+            MERROR("Error while getting excess pool for new swarm creation");
+            return;
+          }
+          new_swarm_snodes.push_back(*snode);
+        }
+        const auto new_swarm_id = get_new_swarm_id(swarms.map());
+        if (!swarms.add_swarm(new_swarm_id, std::move(new_swarm_snodes))) {
+            MFATAL("New swarm ID gave a swarm id (" << new_swarm_id << ") that already exists -- this is a bug!");
+            // If we actually abort() here then hitting this would potentially kill the whole network
+            // if we hit this bug, so just warn very loudly and move on; if it happens we'll have to
+            // track down the bug and fix it separately.
+        } else {
+            LOG_PRINT_L2("Created new swarm from excess: " << new_swarm_id);
         }
       }
-      const size_t random_idx = tools::uniform_distribution_portable(mt, upper_index + 1);
-      const swarm_id_t swarm_id = sorted_swarm_sizes[random_idx].swarm_id;
-      swarm_to_snodes.at(swarm_id).push_back(sn_pk);
-      /// run the excess/threshold round after each additional snode
-      create_new_swarm_from_excess(swarm_to_snodes, mt);
     }
+
+    /// Assign each snode from snode_pubkeys into the FILL_SWARM_LOWER_PERCENTILE percentile of swarms
+    /// and run the excess/threshold logic after each assignment to ensure new swarms are generated when required.
+    void assign_snodes(const std::vector<crypto::public_key> &snode_pubkeys, swarm_index &swarms, std::mt19937_64 &mt, size_t percentile)
+    {
+      std::vector<swarm_size> sorted_swarm_sizes;
+      for (const auto &sn_pk : snode_pubkeys)
+      {
+        calc_swarm_sizes(swarms.map(), sorted_swarm_sizes);
+        const size_t percentile_index = percentile * (sorted_swarm_sizes.size() - 1) / 100;
+        const size_t percentile_value = sorted_swarm_sizes.at(percentile_index).size;
+        /// Find last occurence of percentile_value
+        size_t upper_index = sorted_swarm_sizes.size() - 1;
+        for (size_t i = percentile_index; i < sorted_swarm_sizes.size(); ++i)
+        {
+          if (sorted_swarm_sizes[i].size > percentile_value)
+          {
+            /// Would never happen for i == 0
+            upper_index = i - 1;
+            break;
+          }
+        }
+        const size_t random_idx = tools::uniform_distribution_portable(mt, upper_index + 1);
+        const swarm_id_t swarm_id = sorted_swarm_sizes[random_idx].swarm_id;
+        swarms.add_snode(swarm_id, sn_pk);
+        /// run the excess/threshold round after each additional snode
+        create_new_swarm_from_excess(swarms, mt);
+      }
+    }
+  }
+
+#ifdef UNIT_TEST
+  void create_new_swarm_from_excess(swarm_snode_map_t &swarm_to_snodes, std::mt19937_64 &mt)
+  {
+    swarm_index swarms{swarm_to_snodes};
+    create_new_swarm_from_excess(swarms, mt);
+  }
+
+  void assign_snodes(const std::vector<crypto::public_key> &snode_pubkeys, swarm_snode_map_t &swarm_to_snodes, std::mt19937_64 &mt, size_t percentile)
+  {
+    swarm_index swarms{swarm_to_snodes};
+    assign_snodes(snode_pubkeys, swarms, mt, percentile);
   }
+#endif
 
   void calc_swarm_changes(swarm_snode_map_t &swarm_to_snodes, uint64_t seed)
   {
@@ -224,7 +366,7 @@ namespace masternodes
     std::vector<crypto::public_key> unassigned_snodes;
     const auto it = swarm_to_snodes.find(UNASSIGNED_SWARM_ID);
     if (it != swarm_to_snodes.end()) {
-      unassigned_snodes = it->second;
+      unassigned_snodes = std::move(it->second);
       swarm_to_snodes.erase(it);
     }
 
@@ -238,8 +380,10 @@ namespace masternodes
       LOG_PRINT_L2("Created initial swarm " << new_swarm_id);
     }
 
+    swarm_index swarms{swarm_to_snodes};
+
     /// 1. Assign new registered snodes
-    assign_snodes(unassigned_snodes, swarm_to_snodes, mersenne_twister, FILL_SWARM_LOWER_PERCENTILE);
+    assign_snodes(unassigned_snodes, swarms, mersenne_twister, FILL_SWARM_LOWER_PERCENTILE);
     LOG_PRINT_L2("After assignment:");
     for (const auto &entry : swarm_to_snodes)
     {
@@ -247,6 +391,7 @@ namespace masternodes
     }
 
     /// 2. *Robin Hood Round* steal snodes from wealthy swarms and give them to the poor
+    if (swarms.first_starving())
     {
       std::vector<swarm_size> sorted_swarm_sizes;
       calc_swarm_sizes(swarm_to_snodes, sorted_swarm_sizes);
@@ -257,26 +402,23 @@ namespace masternodes
         if (swarm.size >= MIN_SWARM_SIZE)
           break;
 
-        auto& poor_swarm_snodes = swarm_to_snodes.at(swarm.swarm_id);
+        const auto& poor_swarm_snodes = swarm_to_snodes.at(swarm.swarm_id);
         do
         {
           const size_t percentile_index = STEALING_SWARM_UPPER_PERCENTILE * (sorted_swarm_sizes.size() - 1) / 100;
           /// -1 since we will only consider swarm sizes strictly above percentile_value
           size_t percentile_value = sorted_swarm_sizes.at(percentile_index).size - 1;
           percentile_value = std::max(MIN_SWARM_SIZE, percentile_value);
-          size_t excess;
-          std::vector<excess_pool_snode> excess_pool;
-          get_excess_pool(percentile_value, swarm_to_snodes, excess_pool, excess);
+          const size_t excess = swarms.excess_pool_stats(percentile_value).second;
           /// If we can't save the swarm, don't bother continuing
           const size_t deficit = MIN_SWARM_SIZE - poor_swarm_snodes.size();
           insufficient_excess = (excess < deficit);
           if (insufficient_excess)
             break;
-          const auto& excess_snode = pick_from_excess_pool(excess_pool, mersenne_twister);
-          remove_excess_snode_from_swarm(excess_snode, swarm_to_snodes);
+          const auto excess_snode = swarms.take_from_excess_pool(percentile_value, mersenne_twister);
           /// Add public key to poor swarm
-          poor_swarm_snodes.push_back(excess_snode.public_key);
-          LOG_PRINT_L2("Stolen 1 snode from " << excess_snode.public_key << " and donated to " << swarm.swarm_id);
+          swarms.add_snode(swarm.swarm_id, *excess_snode);
+          LOG_PRINT_L2("Stolen 1 snode from " << *excess_snode << " and donated to " << swarm.swarm_id);
         } while (poor_swarm_snodes.size() < MIN_SWARM_SIZE);
 
         /// If there is not enough excess for the current swarm,
@@ -287,29 +429,18 @@ namespace masternodes
     }
 
     /// 3. New swarm creation
-    create_new_swarm_from_excess(swarm_to_snodes, mersenne_twister);
+    create_new_swarm_from_excess(swarms, mersenne_twister);
 
     /// 4. If there is a swarm with less than MIN_SWARM_SIZE, decommission that swarm.
     if (swarm_to_snodes.size() > 1)
     {
-      while (true)
+      while (auto starving_id = swarms.first_starving())
       {
-        auto it = std::find_if(swarm_to_snodes.begin(),
-                              swarm_to_snodes.end(),
-                              [](const swarm_snode_map_t::value_type& pair) {
-                                return pair.second.size() < MIN_SWARM_SIZE;
-                              });
-        if (it == swarm_to_snodes.end())
-          break;
-
-        MWARNING("swarm " << it->first << " is DECOMMISSIONED");
-        /// Good ol' switcheroo
-        std::vector<crypto::public_key> decommissioned_snodes;
-        std::swap(decommissioned_snodes, it->second);
+        MWARNING("swarm " << *starving_id << " is DECOMMISSIONED");
         /// Remove swarm from map
-        swarm_to_snodes.erase(it);
+        auto decommissioned_snodes = swarms.remove_swarm(*starving_id);
         /// Assign snodes to the 0 percentile, i.e. the smallest swarms
-        assign_snodes(decommissioned_snodes, swarm_to_snodes, mersenne_twister, DECOMMISSIONED_REDISTRIBUTION_LOWER_PERCENTILE);
+        assign_snodes(decommissioned_snodes, swarms, mersenne_twister, DECOMMISSIONED_REDISTRIBUTION_LOWER_PERCENTILE);
       }
     }
 
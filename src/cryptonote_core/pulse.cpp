@@ -6,6 +6,7 @@
 #include "epee/memwipe.h"
 #include "epee/misc_log_ex.h"
 #include "common/random.h"
+#include "common/trace.h"
 
 #include "cryptonote_core.h"
 #include "cryptonote_basic/hardfork.h"
@@ -1705,6 +1706,7 @@ void pulse::main(void *quorumnet_state, cryptonote::core &core)
        last_state != context.state || last_state == round_state::null_state;)
   {
     last_state = context.state;
+    tools::trace::span trace_state{round_state_string(context.state), QUENERO_DEFAULT_LOG_CATEGORY};
 
     switch (context.state)
     {
@@ -0,0 +1,71 @@
+#include "verified_signature_cache.h"
+#include <string>
+
+namespace cryptonote {
+
+  crypto::hash verified_signature_cache::ring_digest(const rct::ctkeyM& mix_ring)
+  {
+    std::string buf;
+    for (const auto& ring : mix_ring)
+      for (const auto& member : ring)
+      {
+        buf.append(reinterpret_cast<const char*>(member.dest.bytes), sizeof(member.dest.bytes));
+        buf.append(reinterpret_cast<const char*>(member.mask.bytes), sizeof(member.mask.bytes));
+      }
+    return crypto::cn_fast_hash(buf.data(), buf.size());
+  }
+
+  void verified_signature_cache::add(const crypto::hash& txid, const crypto::hash& ring)
+  {
+    std::lock_guard lock{m_mutex};
+    if (auto it = m_index.find(txid); it != m_index.end())
+    {
+      it->second->second = ring;
+      m_lru.splice(m_lru.begin(), m_lru, it->second);
+      return;
+    }
+    if (m_capacity == 0)
+      return;
+    while (m_index.size() >= m_capacity)
+    {
+      m_index.erase(m_lru.back().first);
+      m_lru.pop_back();
+    }
+    m_lru.emplace_front(txid, ring);
+    m_index.emplace(txid, m_lru.begin());
+  }
+
+  bool verified_signature_cache::contains(const crypto::hash& txid, const crypto::hash& ring)
+  {
+    std::lock_guard lock{m_mutex};
+    auto it = m_index.find(txid);
+    if (it == m_index.end() || it->second->second != ring)
+      return false;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return true;
+  }
+
+  void verified_signature_cache::remove(const crypto::hash& txid)
+  {
+    std::lock_guard lock{m_mutex};
+    if (auto it = m_index.find(txid); it != m_index.end())
+    {
+      m_lru.erase(it->second);
+      m_index.erase(it);
+    }
+  }
+
+  void verified_signature_cache::clear()
+  {
+    std::lock_guard lock{m_mutex};
+    m_lru.clear();
+    m_index.clear();
+  }
+
+  size_t verified_signature_cache::size() const
+  {
+    std::lock_guard lock{m_mutex};
+    return m_index.size();
+  }
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include "crypto/hash.h"
+#include "ringct/rctTypes.h"
+
+namespace cryptonote {
+
+  /// Bounded, thread-safe record of transactions whose ringct signatures have been verified,
+  /// together with a digest of the ring (the expanded mixRing) each was verified against.  A
+  /// transaction's hash commits to its prunable data (and hence its signatures), so a hit on both
+  /// the tx hash and the ring digest means re-verifying would give the same result.
+  ///
+  /// When full the least recently used entry is dropped.
+  class verified_signature_cache {
+  public:
+    static constexpr size_t DEFAULT_CAPACITY = 16384;
+
+    explicit verified_signature_cache(size_t capacity = DEFAULT_CAPACITY) : m_capacity{capacity} {}
+
+    /// Returns the digest of a (Simple or Full layout) mixRing, as stored in the cache.
+    static crypto::hash ring_digest(const rct::ctkeyM& mix_ring);
+
+    /// Records that `txid`'s signatures verified against the ring with digest `ring`, replacing
+    /// any previous entry for `txid`.
+    void add(const crypto::hash& txid, const crypto::hash& ring);
+
+    /// Returns true (and marks the entry as recently used) if `txid` was recorded with the same
+    /// ring digest.
+    bool contains(const crypto::hash& txid, const crypto::hash& ring);
+
+    void remove(const crypto::hash& txid);
+
+    void clear();
+
+    size_t size() const;
+
+  private:
+    using entry = std::pair<crypto::hash, crypto::hash>; // txid, ring digest
+
+    mutable std::mutex m_mutex;
+    size_t m_capacity;
+    std::list<entry> m_lru; // Most recently used at the front
+    std::unordered_map<crypto::hash, std::list<entry>::iterator> m_index;
+  };
+
+}
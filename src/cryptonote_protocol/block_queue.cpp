@@ -55,9 +55,19 @@ struct hash<boost::uuids::uuid>
 namespace cryptonote
 {
 
-void block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size)
+bool block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size)
 {
   std::unique_lock lock{mutex};
+  for (const auto &span: blocks)
+  {
+    if (span.start_block_height == height && !span.blocks.empty())
+    {
+      MDEBUG("Span " << height << " from " << connection_id << " already received from " << span.connection_id << ", dropping " << size << " bytes");
+      wasted_bytes += size;
+      ++duplicate_spans;
+      return false;
+    }
+  }
   std::vector<crypto::hash> hashes;
   bool has_hashes = remove_span(height, &hashes);
   blocks.emplace(height, std::move(bcel), connection_id, rate, size);
@@ -70,6 +80,7 @@ void block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_comp
     }
     set_span_hashes(height, connection_id, hashes);
   }
+  return true;
 }
 
 void block_queue::add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, std::chrono::steady_clock::time_point time)
@@ -90,6 +101,11 @@ void block_queue::flush_spans(const boost::uuids::uuid &connection_id, bool all)
     {
       erase_block(j);
     }
+    else if (j->speculative_connection_id == connection_id)
+    {
+      const_cast<boost::uuids::uuid&>(j->speculative_connection_id) // doesn't influence sorting
+        = boost::uuids::nil_uuid();
+    }
   }
 }
 
@@ -115,6 +131,11 @@ void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_con
     {
       erase_block(j);
     }
+    else if (!j->speculative_connection_id.is_nil() && live_connections.find(j->speculative_connection_id) == live_connections.end())
+    {
+      const_cast<boost::uuids::uuid&>(j->speculative_connection_id) // doesn't influence sorting
+        = boost::uuids::nil_uuid();
+    }
   }
 }
 
@@ -335,6 +356,50 @@ void block_queue::reset_next_span_time()
       = std::chrono::steady_clock::now();
 }
 
+bool block_queue::set_speculative_fetch(uint64_t start_height, const boost::uuids::uuid &connection_id)
+{
+  std::unique_lock lock{mutex};
+  for (const auto &span: blocks)
+  {
+    if (span.start_block_height != start_height)
+      continue;
+    if (!span.blocks.empty() || span.connection_id == connection_id || !span.speculative_connection_id.is_nil())
+      return false;
+    MDEBUG("Speculatively fetching span " << start_height << " from " << connection_id << " as well as " << span.connection_id);
+    const_cast<boost::uuids::uuid&>(span.speculative_connection_id) // doesn't influence sorting
+      = connection_id;
+    return true;
+  }
+  return false;
+}
+
+bool block_queue::has_speculative_fetch(uint64_t height) const
+{
+  std::unique_lock lock{mutex};
+  for (const auto &span: blocks)
+    if (span.start_block_height <= height && height < span.start_block_height + span.nblocks)
+      return !span.speculative_connection_id.is_nil();
+  return false;
+}
+
+void block_queue::add_wasted(size_t size)
+{
+  std::unique_lock lock{mutex};
+  wasted_bytes += size;
+  ++duplicate_spans;
+}
+
+uint64_t block_queue::get_wasted_bytes() const
+{
+  std::unique_lock lock{mutex};
+  return wasted_bytes;
+}
+
+uint64_t block_queue::get_num_duplicate_spans() const
+{
+  std::unique_lock lock{mutex};
+  return duplicate_spans;
+}
 
 void block_queue::set_span_hashes(uint64_t start_height, const boost::uuids::uuid &connection_id, std::vector<crypto::hash> hashes)
 {
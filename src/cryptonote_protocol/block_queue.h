@@ -59,6 +59,8 @@ namespace cryptonote
       float rate;
       size_t size;
       std::chrono::steady_clock::time_point time;
+      // Second connection racing the owner for this (scheduled) span, or nil if none
+      boost::uuids::uuid speculative_connection_id{};
 
       span(uint64_t start_block_height, std::vector<cryptonote::block_complete_entry> blocks, const boost::uuids::uuid &connection_id, float rate, size_t size):
         start_block_height(start_block_height), blocks(std::move(blocks)), connection_id(connection_id), nblocks(this->blocks.size()), rate(rate), size(size),
@@ -71,7 +73,10 @@ namespace cryptonote
     typedef std::set<span> block_map;
 
   public:
-    void add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size);
+    // Adds a downloaded span.  If the span was also fetched from another peer and that copy has
+    // already been added, the first arrival wins: the new copy is dropped, counted as wasted, and
+    // false is returned.
+    bool add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size);
     void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, std::chrono::steady_clock::time_point time);
     void flush_spans(const boost::uuids::uuid &connection_id, bool all = false);
     void flush_stale_spans(const std::set<boost::uuids::uuid> &live_connections);
@@ -85,6 +90,11 @@ namespace cryptonote
     uint64_t get_next_needed_height(uint64_t blockchain_height) const;
     std::pair<uint64_t, uint64_t> get_next_span_if_scheduled(std::vector<crypto::hash> &hashes, boost::uuids::uuid &connection_id) const;
     void reset_next_span_time();
+    bool set_speculative_fetch(uint64_t start_height, const boost::uuids::uuid &connection_id);
+    bool has_speculative_fetch(uint64_t height) const;
+    void add_wasted(size_t size);
+    uint64_t get_wasted_bytes() const;
+    uint64_t get_num_duplicate_spans() const;
     void set_span_hashes(uint64_t start_height, const boost::uuids::uuid &connection_id, std::vector<crypto::hash> hashes);
     bool get_next_span(uint64_t &height, std::vector<cryptonote::block_complete_entry> &bcel, boost::uuids::uuid &connection_id, bool filled = true) const;
     bool has_next_span(uint64_t height, bool &filled, std::chrono::steady_clock::time_point& time, boost::uuids::uuid &connection_id) const;
@@ -107,5 +117,7 @@ namespace cryptonote
     mutable std::recursive_mutex mutex;
     std::unordered_set<crypto::hash> requested_hashes;
     std::unordered_set<crypto::hash> have_blocks;
+    uint64_t wasted_bytes = 0;
+    uint64_t duplicate_spans = 0;
   };
 }
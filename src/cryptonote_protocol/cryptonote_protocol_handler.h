@@ -163,6 +163,7 @@ namespace cryptonote
     size_t get_synchronizing_connections_count();
     bool on_connection_synchronized();
     bool should_download_next_span(cryptonote_connection_context& context, bool standby);
+    bool should_speculatively_download_span(cryptonote_connection_context& context, uint64_t height, const boost::uuids::uuid& span_connection_id, std::chrono::steady_clock::duration waited);
     void drop_connection(cryptonote_connection_context &context, bool add_fail, bool flush_all_spans);
     bool kick_idle_peers();
     bool check_standby_peers();
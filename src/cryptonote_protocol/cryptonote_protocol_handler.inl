@@ -79,6 +79,9 @@ namespace cryptonote
   constexpr uint64_t BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS = 1000;
   constexpr auto REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD_STANDBY = 5s;
   constexpr auto REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD = 30s;
+  constexpr auto SPECULATIVE_SPAN_MIN_WAIT = 2s;
+  constexpr auto SPECULATIVE_SPAN_THRESHOLD = 3s;
+  constexpr uint64_t SPECULATIVE_SPAN_MIN_SAMPLES = 3;
   constexpr auto IDLE_PEER_KICK_TIME = 10min;
   constexpr auto PASSIVE_PEER_KICK_TIME = 1min;
   constexpr auto DROP_ON_SYNC_WEDGE_THRESHOLD = 30s;
@@ -1198,6 +1201,7 @@ namespace cryptonote
 
     auto request_time = *context.m_last_request_time;
     context.m_last_request_time.reset();
+    context.m_stats->get_blocks_rtt.add(std::chrono::steady_clock::now() - request_time);
 
     // calculate size of request
     size_t blocks_size = 0, others_size = 0;
@@ -1308,8 +1312,18 @@ namespace cryptonote
       // add that new span to the block queue
       seconds_f dt = now - request_time;
       const double rate = size / dt.count();
-      MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.count() << " seconds, " << (rate/1024) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
-      m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
+      // a span fetched from two peers can show up after the other copy was already added to the chain
+      if (start_height + arg.blocks.size() <= m_core.get_current_blockchain_height())
+      {
+        MDEBUG(context << " span at height " << start_height << " was already added from another peer, dropping " << blocks_size << " bytes");
+        m_block_queue.add_wasted(blocks_size);
+        ++m_sync_old_spans_downloaded;
+      }
+      else
+      {
+        MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.count() << " seconds, " << (rate/1024) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
+        m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
+      }
 
       const crypto::hash last_block_hash = cryptonote::get_block_hash(b);
       context.m_last_known_hash = last_block_hash;
@@ -1866,6 +1880,9 @@ skip:
           return true;
         }
 
+        if (should_speculatively_download_span(context, blockchain_height, connection_id, dt))
+          return true;
+
         // in standby, be ready to double download early since we're idling anyway
         // let the fastest peer trigger first
         long threshold;
@@ -1930,6 +1947,40 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::should_speculatively_download_span(cryptonote_connection_context& context, uint64_t height, const boost::uuids::uuid& span_connection_id, std::chrono::steady_clock::duration waited)
+  {
+    if (waited < SPECULATIVE_SPAN_MIN_WAIT || span_connection_id == context.m_connection_id)
+      return false;
+    if (m_block_queue.has_speculative_fetch(height))
+      return false;
+
+    // we need some history for both peers to predict anything
+    const auto our_rtt = context.m_stats->get_blocks_rtt.get();
+    if (our_rtt.count < SPECULATIVE_SPAN_MIN_SAMPLES)
+      return false;
+    tools::latency_histogram::snapshot their_rtt;
+    if (!m_p2p->for_connection(span_connection_id, [&](cryptonote_connection_context& ctx, nodetool::peerid_type peer_id, uint32_t f)->bool{
+      their_rtt = ctx.m_stats->get_blocks_rtt.get();
+      return true;
+    }))
+      return false;
+    if (their_rtt.count < SPECULATIVE_SPAN_MIN_SAMPLES)
+      return false;
+
+    // predict the span arrives at the owning peer's usual (90th percentile) round trip time; once
+    // it's later than that, assume it'll take about as long again as it has so far
+    const std::chrono::microseconds expected{their_rtt.quantile_us(0.9)};
+    const auto remaining = waited < expected ? expected - waited : waited;
+    const std::chrono::microseconds ours{our_rtt.quantile_us(0.5)};
+    if (remaining < SPECULATIVE_SPAN_THRESHOLD || ours >= remaining)
+      return false;
+
+    MDEBUG(context << " we should speculatively download the span at " << height << " too: predicted to arrive in "
+        << seconds_f{remaining}.count() << " seconds from " << span_connection_id << ", we usually take " << seconds_f{ours}.count());
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::should_drop_connection(cryptonote_connection_context& context, uint32_t next_stripe)
   {
     if (context.m_anchor)
@@ -2149,6 +2200,7 @@ skip:
               context.m_requested_objects.insert(hash);
             }
             m_block_queue.reset_next_span_time();
+            m_block_queue.set_speculative_fetch(span.first, context.m_connection_id);
           }
         }
       }
@@ -2374,7 +2426,9 @@ skip:
               (10 * m_sync_download_objects_size / 1024 / 1024) / 10.f << " + " <<
               (10 * m_sync_download_chain_size / 1024 / 1024) / 10.f << " MB downloaded, " <<
               100.0f * m_sync_old_spans_downloaded / m_sync_spans_downloaded << "% old spans, " <<
-              100.0f * m_sync_bad_spans_downloaded / m_sync_spans_downloaded << "% bad spans");
+              100.0f * m_sync_bad_spans_downloaded / m_sync_spans_downloaded << "% bad spans, " <<
+              m_block_queue.get_num_duplicate_spans() << " duplicate spans (" <<
+              (10 * m_block_queue.get_wasted_bytes() / 1024 / 1024) / 10.f << " MB wasted)");
         }
       }
       m_core.on_synchronized();
@@ -2403,6 +2457,8 @@ skip:
       << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height);
     MLOG_PEER_STATE("received chain");
 
+    if (context.m_last_request_time)
+      context.m_stats->chain_rtt.add(std::chrono::steady_clock::now() - *context.m_last_request_time);
     context.m_last_request_time.reset();
 
     m_sync_download_chain_size += arg.m_block_ids.size() * sizeof(crypto::hash);
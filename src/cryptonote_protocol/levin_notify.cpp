@@ -30,6 +30,7 @@
 
 #include <boost/asio/steady_timer.hpp>
 #include <boost/system/system_error.hpp>
+#include <algorithm>
 #include <chrono>
 #include <deque>
 #include <stdexcept>
@@ -132,6 +133,21 @@ namespace levin
       return fullBlob;
     }
 
+    //! \return Size of the `make_fragmented_notify` message for a payload of `payload_size` bytes.
+    std::size_t covert_notify_size(const std::size_t noise_size, const std::size_t payload_size)
+    {
+      constexpr std::size_t header_size = sizeof(epee::levin::bucket_head2);
+      if (noise_size < header_size * 2)
+        return 0;
+      if (payload_size <= noise_size - header_size)
+        return noise_size; // sent unfragmented, padded to the noise size
+
+      // The first fragment also carries the inner levin header; every fragment is noise-sized
+      const std::size_t payload_space = noise_size - header_size;
+      const std::size_t remaining = payload_size - (payload_space - header_size);
+      return noise_size * (1 + (remaining + payload_space - 1) / payload_space);
+    }
+
     /* The current design uses `asio::strand`s. The documentation isn't as clear
        as it should be - a `strand` has an internal `mutex` and `bool`. The
        `mutex` synchronizes thread access and the `bool` is set when a thread is
@@ -161,11 +177,16 @@ namespace levin
        optimized further, it might be better to just use standard locks per
        channel. */
 
-    //! A queue of levin messages for a noise i2p/tor link
+    //! Txs from one `send_txs` call; shared by all of a zone's noise channels.
+    using tx_batch = std::shared_ptr<const std::vector<blobdata>>;
+
+    //! A queue of txs for a noise i2p/tor link
     struct noise_channel
     {
       explicit noise_channel(boost::asio::io_service& io_service)
-        : queue(),
+        : active(),
+          active_batches(0),
+          queue(),
           strand(io_service),
           next_noise(io_service),
           connection(boost::uuids::nil_uuid())
@@ -178,7 +199,8 @@ namespace levin
       // Only read/write these values "inside the strand"
 
       epee::shared_sv active;
-      std::deque<epee::shared_sv> queue;
+      std::size_t active_batches; //!< Number of `queue` batches carried by `active`
+      std::deque<tx_batch> queue;
       boost::asio::io_service::strand strand;
       boost::asio::steady_timer next_noise;
       boost::uuids::uuid connection;
@@ -216,21 +238,16 @@ namespace levin
 
   namespace
   {
-    //! Adds a message to the sending queue of the channel.
+    //! Adds txs to the sending queue of the channel.
     class queue_covert_notify
     {
       std::shared_ptr<detail::zone> zone_;
-      epee::shared_sv message_; // Requires manual copy constructor
+      tx_batch txs_;
       const std::size_t destination_;
 
     public:
-      queue_covert_notify(std::shared_ptr<detail::zone> zone, epee::shared_sv message, std::size_t destination)
-        : zone_(std::move(zone)), message_(std::move(message)), destination_(destination)
-      {}
-
-      queue_covert_notify(queue_covert_notify&&) = default;
-      queue_covert_notify(const queue_covert_notify& source)
-        : zone_(source.zone_), message_(source.message_), destination_(source.destination_)
+      queue_covert_notify(std::shared_ptr<detail::zone> zone, tx_batch txs, std::size_t destination)
+        : zone_(std::move(zone)), txs_(std::move(txs)), destination_(destination)
       {}
 
       //! \pre Called within `zone_->channels[destionation_].strand`.
@@ -243,7 +260,7 @@ namespace levin
         assert(channel.strand.running_in_this_thread());
 
         if (!channel.connection.is_nil())
-          channel.queue.push_back(std::move(message_));
+          channel.queue.push_back(std::move(txs_));
         else if (destination_ == 0 && zone_->connection_count == 0)
           MWARNING("Unable to send transaction(s) over anonymity network - no available outbound connections");
       }
@@ -322,6 +339,7 @@ namespace levin
 
         channel.connection = connection_;
         channel.active = {};
+        channel.active_batches = 0;
 
         if (connection_.is_nil())
           channel.queue.clear();
@@ -391,6 +409,55 @@ namespace levin
       }
     };
 
+    /*! Builds one covert (fragmented) notification carrying the txs of as many
+        of the channel's queued batches as fit, so that txs arriving within
+        the same noise interval share a message and its padding instead of
+        each taking whole noise packets of their own. The noise cadence is
+        unchanged, so the link looks exactly as it did.
+
+        \pre `!channel.queue.empty()`
+        \return The message, or an empty one if the first batch cannot be
+          sent (in which case it has been dropped). */
+    epee::shared_sv make_covert_notify(const detail::zone& zone, noise_channel& channel)
+    {
+      const std::size_t max_size = CRYPTONOTE_MAX_FRAGMENTS * zone.noise.size();
+
+      std::size_t count = 0;
+      std::size_t bytes = 0;
+      for (const tx_batch& batch : channel.queue)
+      {
+        std::size_t batch_bytes = 0;
+        for (const blobdata& tx : *batch)
+          batch_bytes += tx.size();
+        if (count && max_size < bytes + batch_bytes)
+          break;
+        bytes += batch_bytes;
+        ++count;
+      }
+
+      for (; count; --count)
+      {
+        std::vector<blobdata> txs;
+        for (std::size_t i = 0; i < count; ++i)
+          txs.insert(txs.end(), channel.queue[i]->begin(), channel.queue[i]->end());
+        std::sort(txs.begin(), txs.end()); // don't leak receive order
+
+        // padding is not useful when using noise mode
+        const std::string payload = make_tx_payload(std::move(txs), false);
+        if (covert_notify_size(zone.noise.size(), payload.size()) <= max_size)
+        {
+          channel.active_batches = count;
+          return epee::shared_sv{epee::levin::make_fragmented_notify(
+            zone.noise.view, NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<std::uint8_t>(payload)
+          )};
+        }
+      }
+
+      MERROR("notify::send_txs provided message exceeding covert fragment size");
+      channel.queue.pop_front();
+      return {};
+    }
+
     //! Sends a noise packet or real notification and sets timer for next call.
     struct send_noise
     {
@@ -425,25 +492,27 @@ namespace levin
 
         if (!channel.connection.is_nil())
         {
+          if (channel.active.view.empty() && !channel.queue.empty())
+            channel.active = make_covert_notify(*zone_, channel);
+
           epee::shared_sv message;
           if (!channel.active.view.empty())
             message = channel.active.extract_prefix(zone_->noise.size());
-          else if (!channel.queue.empty())
-          {
-            channel.active = channel.queue.front();
-            message = channel.active.extract_prefix(zone_->noise.size());
-          }
           else
             message = zone_->noise;
 
           if (zone_->p2p->send(std::move(message), channel.connection))
           {
-            if (!channel.queue.empty() && channel.active.view.empty())
-              channel.queue.pop_front();
+            if (channel.active_batches && channel.active.view.empty())
+            {
+              channel.queue.erase(channel.queue.begin(), channel.queue.begin() + channel.active_batches);
+              channel.active_batches = 0;
+            }
           }
           else
           {
             channel.active = {};
+            channel.active_batches = 0;
             channel.connection = boost::uuids::nil_uuid();
 
             auto connections = get_out_connections(*zone_->p2p);
@@ -555,21 +624,20 @@ namespace levin
         CRYPTONOTE_MAX_FRAGMENTS * CRYPTONOTE_NOISE_BYTES <= LEVIN_DEFAULT_MAX_PACKET_SIZE, "most nodes will reject this fragment setting"
       );
 
-      // padding is not useful when using noise mode
-      const std::string payload = make_tx_payload(std::move(txs), false);
-      epee::shared_sv message{epee::levin::make_fragmented_notify(
-        zone_->noise.view, NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<std::uint8_t>(payload)
-      )};
-      if (CRYPTONOTE_MAX_FRAGMENTS * zone_->noise.size() < message.size())
+      // The message itself is built when a channel gets to send it, batched
+      // with whatever other txs are waiting by then (see make_covert_notify)
+      const std::string payload = make_tx_payload(std::vector<blobdata>{txs}, false);
+      if (CRYPTONOTE_MAX_FRAGMENTS * zone_->noise.size() < covert_notify_size(zone_->noise.size(), payload.size()))
       {
         MERROR("notify::send_txs provided message exceeding covert fragment size");
         return false;
       }
 
+      const auto batch = std::make_shared<const std::vector<blobdata>>(std::move(txs));
       for (std::size_t channel = 0; channel < zone_->channels.size(); ++channel)
       {
         zone_->channels[channel].strand.dispatch(
-          queue_covert_notify{zone_, message, channel}
+          queue_covert_notify{zone_, batch, channel}
         );
       }
     }
@@ -67,7 +67,7 @@ namespace daemon_args
   };
   const command_line::arg_descriptor<unsigned> arg_max_concurrency = {
     "max-concurrency"
-  , "Max number of threads to use for a parallel job"
+  , "Number of verification threads; the p2p, OxenMQ and HTTP RPC thread pools are scaled from it and run on top of these, so this is not a total thread count; 0 uses the number of CPU cores"
   , 0
   };
 
@@ -224,6 +224,27 @@ bool command_parser_executor::print_net_stats(const std::vector<std::string>& ar
   return m_executor.print_net_stats();
 }
 
+bool command_parser_executor::print_perf_stats(const std::vector<std::string>& args)
+{
+  if (args.size() > 1 || (args.size() == 1 && args[0] != "reset"))
+    return false;
+
+  return m_executor.print_perf_stats(!args.empty());
+}
+
+bool command_parser_executor::trace(const std::vector<std::string>& args)
+{
+  if (args.size() == 1 && args[0] == "start")
+    return m_executor.set_tracing(true);
+  if (args.size() == 1 && args[0] == "stop")
+    return m_executor.set_tracing(false);
+  if (args.size() == 2 && args[0] == "dump")
+    return m_executor.dump_trace(args[1]);
+
+  std::cout << "Invalid arguments; expected: trace start | stop | dump <file>" << std::endl;
+  return false;
+}
+
 bool command_parser_executor::print_blockchain_info(const std::vector<std::string>& args)
 {
   if(!args.size())
@@ -152,6 +152,10 @@ public:
 
   bool print_net_stats(const std::vector<std::string>& args);
 
+  bool print_perf_stats(const std::vector<std::string>& args);
+
+  bool trace(const std::vector<std::string>& args);
+
   bool print_masternode_state_changes(const std::vector<std::string> &args);
 
   bool set_bootstrap_daemon(const std::vector<std::string>& args);
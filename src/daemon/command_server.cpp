@@ -90,6 +90,18 @@ void command_server::init_commands(cryptonote::rpc::core_rpc_server* rpc_server)
     , [this](const auto &x) { return m_parser.print_net_stats(x); }
     , "Print network statistics."
     );
+  m_command_lookup.set_handler(
+      "print_perf_stats"
+    , [this](const auto &x) { return m_parser.print_perf_stats(x); }
+    , "print_perf_stats [reset]"
+    , "Print the timings of the internal hot-path timers (block addition, tx verification, database, ...) since startup or the last reset, and optionally reset them."
+    );
+  m_command_lookup.set_handler(
+      "trace"
+    , [this](const auto &x) { return m_parser.trace(x); }
+    , "trace start | stop | dump <file>"
+    , "Start recording a timeline of daemon internals (discarding any previous recording), stop recording, or write the recorded timeline to <file> as Chrome trace JSON (viewable in chrome://tracing or https://ui.perfetto.dev)."
+    );
   m_command_lookup.set_handler(
       "print_bc"
     , [this](const auto &x) { return m_parser.print_blockchain_info(x); }
@@ -126,6 +126,7 @@ daemon::daemon(boost::program_options::variables_map vm_) :
   core->set_cryptonote_protocol(protocol.get());
 
   auto rpc_config = cryptonote::rpc_args::process(vm);
+  rpc->admission().configure(rpc_config.admission);
   bool new_rpc_options = !is_arg_defaulted(vm, cryptonote::rpc::http_server::arg_rpc_admin)
     || !is_arg_defaulted(vm, cryptonote::rpc::http_server::arg_rpc_public);
   // TODO: Remove these options, perhaps starting in quenero 9.0
@@ -207,16 +208,19 @@ daemon::daemon(boost::program_options::variables_map vm_) :
     }
   }
 
+  auto rpc_http_threads = command_line::get_arg(vm, cryptonote::rpc::http_server::arg_rpc_http_threads);
+  auto rpc_metrics = command_line::get_arg(vm, cryptonote::rpc::http_server::arg_rpc_metrics);
+
   if (!rpc_listen_admin.empty())
   {
     MGINFO("- admin HTTP RPC server");
-    http_rpc_admin.emplace(*rpc, rpc_config, false /*not restricted*/, std::move(rpc_listen_admin));
+    http_rpc_admin.emplace(*rpc, rpc_config, false /*not restricted*/, std::move(rpc_listen_admin), rpc_http_threads, rpc_metrics);
   }
 
   if (!rpc_listen_public.empty())
   {
     MGINFO("- public HTTP RPC server");
-    http_rpc_public.emplace(*rpc, rpc_config, true /*restricted*/, std::move(rpc_listen_public));
+    http_rpc_public.emplace(*rpc, rpc_config, true /*restricted*/, std::move(rpc_listen_public), rpc_http_threads);
   }
 
   MGINFO_BLUE("Done daemon object initialization");
@@ -34,6 +34,7 @@
 #include "common/scoped_message_writer.h"
 #include "common/pruning.h"
 #include "common/hex.h"
+#include "common/file.h"
 #include "daemon/rpc_command_executor.h"
 #include "epee/int-util.h"
 #include "rpc/core_rpc_server_commands_defs.h"
@@ -611,6 +612,13 @@ bool rpc_command_executor::mining_status() {
   else
   {
     tools::msg_writer() << "Mining at " << get_mining_speed(mres.speed) << " with " << mres.threads_count << " threads";
+    if (mres.thread_speeds.size() > 1)
+    {
+      std::ostringstream str;
+      for (size_t i = 0; i < mres.thread_speeds.size(); i++)
+        str << (i ? ", " : "Per thread: ") << get_mining_speed(mres.thread_speeds[i]);
+      tools::msg_writer() << str.str();
+    }
   }
 
   tools::msg_writer() << "PoW algorithm: " << mres.pow_algorithm;
@@ -710,6 +718,57 @@ bool rpc_command_executor::print_net_stats()
   return true;
 }
 
+bool rpc_command_executor::print_perf_stats(bool reset)
+{
+  GET_PERF_STATS::response res{};
+  if (!invoke<GET_PERF_STATS>({reset}, res, "Unable to retrieve perf timer statistics"))
+    return false;
+
+  if (res.timers.empty())
+  {
+    tools::msg_writer() << "No perf timers have run (or they were compiled out)";
+    return true;
+  }
+
+  tools::msg_writer() << boost::format("%-50s %10s %12s %10s %10s %10s %10s")
+    % "Timer" % "Calls" % "Total (ms)" % "Mean (us)" % "p50 (us)" % "p99 (us)" % "Max (us)";
+  for (const auto& t : res.timers)
+    tools::msg_writer() << boost::format("%-50s %10u %12u %10u %10u %10u %10u")
+      % t.name % t.timing.count % (t.timing.total_us / 1000) % t.timing.mean_us
+      % t.timing.p50_us % t.timing.p99_us % t.timing.max_us;
+  if (reset)
+    tools::success_msg_writer() << "Perf timer statistics reset";
+
+  return true;
+}
+
+bool rpc_command_executor::set_tracing(bool enable)
+{
+  SET_TRACING::response res{};
+  if (!invoke<SET_TRACING>({enable, enable /*clear*/}, res, "Unable to change tracing state"))
+    return false;
+
+  tools::success_msg_writer() << (enable ? "Tracing started" : "Tracing stopped");
+  return true;
+}
+
+bool rpc_command_executor::dump_trace(const std::string& file)
+{
+  GET_TRACE::response res{};
+  if (!invoke<GET_TRACE>({false}, res, "Unable to retrieve trace"))
+    return false;
+
+  if (!tools::dump_file(fs::u8path(file), res.trace))
+  {
+    tools::fail_msg_writer() << "Failed to write trace to " << file;
+    return false;
+  }
+
+  tools::success_msg_writer() << "Wrote " << res.events << " trace events to " << file
+    << (res.enabled ? " (tracing is still running)" : "");
+  return true;
+}
+
 bool rpc_command_executor::print_blockchain_info(int64_t start_block_index, uint64_t end_block_index) {
   GET_BLOCK_HEADERS_RANGE::request req{};
   GET_BLOCK_HEADERS_RANGE::response res{};
@@ -197,6 +197,12 @@ public:
 
   bool print_net_stats();
 
+  bool print_perf_stats(bool reset);
+
+  bool set_tracing(bool enable);
+
+  bool dump_trace(const std::string& file);
+
   bool set_bootstrap_daemon(
     const std::string &address,
     const std::string &username,
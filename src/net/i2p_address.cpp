@@ -120,7 +120,8 @@ namespace net
         return i2p_address{host, porti};
     }
 
-    bool i2p_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    template <typename Storage>
+    bool i2p_address::load_serialized(Storage& src, typename Storage::section_type* hparent)
     {
         i2p_serialized in{};
         if (in._load(src, hparent) && in.host.size() < sizeof(host_) && (in.host == unknown_host || !host_check(in.host).has_error()))
@@ -136,6 +137,16 @@ namespace net
         return false;
     }
 
+    bool i2p_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    {
+        return load_serialized(src, hparent);
+    }
+
+    bool i2p_address::_load(epee::serialization::flat_storage& src, const epee::serialization::flat_entry* hparent)
+    {
+        return load_serialized(src, hparent);
+    }
+
     bool i2p_address::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
     {
         const i2p_serialized out{std::string{host_}, port_};
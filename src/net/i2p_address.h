@@ -42,6 +42,8 @@ namespace serialization
 {
     class portable_storage;
     struct section;
+    class flat_storage;
+    struct flat_entry;
 }
 }
 
@@ -56,6 +58,9 @@ namespace net
         //! Keep in private, `host.size()` has no runtime check
         i2p_address(std::string_view host, std::uint16_t port) noexcept;
 
+        template <typename Storage>
+        bool load_serialized(Storage& src, typename Storage::section_type* hparent);
+
     public:
         //! \return Size of internal buffer for host.
         static constexpr std::size_t buffer_size() noexcept { return sizeof(host_); }
@@ -78,6 +83,7 @@ namespace net
 
         //! Load from epee p2p format, and \return false if not valid tor address
         bool _load(epee::serialization::portable_storage& src, epee::serialization::section* hparent);
+        bool _load(epee::serialization::flat_storage& src, const epee::serialization::flat_entry* hparent);
 
         //! Store in epee p2p format
         bool store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const;
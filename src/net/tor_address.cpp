@@ -123,7 +123,8 @@ namespace net
         return tor_address{host, porti};
     }
 
-    bool tor_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    template <typename Storage>
+    bool tor_address::load_serialized(Storage& src, typename Storage::section_type* hparent)
     {
         tor_serialized in{};
         if (in._load(src, hparent) && in.host.size() < sizeof(host_) && (in.host == unknown_host || !host_check(in.host).has_error()))
@@ -139,6 +140,16 @@ namespace net
         return false;
     }
 
+    bool tor_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    {
+        return load_serialized(src, hparent);
+    }
+
+    bool tor_address::_load(epee::serialization::flat_storage& src, const epee::serialization::flat_entry* hparent)
+    {
+        return load_serialized(src, hparent);
+    }
+
     bool tor_address::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
     {
         const tor_serialized out{std::string{host_}, port_};
@@ -0,0 +1,91 @@
+#include "levin_recording.h"
+
+#include <stdexcept>
+#include <boost/endian/conversion.hpp>
+#include "common/util.h"
+
+namespace nodetool
+{
+  namespace
+  {
+    constexpr std::string_view RECORDING_MAGIC = "QNLEVREC";
+    constexpr uint32_t RECORDING_VERSION = 1;
+    constexpr uint8_t RECORD_FLAG_OUTGOING = 1;
+
+    template <typename T>
+    bool read_le(std::istream& in, T& val)
+    {
+      in.read(reinterpret_cast<char*>(&val), sizeof(val));
+      boost::endian::little_to_native_inplace(val);
+      return in.gcount() == sizeof(val);
+    }
+  }
+
+  levin_recorder::levin_recorder(const fs::path& file)
+    : m_out{file, std::ios::binary | std::ios::trunc}, m_start{std::chrono::steady_clock::now()}
+  {
+    if (!m_out)
+      throw std::runtime_error{"Failed to open levin recording file " + file.string()};
+    m_out.write(RECORDING_MAGIC.data(), RECORDING_MAGIC.size());
+    const auto version = tools::memcpy_le(RECORDING_VERSION);
+    m_out.write(version.data(), version.size());
+  }
+
+  void levin_recorder::record(const boost::uuids::uuid& connection_id, int command, bool outgoing, std::string_view payload)
+  {
+    const uint64_t time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+    if (outgoing)
+      payload = {};
+
+    std::lock_guard lock{m_lock};
+    const uint32_t connection = m_connections.emplace(connection_id, m_connections.size()).first->second;
+    const auto head = tools::memcpy_le(time, connection, outgoing ? RECORD_FLAG_OUTGOING : uint8_t{0},
+        static_cast<int32_t>(command), static_cast<uint32_t>(payload.size()));
+    m_out.write(head.data(), head.size());
+    m_out.write(payload.data(), payload.size());
+  }
+
+  void levin_recorder::flush()
+  {
+    std::lock_guard lock{m_lock};
+    m_out.flush();
+  }
+
+  levin_recording_reader::levin_recording_reader(const fs::path& file)
+    : m_in{file, std::ios::binary}
+  {
+    if (!m_in)
+      throw std::runtime_error{"Failed to open levin recording file " + file.string()};
+    std::string magic(RECORDING_MAGIC.size(), '\0');
+    m_in.read(magic.data(), magic.size());
+    uint32_t version;
+    if (magic != RECORDING_MAGIC || !read_le(m_in, version))
+      throw std::runtime_error{file.string() + " is not a levin recording"};
+    if (version != RECORDING_VERSION)
+      throw std::runtime_error{"Unsupported levin recording version " + std::to_string(version)};
+  }
+
+  bool levin_recording_reader::next(levin_record& rec)
+  {
+    uint64_t time;
+    if (!read_le(m_in, time))
+    {
+      if (m_in.gcount() == 0)
+        return false;
+      throw std::runtime_error{"Truncated levin recording"};
+    }
+    uint8_t flags;
+    int32_t command;
+    uint32_t size;
+    if (!read_le(m_in, rec.connection) || !read_le(m_in, flags) || !read_le(m_in, command) || !read_le(m_in, size))
+      throw std::runtime_error{"Truncated levin recording"};
+    rec.time = std::chrono::microseconds{time};
+    rec.outgoing = flags & RECORD_FLAG_OUTGOING;
+    rec.command = command;
+    rec.payload.resize(size);
+    m_in.read(rec.payload.data(), size);
+    if (static_cast<uint32_t>(m_in.gcount()) != size)
+      throw std::runtime_error{"Truncated levin recording"};
+    return true;
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include "common/fs.h"
+
+namespace nodetool
+{
+  /// One message of a levin recording
+  struct levin_record
+  {
+    std::chrono::microseconds time; // Since the start of the recording
+    uint32_t connection;            // Connection number, in order of first appearance
+    bool outgoing;
+    int command;
+    std::string payload;            // Always empty for outgoing messages: only their timing is kept
+  };
+
+  /// Records the levin traffic of a running node (`--p2p-record-sync`) so that a sync session can
+  /// be replayed later, without network access, by tests/sync_replay.  Incoming messages are
+  /// written with their full payload; outgoing messages only with their command and time, which
+  /// is enough to recover request/response timings.
+  ///
+  /// The file starts with the 8 byte magic "QNLEVREC" and a uint32_t format version, followed by
+  /// one entry per message: uint64_t time (µs), uint32_t connection, uint8_t flags (1 =
+  /// outgoing), int32_t command, uint32_t payload size and the payload itself.  All integers are
+  /// little-endian.
+  class levin_recorder
+  {
+  public:
+    /// Creates (or truncates) the recording file; throws std::runtime_error on failure.
+    explicit levin_recorder(const fs::path& file);
+
+    void record(const boost::uuids::uuid& connection_id, int command, bool outgoing, std::string_view payload = {});
+    void flush();
+
+  private:
+    std::mutex m_lock;
+    fs::ofstream m_out;
+    const std::chrono::steady_clock::time_point m_start;
+    std::unordered_map<boost::uuids::uuid, uint32_t, boost::hash<boost::uuids::uuid>> m_connections;
+  };
+
+  /// Reads back a file written by levin_recorder.
+  class levin_recording_reader
+  {
+  public:
+    /// Opens a recording; throws std::runtime_error if it can't be opened or isn't a recording.
+    explicit levin_recording_reader(const fs::path& file);
+
+    /// Reads the next record.  Returns false at the end of the file; throws std::runtime_error
+    /// if the file is truncated.
+    bool next(levin_record& rec);
+
+  private:
+    fs::ifstream m_in;
+  };
+}
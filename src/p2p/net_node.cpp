@@ -159,6 +159,8 @@ namespace nodetool
     const command_line::arg_descriptor<int64_t> arg_limit_rate_down = {"limit-rate-down", "set limit-rate-down [kB/s]", P2P_DEFAULT_LIMIT_RATE_DOWN};
     const command_line::arg_descriptor<int64_t> arg_limit_rate = {"limit-rate", "set limit-rate [kB/s]", -1};
 
+    const command_line::arg_descriptor<std::string> arg_p2p_record_sync = {"p2p-record-sync", "Record received p2p traffic and its timing to the given file, for replaying sync sessions with sync_replay", ""};
+
     std::optional<std::vector<proxy>> get_proxies(boost::program_options::variables_map const& vm)
     {
         namespace ip = boost::asio::ip;
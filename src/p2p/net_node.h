@@ -37,6 +37,9 @@
 #include <boost/program_options/variables_map.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
 #include <shared_mutex>
@@ -51,6 +54,7 @@
 #include "epee/storages/levin_abstract_invoke2.h"
 #include "net_peerlist.h"
 #include "net_node_common.h"
+#include "levin_recording.h"
 #include "epee/net/enums.h"
 #include "net/fwd.h"
 #include "common/command_line.h"
@@ -196,6 +200,10 @@ namespace nodetool
       std::atomic<unsigned int> m_current_number_of_out_peers;
       std::atomic<unsigned int> m_current_number_of_in_peers;
       bool m_can_pingback;
+      // Entries of remote peerlists that have been validated but not yet merged into m_peerlist,
+      // de-duplicated by address; see merge_pending_peerlists().
+      std::mutex m_pending_peers_lock;
+      std::map<epee::net_utils::network_address, peerlist_entry> m_pending_peers;
 
     private:
       void set_config_defaults() noexcept
@@ -285,6 +293,8 @@ namespace nodetool
     CHAIN_LEVIN_NOTIFY_MAP2(p2p_connection_context); //move levin_commands_handler interface notify(...) callbacks into nothing
 
     BEGIN_INVOKE_MAP2(node_server)
+      if (m_recorder)
+        m_recorder->record(context.m_connection_id, command, false, {reinterpret_cast<const char*>(in_buff.data()), in_buff.size()});
       if (is_filtered_command(context.m_remote_address, command))
         return LEVIN_ERROR_CONNECTION_HANDLER_NOT_DEFINED;
 
@@ -311,6 +321,7 @@ namespace nodetool
     //----------------- levin_commands_handler -------------------------------------------------------------
     virtual void on_connection_new(p2p_connection_context& context);
     virtual void on_connection_close(p2p_connection_context& context);
+    virtual void on_levin_message(int command, size_t bytes, bool outgoing, p2p_connection_context& context);
     virtual void callback(p2p_connection_context& context);
     //----------------- i_p2p_endpoint -------------------------------------------------------------
     virtual bool relay_notify_to_list(int command, const epee::span<const uint8_t> data_buff, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections);
@@ -330,7 +341,8 @@ namespace nodetool
         const boost::program_options::variables_map& vm
       );
     bool idle_worker();
-    bool handle_remote_peerlist(const std::vector<peerlist_entry>& peerlist, const epee::net_utils::connection_context_base& context);
+    bool handle_remote_peerlist(const std::vector<peerlist_entry>& peerlist, const epee::net_utils::connection_context_base& context, bool merge_now = false);
+    bool merge_pending_peerlists();
     bool get_local_node_data(basic_node_data& node_data, const network_zone& zone);
     //bool get_local_handshake_data(handshake_data& hshd);
 
@@ -441,6 +453,7 @@ namespace nodetool
     tools::periodic_task m_peerlist_store_interval{30min};
     tools::periodic_task m_gray_peerlist_housekeeping_interval{1min};
     tools::periodic_task m_incoming_connections_interval{1h};
+    tools::periodic_task m_peerlist_merge_interval{1s};
 
     std::list<epee::net_utils::network_address>   m_priority_peers;
     std::vector<epee::net_utils::network_address> m_exclusive_peers;
@@ -452,6 +465,9 @@ namespace nodetool
     uint64_t m_peer_livetime;
     //keep connections to initiate some interactions
 
+    // Records p2p traffic for sync replays, if enabled with --p2p-record-sync
+    std::unique_ptr<levin_recorder> m_recorder;
+
 
     static std::optional<p2p_connection_context> public_connect(network_zone&, epee::net_utils::network_address const&);
     static std::optional<p2p_connection_context> socks_connect(network_zone&, epee::net_utils::network_address const&);
@@ -511,6 +527,8 @@ namespace nodetool
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate_up;
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate_down;
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate;
+
+    extern const command_line::arg_descriptor<std::string> arg_p2p_record_sync;
 }
 
 POP_WARNINGS
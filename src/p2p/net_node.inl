@@ -47,6 +47,7 @@
 #include "common/file.h"
 #include "common/dns_utils.h"
 #include "common/pruning.h"
+#include "common/util.h"
 #include "net/error.h"
 #include "common/periodic_task.h"
 #include "epee/misc_log_ex.h"
@@ -55,6 +56,7 @@
 #include "crypto/crypto.h"
 #include "epee/storages/levin_abstract_invoke2.h"
 #include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "net/parse.h"
 
 #ifndef WITHOUT_MINIUPNPC
@@ -115,6 +117,7 @@ namespace nodetool
     command_line::add_arg(desc, arg_limit_rate_up);
     command_line::add_arg(desc, arg_limit_rate_down);
     command_line::add_arg(desc, arg_limit_rate);
+    command_line::add_arg(desc, arg_p2p_record_sync);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -470,6 +473,17 @@ namespace nodetool
     if ( !set_rate_limit(vm, command_line::get_arg(vm, arg_limit_rate) ) )
       return false;
 
+    if (const auto record_file = command_line::get_arg(vm, arg_p2p_record_sync); !record_file.empty())
+    {
+      try {
+        m_recorder = std::make_unique<levin_recorder>(fs::u8path(record_file));
+      } catch (const std::exception& e) {
+        MERROR(e.what());
+        return false;
+      }
+      MGINFO("Recording p2p traffic to " << record_file);
+    }
+
 
     epee::shared_sv noise;
     auto proxies = get_proxies(vm);
@@ -767,6 +781,13 @@ namespace nodetool
     {
       zone.second.m_net_server.get_config_object().set_handler(this);
       zone.second.m_net_server.get_config_object().m_invoke_timeout = P2P_DEFAULT_INVOKE_TIMEOUT;
+      // Connection upkeep and block/masternode propagation shouldn't sit behind a queue of bulk
+      // sync and tx relay data
+      zone.second.m_net_server.get_config_object().m_priority_commands = {
+        COMMAND_HANDSHAKE::ID, COMMAND_TIMED_SYNC::ID, COMMAND_PING::ID, COMMAND_REQUEST_SUPPORT_FLAGS::ID,
+        cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::ID, cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::ID,
+        cryptonote::NOTIFY_UPTIME_PROOF::ID, cryptonote::NOTIFY_BTENCODED_UPTIME_PROOF::ID,
+        cryptonote::NOTIFY_NEW_MASTERNODE_VOTE::ID};
 
       if (!zone.second.m_bind_ip.empty())
       {
@@ -856,8 +877,8 @@ namespace nodetool
     public_zone.m_net_server.add_idle_handler([this] { return idle_worker(); }, 1s);
     public_zone.m_net_server.add_idle_handler([this] { return m_payload_handler.on_idle(); }, 1s);
 
-    //here you can set worker threads count
-    int thrds_count = 10;
+    // Scaled from --max-concurrency; see tools::get_thread_budget
+    const unsigned thrds_count = tools::get_thread_budget().p2p;
     //go to loop
     MINFO("Run net_service loop( " << thrds_count << " threads)...");
     if(!public_zone.m_net_server.run_server(thrds_count, true))
@@ -891,6 +912,9 @@ namespace nodetool
       if(m_igd == igd)
         delete_upnp_port_mapping(m_listening_port);
     }
+    merge_pending_peerlists();
+    if (m_recorder)
+      m_recorder->flush();
     return store_config();
   }
   //-----------------------------------------------------------------------------------
@@ -975,7 +999,8 @@ namespace nodetool
         return;
       }
 
-      if(!handle_remote_peerlist(rsp.local_peerlist_new, context))
+      // A peerlist-only handshake is made because we need the peers right away, so merge it now
+      if(!handle_remote_peerlist(rsp.local_peerlist_new, context, just_take_peerlist))
       {
         LOG_WARNING_CC(context, "COMMAND_HANDSHAKE: failed to handle_remote_peerlist(...), closing connection.");
         add_host_fail(context.m_remote_address);
@@ -1762,6 +1787,7 @@ namespace nodetool
     m_gray_peerlist_housekeeping_interval.do_call([this] { return gray_peerlist_housekeeping(); });
     m_peerlist_store_interval.do_call([this] { return store_config(); });
     m_incoming_connections_interval.do_call([this] { return check_incoming_connections(); });
+    m_peerlist_merge_interval.do_call([this] { return merge_pending_peerlists(); });
     return true;
   }
   //-----------------------------------------------------------------------------------
@@ -1866,7 +1892,7 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::handle_remote_peerlist(const std::vector<peerlist_entry>& peerlist, const epee::net_utils::connection_context_base& context)
+  bool node_server<t_payload_net_handler>::handle_remote_peerlist(const std::vector<peerlist_entry>& peerlist, const epee::net_utils::connection_context_base& context, bool merge_now)
   {
     std::vector<peerlist_entry> peerlist_ = peerlist;
     if(!sanitize_peerlist(peerlist_))
@@ -1884,7 +1910,52 @@ namespace nodetool
 
     LOG_DEBUG_CC(context, "REMOTE PEERLIST: remote peerlist size=" << peerlist_.size());
     LOG_TRACE_CC(context, "REMOTE PEERLIST: \n" << print_peerlist_to_string(peerlist_));
-    return m_network_zones.at(context.m_remote_address.get_zone()).m_peerlist.merge_peerlist(peerlist_, [this](const peerlist_entry &pe) { return !is_addr_recently_failed(pe.adr); });
+    network_zone& net_zone = m_network_zones.at(zone);
+    if (merge_now)
+      return net_zone.m_peerlist.merge_peerlist(peerlist_, [this](const peerlist_entry &pe) { return !is_addr_recently_failed(pe.adr); });
+
+    // Otherwise leave the (locked, comparatively expensive) merge to merge_pending_peerlists(), so
+    // that the connection isn't held up and the overlapping lists that peers send get merged once
+    std::lock_guard lock{net_zone.m_pending_peers_lock};
+    for (auto& peer : peerlist_)
+    {
+      auto [it, inserted] = net_zone.m_pending_peers.try_emplace(peer.adr, peer);
+      if (inserted)
+      {
+        if (net_zone.m_pending_peers.size() > P2P_LOCAL_GRAY_PEERLIST_LIMIT)
+        {
+          net_zone.m_pending_peers.erase(it); // we would only trim them again when merging
+          break;
+        }
+        continue;
+      }
+      if (!it->second.pruning_seed)
+        it->second.pruning_seed = peer.pruning_seed;
+      if (!it->second.rpc_port)
+        it->second.rpc_port = peer.rpc_port;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::merge_pending_peerlists()
+  {
+    for (auto& [type, zone] : m_network_zones)
+    {
+      std::vector<peerlist_entry> peers;
+      {
+        std::lock_guard lock{zone.m_pending_peers_lock};
+        if (zone.m_pending_peers.empty())
+          continue;
+        peers.reserve(zone.m_pending_peers.size());
+        for (auto& [addr, peer] : zone.m_pending_peers)
+          peers.push_back(std::move(peer));
+        zone.m_pending_peers.clear();
+      }
+      MDEBUG("Merging " << peers.size() << " peers from remote peerlists into the " << epee::net_utils::zone_to_string(type) << " peerlist");
+      zone.m_peerlist.merge_peerlist(peers, [this](const peerlist_entry &pe) { return !is_addr_recently_failed(pe.adr); });
+    }
+    return true;
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -2377,6 +2448,14 @@ namespace nodetool
 
     MINFO("["<< epee::net_utils::print_connection_context(context) << "] CLOSE CONNECTION");
   }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::on_levin_message(int command, size_t bytes, bool outgoing, p2p_connection_context& context)
+  {
+    context.m_stats->record(command, bytes, outgoing);
+    if (outgoing && m_recorder)
+      m_recorder->record(context.m_connection_id, command, true);
+  }
 
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::is_priority_node(const epee::net_utils::network_address& na)
@@ -0,0 +1,191 @@
+#include "compression.h"
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include "common/string_util.h"
+
+#ifdef ENABLE_RPC_GZIP
+#include <zlib.h>
+#endif
+#ifdef ENABLE_RPC_ZSTD
+#include <zstd.h>
+#endif
+
+namespace cryptonote::rpc {
+
+  using namespace std::literals;
+
+  namespace {
+
+    // Size of each compressed output piece
+    constexpr size_t OUTPUT_PIECE_SIZE = 64 * 1024;
+
+    // We are compressing on an RPC worker thread, usually for a remote client, so favour speed:
+    // these get most of the size reduction for RPC data at a fraction of the higher levels' cost.
+    [[maybe_unused]] constexpr int GZIP_LEVEL = 4;
+    [[maybe_unused]] constexpr int ZSTD_LEVEL = 3;
+
+#ifdef ENABLE_RPC_GZIP
+    std::vector<std::string> compress_gzip(std::vector<std::string>&& body) {
+      z_stream zs{};
+      // windowBits of 15+16 tells zlib to write a gzip (rather than raw zlib) header and trailer
+      if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error{"Failed to initialize gzip compression"};
+      // Frees the zlib stream state however we leave, including when an output allocation throws
+      struct deflate_end { void operator()(z_stream* s) const { deflateEnd(s); } };
+      std::unique_ptr<z_stream, deflate_end> zs_guard{&zs};
+
+      std::vector<std::string> out;
+      auto next_output = [&] {
+        if (!out.empty())
+          out.back().resize(out.back().size() - zs.avail_out);
+        auto& piece = out.emplace_back();
+        piece.resize(OUTPUT_PIECE_SIZE);
+        zs.next_out = reinterpret_cast<Bytef*>(piece.data());
+        zs.avail_out = piece.size();
+      };
+      next_output();
+
+      int ret = Z_OK;
+      for (size_t i = 0; i <= body.size(); i++) {
+        bool last = i == body.size();
+        if (!last) {
+          zs.next_in = reinterpret_cast<Bytef*>(body[i].data());
+          zs.avail_in = body[i].size();
+        }
+        int flush = last ? Z_FINISH : Z_NO_FLUSH;
+        do {
+          if (zs.avail_out == 0)
+            next_output();
+          ret = deflate(&zs, flush);
+          if (ret == Z_STREAM_ERROR)
+            throw std::runtime_error{"gzip compression failed"};
+        } while (last ? ret != Z_STREAM_END : zs.avail_in > 0 || zs.avail_out == 0);
+
+        if (!last)
+          std::string{}.swap(body[i]);
+      }
+      out.back().resize(out.back().size() - zs.avail_out);
+      return out;
+    }
+#endif
+
+#ifdef ENABLE_RPC_ZSTD
+    std::vector<std::string> compress_zstd(std::vector<std::string>&& body) {
+      std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx{ZSTD_createCCtx(), ZSTD_freeCCtx};
+      if (!cctx || ZSTD_isError(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, ZSTD_LEVEL)))
+        throw std::runtime_error{"Failed to initialize zstd compression"};
+
+      size_t total = 0;
+      for (const auto& piece : body) total += piece.size();
+      // Lets zstd record the content size in the frame header and pick parameters to suit
+      ZSTD_CCtx_setPledgedSrcSize(cctx.get(), total);
+
+      std::vector<std::string> out;
+      ZSTD_outBuffer output{nullptr, 0, 0};
+      auto next_output = [&] {
+        if (!out.empty())
+          out.back().resize(output.pos);
+        auto& piece = out.emplace_back();
+        piece.resize(OUTPUT_PIECE_SIZE);
+        output = {piece.data(), piece.size(), 0};
+      };
+      next_output();
+
+      for (size_t i = 0; i <= body.size(); i++) {
+        bool last = i == body.size();
+        ZSTD_inBuffer input{last ? nullptr : body[i].data(), last ? 0 : body[i].size(), 0};
+        auto mode = last ? ZSTD_e_end : ZSTD_e_continue;
+        size_t remaining;
+        do {
+          if (output.pos == output.size)
+            next_output();
+          remaining = ZSTD_compressStream2(cctx.get(), &output, &input, mode);
+          if (ZSTD_isError(remaining))
+            throw std::runtime_error{"zstd compression failed: "s + ZSTD_getErrorName(remaining)};
+        } while (last ? remaining != 0 : input.pos < input.size);
+
+        if (!last)
+          std::string{}.swap(body[i]);
+      }
+      out.back().resize(output.pos);
+      return out;
+    }
+#endif
+
+  }
+
+  bool compression_supported(compression c) {
+    switch (c) {
+      case compression::none: return true;
+#ifdef ENABLE_RPC_GZIP
+      case compression::gzip: return true;
+#endif
+#ifdef ENABLE_RPC_ZSTD
+      case compression::zstd: return true;
+#endif
+      default: return false;
+    }
+  }
+
+  std::string_view compression_name(compression c) {
+    switch (c) {
+      case compression::gzip: return "gzip"sv;
+      case compression::zstd: return "zstd"sv;
+      default: return "identity"sv;
+    }
+  }
+
+  compression negotiate_compression(std::string_view accept_encoding) {
+    // q values given for gzip, zstd and "*"; "*" only applies to encodings not listed explicitly,
+    // so that e.g. "gzip;q=0, *" never picks gzip.
+    std::optional<double> gzip_q, zstd_q, star_q;
+    for (auto item : tools::split(accept_encoding, ","sv, true)) {
+      auto params = tools::split(item, ";"sv);
+      auto name = params[0];
+      tools::trim(name);
+      double q = 1;
+      for (size_t i = 1; i < params.size(); i++) {
+        auto p = params[i];
+        tools::trim(p);
+        if (p.size() > 2 && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=') {
+          try { q = std::stod(std::string{p.substr(2)}); }
+          catch (...) { q = 0; }
+        }
+      }
+
+      if (tools::string_iequal(name, "zstd"sv))
+        zstd_q = q;
+      else if (tools::string_iequal(name, "gzip"sv) || tools::string_iequal(name, "x-gzip"sv))
+        gzip_q = q;
+      else if (name == "*"sv)
+        star_q = q;
+    }
+
+    compression best = compression::none;
+    double best_q = 0;
+    // zstd goes first so that it wins a tie
+    for (auto [c, q] : {std::pair{compression::zstd, zstd_q}, std::pair{compression::gzip, gzip_q}}) {
+      if (!q) q = star_q;
+      if (q && *q > best_q && compression_supported(c)) {
+        best = c;
+        best_q = *q;
+      }
+    }
+    return best;
+  }
+
+  std::vector<std::string> compress(compression c, std::vector<std::string>&& body) {
+    switch (c) {
+      case compression::none: return std::move(body);
+#ifdef ENABLE_RPC_GZIP
+      case compression::gzip: return compress_gzip(std::move(body));
+#endif
+#ifdef ENABLE_RPC_ZSTD
+      case compression::zstd: return compress_zstd(std::move(body));
+#endif
+      default: throw std::runtime_error{"Unsupported compression requested"};
+    }
+  }
+
+}
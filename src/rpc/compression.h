@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cryptonote::rpc {
+
+  /// Content encodings we can apply to RPC response bodies.  Which of these are actually available
+  /// depends on the libraries we were built with (see compression_supported()).
+  enum class compression : uint8_t { none, gzip, zstd };
+
+  /// Responses smaller than this are never compressed: the savings don't pay for the CPU time (and,
+  /// for tiny responses, gzip/zstd framing can even make them bigger).
+  constexpr size_t COMPRESSION_MIN_SIZE = 2048;
+
+  /// Returns true if this build can produce the given encoding.  `none` is always supported.
+  bool compression_supported(compression c);
+
+  /// Returns the token used for the encoding in HTTP Content-Encoding headers (and in OMQ
+  /// replies): "gzip", "zstd", or "identity" for `none`.
+  std::string_view compression_name(compression c);
+
+  /// Picks the encoding to use given the value of an HTTP Accept-Encoding header (or the equivalent
+  /// value sent with an OMQ RPC request), e.g. "gzip, deflate, br;q=0.9, zstd".  Encodings we don't
+  /// support and encodings with q=0 are skipped, and a "*" entry only covers encodings not listed
+  /// explicitly; among the rest the highest q wins, with zstd preferred over gzip on a tie.
+  /// Returns `none` if nothing acceptable is found.
+  compression negotiate_compression(std::string_view accept_encoding);
+
+  /// Compresses a response body, given as a sequence of pieces to be concatenated, and returns the
+  /// compressed body as a sequence of pieces.  The input pieces are freed as they are consumed.
+  /// Throws std::runtime_error if compression fails or `c` isn't supported.  Calling this with
+  /// `none` just returns the input.
+  std::vector<std::string> compress(compression c, std::vector<std::string>&& body);
+
+}
@@ -46,10 +46,12 @@
 #include "quenero_economy.h"
 #include "epee/string_tools.h"
 #include "core_rpc_server.h"
+#include "common/chunked_streambuf.h"
 #include "common/command_line.h"
 #include "common/quenero.h"
 #include "common/sha256sum.h"
 #include "common/perf_timer.h"
+#include "common/trace.h"
 #include "common/random.h"
 #include "common/hex.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
@@ -72,6 +74,13 @@
 namespace cryptonote { namespace rpc {
 
   namespace {
+    // Stores a response into epee's generic storage.  Takes the response by value so that it is
+    // destroyed once stored, rather than staying alive while the storage gets serialized.
+    template <typename Response>
+    void store_to_storage(Response res, epee::serialization::portable_storage& ps) {
+      res.store(ps);
+    }
+
     // Helper loaders for RPC registration; this lets us reduce the amount of compiled code by
     // avoiding the need to instantiate {JSON,binary} loading code for {binary,JSON} commands.
     // This first one is for JSON, the specialization below is for binary.
@@ -124,6 +133,19 @@ namespace cryptonote { namespace rpc {
         epee::serialization::store_t_to_json(res, response, 0 /*indent*/, false /*newlines*/);
         return response;
       }
+
+      // Streaming versions of the above
+      template <typename R = typename RPC::response, std::enable_if_t<std::is_same<R, std::string>::value, int> = 0>
+      void serialize(std::string&& res, std::ostream& out) {
+        epee::serialization::dump_as_json(out, res, 0 /*indent*/, false /*newlines*/);
+      }
+
+      template <typename R = typename RPC::response, std::enable_if_t<!std::is_same<R, std::string>::value, int> = 0>
+      void serialize(typename RPC::response&& res, std::ostream& out) {
+        epee::serialization::portable_storage ps;
+        store_to_storage(std::move(res), ps);
+        ps.dump_as_json(out, 0 /*indent*/, false /*newlines*/);
+      }
     };
 
     // binary command specialization
@@ -147,8 +169,31 @@ namespace cryptonote { namespace rpc {
         epee::serialization::store_t_to_binary(res, response);
         return response;
       }
+
+      void serialize(typename RPC::response&& res, std::ostream& out) {
+        epee::serialization::portable_storage ps;
+        store_to_storage(std::move(res), ps);
+        ps.store_to_binary(out);
+      }
     };
 
+    // Loads and invokes the request, then passes the response to `serializer` to produce the
+    // result; records the handler and serialization times in the request.
+    template <typename RPC, typename Serializer>
+    auto invoke_timed(rpc_request& request, core_rpc_server& server, Serializer&& serializer)
+    {
+      tools::trace::span trace_call{RPC::names()[0], QUENERO_DEFAULT_LOG_CATEGORY};
+      reg_helper<RPC> helper;
+      auto start = std::chrono::steady_clock::now();
+      typename RPC::response res = server.invoke(helper.load(request), std::move(request.context));
+      auto invoked = std::chrono::steady_clock::now();
+      TRACE_SPAN(serialize);
+      auto result = serializer(helper, std::move(res));
+      request.timing.handler = invoked - start;
+      request.timing.serialize = std::chrono::steady_clock::now() - invoked;
+      return result;
+    }
+
     template <typename RPC, std::enable_if_t<std::is_base_of_v<RPC_COMMAND, RPC>, int> = 0>
     void register_rpc_command(std::unordered_map<std::string, std::shared_ptr<const rpc_command>>& regs)
     {
@@ -163,10 +208,19 @@ namespace cryptonote { namespace rpc {
       cmd->is_public = std::is_base_of_v<PUBLIC, RPC>;
       cmd->is_binary = std::is_base_of_v<BINARY, RPC>;
       cmd->is_legacy = std::is_base_of_v<LEGACY, RPC>;
+      cmd->name = RPC::names()[0];
       cmd->invoke = [](rpc_request&& request, core_rpc_server& server) {
-        reg_helper<RPC> helper;
-        Response res = server.invoke(helper.load(request), std::move(request.context));
-        return helper.serialize(std::move(res));
+        return invoke_timed<RPC>(request, server, [](reg_helper<RPC>& helper, Response&& res) {
+          return helper.serialize(std::move(res));
+        });
+      };
+      cmd->invoke_chunked = [](rpc_request&& request, core_rpc_server& server, size_t chunk_size) {
+        return invoke_timed<RPC>(request, server, [chunk_size](reg_helper<RPC>& helper, Response&& res) {
+          tools::chunked_streambuf buf{chunk_size};
+          std::ostream out{&buf};
+          helper.serialize(std::move(res), out);
+          return buf.release();
+        });
       };
 
       for (const auto& name : RPC::names())
@@ -1294,6 +1348,7 @@ namespace cryptonote { namespace rpc {
     if ( lMiner.is_mining() ) {
       res.speed = lMiner.get_speed();
       res.threads_count = lMiner.get_threads_count();
+      res.thread_speeds = lMiner.get_thread_speeds();
       res.block_reward = lMiner.get_block_reward();
     }
     const account_public_address& lMiningAdr = lMiner.get_mining_address();
@@ -2918,6 +2973,188 @@ namespace cryptonote { namespace rpc {
     return res;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  static latency_summary summarize(const tools::latency_histogram::snapshot& h)
+  {
+    latency_summary s{};
+    s.count = h.count;
+    s.total_us = h.sum_us;
+    s.mean_us = h.mean_us();
+    s.p50_us = h.quantile_us(0.5);
+    s.p90_us = h.quantile_us(0.9);
+    s.p99_us = h.quantile_us(0.99);
+    s.max_us = h.max_us;
+    return s;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  GET_RPC_STATS::response core_rpc_server::invoke(GET_RPC_STATS::request&& req, rpc_context context)
+  {
+    GET_RPC_STATS::response res{};
+
+    for (auto& [key, stats] : m_stats.commands())
+    {
+      auto& [command, source, admin] = key;
+      auto& e = res.commands.emplace_back();
+      e.command = command;
+      e.source = to_string(source);
+      e.admin = admin;
+      e.calls = stats.calls;
+      e.errors = stats.errors;
+      e.bytes_out = stats.bytes_out;
+      e.queue = summarize(stats.queue);
+      e.handler = summarize(stats.handler);
+      e.serialize = summarize(stats.serialize);
+    }
+
+    if (req.top_clients > 0)
+    {
+      for (auto& [remote, client] : m_stats.top_clients(req.top_clients))
+      {
+        auto& c = res.clients.emplace_back();
+        c.remote = remote;
+        c.calls = client.calls;
+        c.busy_us = client.busy_us;
+        c.bytes_out = client.bytes_out;
+      }
+    }
+
+    res.rate_limited = m_admission.rate_limited();
+    res.shed = m_admission.shed();
+
+    if (req.reset)
+      m_stats.reset();
+
+    res.status = STATUS_OK;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  static std::string levin_command_name(int command)
+  {
+    switch (command)
+    {
+      case nodetool::COMMAND_HANDSHAKE_T<CORE_SYNC_DATA>::ID: return "handshake";
+      case nodetool::COMMAND_TIMED_SYNC_T<CORE_SYNC_DATA>::ID: return "timed_sync";
+      case nodetool::COMMAND_PING::ID: return "ping";
+      case nodetool::COMMAND_REQUEST_SUPPORT_FLAGS::ID: return "request_support_flags";
+      case NOTIFY_NEW_TRANSACTIONS::ID: return "new_transactions";
+      case NOTIFY_REQUEST_GET_BLOCKS::ID: return "request_get_blocks";
+      case NOTIFY_RESPONSE_GET_BLOCKS::ID: return "response_get_blocks";
+      case NOTIFY_REQUEST_CHAIN::ID: return "request_chain";
+      case NOTIFY_RESPONSE_CHAIN_ENTRY::ID: return "response_chain_entry";
+      case NOTIFY_NEW_FLUFFY_BLOCK::ID: return "new_fluffy_block";
+      case NOTIFY_REQUEST_FLUFFY_MISSING_TX::ID: return "request_fluffy_missing_tx";
+      case NOTIFY_UPTIME_PROOF::ID: return "uptime_proof";
+      case NOTIFY_BTENCODED_UPTIME_PROOF::ID: return "btencoded_uptime_proof";
+      case NOTIFY_REQUEST_BLOCK_BLINKS::ID: return "request_block_blinks";
+      case NOTIFY_RESPONSE_BLOCK_BLINKS::ID: return "response_block_blinks";
+      case NOTIFY_REQUEST_GET_TXS::ID: return "request_get_txs";
+      case NOTIFY_NEW_MASTERNODE_VOTE::ID: return "new_masternode_vote";
+      case 0: return "noise";
+      default: return std::to_string(command);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  GET_PEER_STATS::response core_rpc_server::invoke(GET_PEER_STATS::request&& req, rpc_context context)
+  {
+    GET_PEER_STATS::response res{};
+
+    auto to_entry = [](int command, const connection_stats::command_counters& c) {
+      GET_PEER_STATS::command_entry e{};
+      e.command = levin_command_name(command);
+      e.id = static_cast<uint32_t>(command);
+      e.msgs_in = c.msgs_in;
+      e.bytes_in = c.bytes_in;
+      e.msgs_out = c.msgs_out;
+      e.bytes_out = c.bytes_out;
+      return e;
+    };
+
+    std::map<int, connection_stats::command_counters> totals;
+    const auto now = std::chrono::steady_clock::now();
+    // node_server only exposes for_each_connection through its endpoint interface
+    nodetool::i_p2p_endpoint<cryptonote_connection_context>& p2p = m_p2p;
+    p2p.for_each_connection([&](cryptonote_connection_context& cntxt, nodetool::peerid_type, uint32_t)
+    {
+      auto& p = res.peers.emplace_back();
+      p.connection_id = tools::type_to_hex(cntxt.m_connection_id);
+      p.address = cntxt.m_remote_address.str();
+      p.incoming = cntxt.m_is_income;
+      p.state = get_protocol_state_string(cntxt.m_state);
+      p.height = cntxt.m_remote_blockchain_height;
+      p.live_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - cntxt.m_started).count();
+      p.recv_bytes = cntxt.m_recv_cnt;
+      p.send_bytes = cntxt.m_send_cnt;
+      p.current_download = cntxt.m_current_speed_down / 1024;
+      p.current_upload = cntxt.m_current_speed_up / 1024;
+      p.send_queue_chunks = cntxt.m_send_queue_chunks;
+      p.send_queue_peak = cntxt.m_send_queue_peak;
+      p.send_stall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(cntxt.m_send_stall_time).count();
+      p.get_blocks_rtt = summarize(cntxt.m_stats->get_blocks_rtt.get());
+      p.chain_rtt = summarize(cntxt.m_stats->chain_rtt.get());
+      for (auto& [command, c] : cntxt.m_stats->commands())
+      {
+        auto& t = totals[command];
+        t.msgs_in += c.msgs_in;
+        t.bytes_in += c.bytes_in;
+        t.msgs_out += c.msgs_out;
+        t.bytes_out += c.bytes_out;
+        if (req.peer_commands)
+          p.commands.push_back(to_entry(command, c));
+      }
+      return true;
+    });
+
+    for (auto& [command, c] : totals)
+      res.commands.push_back(to_entry(command, c));
+
+    res.status = STATUS_OK;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  GET_PERF_STATS::response core_rpc_server::invoke(GET_PERF_STATS::request&& req, rpc_context context)
+  {
+    GET_PERF_STATS::response res{};
+
+    for (auto& t : tools::get_perf_timer_stats())
+    {
+      auto& e = res.timers.emplace_back();
+      e.name = std::move(t.name);
+      e.timing = summarize(t.timing);
+    }
+
+    if (req.reset)
+      tools::reset_perf_timer_stats();
+
+    res.status = STATUS_OK;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  SET_TRACING::response core_rpc_server::invoke(SET_TRACING::request&& req, rpc_context context)
+  {
+    SET_TRACING::response res{};
+
+    if (req.clear)
+      tools::trace::clear();
+    tools::trace::set_enabled(req.enabled);
+    MGINFO("Timeline tracing " << (req.enabled ? "started" : "stopped"));
+
+    res.status = STATUS_OK;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  GET_TRACE::response core_rpc_server::invoke(GET_TRACE::request&& req, rpc_context context)
+  {
+    GET_TRACE::response res{};
+
+    res.enabled = tools::trace::enabled();
+    res.events = tools::trace::event_count();
+    res.trace = tools::trace::dump_chrome_json();
+    if (req.clear)
+      tools::trace::clear();
+
+    res.status = STATUS_OK;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   GET_MASTERNODE_REGISTRATION_CMD_RAW::response core_rpc_server::invoke(GET_MASTERNODE_REGISTRATION_CMD_RAW::request&& req, rpc_context context)
   {
     GET_MASTERNODE_REGISTRATION_CMD_RAW::response res{};
@@ -39,6 +39,8 @@
 
 #include "bootstrap_daemon.h"
 #include "core_rpc_server_commands_defs.h"
+#include "rpc_admission.h"
+#include "rpc_stats.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "p2p/net_node.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
@@ -128,15 +130,25 @@ namespace cryptonote::rpc {
 
     // Values to pass through to the invoke() call
     rpc_context context;
+
+    // Timing details of the call; the handler and serialization times are filled in by
+    // rpc_command::invoke/invoke_chunked.
+    rpc_call_timing timing;
   };
 
   class core_rpc_server;
 
   /// Stores an RPC command callback.  These are set up in core_rpc_server.cpp.
   struct rpc_command {
+    // The primary name of the command (used, for instance, to aggregate stats).
+    std::string_view name;
     // Called with the incoming command data; returns the response body if all goes well,
     // otherwise throws an exception.
     std::string(*invoke)(rpc_request&&, core_rpc_server&);
+    // Same as `invoke`, but serializes the response body straight into a list of pieces of
+    // `chunk_size` bytes (the last one may be shorter) instead of into one contiguous string.  Used
+    // by the HTTP server so that large responses can be written out (and freed) piece by piece.
+    std::vector<std::string>(*invoke_chunked)(rpc_request&&, core_rpc_server&, size_t chunk_size);
     bool is_public; // callable via restricted RPC
     bool is_binary; // only callable at /name (for HTTP RPC), and binary data, not JSON.
     bool is_legacy; // callable at /name (for HTTP RPC), even though it is JSON (for backwards compat).
@@ -190,6 +202,13 @@ namespace cryptonote::rpc {
 
     network_type nettype() const { return m_core.get_nettype(); }
 
+    /// Returns the aggregated RPC call statistics, which the RPC transports record into
+    rpc_stats& stats() { return m_stats; }
+
+    /// Returns the admission controller (per-client rate limits, lanes and load shedding) that the
+    /// RPC transports consult before running a public request
+    rpc_admission& admission() { return m_admission; }
+
     GET_HEIGHT::response                                invoke(GET_HEIGHT::request&& req, rpc_context context);
     GET_BLOCKS_FAST::response                           invoke(GET_BLOCKS_FAST::request&& req, rpc_context context);
     GET_ALT_BLOCKS_HASHES::response                     invoke(GET_ALT_BLOCKS_HASHES::request&& req, rpc_context context);
@@ -270,6 +289,11 @@ namespace cryptonote::rpc {
     ONS_OWNERS_TO_NAMES::response                       invoke(ONS_OWNERS_TO_NAMES::request&& req, rpc_context context);
     ONS_RESOLVE::response                               invoke(ONS_RESOLVE::request&& req, rpc_context context);
     FLUSH_CACHE::response                               invoke(FLUSH_CACHE::request&& req, rpc_context);
+    GET_RPC_STATS::response                             invoke(GET_RPC_STATS::request&& req, rpc_context context);
+    GET_PEER_STATS::response                            invoke(GET_PEER_STATS::request&& req, rpc_context context);
+    GET_PERF_STATS::response                            invoke(GET_PERF_STATS::request&& req, rpc_context context);
+    SET_TRACING::response                               invoke(SET_TRACING::request&& req, rpc_context context);
+    GET_TRACE::response                                 invoke(GET_TRACE::request&& req, rpc_context context);
 
 #if defined(QUENERO_ENABLE_INTEGRATION_TEST_HOOKS)
     void on_relay_uptime_and_votes()
@@ -332,6 +356,8 @@ private:
     std::unique_ptr<bootstrap_daemon> m_bootstrap_daemon;
     std::chrono::system_clock::time_point m_bootstrap_height_check_time;
     bool m_was_bootstrap_ever_used;
+    rpc_stats m_stats;
+    rpc_admission m_admission;
   };
 
 } // namespace cryptonote::rpc
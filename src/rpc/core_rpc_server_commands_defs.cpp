@@ -282,6 +282,7 @@ KV_SERIALIZE_MAP_CODE_BEGIN(MINING_STATUS::response)
   KV_SERIALIZE(active)
   KV_SERIALIZE(speed)
   KV_SERIALIZE(threads_count)
+  KV_SERIALIZE(thread_speeds)
   KV_SERIALIZE(address)
   KV_SERIALIZE(pow_algorithm)
   KV_SERIALIZE(block_target)
@@ -1374,4 +1375,135 @@ KV_SERIALIZE_MAP_CODE_BEGIN(FLUSH_CACHE::request)
   KV_SERIALIZE_OPT(bad_blocks, false)
 KV_SERIALIZE_MAP_CODE_END()
 
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(latency_summary)
+  KV_SERIALIZE(count)
+  KV_SERIALIZE(total_us)
+  KV_SERIALIZE(mean_us)
+  KV_SERIALIZE(p50_us)
+  KV_SERIALIZE(p90_us)
+  KV_SERIALIZE(p99_us)
+  KV_SERIALIZE(max_us)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_RPC_STATS::request)
+  KV_SERIALIZE_OPT(top_clients, (uint32_t)0)
+  KV_SERIALIZE_OPT(reset, false)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_RPC_STATS::command_entry)
+  KV_SERIALIZE(command)
+  KV_SERIALIZE(source)
+  KV_SERIALIZE(admin)
+  KV_SERIALIZE(calls)
+  KV_SERIALIZE(errors)
+  KV_SERIALIZE(bytes_out)
+  KV_SERIALIZE(queue)
+  KV_SERIALIZE(handler)
+  KV_SERIALIZE(serialize)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_RPC_STATS::client_entry)
+  KV_SERIALIZE(remote)
+  KV_SERIALIZE(calls)
+  KV_SERIALIZE(busy_us)
+  KV_SERIALIZE(bytes_out)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_RPC_STATS::response)
+  KV_SERIALIZE(status)
+  KV_SERIALIZE(commands)
+  KV_SERIALIZE(clients)
+  KV_SERIALIZE(rate_limited)
+  KV_SERIALIZE(shed)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_PEER_STATS::request)
+  KV_SERIALIZE_OPT(peer_commands, false)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_PEER_STATS::command_entry)
+  KV_SERIALIZE(command)
+  KV_SERIALIZE(id)
+  KV_SERIALIZE(msgs_in)
+  KV_SERIALIZE(bytes_in)
+  KV_SERIALIZE(msgs_out)
+  KV_SERIALIZE(bytes_out)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_PEER_STATS::peer_entry)
+  KV_SERIALIZE(connection_id)
+  KV_SERIALIZE(address)
+  KV_SERIALIZE(incoming)
+  KV_SERIALIZE(state)
+  KV_SERIALIZE(height)
+  KV_SERIALIZE(live_ms)
+  KV_SERIALIZE(recv_bytes)
+  KV_SERIALIZE(send_bytes)
+  KV_SERIALIZE(current_download)
+  KV_SERIALIZE(current_upload)
+  KV_SERIALIZE(send_queue_chunks)
+  KV_SERIALIZE(send_queue_peak)
+  KV_SERIALIZE(send_stall_ms)
+  KV_SERIALIZE(get_blocks_rtt)
+  KV_SERIALIZE(chain_rtt)
+  KV_SERIALIZE(commands)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_PEER_STATS::response)
+  KV_SERIALIZE(status)
+  KV_SERIALIZE(peers)
+  KV_SERIALIZE(commands)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_PERF_STATS::request)
+  KV_SERIALIZE_OPT(reset, false)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_PERF_STATS::timer_entry)
+  KV_SERIALIZE(name)
+  KV_SERIALIZE(timing)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_PERF_STATS::response)
+  KV_SERIALIZE(status)
+  KV_SERIALIZE(timers)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(SET_TRACING::request)
+  KV_SERIALIZE(enabled)
+  KV_SERIALIZE_OPT(clear, false)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(SET_TRACING::response)
+  KV_SERIALIZE(status)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_TRACE::request)
+  KV_SERIALIZE_OPT(clear, false)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_TRACE::response)
+  KV_SERIALIZE(status)
+  KV_SERIALIZE(enabled)
+  KV_SERIALIZE(events)
+  KV_SERIALIZE(trace)
+KV_SERIALIZE_MAP_CODE_END()
+
 }
@@ -66,7 +66,7 @@ namespace rpc {
 // has its own version, and that clients can just test major to see
 // whether they can talk to a given daemon without having to know in
 // advance which version they will stop working with
-  constexpr version_t VERSION = {4, 0};
+  constexpr version_t VERSION = {4, 6};
 
   /// Makes a version array from a packed 32-bit integer version
   constexpr version_t make_version(uint32_t version)
@@ -593,6 +593,7 @@ namespace rpc {
       bool active;                       // States if mining is enabled (`true`) or disabled (`false`).
       uint64_t speed;                    // Mining power in hashes per seconds.
       uint32_t threads_count;            // Number of running mining threads.
+      std::vector<uint64_t> thread_speeds; // Mining power of each mining thread, in hashes per second.
       std::string address;               // Account address daemon is mining to. Empty if not mining.
       std::string pow_algorithm;         // Current hashing algorithm name
       uint32_t block_target;             // The expected time to solve per block, i.e. TARGET_BLOCK_TIME
@@ -2543,6 +2544,218 @@ namespace rpc {
     struct response : STATUS { };
   };
 
+  /// Summary of a latency histogram.  All times are in microseconds; the percentiles are estimates
+  /// (the upper bound of the power-of-two bucket the percentile falls in).
+  struct latency_summary
+  {
+    uint64_t count;    // Number of recorded values
+    uint64_t total_us; // Sum of all recorded values
+    uint64_t mean_us;  // Average value
+    uint64_t p50_us;   // Median
+    uint64_t p90_us;   // 90th percentile
+    uint64_t p99_us;   // 99th percentile
+    uint64_t max_us;   // Largest recorded value
+
+    KV_MAP_SERIALIZABLE
+  };
+
+  QUENERO_RPC_DOC_INTROSPECT
+  // Returns per-command RPC statistics accumulated since startup (or the last reset): call and
+  // error counts, response bytes, and latency summaries for time spent queued waiting for a worker
+  // thread, executing the command, and serializing its response.  Stats are split by transport
+  // (http/omq) and by access level (public/admin).  Optionally also returns the clients that have
+  // used the most RPC time.
+  struct GET_RPC_STATS : RPC_COMMAND
+  {
+    static constexpr auto names() { return NAMES("get_rpc_stats"); }
+
+    struct request
+    {
+      uint32_t top_clients; // How many of the busiest clients to return (default 0: don't return any clients)
+      bool reset;           // If true, clear all stats after retrieving them
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct command_entry
+    {
+      std::string command;        // The RPC command name
+      std::string source;         // "http" or "omq"
+      bool admin;                 // True for calls with admin access, false for public calls
+      uint64_t calls;             // Number of calls
+      uint64_t errors;            // Number of calls that failed
+      uint64_t bytes_out;         // Response body bytes sent (after any compression)
+      latency_summary queue;      // Time spent waiting for a worker thread (HTTP only)
+      latency_summary handler;    // Time spent executing the command
+      latency_summary serialize;  // Time spent serializing the response
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct client_entry
+    {
+      std::string remote; // The client's address (or pubkey, for OMQ)
+      uint64_t calls;     // Number of calls made
+      uint64_t busy_us;   // Total time spent executing and serializing this client's calls
+      uint64_t bytes_out; // Total response bytes sent to the client
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::string status;                  // General RPC error code. "OK" means everything looks good.
+      std::vector<command_entry> commands; // Per-command stats
+      std::vector<client_entry> clients;   // The `top_clients` clients with the highest `busy_us`
+      uint64_t rate_limited;               // Public requests refused by the per-client rate limit since startup
+      uint64_t shed;                       // Public requests refused because the worker queues were backed up, since startup
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
+  QUENERO_RPC_DOC_INTROSPECT
+  // Returns p2p traffic statistics of each currently connected peer: levin message and byte counts
+  // per command, the depth of the connection's send queue and how long data has waited in it, and
+  // round trip times of block (NOTIFY_REQUEST_GET_BLOCKS) and chain (NOTIFY_REQUEST_CHAIN)
+  // requests.  Also returns the per-command totals over all connected peers.
+  struct GET_PEER_STATS : RPC_COMMAND
+  {
+    static constexpr auto names() { return NAMES("get_peer_stats"); }
+
+    struct request
+    {
+      bool peer_commands; // If true, include the per-command counters of each peer, not just the totals
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct command_entry
+    {
+      std::string command; // The levin command name (or its number, if unknown)
+      uint32_t id;         // The levin command number
+      uint64_t msgs_in;    // Messages received (requests, notifications and responses)
+      uint64_t bytes_in;   // Bytes received, including levin headers
+      uint64_t msgs_out;   // Messages sent
+      uint64_t bytes_out;  // Bytes sent, including levin headers
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct peer_entry
+    {
+      std::string connection_id;           // The connection id, as in get_connections
+      std::string address;                 // The peer's address
+      bool incoming;                       // True if the peer connected to us
+      std::string state;                   // Sync state of the connection
+      uint64_t height;                     // The peer's reported blockchain height
+      uint64_t live_ms;                    // How long the connection has been open
+      uint64_t recv_bytes;                 // Total bytes received
+      uint64_t send_bytes;                 // Total bytes queued to send
+      uint64_t current_download;           // Current download rate, in kB/s
+      uint64_t current_upload;             // Current upload rate, in kB/s
+      uint64_t send_queue_chunks;          // Chunks currently in the send queue
+      uint64_t send_queue_peak;            // The most chunks the send queue has held
+      uint64_t send_stall_ms;              // Total time the send queue has had data waiting to go out
+      latency_summary get_blocks_rtt;      // Time from requesting blocks to receiving them
+      latency_summary chain_rtt;           // Time from requesting a chain entry to receiving it
+      std::vector<command_entry> commands; // Per-command counters (only if requested)
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::string status;                  // General RPC error code. "OK" means everything looks good.
+      std::vector<peer_entry> peers;       // One entry per connected peer
+      std::vector<command_entry> commands; // Per-command counters summed over all connected peers
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
+  QUENERO_RPC_DOC_INTROSPECT
+  // Returns the timings of the daemon's internal hot-path timers (block addition, transaction
+  // verification, database operations, ...) accumulated since startup or the last reset.  These
+  // are recorded whether or not the perf.* log categories are enabled.  Returns no timers if the
+  // daemon was built with the timers compiled out.
+  struct GET_PERF_STATS : RPC_COMMAND
+  {
+    static constexpr auto names() { return NAMES("get_perf_stats"); }
+
+    struct request
+    {
+      bool reset; // If true, clear all timings after retrieving them
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct timer_entry
+    {
+      std::string name;       // The timer name
+      latency_summary timing; // Durations of the timed section
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::string status;              // General RPC error code. "OK" means everything looks good.
+      std::vector<timer_entry> timers; // One entry per timer, sorted by name
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
+  QUENERO_RPC_DOC_INTROSPECT
+  // Starts or stops timeline tracing of the daemon's internals (block processing stages, database
+  // commits, quorum checks, pulse rounds and RPC calls).  Events are kept in a fixed-size buffer
+  // that overwrites the oldest events once full; use GET_TRACE to retrieve them.
+  struct SET_TRACING : RPC_COMMAND
+  {
+    static constexpr auto names() { return NAMES("set_tracing"); }
+
+    struct request
+    {
+      bool enabled; // True to start recording, false to stop.  Stopping keeps the recorded events.
+      bool clear;   // If true, discard all previously recorded events first
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::string status; // General RPC error code. "OK" means everything looks good.
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
+  QUENERO_RPC_DOC_INTROSPECT
+  // Returns the events recorded by timeline tracing (see SET_TRACING) as a Chrome trace event JSON
+  // document, which can be loaded into chrome://tracing or https://ui.perfetto.dev.
+  struct GET_TRACE : RPC_COMMAND
+  {
+    static constexpr auto names() { return NAMES("get_trace"); }
+
+    struct request
+    {
+      bool clear; // If true, discard the recorded events after retrieving them
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::string status; // General RPC error code. "OK" means everything looks good.
+      bool enabled;       // Whether tracing is currently recording
+      uint64_t events;    // Number of events in the trace
+      std::string trace;  // The trace, as Chrome trace event JSON
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
   /// List of all supported rpc command structs to allow compile-time enumeration of all supported
   /// RPC types.  Every type added above that has an RPC endpoint needs to be added here, and needs
   /// a core_rpc_server::invoke() overload that takes a <TYPE>::request and returns a
@@ -2628,7 +2841,12 @@ namespace rpc {
     ONS_NAMES_TO_OWNERS,
     ONS_OWNERS_TO_NAMES,
     ONS_RESOLVE,
-    FLUSH_CACHE
+    FLUSH_CACHE,
+    GET_RPC_STATS,
+    GET_PEER_STATS,
+    GET_PERF_STATS,
+    SET_TRACING,
+    GET_TRACE
   >;
 
 } } // namespace cryptonote::rpc
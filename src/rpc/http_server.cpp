@@ -1,5 +1,6 @@
 
 #include "http_server.h"
+#include <algorithm>
 #include <chrono>
 #include <exception>
 #include <oxenmq/base64.h>
@@ -7,9 +8,11 @@
 #include <oxenmq/variant.h>
 #include "common/command_line.h"
 #include "common/string_util.h"
+#include "common/util.h"
 #include "cryptonote_config.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "epee/net/jsonrpc_structs.h"
+#include "rpc/compression.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "rpc/rpc_args.h"
 #include "version.h"
@@ -39,6 +42,18 @@ namespace cryptonote::rpc {
     }
   };
 
+  const command_line::arg_descriptor<unsigned> http_server::arg_rpc_http_threads{
+    "rpc-http-threads",
+    "Number of event loop threads accepting, parsing and replying to HTTP RPC requests for each of the public and admin RPC servers; 0 scales it from --max-concurrency.",
+    0
+  };
+
+  const command_line::arg_descriptor<bool> http_server::arg_rpc_metrics{
+    "rpc-metrics",
+    "Serve RPC call counters and latency histograms in Prometheus text format at /metrics on the admin (unrestricted) RPC listeners.",
+    false
+  };
+
   const command_line::arg_descriptor<uint16_t> http_server::arg_rpc_bind_port = {
       "rpc-bind-port",
       "Port for RPC server; deprecated, use --rpc-public or --rpc-admin instead.",
@@ -72,6 +87,8 @@ namespace cryptonote::rpc {
   {
     command_line::add_arg(desc, arg_rpc_public);
     command_line::add_arg(desc, arg_rpc_admin);
+    command_line::add_arg(desc, arg_rpc_http_threads);
+    command_line::add_arg(desc, arg_rpc_metrics);
 
     command_line::add_arg(hidden, arg_rpc_bind_port);
     command_line::add_arg(hidden, arg_rpc_restricted_bind_port);
@@ -86,81 +103,115 @@ namespace cryptonote::rpc {
       core_rpc_server& server,
       rpc_args rpc_config,
       bool restricted,
-      std::vector<std::tuple<std::string, uint16_t, bool>> bind)
-    : m_server{server}, m_restricted{restricted}
+      std::vector<std::tuple<std::string, uint16_t, bool>> bind,
+      unsigned threads,
+      bool metrics)
+    : m_server{server}, m_bind{std::move(bind)}, m_restricted{restricted}, m_metrics{metrics && !restricted}
   {
-    // uWS is designed to work from a single thread, which is good (we pull off the requests and
-    // then stick them into the LMQ job queue to be scheduled along with other jobs).  But as a
-    // consequence, we need to create everything inside that thread.  We *also* need to get the
-    // (thread local) event loop pointer back from the thread so that we can shut it down later
-    // (injecting a callback into it is one of the few thread-safe things we can do across threads).
+    // uWS is designed to work from a single thread per event loop, which is good (we pull off the
+    // requests and then stick them into the LMQ job queue to be scheduled along with other jobs).
+    // But as a consequence, we need to create everything inside each loop's thread.  We *also* need
+    // to get the (thread local) event loop pointers back from the threads so that we can shut them
+    // down later (injecting a callback into a loop is one of the few thread-safe things we can do
+    // across threads).
+    //
+    // To scale past what a single thread can parse and write we run `threads` independent event
+    // loops, each with its own uWS::App listening on the same addresses.
     //
-    // Things we need in the owning thread, fulfilled from the http thread:
+    // Things we need in the owning thread, fulfilled from each http thread:
 
     // - the uWS::Loop* for the event loop thread (which is thread_local).  We can get this during
     //   thread startup, after the thread does basic initialization.
-    std::promise<uWS::Loop*> loop_promise;
-    auto loop_future = loop_promise.get_future();
-
-    // - the us_listen_socket_t* on which the server is listening.  We can't get this until we
+    //
+    // - the us_listen_socket_t* on which the loop is listening.  We can't get this until we
     //   actually start listening, so wait until `start()` for it.  (We also double-purpose it to
     //   send back an exception if one fires during startup).
-    std::promise<std::vector<us_listen_socket_t*>> startup_success_promise;
-    m_startup_success = startup_success_promise.get_future();
-
-    // Things we need to send from the owning thread to the event loop thread:
-    // - a signal when the thread should bind to the port and start the event loop (when we call
-    //   start()).
-    //m_startup_promise
-
-    m_rpc_thread = std::thread{[this, rpc_config=std::move(rpc_config), bind=std::move(bind)] (
-        std::promise<uWS::Loop*> loop_promise,
-        std::future<bool> startup_future,
-        std::promise<std::vector<us_listen_socket_t*>> startup_success) {
-      uWS::App http;
+    //
+    // Things we need to send from the owning thread to the event loop threads:
+    // - a signal when the threads should bind to the port and start the event loop (when we call
+    //   start()).  This is shared by all of the threads.
+    std::shared_future<bool> startup_future = m_startup_promise.get_future().share();
+
+    m_login = rpc_config.login;
+    m_cors = {rpc_config.access_control_origins.begin(), rpc_config.access_control_origins.end()};
+
+    if (threads == 0)
+      threads = tools::get_thread_budget().http;
+    m_loops.resize(threads);
+    std::exception_ptr failure;
+    for (auto& el : m_loops)
+    {
+      std::promise<uWS::Loop*> loop_promise;
+      auto loop_future = loop_promise.get_future();
+      std::promise<std::vector<us_listen_socket_t*>> startup_success_promise;
+      el.startup_success = startup_success_promise.get_future();
+
+      el.thread = std::thread{&http_server::run_event_loop, this,
+        std::move(loop_promise), startup_future, std::move(startup_success_promise)};
+
       try {
-        create_rpc_endpoints(http);
+        el.loop = loop_future.get();
       } catch (...) {
-        loop_promise.set_exception(std::current_exception());
-        return;
+        failure = std::current_exception();
+        break;
       }
-      loop_promise.set_value(uWS::Loop::get());
-      if (!startup_future.get())
-        // False means cancel, i.e. we got destroyed/shutdown without start() being called
-        return;
+    }
 
-      m_login = rpc_config.login;
+    if (failure)
+    {
+      // Abort whatever threads we already started, then propagate.
+      m_startup_promise.set_value(false);
+      for (auto& el : m_loops)
+        if (el.thread.joinable())
+          el.thread.join();
+      std::rethrow_exception(failure);
+    }
 
-      m_cors = {rpc_config.access_control_origins.begin(), rpc_config.access_control_origins.end()};
+    m_loop = m_loops.front().loop;
+  }
 
-      std::vector<us_listen_socket_t*> listening;
-      try {
-        bool required_bind_failed = false;
-        for (const auto& [addr, port, required] : bind)
-          http.listen(addr, port, [&listening, req=required, &required_bind_failed](us_listen_socket_t* sock) {
-            if (sock) listening.push_back(sock);
-            else if (req) required_bind_failed = true;
-          });
+  void http_server::run_event_loop(
+      std::promise<uWS::Loop*> loop_promise,
+      std::shared_future<bool> startup_future,
+      std::promise<std::vector<us_listen_socket_t*>> startup_success)
+  {
+    uWS::App http;
+    try {
+      create_rpc_endpoints(http);
+    } catch (...) {
+      loop_promise.set_exception(std::current_exception());
+      return;
+    }
+    loop_promise.set_value(uWS::Loop::get());
+    if (!startup_future.get())
+      // False means cancel, i.e. we got destroyed/shutdown without start() being called
+      return;
 
-        if (listening.empty() || required_bind_failed) {
-          std::ostringstream error;
-          error << "RPC HTTP server failed to bind; ";
-          if (listening.empty()) error << "no valid bind address(es) given";
-          error << "tried to bind to:";
-          for (const auto& [addr, port, required] : bind)
-            error << ' ' << addr << ':' << port;
-          throw std::runtime_error(error.str());
-        }
-      } catch (...) {
-        startup_success.set_exception(std::current_exception());
-        return;
-      }
-      startup_success.set_value(std::move(listening));
+    std::vector<us_listen_socket_t*> listening;
+    try {
+      bool required_bind_failed = false;
+      for (const auto& [addr, port, required] : m_bind)
+        http.listen(addr, port, [&listening, req=required, &required_bind_failed](us_listen_socket_t* sock) {
+          if (sock) listening.push_back(sock);
+          else if (req) required_bind_failed = true;
+        });
 
-      http.run();
-    }, std::move(loop_promise), m_startup_promise.get_future(), std::move(startup_success_promise)};
+      if (listening.empty() || required_bind_failed) {
+        std::ostringstream error;
+        error << "RPC HTTP server failed to bind; ";
+        if (listening.empty()) error << "no valid bind address(es) given";
+        error << "tried to bind to:";
+        for (const auto& [addr, port, required] : m_bind)
+          error << ' ' << addr << ':' << port;
+        throw std::runtime_error(error.str());
+      }
+    } catch (...) {
+      startup_success.set_exception(std::current_exception());
+      return;
+    }
+    startup_success.set_value(std::move(listening));
 
-    m_loop = loop_future.get();
+    http.run();
   }
 
   void http_server::create_rpc_endpoints(uWS::App& http)
@@ -188,6 +239,21 @@ namespace cryptonote::rpc {
       handle_json_rpc_request(*res, *req);
     });
 
+    if (m_metrics)
+      http.get("/metrics", [this](HttpResponse* res, HttpRequest* req) {
+        if (m_login && !check_auth(*req, *res))
+          return;
+        auto body = m_server.stats().prometheus();
+        res->cork([&] {
+          res->writeStatus("200 OK");
+          res->writeHeader("Server", m_server_header);
+          res->writeHeader("Content-Type", "text/plain; version=0.0.4");
+          if (m_closing) res->writeHeader("Connection", "close");
+          res->end(body);
+          if (m_closing) res->close();
+        });
+      });
+
     // Fallback to send a 404 for anything else:
     http.any("/*", [this](HttpResponse* res, HttpRequest* req) {
       if (m_login && !check_auth(*req, *res))
@@ -199,10 +265,16 @@ namespace cryptonote::rpc {
 
   namespace {
 
+  // Size of the pieces that responses get serialized into; this is also the largest amount of a
+  // response that we hand to uWS at once.
+  constexpr size_t RESPONSE_CHUNK_SIZE = 64 * 1024;
+
   struct call_data {
     http_server& http;
     core_rpc_server& core_rpc;
     HttpResponse& res;
+    // The event loop that owns `res`; every write to it has to be deferred into this loop.
+    uWS::Loop* loop;
     std::string uri;
     const rpc_command* call{nullptr};
     rpc_request request{};
@@ -210,14 +282,25 @@ namespace cryptonote::rpc {
     bool replied{false};
     bool jsonrpc{false};
     std::string jsonrpc_id; // pre-formatted json value
+    std::chrono::steady_clock::time_point queued; // When the request was handed to the worker queue
+    rpc_admission::ticket admission; // Admission control state for public requests
+    compression compress{compression::none}; // Content-Encoding negotiated from Accept-Encoding
     std::vector<std::pair<std::string, std::string>> extra_headers; // Extra headers to send
 
+    // The response body while it is being written out: the pieces not yet fully sent, the total
+    // body size, the index of the piece currently being written and the response write offset at
+    // which that piece starts.  Only touched from inside `loop`.
+    std::vector<std::string> body;
+    uintmax_t body_size{0};
+    size_t body_piece{0};
+    uintmax_t body_piece_offset{0};
+
     // If we have to drop the request because we are overloaded we want to reply with an error (so
     // that we close the connection instead of leaking it and leaving it hanging).  We don't do
     // this, of course, if the request got aborted and replied to.
     ~call_data() {
       if (replied || aborted) return;
-      http.loop_defer([&http=http, &res=res, jsonrpc=jsonrpc] {
+      loop->defer([&http=http, &res=res, jsonrpc=jsonrpc] {
         if (jsonrpc)
           http.jsonrpc_error_response(res, -32003, "Server busy, try again later");
         else
@@ -247,16 +330,79 @@ namespace cryptonote::rpc {
     }
   };
 
+  // Runs admission control on a request that is about to be queued and picks the worker queue (OMQ
+  // category) it should go into.  Returns std::nullopt, after replying with an error, if the
+  // request was refused.  Requests on admin servers are never refused.
+  std::optional<std::string> admit_request(call_data& data)
+  {
+    auto& admission = data.core_rpc.admission();
+    if (!data.call->is_public)
+      return "admin";
+    if (data.request.context.admin)
+      return admission.lane(data.call->name) == rpc_lane::fast ? "rpc_fast" : "rpc";
+
+    switch (admission.admit(data.call->name, data.request.context.remote, true /*queued*/, data.admission))
+    {
+      case rpc_admission::result::admitted:
+        return data.admission.lane() == rpc_lane::fast ? "rpc_fast" : "rpc";
+      case rpc_admission::result::rate_limited:
+        if (data.jsonrpc)
+          data.jsonrpc_error_response(data.res, -32004, "Rate limit exceeded, try again later");
+        else
+          data.error_response(data.res, http_server::HTTP_TOO_MANY_REQUESTS, "Rate limit exceeded, try again later");
+        return std::nullopt;
+      default:
+        if (data.jsonrpc)
+          data.jsonrpc_error_response(data.res, -32003, "Server busy, try again later");
+        else
+          data.error_response(data.res, http_server::HTTP_SERVICE_UNAVAILABLE, "Server busy, try again later");
+        return std::nullopt;
+    }
+  }
+
+  // Writes as much of the queued response body as the socket will currently take.  Returns true if
+  // the response is finished (or the connection is gone) and false if we stopped because of
+  // backpressure, in which case we get called again from onWritable once the socket drains.  Each
+  // piece is freed as soon as it has been sent, so a large response doesn't sit around in memory
+  // (or get copied into uWS's own backpressure buffer) for the lifetime of a slow connection.
+  bool write_body(call_data& data)
+  {
+    auto& res = data.res;
+    while (!data.aborted && data.body_piece < data.body.size())
+    {
+      std::string_view piece{data.body[data.body_piece]};
+      piece.remove_prefix(res.getWriteOffset() - data.body_piece_offset);
+      auto [ok, done] = res.tryEnd(piece, data.body_size);
+      if (done)
+      {
+        data.body.clear();
+        if (data.http.closing()) res.close();
+        return true;
+      }
+      if (!ok)
+        return false;
+
+      data.body_piece_offset += data.body[data.body_piece].size();
+      std::string{}.swap(data.body[data.body_piece++]);
+    }
+    return true;
+  }
+
   // Queues a response for the HTTP thread to handle; the response can be in multiple string pieces
-  // to be concatenated together.
+  // to be concatenated together.  The pieces are written with backpressure: we only hand uWS as
+  // much as the socket accepts, then continue from onWritable.
   void queue_response(std::shared_ptr<call_data> data, std::vector<std::string> body)
   {
-    auto& http = data->http;
+    auto* loop = data->loop;
     data->replied = true;
-    http.loop_defer([data=std::move(data), body=std::move(body)] {
+    loop->defer([data=std::move(data), body=std::move(body)]() mutable {
       if (data->aborted)
         return;
-      data->res.cork([data=std::move(data), body=std::move(body)] {
+      data->body = std::move(body);
+      data->body_size = 0;
+      for (const auto& piece : data->body)
+        data->body_size += piece.size();
+      data->res.cork([&data] {
         auto& res = data->res;
         res.writeHeader("Server", data->http.server_header());
         res.writeHeader("Content-Type", data->call->is_binary ? "application/octet-stream"sv : "application/json"sv);
@@ -264,11 +410,16 @@ namespace cryptonote::rpc {
         for (const auto& [name, value] : data->extra_headers)
           res.writeHeader(name, value);
 
-        for (const auto& piece : body)
-          res.write(piece);
+        if (data->body_size == 0)
+        {
+          res.end();
+          if (data->http.closing()) res.close();
+          return;
+        }
 
-        res.end();
-        if (data->http.closing()) res.close();
+        data->body_piece_offset = res.getWriteOffset();
+        if (!write_body(*data))
+          res.onWritable([data](uintmax_t) { return write_body(*data); });
       });
     });
   }
@@ -281,26 +432,31 @@ namespace cryptonote::rpc {
     queue_response(std::move(data), std::move(b));
   }
 
-  void invoke_txpool_hashes_bin(std::shared_ptr<call_data> data);
+  void invoke_txpool_hashes_bin(std::shared_ptr<call_data> data, std::chrono::steady_clock::time_point start);
 
   // Invokes the actual RPC request; this is called (via oxenmq) from some random LMQ worker thread,
   // which means we can't just write our reply; instead we have to post it to the uWS loop.
   void invoke_rpc(std::shared_ptr<call_data> dataptr)
   {
     auto& data = *dataptr;
+    auto start = std::chrono::steady_clock::now();
+    data.admission.started(start - data.queued);
     if (data.aborted) return;
 
+    data.request.timing.queue = start - data.queued;
+
     // Replace the default tx pool hashes callback with our own (which adds long poll support):
     if (std::string_view{data.uri}.substr(1) == rpc::GET_TRANSACTION_POOL_HASHES_BIN::names()[0])
-      return invoke_txpool_hashes_bin(std::move(dataptr));
+      return invoke_txpool_hashes_bin(std::move(dataptr), start);
 
     const bool time_logging = LOG_ENABLED(Debug);
-    std::chrono::steady_clock::time_point start;
-    if (time_logging)
-      start = std::chrono::steady_clock::now();
+
+    // invoke() consumes the request context, so grab what we need for logging and stats first
+    const std::string remote = data.request.context.remote;
+    const bool admin = data.request.context.admin;
+    auto& stats = data.core_rpc.stats();
 
     std::vector<std::string> result;
-    result.reserve(data.jsonrpc ? 3 : 1);
     if (data.jsonrpc)
     {
       result.emplace_back(R"({"jsonrpc":"2.0","id":)");
@@ -313,7 +469,11 @@ namespace cryptonote::rpc {
     std::string http_message;
 
     try {
-      result.push_back(data.call->invoke(std::move(data.request), data.core_rpc));
+      auto pieces = data.call->invoke_chunked(std::move(data.request), data.core_rpc, RESPONSE_CHUNK_SIZE);
+      if (result.empty())
+        result = std::move(pieces);
+      else
+        result.insert(result.end(), std::make_move_iterator(pieces.begin()), std::make_move_iterator(pieces.end()));
       json_error = 0;
     } catch (const parse_error& e) {
       // This isn't really WARNable as it's the client fault; log at info level instead.
@@ -331,9 +491,11 @@ namespace cryptonote::rpc {
     } catch (...) {
       MWARNING("HTTP RPC request '" << data.uri << "' raised an unknown exception");
     }
+    data.core_rpc.admission().finished(data.admission, data.call->name, data.request.timing.handler + data.request.timing.serialize);
 
     if (json_error != 0) {
-      data.http.loop_defer([data=std::move(dataptr), json_error, msg=std::move(data.jsonrpc ? json_message : http_message)] {
+      stats.record(data.call->name, rpc_source::http, admin, remote, data.request.timing, 0, true /*error*/);
+      data.loop->defer([data=std::move(dataptr), json_error, msg=std::move(data.jsonrpc ? json_message : http_message)] {
         if (data->jsonrpc)
           data->jsonrpc_error_response(data->res, json_error, msg);
         else
@@ -345,14 +507,41 @@ namespace cryptonote::rpc {
     if (data.jsonrpc)
       result.emplace_back("}\n");
 
+    size_t bytes = 0;
+    for (const auto& r : result) bytes += r.size();
+
+    // Compress here, on the worker thread, rather than in the uWS loop.
+    std::string compressed;
+    size_t bytes_out = bytes;
+    if (data.compress != compression::none && bytes >= COMPRESSION_MIN_SIZE)
+    {
+      try {
+        result = compress(data.compress, std::move(result));
+      } catch (const std::exception& e) {
+        MWARNING("HTTP RPC request '" << data.uri << "' response compression failed: " << e.what());
+        stats.record(data.call->name, rpc_source::http, admin, remote, data.request.timing, 0, true /*error*/);
+        data.loop->defer([data=std::move(dataptr)] {
+          data->error_response(data->res, http_server::HTTP_ERROR);
+        });
+        return;
+      }
+      data.extra_headers.emplace_back("Content-Encoding", compression_name(data.compress));
+      bytes_out = 0;
+      for (const auto& r : result) bytes_out += r.size();
+      compressed = ", " + std::to_string(bytes_out) + " " + std::string{compression_name(data.compress)};
+    }
+
+    // Whether we compress depends on Accept-Encoding even when we don't (the client didn't ask, or
+    // the response is small), so tell caches to key uncompressed responses on it as well.
+    if (compression_supported(compression::gzip) || compression_supported(compression::zstd))
+      data.extra_headers.emplace_back("Vary", "Accept-Encoding");
+
+    stats.record(data.call->name, rpc_source::http, admin, remote, data.request.timing, bytes_out, false /*error*/);
+
     std::string call_duration;
     if (time_logging)
       call_duration = " in " + tools::friendly_duration(std::chrono::steady_clock::now() - start);
-    if (LOG_ENABLED(Info)) {
-      size_t bytes = 0;
-      for (const auto& r : result) bytes += r.size();
-      MINFO("HTTP RPC " << data.uri << " [" << data.request.context.remote << "] OK (" << bytes << " bytes)" << call_duration);
-    }
+    MINFO("HTTP RPC " << data.uri << " [" << remote << "] OK (" << bytes << " bytes" << compressed << ")" << call_duration);
 
     queue_response(std::move(dataptr), std::move(result));
   }
@@ -370,20 +559,39 @@ namespace cryptonote::rpc {
   std::list<std::pair<std::shared_ptr<call_data>, std::chrono::steady_clock::time_point>> long_pollers;
   std::mutex long_poll_mutex;
 
+  // Records stats for a get_transaction_pool_hashes.bin reply; called when the reply is queued,
+  // which for a deferred long poll is when the pool changes or the poll times out.
+  void record_txpool_reply(call_data& data, size_t bytes_out, bool error = false) {
+    data.core_rpc.stats().record(data.call->name, rpc_source::http, data.request.context.admin,
+        data.request.context.remote, data.request.timing, bytes_out, error);
+  }
+
   // HTTP-only long-polling support for the transaction pool hashes command
-  void invoke_txpool_hashes_bin(std::shared_ptr<call_data> data) {
+  void invoke_txpool_hashes_bin(std::shared_ptr<call_data> data, std::chrono::steady_clock::time_point start) {
     GET_TRANSACTION_POOL_HASHES_BIN::request req{};
-    std::string_view body;
-    if (auto body_sv = data->request.body_view())
-      body = *body_sv;
+    std::vector<crypto::hash> pool_hashes;
+    std::string error;
+    if (auto body = data->request.body_view(); !body)
+      error = "Internal error: got unexpected request body type";
+    else if (!epee::serialization::load_t_from_binary(req, *body))
+      error = "Failed to parse binary data parameters";
     else
-      throw parse_error{"Internal error: got unexpected request body type"};
+      data->core_rpc.get_core().get_pool().get_transaction_hashes(pool_hashes, data->request.context.admin, req.blinked_txs_only /*include_only_blinked*/);
 
-    if (!epee::serialization::load_t_from_binary(req, body))
-      throw parse_error{"Failed to parse binary data parameters"};
+    // The worker is done with the request here even if we defer the reply below, so release the
+    // admission ticket now rather than when the long poll returns.
+    data->request.timing.handler = std::chrono::steady_clock::now() - start;
+    data->core_rpc.admission().finished(data->admission, data->call->name, data->request.timing.handler);
 
-    std::vector<crypto::hash> pool_hashes;
-    data->core_rpc.get_core().get_pool().get_transaction_hashes(pool_hashes, data->request.context.admin, req.blinked_txs_only /*include_only_blinked*/);
+    if (!error.empty())
+    {
+      MINFO("HTTP RPC request '" << data->uri << "' called with invalid/unparseable data: " << error);
+      record_txpool_reply(*data, 0, true /*error*/);
+      data->loop->defer([data=std::move(data), msg=std::move(error)] {
+        data->error_response(data->res, http_server::HTTP_ERROR, msg);
+      });
+      return;
+    }
 
     if (req.long_poll)
     {
@@ -402,7 +610,9 @@ namespace cryptonote::rpc {
     }
 
     // Either not a long poll request or checksum didn't match
-    queue_response(std::move(data), pool_hashes_response(std::move(pool_hashes)));
+    auto response = pool_hashes_response(std::move(pool_hashes));
+    record_txpool_reply(*data, response.size());
+    queue_response(std::move(data), std::move(response));
   }
 
   // This get invoked (from cryptonote_core.cpp) whenever the mempool is added to.  We queue
@@ -427,6 +637,7 @@ namespace cryptonote::rpc {
         body = pool_hashes_response(std::move(pool_hashes));
       }
       MTRACE("Sending deferred long poll pool update to " << data.request.context.remote);
+      record_txpool_reply(data, body->size());
       queue_response(std::move(dataptr), *body);
     }
     long_pollers.clear();
@@ -456,6 +667,7 @@ namespace cryptonote::rpc {
       if (it->second < now)
       {
         MTRACE("Sending long poll timeout to " << it->first->request.context.remote);
+        record_txpool_reply(*it->first, long_poll_timeout_body.size());
         queue_response(std::move(it->first), long_poll_timeout_body);
         it = long_pollers.erase(it);
         count++;
@@ -477,12 +689,13 @@ namespace cryptonote::rpc {
         HttpRequest& req,
         const rpc_command& call)
   {
-    std::shared_ptr<call_data> data{new call_data{*this, m_server, res, std::string{req.getUrl()}, &call}};
+    std::shared_ptr<call_data> data{new call_data{*this, m_server, res, uWS::Loop::get(), std::string{req.getUrl()}, &call}};
     auto& request = data->request;
     request.body = ""s;
     request.context.admin = !m_restricted;
     request.context.source = rpc_source::http;
     request.context.remote = get_remote_address(res);
+    data->compress = negotiate_compression(req.getHeader("accept-encoding"));
     handle_cors(req, data->extra_headers);
     MTRACE("Received " << req.getMethod() << " " << req.getUrl() << " request from " << request.context.remote);
 
@@ -492,22 +705,26 @@ namespace cryptonote::rpc {
       if (!done)
         return;
 
+      auto cat = admit_request(*data);
+      if (!cat)
+        return;
       auto& omq = data->core_rpc.get_core().get_omq();
-      std::string cat{data->call->is_public ? "rpc" : "admin"};
       std::string cmd{"http:" + data->uri}; // Used for LMQ job logging; prefixed with http: so we can distinguish it
       std::string remote{data->request.context.remote};
-      omq.inject_task(std::move(cat), std::move(cmd), std::move(remote), [data=std::move(data)] { invoke_rpc(std::move(data)); });
+      data->queued = std::chrono::steady_clock::now();
+      omq.inject_task(std::move(*cat), std::move(cmd), std::move(remote), [data=std::move(data)] { invoke_rpc(std::move(data)); });
     });
   }
 
   void http_server::handle_json_rpc_request(HttpResponse& res, HttpRequest& req)
   {
-    std::shared_ptr<call_data> data{new call_data{*this, m_server, res, std::string{req.getUrl()}}};
+    std::shared_ptr<call_data> data{new call_data{*this, m_server, res, uWS::Loop::get(), std::string{req.getUrl()}}};
     data->jsonrpc = true;
     auto& request = data->request;
     request.context.admin = !m_restricted;
     request.context.source = rpc_source::http;
     request.context.remote = get_remote_address(res);
+    data->compress = negotiate_compression(req.getHeader("accept-encoding"));
     handle_cors(req, data->extra_headers);
 
     res.onAborted([data] { data->aborted = true; });
@@ -565,11 +782,14 @@ namespace cryptonote::rpc {
       if (!ps.get_value("params", st_entry, nullptr))
         data->request.body = ""sv;
 
+      auto cat = admit_request(*data);
+      if (!cat)
+        return;
       auto& omq = data->core_rpc.get_core().get_omq();
-      std::string cat{data->call->is_public ? "rpc" : "admin"};
       std::string cmd{"jsonrpc:" + method}; // Used for LMQ job logging; prefixed with jsonrpc: so we can distinguish it
       std::string remote{data->request.context.remote};
-      omq.inject_task(std::move(cat), std::move(cmd), std::move(remote), [data=std::move(data)] { invoke_rpc(std::move(data)); });
+      data->queued = std::chrono::steady_clock::now();
+      omq.inject_task(std::move(*cat), std::move(cmd), std::move(remote), [data=std::move(data)] { invoke_rpc(std::move(data)); });
     });
   }
 
@@ -586,7 +806,22 @@ namespace cryptonote::rpc {
 
     m_startup_promise.set_value(true);
     m_sent_startup = true;
-    m_listen_socks = m_startup_success.get();
+    std::exception_ptr failure;
+    for (auto& el : m_loops)
+    {
+      try {
+        el.listen_socks = el.startup_success.get();
+      } catch (...) {
+        if (!failure) failure = std::current_exception();
+      }
+    }
+    if (failure)
+    {
+      // Some loops may have started listening; shut those down before propagating.
+      shutdown(true);
+      std::rethrow_exception(failure);
+    }
+    MINFO("HTTP RPC server running with " << m_loops.size() << " event loop thread(s)");
 
     auto& omq = m_server.get_core().get_omq();
     if (timer_started.insert(&omq).second)
@@ -595,7 +830,7 @@ namespace cryptonote::rpc {
 
   void http_server::shutdown(bool join)
   {
-    if (!m_rpc_thread.joinable())
+    if (m_loops.empty())
       return;
 
     if (!m_sent_shutdown)
@@ -606,37 +841,49 @@ namespace cryptonote::rpc {
         m_startup_promise.set_value(false);
         m_sent_startup = true;
       }
-      else if (!m_listen_socks.empty())
+      else
       {
-        loop_defer([this] {
-          MTRACE("closing " << m_listen_socks.size() << " listening sockets");
-          for (auto* s : m_listen_socks)
-            us_listen_socket_close(/*ssl=*/false, s);
-          m_listen_socks.clear();
-
-          m_closing = true;
-
-          {
-            // Destroy any pending long poll connections as well
-            MTRACE("closing pending long poll requests");
-            std::lock_guard lock{long_poll_mutex};
-            for (auto it = long_pollers.begin(); it != long_pollers.end(); )
+        for (auto& el : m_loops)
+        {
+          if (el.listen_socks.empty())
+            continue; // Never started listening (and so the thread has already exited)
+          el.loop->defer([this, &el] {
+            MTRACE("closing " << el.listen_socks.size() << " listening sockets");
+            for (auto* s : el.listen_socks)
+              us_listen_socket_close(/*ssl=*/false, s);
+            el.listen_socks.clear();
+
+            m_closing = true;
+
             {
-              if (&it->first->http != this)
-                continue; // Belongs to some other http_server instance
-              it->first->aborted = true;
-              it->first->res.close();
-              it = long_pollers.erase(it);
+              // Destroy any pending long poll connections owned by this loop as well
+              MTRACE("closing pending long poll requests");
+              std::lock_guard lock{long_poll_mutex};
+              for (auto it = long_pollers.begin(); it != long_pollers.end(); )
+              {
+                if (&it->first->http != this || it->first->loop != el.loop)
+                {
+                  ++it;
+                  continue; // Belongs to some other http_server instance or event loop
+                }
+                it->first->aborted = true;
+                it->first->res.close();
+                it = long_pollers.erase(it);
+              }
             }
-          }
-        });
+          });
+        }
       }
       m_sent_shutdown = true;
     }
 
-    MTRACE("joining rpc thread");
     if (join)
-      m_rpc_thread.join();
+    {
+      MTRACE("joining rpc threads");
+      for (auto& el : m_loops)
+        if (el.thread.joinable())
+          el.thread.join();
+    }
     MTRACE("done shutdown");
   }
 
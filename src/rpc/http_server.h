@@ -47,6 +47,8 @@ namespace cryptonote::rpc {
   public:
     static const command_line::arg_descriptor<std::vector<std::string>> arg_rpc_public;
     static const command_line::arg_descriptor<std::vector<std::string>, false, true, 2> arg_rpc_admin;
+    static const command_line::arg_descriptor<unsigned> arg_rpc_http_threads;
+    static const command_line::arg_descriptor<bool> arg_rpc_metrics;
 
     // Deprecated:
     static const command_line::arg_descriptor<uint16_t> arg_rpc_bind_port;
@@ -60,20 +62,22 @@ namespace cryptonote::rpc {
         core_rpc_server& server,
         rpc_args rpc_config,
         bool restricted,
-        std::vector<std::tuple<std::string, uint16_t, bool>> bind // {IP,port,required}
+        std::vector<std::tuple<std::string, uint16_t, bool>> bind, // {IP,port,required}
+        unsigned threads = 1,
+        bool metrics = false
         );
 
     ~http_server() override;
 
-    /// Starts the event loop in the thread handling http requests.  Core must have been initialized
-    /// and OxenMQ started.  Will propagate an exception from the thread if startup fails.
+    /// Starts the event loops in the threads handling http requests.  Core must have been
+    /// initialized and OxenMQ started.  Will propagate an exception from a thread if startup fails.
     void start();
 
     /// Closes the http server connection.  Can safely be called multiple times, or to abort a
     /// startup if called before start().
     ///
-    /// \param join - if true, wait for the proxy thread to exit.  If false then joining will occur
-    /// during destruction.
+    /// \param join - if true, wait for the event loop threads to exit.  If false then joining will
+    /// occur during destruction.
     void shutdown(bool join = false);
 
   private:
@@ -91,19 +95,42 @@ namespace cryptonote::rpc {
     /// Handles a POST request to /json_rpc.
     void handle_json_rpc_request(HttpResponse& res, HttpRequest& req);
 
+    /// Body of each event loop thread: sets up the endpoints, hands back the (thread local) loop
+    /// pointer, waits for the startup signal and then listens on every bind address.
+    void run_event_loop(
+        std::promise<uWS::Loop*> loop_promise,
+        std::shared_future<bool> startup_future,
+        std::promise<std::vector<us_listen_socket_t*>> startup_success);
+
+    // Per-thread state of one uWS event loop.  Every loop listens on the same addresses (with
+    // SO_REUSEPORT, which uSockets sets by default) so that the kernel spreads incoming connections
+    // across them; a connection, and everything written to it, stays on the loop that accepted it.
+    struct event_loop {
+      uWS::Loop* loop{nullptr};
+      std::thread thread;
+      // A future (promise held by the thread) that delivers us the listening uSockets sockets so
+      // that, when we want to shut down, we can tell uWebSockets to close them (which will then run
+      // off the end of the event loop).  This also doubles to propagate listen exceptions back to us.
+      std::future<std::vector<us_listen_socket_t*>> startup_success;
+      // The listening sockets; only touched from inside this loop once started.
+      std::vector<us_listen_socket_t*> listen_socks;
+    };
+
     // The core rpc server which handles the internal requests
     core_rpc_server& m_server;
-    // A promise we send from outside into the event loop thread to signal it to start.  We sent
-    // "true" to go ahead with binding + starting the event loop, or false to abort.
+    // The bind addresses, shared by all of the event loop threads.
+    std::vector<std::tuple<std::string, uint16_t, bool>> m_bind;
+    // The event loops; the first one is also the base class m_loop.
+    std::vector<event_loop> m_loops;
+    // A promise we send from outside into the event loop threads to signal them to start.  We send
+    // "true" to go ahead with binding + starting the event loops, or false to abort.
     std::promise<bool> m_startup_promise;
-    // A future (promise held by the thread) that delivers us the listening uSockets sockets so
-    // that, when we want to shut down, we can tell uWebSockets to close them (which will then run
-    // off the end of the event loop).  This also doubles to propagate listen exceptions back to us.
-    std::future<std::vector<us_listen_socket_t*>> m_startup_success;
     // Whether we have sent the startup/shutdown signals
     bool m_sent_startup{false}, m_sent_shutdown{false};
     // Whether this is restricted, i.e. public.  Unrestricted allows admin commands.
     bool m_restricted;
+    // Whether we serve /metrics (only ever true for unrestricted servers)
+    bool m_metrics;
   };
 
 } // namespace cryptonote::rpc
@@ -1,6 +1,8 @@
 
 #include "lmq_server.h"
 #include "oxenmq/oxenmq.h"
+#include "oxenmq/hex.h"
+#include "rpc/compression.h"
 
 #undef QUENERO_DEFAULT_LOG_CATEGORY
 #define QUENERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
@@ -78,7 +80,9 @@ auto as_x_pubkeys(const std::vector<std::string>& pk_strings) {
 constexpr std::string_view
   LMQ_OK{"200"sv},
   LMQ_BAD_REQUEST{"400"sv},
-  LMQ_ERROR{"500"sv};
+  LMQ_TOO_MANY_REQUESTS{"429"sv},
+  LMQ_ERROR{"500"sv},
+  LMQ_BUSY{"503"sv};
 
 } // end anonymous namespace
 
@@ -181,6 +185,11 @@ omq_rpc::omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::prog
   // basic (non-admin) rpc commands go into the "rpc." category (e.g. 'rpc.get_info')
   omq.add_category("rpc", AuthLevel::basic, 0 /*no reserved threads*/, 1000 /*max queued requests*/);
 
+  // "rpc_fast." has no commands of its own: the HTTP RPC servers queue public requests for commands
+  // that are currently cheap (see rpc_admission) here rather than into "rpc.", and the reserved
+  // thread keeps them from getting stuck behind a backlog of expensive requests.
+  omq.add_category("rpc_fast", AuthLevel::basic, 1 /*reserved thread*/, 1000 /*max queued requests*/);
+
   // Admin rpc commands go into "admin.".  We also always keep one (potential) thread reserved for
   // admin RPC commands; that way even if there are loads of basic commands being processed we'll
   // still have room to invoke an admin command without waiting for the basic ones to finish.
@@ -189,9 +198,15 @@ omq_rpc::omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::prog
   for (auto& cmd : rpc_commands) {
     omq.add_request_command(cmd.second->is_public ? "rpc" : "admin", cmd.first,
         [name=std::string_view{cmd.first}, &call=*cmd.second, this](oxenmq::Message& m) {
-      if (m.data.size() > 1)
-        m.send_reply(LMQ_BAD_REQUEST, "Bad request: RPC commands must have at most one data part "
+      // The optional second data part opts in to response compression: it takes a list of
+      // acceptable encodings in the same format as an HTTP Accept-Encoding header (e.g. "zstd,
+      // gzip").  When given, the reply gets a third part naming the encoding actually applied to
+      // the body ("identity" if we didn't compress it).
+      if (m.data.size() > 2) {
+        m.send_reply(LMQ_BAD_REQUEST, "Bad request: RPC commands must have at most two data parts "
             "(received " + std::to_string(m.data.size()) + ")");
+        return;
+      }
 
       rpc_request request{};
       request.context.admin = m.access.auth >= AuthLevel::admin;
@@ -199,8 +214,51 @@ omq_rpc::omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::prog
       request.context.remote = m.remote;
       request.body = m.data.empty() ? ""sv : m.data[0];
 
+      // The context gets moved into the invoke call, so take copies for the stats
+      const bool admin = request.context.admin;
+      const std::string remote{m.remote};
+
+      rpc_admission::ticket ticket;
+      if (!admin) {
+        // Limit per pubkey where we have one so that a client can't dodge it by reconnecting.  Costs
+        // are tracked under the primary name, as for HTTP, whichever alias was called.
+        const auto& pubkey = m.conn.pubkey();
+        auto verdict = rpc_.admission().admit(call.name, pubkey.empty() ? remote : oxenmq::to_hex(pubkey), false /*not queued*/, ticket);
+        if (verdict == rpc_admission::result::rate_limited) {
+          m.send_reply(LMQ_TOO_MANY_REQUESTS, "Rate limit exceeded, try again later");
+          return;
+        }
+        if (verdict != rpc_admission::result::admitted) {
+          m.send_reply(LMQ_BUSY, "Server busy, try again later");
+          return;
+        }
+      }
+
+      auto record = [&](size_t bytes_out, bool error) {
+        rpc_.admission().finished(ticket, call.name, request.timing.handler + request.timing.serialize);
+        rpc_.stats().record(call.name, rpc_source::omq, admin, remote, request.timing, bytes_out, error);
+      };
+
       try {
-        m.send_reply(LMQ_OK, call.invoke(std::move(request), rpc_));
+        auto response = call.invoke(std::move(request), rpc_);
+        if (m.data.size() < 2) {
+          record(response.size(), false);
+          m.send_reply(LMQ_OK, response);
+          return;
+        }
+        auto compress_with = negotiate_compression(m.data[1]);
+        if (compress_with == compression::none || response.size() < COMPRESSION_MIN_SIZE) {
+          record(response.size(), false);
+          m.send_reply(LMQ_OK, response, compression_name(compression::none));
+          return;
+        }
+        std::vector<std::string> pieces;
+        pieces.push_back(std::move(response));
+        pieces = compress(compress_with, std::move(pieces));
+        for (size_t i = 1; i < pieces.size(); i++)
+          pieces[0] += pieces[i];
+        record(pieces[0].size(), false);
+        m.send_reply(LMQ_OK, pieces[0], compression_name(compress_with));
         return;
       } catch (const parse_error& e) {
         // This isn't really WARNable as it's the client fault; log at info level instead.
@@ -210,10 +268,12 @@ omq_rpc::omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::prog
         // number instead of a JSON object.  If you want to find some, `grep number2 epee` (for
         // real).
         MINFO("LMQ RPC request '" << (call.is_public ? "rpc." : "admin.") << name << "' called with invalid/unparseable data: " << e.what());
+        record(0, true);
         m.send_reply(LMQ_BAD_REQUEST, "Unable to parse request: "s + e.what());
         return;
       } catch (const rpc_error& e) {
         MWARNING("LMQ RPC request '" << (call.is_public ? "rpc." : "admin.") << name << "' failed with: " << e.what());
+        record(0, true);
         m.send_reply(LMQ_ERROR, e.what());
         return;
       } catch (const std::exception& e) {
@@ -226,6 +286,7 @@ omq_rpc::omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::prog
       // Don't include the exception message in case it contains something that we don't want go
       // back to the user.  If we want to support it eventually we could add some sort of
       // `rpc::user_visible_exception` that carries a message to send back to the user.
+      record(0, true);
       m.send_reply(LMQ_ERROR, "An exception occured while processing your request");
     });
   }
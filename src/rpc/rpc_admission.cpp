@@ -0,0 +1,183 @@
+#include "rpc_admission.h"
+#include <algorithm>
+#include "epee/misc_log_ex.h"
+#include "core_rpc_server_commands_defs.h"
+
+#undef QUENERO_DEFAULT_LOG_CATEGORY
+#define QUENERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
+
+namespace cryptonote::rpc {
+
+  using namespace std::literals;
+
+  namespace {
+
+    // What we assume a command costs before we have seen it run.  The heavyweights that walk many
+    // blocks, outputs or transactions start out on the normal lane and with a cost that makes a
+    // burst of them eat a client's bucket quickly; everything else starts out cheap.  Commands are
+    // identified by their primary name (the first of RPC::names()), whichever alias was called.
+    constexpr uint64_t DEFAULT_COST_US = 500;
+    constexpr uint64_t EXPENSIVE_COST_US = 20000;
+    template <typename... RPC>
+    constexpr std::array<std::string_view, sizeof...(RPC)> primary_names() { return {RPC::names()[0]...}; }
+    constexpr auto EXPENSIVE_COMMANDS = primary_names<
+      GET_BLOCKS_FAST, GET_BLOCKS_BY_HEIGHT, GET_HASHES_FAST, GET_OUTPUTS_BIN, GET_OUTPUTS,
+      GET_TRANSACTIONS, GET_OUTPUT_DISTRIBUTION, GET_OUTPUT_DISTRIBUTION_BIN, GET_OUTPUT_HISTOGRAM,
+      GET_COINBASE_TX_SUM, GET_BLOCK_HEADERS_RANGE, GET_TRANSACTION_POOL, GET_TRANSACTION_POOL_BACKLOG,
+      GET_MASTERNODES, GET_ALTERNATE_CHAINS, GET_OUTPUT_BLACKLIST>();
+
+    // Weight given to the newest sample in the moving averages (1/8)
+    constexpr uint64_t EWMA_SHIFT = 3;
+    uint64_t ewma(uint64_t avg, uint64_t sample) {
+      return avg - (avg >> EWMA_SHIFT) + (sample >> EWMA_SHIFT);
+    }
+
+    uint64_t to_us(std::chrono::steady_clock::duration d) {
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+      return us > 0 ? us : 0;
+    }
+  }
+
+  rpc_admission::ticket& rpc_admission::ticket::operator=(ticket&& t) noexcept {
+    if (this != &t) {
+      dequeue();
+      admission_ = t.admission_;
+      lane_ = t.lane_;
+      queued_ = t.queued_;
+      client_ = std::move(t.client_);
+      charged_us_ = t.charged_us_;
+      t.admission_ = nullptr;
+      t.queued_ = false;
+      t.client_.clear();
+    }
+    return *this;
+  }
+
+  void rpc_admission::ticket::dequeue() {
+    if (queued_ && admission_)
+      admission_->lanes_[static_cast<size_t>(lane_)].queued--;
+    queued_ = false;
+  }
+
+  void rpc_admission::ticket::started(std::chrono::steady_clock::duration waited) {
+    if (!queued_ || !admission_)
+      return;
+    auto& lane = admission_->lanes_[static_cast<size_t>(lane_)];
+    queued_ = false;
+    uint64_t sample = to_us(waited);
+    // Once the queue has drained, the history no longer says anything about how long a new request
+    // will wait, so start over from this sample (otherwise a past spike would keep us shedding).
+    // Otherwise this is a racy read-modify-write, but a lost sample doesn't matter for an average.
+    if (--lane.queued == 0)
+      lane.queue_latency_us = sample;
+    else
+      lane.queue_latency_us = ewma(lane.queue_latency_us, sample);
+  }
+
+  void rpc_admission::configure(const limits& l) {
+    std::lock_guard lock{mutex_};
+    limits_ = l;
+    clients_.clear();
+  }
+
+  uint64_t rpc_admission::cost_estimate(std::string_view command) const {
+    if (auto it = costs_.find(command); it != costs_.end())
+      return it->second;
+    if (std::find(EXPENSIVE_COMMANDS.begin(), EXPENSIVE_COMMANDS.end(), command) != EXPENSIVE_COMMANDS.end())
+      return EXPENSIVE_COST_US;
+    return DEFAULT_COST_US;
+  }
+
+  std::chrono::microseconds rpc_admission::cost(std::string_view command) const {
+    std::lock_guard lock{mutex_};
+    return std::chrono::microseconds{cost_estimate(command)};
+  }
+
+  rpc_lane rpc_admission::lane(std::string_view command) const {
+    std::lock_guard lock{mutex_};
+    return cost_estimate(command) < FAST_LANE_MAX_COST_US ? rpc_lane::fast : rpc_lane::normal;
+  }
+
+  rpc_admission::bucket& rpc_admission::refill(std::string_view client, std::chrono::steady_clock::time_point now) {
+    const double burst = limits_.client_burst_ms * 1000.0;
+    auto [it, inserted] = clients_.try_emplace(std::string{client}, bucket{burst, now});
+    auto& b = it->second;
+    if (!inserted) {
+      // client_rate_ms is ms per second, i.e. exactly µs of credit per ms of elapsed time.
+      double elapsed_ms = std::chrono::duration<double, std::milli>(now - b.updated).count();
+      b.tokens_us = std::min(burst, b.tokens_us + elapsed_ms * limits_.client_rate_ms);
+      b.updated = now;
+    }
+    return b;
+  }
+
+  void rpc_admission::prune_clients(std::chrono::steady_clock::time_point now) {
+    const double burst = limits_.client_burst_ms * 1000.0;
+    for (auto it = clients_.begin(); it != clients_.end(); ) {
+      double elapsed_ms = std::chrono::duration<double, std::milli>(now - it->second.updated).count();
+      if (it->second.tokens_us + elapsed_ms * limits_.client_rate_ms >= burst)
+        it = clients_.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  rpc_admission::result rpc_admission::admit(std::string_view command, std::string_view client, bool queued, ticket& t) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard lock{mutex_};
+
+    uint64_t cost = cost_estimate(command);
+    rpc_lane lane = cost < FAST_LANE_MAX_COST_US ? rpc_lane::fast : rpc_lane::normal;
+    auto& ls = lanes_[static_cast<size_t>(lane)];
+
+    if (limits_.max_queue_latency.count() > 0 && ls.queued > 0 &&
+        ls.queue_latency_us > static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(limits_.max_queue_latency).count())) {
+      shed_++;
+      MDEBUG("Shedding RPC " << command << " request from " << client << ": " << (lane == rpc_lane::fast ? "fast" : "normal")
+          << " lane queue latency is " << ls.queue_latency_us << "µs");
+      return result::overloaded;
+    }
+
+    t = ticket{};
+    t.admission_ = this;
+    t.lane_ = lane;
+
+    if (limits_.client_rate_ms > 0) {
+      auto& b = refill(client, now);
+      // Admit as long as the bucket isn't empty; the charge can take it negative, which then keeps
+      // the client out until it has paid that back.
+      if (b.tokens_us <= 0) {
+        rate_limited_++;
+        MDEBUG("Rate limiting RPC " << command << " request from " << client);
+        return result::rate_limited;
+      }
+      b.tokens_us -= cost;
+      t.client_ = client;
+      t.charged_us_ = cost;
+      if (clients_.size() > MAX_CLIENTS)
+        prune_clients(now);
+    }
+
+    if (queued) {
+      ls.queued++;
+      t.queued_ = true;
+    }
+    return result::admitted;
+  }
+
+  void rpc_admission::finished(ticket& t, std::string_view command, std::chrono::steady_clock::duration cost) {
+    uint64_t actual = to_us(cost);
+    std::lock_guard lock{mutex_};
+    if (auto it = costs_.find(command); it != costs_.end())
+      it->second = ewma(it->second, actual);
+    else
+      costs_.emplace(command, ewma(cost_estimate(command), actual));
+
+    if (!t.client_.empty() && limits_.client_rate_ms > 0) {
+      auto& b = refill(t.client_, std::chrono::steady_clock::now());
+      b.tokens_us += static_cast<double>(t.charged_us_) - static_cast<double>(actual);
+      t.client_.clear();
+    }
+  }
+
+}
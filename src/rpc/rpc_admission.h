@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace cryptonote::rpc {
+
+  /// The worker queue a public RPC request gets scheduled on.  Cheap commands (e.g. get_height) go
+  /// on the fast lane, which has a worker thread reserved for it, so that they don't sit behind a
+  /// queue of expensive get_outs/get_transactions requests.
+  enum class rpc_lane : uint8_t { fast, normal };
+
+  /// Admission control for public (i.e. non-admin) RPC requests.  This does three things:
+  ///
+  /// - keeps a running estimate of what each command costs (handler + serialization time, seeded
+  ///   for the known-expensive commands and then learned from actual calls), and uses it to put
+  ///   each command on the fast or normal lane;
+  ///
+  /// - gives each client (IP address for HTTP, pubkey or address for OMQ) a token bucket of worker
+  ///   time: each request is charged its command's estimated cost up front (and trued up to the
+  ///   actual cost once it finishes), and requests are refused while the bucket is empty;
+  ///
+  /// - sheds new requests for a lane while requests on that lane are waiting longer than the
+  ///   configured maximum queue latency for a worker.
+  ///
+  /// All methods are safe to call from any thread.
+  class rpc_admission {
+  public:
+    struct limits {
+      // Sustained worker time, in milliseconds per second, that one client may use; 0 (the default)
+      // disables the per-client limit.
+      uint32_t client_rate_ms = 0;
+      // Bucket size, i.e. how much worker time (in ms) a client can use in a burst.
+      uint32_t client_burst_ms = 5000;
+      // Shed new requests for a lane while its requests wait longer than this; 0 disables.
+      std::chrono::milliseconds max_queue_latency{2000};
+    };
+
+    /// Commands with an estimated cost below this go on the fast lane.
+    static constexpr uint64_t FAST_LANE_MAX_COST_US = 2000;
+
+    /// Maximum number of client buckets we keep; beyond this, buckets that have refilled (and so
+    /// are indistinguishable from a new client) are dropped.
+    static constexpr size_t MAX_CLIENTS = 10000;
+
+    enum class result : uint8_t { admitted, rate_limited, overloaded };
+
+    /// Handed out by admit(): tracks a request from admission to completion.  Destroying a ticket
+    /// for a queued request that never started (e.g. because the worker queue was full) takes it
+    /// back off the lane's queue count.
+    class ticket {
+    public:
+      ticket() = default;
+      ticket(ticket&& t) noexcept { *this = std::move(t); }
+      ticket& operator=(ticket&& t) noexcept;
+      ticket(const ticket&) = delete;
+      ticket& operator=(const ticket&) = delete;
+      ~ticket() { dequeue(); }
+
+      rpc_lane lane() const { return lane_; }
+
+      /// Called when a queued request gets picked up by a worker after waiting for `waited`.
+      void started(std::chrono::steady_clock::duration waited);
+
+    private:
+      friend class rpc_admission;
+      void dequeue();
+
+      rpc_admission* admission_ = nullptr;
+      rpc_lane lane_ = rpc_lane::normal;
+      bool queued_ = false;
+      std::string client_; // Empty if the request isn't subject to the per-client limit
+      uint64_t charged_us_ = 0;
+    };
+
+    void configure(const limits& l);
+
+    /// Returns the current cost estimate of `command`.
+    std::chrono::microseconds cost(std::string_view command) const;
+
+    /// Returns the lane that requests for `command` should currently be scheduled on.
+    rpc_lane lane(std::string_view command) const;
+
+    /// Decides whether to accept a new request for `command` from `client`.  If admitted, the
+    /// estimated cost is charged to the client and `t` is set up to track the request.  `queued`
+    /// should be true if the request is about to go into a worker queue (HTTP), and false if it is
+    /// already running on a worker (OMQ, which queues internally before we see the request).
+    result admit(std::string_view command, std::string_view client, bool queued, ticket& t);
+
+    /// Called when a request completes with the handler + serialization time it took.  This
+    /// updates the command's cost estimate and, for an admitted request, refunds or charges the
+    /// difference between the estimated and actual cost.  Call this with a default ticket for
+    /// requests that bypass admission (i.e. admin requests) to still learn from their cost.
+    void finished(ticket& t, std::string_view command, std::chrono::steady_clock::duration cost);
+
+    /// Totals of refused requests since startup.
+    uint64_t rate_limited() const { return rate_limited_; }
+    uint64_t shed() const { return shed_; }
+
+  private:
+    struct bucket {
+      double tokens_us;
+      std::chrono::steady_clock::time_point updated;
+    };
+
+    // Returns the cost estimate for a command; mutex_ must be held
+    uint64_t cost_estimate(std::string_view command) const;
+    // Refills and returns the bucket for a client; mutex_ must be held
+    bucket& refill(std::string_view client, std::chrono::steady_clock::time_point now);
+    void prune_clients(std::chrono::steady_clock::time_point now);
+
+    mutable std::mutex mutex_;
+    limits limits_;
+    std::map<std::string, uint64_t, std::less<>> costs_; // learned per-command cost, in µs
+    std::unordered_map<std::string, bucket> clients_;
+
+    struct lane_state {
+      std::atomic<uint32_t> queued{0};
+      // Exponentially weighted moving average of how long requests wait for a worker
+      std::atomic<uint64_t> queue_latency_us{0};
+    };
+    lane_state lanes_[2];
+
+    std::atomic<uint64_t> rate_limited_{0};
+    std::atomic<uint64_t> shed_{0};
+  };
+
+}
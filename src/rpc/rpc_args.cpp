@@ -47,6 +47,9 @@ namespace cryptonote
      , rpc_login({"rpc-login", rpc_args::tr("Specify username[:password] required for RPC server"), "", true})
      , confirm_external_bind({"confirm-external-bind", rpc_args::tr("Confirm rpc bind IP value is NOT a loopback (local) IP")})
      , rpc_access_control_origins({"rpc-access-control-origins", rpc_args::tr("Specify a comma separated list of origins to allow cross origin resource sharing"), ""})
+     , rpc_client_rate_limit({"rpc-client-rate-limit", rpc_args::tr("Average RPC worker time, in milliseconds per second, that a single public RPC client (IP address or OxenMQ pubkey) may use; requests beyond it are refused. 0 (the default) disables the limit; note that clients behind a shared NAT or proxy share one limit"), rpc::rpc_admission::limits{}.client_rate_ms})
+     , rpc_client_burst({"rpc-client-burst", rpc_args::tr("RPC worker time, in milliseconds, that a single public RPC client may use in a burst above --rpc-client-rate-limit"), rpc::rpc_admission::limits{}.client_burst_ms})
+     , rpc_max_queue_latency({"rpc-max-queue-latency", rpc_args::tr("Refuse new public RPC requests with a busy error while requests are waiting more than this many milliseconds for a worker thread. 0 disables load shedding"), static_cast<uint32_t>(rpc::rpc_admission::limits{}.max_queue_latency.count())})
      , zmq_rpc_bind_ip({"zmq-rpc-bind-ip", rpc_args::tr("Deprecated option, ignored."), ""})
      , zmq_rpc_bind_port({"zmq-rpc-bind-port", rpc_args::tr("Deprecated option, ignored."), ""})
   {}
@@ -63,6 +66,9 @@ namespace cryptonote
     command_line::add_arg(desc, arg.rpc_login);
     command_line::add_arg(desc, arg.confirm_external_bind);
     command_line::add_arg(desc, arg.rpc_access_control_origins);
+    command_line::add_arg(desc, arg.rpc_client_rate_limit);
+    command_line::add_arg(desc, arg.rpc_client_burst);
+    command_line::add_arg(desc, arg.rpc_max_queue_latency);
     command_line::add_arg(hidden, arg.zmq_rpc_bind_ip);
     command_line::add_arg(hidden, arg.zmq_rpc_bind_port);
   }
@@ -129,6 +135,12 @@ namespace cryptonote
       for (auto& aco : aco_entries) access_control_origins.emplace_back(aco);
     }
 
+    config.admission.client_rate_ms = command_line::get_arg(vm, arg.rpc_client_rate_limit);
+    config.admission.client_burst_ms = command_line::get_arg(vm, arg.rpc_client_burst);
+    config.admission.max_queue_latency = std::chrono::milliseconds{command_line::get_arg(vm, arg.rpc_max_queue_latency)};
+    if (config.admission.client_rate_ms > 0 && config.admission.client_burst_ms == 0)
+      throw std::runtime_error{"--"s + arg.rpc_client_burst.name + tr(" must be non-zero when --") + arg.rpc_client_rate_limit.name + tr(" is enabled")};
+
     return config;
   }
 }
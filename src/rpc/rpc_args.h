@@ -35,6 +35,7 @@
 
 #include "common/command_line.h"
 #include "common/password.h"
+#include "rpc/rpc_admission.h"
 
 namespace cryptonote
 {
@@ -57,6 +58,9 @@ namespace cryptonote
       const command_line::arg_descriptor<std::string> rpc_login;
       const command_line::arg_descriptor<bool> confirm_external_bind;
       const command_line::arg_descriptor<std::string> rpc_access_control_origins;
+      const command_line::arg_descriptor<uint32_t> rpc_client_rate_limit;
+      const command_line::arg_descriptor<uint32_t> rpc_client_burst;
+      const command_line::arg_descriptor<uint32_t> rpc_max_queue_latency;
       const command_line::arg_descriptor<std::string> zmq_rpc_bind_ip;   // Deprecated & ignored
       const command_line::arg_descriptor<std::string> zmq_rpc_bind_port; // Deprecated & ignored
     };
@@ -74,5 +78,6 @@ namespace cryptonote
     bool require_ipv4;
     std::vector<std::string> access_control_origins;
     std::optional<tools::login> login; // currently `std::nullopt` if unspecified by user
+    rpc::rpc_admission::limits admission; // per-client and load shedding limits for public RPC
   };
 }
@@ -0,0 +1,173 @@
+#include "rpc_stats.h"
+#include <algorithm>
+#include <sstream>
+#include "core_rpc_server.h"
+
+namespace cryptonote::rpc {
+
+  using namespace std::literals;
+
+  std::string_view to_string(rpc_source source) {
+    switch (source) {
+      case rpc_source::http: return "http"sv;
+      case rpc_source::omq: return "omq"sv;
+      default: return "internal"sv;
+    }
+  }
+
+  void rpc_stats::record(std::string_view command, rpc_source source, bool admin, const std::string& remote,
+      const rpc_call_timing& timing, size_t bytes_out, bool error)
+  {
+    command_key key{std::string{command}, source, admin};
+    command_stats* stats = nullptr;
+    {
+      std::shared_lock lock{cmd_mutex_};
+      if (auto it = cmds_.find(key); it != cmds_.end())
+        stats = it->second.get();
+    }
+    if (!stats)
+    {
+      std::unique_lock lock{cmd_mutex_};
+      auto& ptr = cmds_[std::move(key)];
+      if (!ptr)
+        ptr = std::make_unique<command_stats>();
+      stats = ptr.get();
+    }
+
+    // Entries are never removed from cmds_ (reset() zeroes them in place), so `stats` stays valid.
+    stats->calls.fetch_add(1, std::memory_order_relaxed);
+    if (error)
+      stats->errors.fetch_add(1, std::memory_order_relaxed);
+    stats->bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+    if (timing.queue.count())
+      stats->queue.add(timing.queue);
+    stats->handler.add(timing.handler);
+    stats->serialize.add(timing.serialize);
+
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard lock{client_mutex_};
+    auto& client = clients_[remote];
+    client.calls++;
+    client.busy_us += std::chrono::duration_cast<std::chrono::microseconds>(timing.handler + timing.serialize).count();
+    client.bytes_out += bytes_out;
+    client.last_seen = now;
+
+    if (clients_.size() > MAX_CLIENTS)
+    {
+      // Drop the oldest 10% in one go so that we aren't doing this on every new client
+      std::vector<std::pair<std::chrono::steady_clock::time_point, const std::string*>> by_age;
+      by_age.reserve(clients_.size());
+      for (const auto& [addr, c] : clients_)
+        by_age.emplace_back(c.last_seen, &addr);
+      auto cut = by_age.begin() + clients_.size() / 10;
+      std::nth_element(by_age.begin(), cut, by_age.end());
+      std::vector<std::string> drop;
+      for (auto it = by_age.begin(); it != cut; ++it)
+        drop.push_back(*it->second);
+      for (const auto& addr : drop)
+        clients_.erase(addr);
+    }
+  }
+
+  std::vector<std::pair<rpc_stats::command_key, rpc_stats::command_snapshot>> rpc_stats::commands() const
+  {
+    std::vector<std::pair<command_key, command_snapshot>> result;
+    std::shared_lock lock{cmd_mutex_};
+    result.reserve(cmds_.size());
+    for (const auto& [key, stats] : cmds_)
+      result.emplace_back(key, command_snapshot{
+          stats->calls.load(std::memory_order_relaxed),
+          stats->errors.load(std::memory_order_relaxed),
+          stats->bytes_out.load(std::memory_order_relaxed),
+          stats->queue.get(),
+          stats->handler.get(),
+          stats->serialize.get()});
+    return result;
+  }
+
+  std::vector<std::pair<std::string, rpc_stats::client_stats>> rpc_stats::top_clients(size_t n) const
+  {
+    std::vector<std::pair<std::string, client_stats>> result;
+    {
+      std::lock_guard lock{client_mutex_};
+      result.assign(clients_.begin(), clients_.end());
+    }
+    auto by_busy = [](const auto& a, const auto& b) { return a.second.busy_us > b.second.busy_us; };
+    if (n < result.size())
+    {
+      std::partial_sort(result.begin(), result.begin() + n, result.end(), by_busy);
+      result.resize(n);
+    }
+    else
+      std::sort(result.begin(), result.end(), by_busy);
+    return result;
+  }
+
+  namespace {
+    void prometheus_histogram(std::ostream& o, std::string_view name, std::string_view labels,
+        const tools::latency_histogram::snapshot& h)
+    {
+      uint64_t cumulative = 0;
+      for (size_t b = 0; b < tools::latency_histogram::BUCKETS - 1; b++)
+      {
+        cumulative += h.buckets[b];
+        o << name << "_bucket{" << labels << ",le=\"" << tools::latency_histogram::bucket_upper_us(b) / 1e6 << "\"} " << cumulative << '\n';
+      }
+      o << name << "_bucket{" << labels << ",le=\"+Inf\"} " << h.count << '\n';
+      o << name << "_sum{" << labels << "} " << h.sum_us / 1e6 << '\n';
+      o << name << "_count{" << labels << "} " << h.count << '\n';
+    }
+  }
+
+  std::string rpc_stats::prometheus() const
+  {
+    auto cmds = commands();
+    std::ostringstream o;
+
+    auto labels = [](const command_key& k) {
+      auto& [command, source, admin] = k;
+      return "command=\"" + command + "\",source=\"" + std::string{to_string(source)} + "\",access=\"" + (admin ? "admin" : "public") + "\"";
+    };
+
+    o << "# HELP quenerod_rpc_calls_total RPC requests handled\n# TYPE quenerod_rpc_calls_total counter\n";
+    for (const auto& [key, s] : cmds)
+      o << "quenerod_rpc_calls_total{" << labels(key) << "} " << s.calls << '\n';
+    o << "# HELP quenerod_rpc_errors_total RPC requests that failed\n# TYPE quenerod_rpc_errors_total counter\n";
+    for (const auto& [key, s] : cmds)
+      o << "quenerod_rpc_errors_total{" << labels(key) << "} " << s.errors << '\n';
+    o << "# HELP quenerod_rpc_response_bytes_total RPC response body bytes sent\n# TYPE quenerod_rpc_response_bytes_total counter\n";
+    for (const auto& [key, s] : cmds)
+      o << "quenerod_rpc_response_bytes_total{" << labels(key) << "} " << s.bytes_out << '\n';
+
+    for (auto [name, help, member] : {
+        std::make_tuple("quenerod_rpc_queue_seconds"sv, "Time RPC requests spent waiting for a worker thread"sv, &command_snapshot::queue),
+        std::make_tuple("quenerod_rpc_handler_seconds"sv, "Time spent executing RPC requests"sv, &command_snapshot::handler),
+        std::make_tuple("quenerod_rpc_serialize_seconds"sv, "Time spent serializing RPC responses"sv, &command_snapshot::serialize)})
+    {
+      o << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " histogram\n";
+      for (const auto& [key, s] : cmds)
+        prometheus_histogram(o, name, labels(key), s.*member);
+    }
+
+    return o.str();
+  }
+
+  void rpc_stats::reset()
+  {
+    {
+      std::unique_lock lock{cmd_mutex_};
+      for (auto& [key, stats] : cmds_)
+      {
+        stats->calls = 0;
+        stats->errors = 0;
+        stats->bytes_out = 0;
+        stats->queue.reset();
+        stats->handler.reset();
+        stats->serialize.reset();
+      }
+    }
+    std::lock_guard lock{client_mutex_};
+    clients_.clear();
+  }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "common/latency_histogram.h"
+
+namespace cryptonote::rpc {
+
+  enum struct rpc_source : uint8_t; // Defined in core_rpc_server.h
+
+  /// Timings of a single RPC call.  `queue` is filled in by the transport when it knows when the
+  /// request arrived (currently only HTTP); `handler` and `serialize` are filled in by the
+  /// rpc_command invoke callbacks.
+  struct rpc_call_timing {
+    std::chrono::steady_clock::duration queue{};
+    std::chrono::steady_clock::duration handler{};
+    std::chrono::steady_clock::duration serialize{};
+  };
+
+  /// Aggregated RPC statistics: per command (split by transport and by public/admin access) call
+  /// and error counts, bytes sent and latency histograms, plus per-client totals so that heavy
+  /// callers can be identified.  Recording is safe from any thread.
+  class rpc_stats {
+  public:
+    /// (command name, source, admin)
+    using command_key = std::tuple<std::string, rpc_source, bool>;
+
+    struct command_stats {
+      std::atomic<uint64_t> calls{0};
+      std::atomic<uint64_t> errors{0};
+      std::atomic<uint64_t> bytes_out{0};
+      tools::latency_histogram queue;
+      tools::latency_histogram handler;
+      tools::latency_histogram serialize;
+    };
+
+    struct command_snapshot {
+      uint64_t calls, errors, bytes_out;
+      tools::latency_histogram::snapshot queue, handler, serialize;
+    };
+
+    struct client_stats {
+      uint64_t calls = 0;
+      uint64_t busy_us = 0; // Total handler + serialization time spent on this client's requests
+      uint64_t bytes_out = 0;
+      std::chrono::steady_clock::time_point last_seen;
+    };
+
+    /// Maximum number of distinct clients we keep totals for; when exceeded the least recently
+    /// seen clients are dropped.
+    static constexpr size_t MAX_CLIENTS = 1000;
+
+    /// Records a completed (or failed) call.
+    void record(std::string_view command, rpc_source source, bool admin, const std::string& remote,
+        const rpc_call_timing& timing, size_t bytes_out, bool error);
+
+    /// Returns a snapshot of the stats of every command that has been called, in key order.
+    std::vector<std::pair<command_key, command_snapshot>> commands() const;
+
+    /// Returns the `n` clients with the highest busy time, highest first.
+    std::vector<std::pair<std::string, client_stats>> top_clients(size_t n) const;
+
+    /// Renders the per-command stats in the Prometheus text exposition format.
+    std::string prometheus() const;
+
+    /// Clears everything.
+    void reset();
+
+  private:
+    mutable std::shared_mutex cmd_mutex_;
+    // unique_ptr values so that the (atomic) stats can be updated under just a shared lock
+    std::map<command_key, std::unique_ptr<command_stats>> cmds_;
+
+    mutable std::mutex client_mutex_;
+    std::unordered_map<std::string, client_stats> clients_;
+  };
+
+  /// Returns "http", "omq", or "internal"
+  std::string_view to_string(rpc_source source);
+
+}
@@ -0,0 +1,488 @@
+// Replays a sync session recorded with `quenerod --p2p-record-sync FILE` against a fresh daemon over
+// loopback.  The replayer listens as a single p2p peer serving the chain entries and blocks from the
+// recording; point a daemon with an empty (or older) data directory at it with
+// `--add-exclusive-node 127.0.0.1:PORT` and it reports throughput and per-stage timings once the
+// daemon has caught up to the top of the recorded chain.
+
+#include <algorithm>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/program_options.hpp>
+
+#include "common/command_line.h"
+#include "common/latency_histogram.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "epee/net/abstract_tcp_server2.h"
+#include "epee/net/levin_protocol_handler_async.h"
+#include "epee/storages/portable_storage_template_helper.h"
+#include "p2p/levin_recording.h"
+#include "p2p/p2p_protocol_defs.h"
+
+#undef QUENERO_DEFAULT_LOG_CATEGORY
+#define QUENERO_DEFAULT_LOG_CATEGORY "sync_replay"
+
+namespace po = boost::program_options;
+using namespace std::literals;
+
+namespace
+{
+  using COMMAND_HANDSHAKE = nodetool::COMMAND_HANDSHAKE_T<cryptonote::CORE_SYNC_DATA>;
+  using COMMAND_TIMED_SYNC = nodetool::COMMAND_TIMED_SYNC_T<cryptonote::CORE_SYNC_DATA>;
+
+  struct replay_context : epee::net_utils::connection_context_base {};
+  using replay_protocol_handler = epee::levin::async_protocol_handler<replay_context>;
+  using replay_server = epee::net_utils::boosted_tcp_server<replay_protocol_handler>;
+
+  using seconds_f = std::chrono::duration<double>;
+
+  const command_line::arg_descriptor<std::string> arg_recording = {"recording", "Recording made with quenerod --p2p-record-sync"};
+  const command_line::arg_descriptor<std::string> arg_bind_ip = {"bind-ip", "Address to serve the recorded chain on", "127.0.0.1"};
+  const command_line::arg_descriptor<std::string> arg_port = {"port", "Port to serve the recorded chain on", "48088"};
+  const command_line::arg_descriptor<bool> arg_pace = {"pace", "Delay responses by the round trip times seen in the recording", false};
+  const command_line::arg_descriptor<uint32_t> arg_idle_timeout = {"idle-timeout", "Give up after this many seconds without a request from the daemon", 120};
+
+  /// The chain served to the daemon: every block that arrived during the recorded session, indexed
+  /// by the heights announced in the recorded chain entries.
+  struct recorded_chain
+  {
+    std::vector<crypto::hash> hashes; // By height; null where no chain entry covered the height
+    std::unordered_map<crypto::hash, uint64_t> heights;
+    std::unordered_map<crypto::hash, cryptonote::block_complete_entry> blocks;
+    uint64_t first_height = 0, top_height = 0; // We can serve every block in [first, top]
+    uint8_t top_version = 0;
+    uint64_t cumulative_difficulty = 0;
+    std::chrono::microseconds duration{0};
+    // Round trip times of the recorded requests, replayed in order with --pace
+    std::vector<std::chrono::microseconds> chain_rtts, blocks_rtts;
+  };
+
+  recorded_chain load_recording(const fs::path& file)
+  {
+    recorded_chain chain;
+    nodetool::levin_recording_reader reader{file};
+    nodetool::levin_record rec;
+    // Time of the outstanding request on each connection, to pair it with its response
+    std::unordered_map<uint32_t, std::chrono::microseconds> chain_requests, blocks_requests;
+    std::unordered_map<crypto::hash, cryptonote::block_complete_entry> blocks;
+    size_t messages = 0;
+    while (reader.next(rec))
+    {
+      ++messages;
+      chain.duration = rec.time;
+      if (rec.outgoing)
+      {
+        if (rec.command == cryptonote::NOTIFY_REQUEST_CHAIN::ID)
+          chain_requests[rec.connection] = rec.time;
+        else if (rec.command == cryptonote::NOTIFY_REQUEST_GET_BLOCKS::ID)
+          blocks_requests[rec.connection] = rec.time;
+        continue;
+      }
+
+      if (rec.command == cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::ID)
+      {
+        cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request entry;
+        if (!epee::serialization::load_t_from_binary(entry, rec.payload))
+        {
+          MWARNING("Skipping unparseable chain entry at " << rec.time.count() << "µs");
+          continue;
+        }
+        if (chain.hashes.size() < entry.start_height + entry.m_block_ids.size())
+          chain.hashes.resize(entry.start_height + entry.m_block_ids.size(), crypto::null_hash);
+        std::copy(entry.m_block_ids.begin(), entry.m_block_ids.end(), chain.hashes.begin() + entry.start_height);
+        chain.cumulative_difficulty = std::max(chain.cumulative_difficulty, entry.cumulative_difficulty);
+        if (auto it = chain_requests.find(rec.connection); it != chain_requests.end())
+        {
+          chain.chain_rtts.push_back(rec.time - it->second);
+          chain_requests.erase(it);
+        }
+      }
+      else if (rec.command == cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::ID)
+      {
+        cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::request resp;
+        if (!epee::serialization::load_t_from_binary(resp, rec.payload))
+        {
+          MWARNING("Skipping unparseable blocks response at " << rec.time.count() << "µs");
+          continue;
+        }
+        for (auto& entry : resp.blocks)
+        {
+          cryptonote::block b;
+          crypto::hash hash;
+          if (cryptonote::parse_and_validate_block_from_blob(entry.block, b, hash))
+            blocks.emplace(hash, std::move(entry));
+        }
+        if (auto it = blocks_requests.find(rec.connection); it != blocks_requests.end())
+        {
+          chain.blocks_rtts.push_back(rec.time - it->second);
+          blocks_requests.erase(it);
+        }
+      }
+    }
+
+    // Serve the longest run of consecutive blocks, starting at the first block we received
+    uint64_t height = 1;
+    while (height < chain.hashes.size() && !blocks.count(chain.hashes[height]))
+      ++height;
+    chain.first_height = height;
+    for (; height < chain.hashes.size(); ++height)
+    {
+      auto it = blocks.find(chain.hashes[height]);
+      if (it == blocks.end())
+        break;
+      chain.blocks.insert(blocks.extract(it));
+    }
+    if (chain.blocks.empty())
+      throw std::runtime_error{"Recording doesn't contain any blocks of the announced chain"};
+    chain.top_height = height - 1;
+    chain.hashes.resize(height);
+    for (height = 0; height < chain.hashes.size(); ++height)
+      if (chain.hashes[height] != crypto::null_hash)
+        chain.heights.emplace(chain.hashes[height], height);
+
+    cryptonote::block top;
+    cryptonote::parse_and_validate_block_from_blob(chain.blocks[chain.hashes.back()].block, top);
+    chain.top_version = top.major_version;
+
+    MGINFO("Loaded " << messages << " messages covering " << tools::get_human_readable_timespan(chain.duration)
+        << "; serving blocks " << chain.first_height << "-" << chain.top_height);
+    return chain;
+  }
+
+  /// Plays the part of the recorded peer(s) for the connected daemon
+  class replay_handler : public epee::levin::levin_commands_handler<replay_context>
+  {
+  public:
+    replay_handler(const recorded_chain& chain, replay_server& server, const boost::uuids::uuid& network_id, bool pace)
+      : m_chain{chain}, m_server{server}, m_network_id{network_id}, m_pace{pace}, m_last_activity{std::chrono::steady_clock::now()}
+    {
+      m_sync_data.current_height = m_chain.top_height + 1;
+      m_sync_data.cumulative_difficulty = m_chain.cumulative_difficulty;
+      m_sync_data.top_id = m_chain.hashes.back();
+      m_sync_data.top_version = m_chain.top_version;
+      m_sync_data.pruning_seed = 0;
+    }
+
+    int invoke(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, replay_context& context) override
+    {
+      activity();
+      switch (command)
+      {
+        case COMMAND_HANDSHAKE::ID:
+        {
+          COMMAND_HANDSHAKE::request req;
+          if (!epee::serialization::load_t_from_binary(req, in_buff))
+            return LEVIN_ERROR_FORMAT;
+          {
+            std::lock_guard lock{m_lock};
+            m_handshake_time = std::chrono::steady_clock::now();
+            m_start_height = req.payload_data.current_height;
+          }
+          MGINFO("Daemon connected at height " << req.payload_data.current_height << ", syncing to " << m_sync_data.current_height);
+          COMMAND_HANDSHAKE::response rsp;
+          rsp.node_data.network_id = m_network_id;
+          rsp.node_data.my_port = 0;
+          rsp.node_data.rpc_port = 0;
+          rsp.node_data.peer_id = crypto::rand<nodetool::peerid_type>();
+          rsp.payload_data = m_sync_data;
+          epee::serialization::store_t_to_binary(rsp, buff_out);
+          return 1;
+        }
+        case COMMAND_TIMED_SYNC::ID:
+        {
+          COMMAND_TIMED_SYNC::response rsp;
+          rsp.local_time = time(nullptr);
+          rsp.payload_data = m_sync_data;
+          epee::serialization::store_t_to_binary(rsp, buff_out);
+          return 1;
+        }
+        case nodetool::COMMAND_PING::ID:
+        {
+          nodetool::COMMAND_PING::response rsp;
+          rsp.status = PING_OK_RESPONSE_STATUS_TEXT;
+          rsp.peer_id = 0;
+          epee::serialization::store_t_to_binary(rsp, buff_out);
+          return 1;
+        }
+        case nodetool::COMMAND_REQUEST_SUPPORT_FLAGS::ID:
+        {
+          nodetool::COMMAND_REQUEST_SUPPORT_FLAGS::response rsp;
+          rsp.support_flags = P2P_SUPPORT_FLAGS;
+          epee::serialization::store_t_to_binary(rsp, buff_out);
+          return 1;
+        }
+      }
+      return LEVIN_ERROR_CONNECTION_HANDLER_NOT_DEFINED;
+    }
+
+    int notify(int command, const epee::span<const uint8_t> in_buff, replay_context& context) override
+    {
+      activity();
+      if (command == cryptonote::NOTIFY_REQUEST_CHAIN::ID)
+      {
+        cryptonote::NOTIFY_REQUEST_CHAIN::request req;
+        if (epee::serialization::load_t_from_binary(req, in_buff))
+          handle_request_chain(req, context);
+      }
+      else if (command == cryptonote::NOTIFY_REQUEST_GET_BLOCKS::ID)
+      {
+        cryptonote::NOTIFY_REQUEST_GET_BLOCKS::request req;
+        if (epee::serialization::load_t_from_binary(req, in_buff))
+          handle_request_get_blocks(req, context);
+      }
+      return 1;
+    }
+
+    void on_connection_close(replay_context& context) override
+    {
+      MGINFO("Daemon disconnected");
+    }
+
+    /// Waits until the daemon has synced the recorded chain (returns true) or has been idle for
+    /// `idle_timeout` (returns false).
+    bool wait(std::chrono::seconds idle_timeout)
+    {
+      std::unique_lock lock{m_lock};
+      while (!m_done)
+      {
+        if (m_cv.wait_for(lock, 1s, [this] { return m_done; }))
+          break;
+        if (std::chrono::steady_clock::now() - m_last_activity > idle_timeout)
+          return false;
+      }
+      return true;
+    }
+
+    void print_report(std::ostream& o)
+    {
+      std::lock_guard lock{m_lock};
+      const auto now = m_done_time.value_or(std::chrono::steady_clock::now());
+      if (!m_handshake_time)
+      {
+        o << "The daemon never connected\n";
+        return;
+      }
+      const seconds_f total = now - *m_handshake_time;
+      const uint64_t blocks = m_blocks_served;
+      o << std::fixed << std::setprecision(2)
+        << (m_done ? "Synced " : "Sync stalled after ") << blocks << " blocks from height " << m_start_height
+        << " in " << total.count() << "s: " << blocks / total.count() << " blocks/s, "
+        << m_bytes_served / total.count() / 1048576 << " MB/s (" << m_bytes_served / 1048576.f << " MB served)\n";
+      o << "  recorded session: " << seconds_f{m_chain.duration}.count() << "s" << (m_pace ? ", replayed with recorded round trip times" : "") << "\n";
+      if (m_first_blocks_request)
+        o << "  startup (handshake to first block request): " << seconds_f{*m_first_blocks_request - *m_handshake_time}.count() << "s\n";
+      print_stage(o, "chain requests", m_chain_requests, m_chain_gap.get());
+      print_stage(o, "block requests", m_blocks_requests, m_blocks_gap.get());
+      o << "  (gap = time from our response to the daemon's next request of that kind: download + verification + import)\n";
+    }
+
+  private:
+    static void print_stage(std::ostream& o, std::string_view name, uint64_t requests, const tools::latency_histogram::snapshot& gap)
+    {
+      o << "  " << name << ": " << requests;
+      if (gap.count)
+        o << ", gap mean " << gap.mean_us() / 1000.0 << "ms, p50 " << gap.quantile_us(0.5) / 1000.0
+          << "ms, p90 " << gap.quantile_us(0.9) / 1000.0 << "ms, max " << gap.max_us / 1000.0 << "ms";
+      o << "\n";
+    }
+
+    void activity()
+    {
+      std::lock_guard lock{m_lock};
+      m_last_activity = std::chrono::steady_clock::now();
+    }
+
+    void handle_request_chain(const cryptonote::NOTIFY_REQUEST_CHAIN::request& req, replay_context& context)
+    {
+      const auto now = std::chrono::steady_clock::now();
+      std::optional<std::chrono::microseconds> delay;
+      {
+        std::lock_guard lock{m_lock};
+        ++m_chain_requests;
+        if (m_last_chain_response)
+          m_chain_gap.add(now - *m_last_chain_response);
+        // Once the daemon asks for blocks after our top block, it has synced everything we have
+        if (!req.block_ids.empty() && req.block_ids.front() == m_chain.hashes.back() && !m_done)
+        {
+          m_done = true;
+          m_done_time = now;
+          m_cv.notify_all();
+        }
+        if (m_pace && !m_chain.chain_rtts.empty())
+          delay = m_chain.chain_rtts[(m_chain_requests - 1) % m_chain.chain_rtts.size()];
+      }
+
+      uint64_t start_height = 0;
+      bool found = false;
+      for (const auto& id : req.block_ids)
+      {
+        if (auto it = m_chain.heights.find(id); it != m_chain.heights.end())
+        {
+          start_height = it->second;
+          found = true;
+          break;
+        }
+      }
+      if (!found)
+      {
+        MERROR("Daemon's chain has no block in common with the recording");
+        return;
+      }
+
+      cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request rsp;
+      rsp.start_height = start_height;
+      rsp.total_height = m_chain.top_height + 1;
+      rsp.cumulative_difficulty = m_chain.cumulative_difficulty;
+      const uint64_t end = std::min<uint64_t>(m_chain.hashes.size(), start_height + BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT);
+      rsp.m_block_ids.assign(m_chain.hashes.begin() + start_height, m_chain.hashes.begin() + end);
+      send(cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::ID, epee::serialization::store_t_to_binary(rsp), context.m_connection_id, delay, m_last_chain_response);
+    }
+
+    void handle_request_get_blocks(const cryptonote::NOTIFY_REQUEST_GET_BLOCKS::request& req, replay_context& context)
+    {
+      const auto now = std::chrono::steady_clock::now();
+      std::optional<std::chrono::microseconds> delay;
+      {
+        std::lock_guard lock{m_lock};
+        ++m_blocks_requests;
+        if (!m_first_blocks_request)
+          m_first_blocks_request = now;
+        if (m_last_blocks_response)
+          m_blocks_gap.add(now - *m_last_blocks_response);
+        if (m_pace && !m_chain.blocks_rtts.empty())
+          delay = m_chain.blocks_rtts[(m_blocks_requests - 1) % m_chain.blocks_rtts.size()];
+      }
+
+      cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::request rsp;
+      rsp.current_blockchain_height = m_chain.top_height + 1;
+      size_t bytes = 0;
+      for (const auto& id : req.blocks)
+      {
+        auto it = m_chain.blocks.find(id);
+        if (it == m_chain.blocks.end())
+        {
+          rsp.missed_ids.push_back(id);
+          continue;
+        }
+        rsp.blocks.push_back(it->second);
+        bytes += it->second.block.size();
+        for (const auto& tx : it->second.txs)
+          bytes += tx.size();
+      }
+      {
+        std::lock_guard lock{m_lock};
+        m_blocks_served += rsp.blocks.size();
+        m_bytes_served += bytes;
+      }
+      send(cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::ID, epee::serialization::store_t_to_binary(rsp), context.m_connection_id, delay, m_last_blocks_response);
+    }
+
+    // Sends a notification now, or after `delay` when pacing; `sent` is updated with the send time.
+    void send(int command, std::string payload, const boost::uuids::uuid& connection_id,
+        std::optional<std::chrono::microseconds> delay, std::optional<std::chrono::steady_clock::time_point>& sent)
+    {
+      auto do_send = [this, command, payload = std::move(payload), connection_id, &sent] {
+        m_server.get_config_object().notify(command, epee::strspan<uint8_t>(payload), connection_id);
+        std::lock_guard lock{m_lock};
+        sent = std::chrono::steady_clock::now();
+      };
+      if (!delay)
+        return do_send();
+      auto timer = std::make_shared<boost::asio::steady_timer>(m_server.get_io_service(), *delay);
+      timer->async_wait([timer, do_send = std::move(do_send)](const boost::system::error_code& ec) {
+        if (!ec)
+          do_send();
+      });
+    }
+
+    const recorded_chain& m_chain;
+    replay_server& m_server;
+    const boost::uuids::uuid m_network_id;
+    const bool m_pace;
+    cryptonote::CORE_SYNC_DATA m_sync_data;
+
+    std::mutex m_lock;
+    std::condition_variable m_cv;
+    bool m_done = false;
+    std::chrono::steady_clock::time_point m_last_activity;
+    std::optional<std::chrono::steady_clock::time_point> m_handshake_time, m_first_blocks_request, m_done_time;
+    std::optional<std::chrono::steady_clock::time_point> m_last_chain_response, m_last_blocks_response;
+    uint64_t m_start_height = 0;
+    uint64_t m_chain_requests = 0, m_blocks_requests = 0, m_blocks_served = 0, m_bytes_served = 0;
+    tools::latency_histogram m_chain_gap, m_blocks_gap;
+  };
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+  mlog_configure(mlog_get_default_log_path("sync_replay.log"), true);
+
+  po::options_description desc("Allowed options");
+  command_line::add_arg(desc, command_line::arg_help);
+  command_line::add_arg(desc, arg_recording);
+  command_line::add_arg(desc, arg_bind_ip);
+  command_line::add_arg(desc, arg_port);
+  command_line::add_arg(desc, arg_pace);
+  command_line::add_arg(desc, arg_idle_timeout);
+  command_line::add_arg(desc, cryptonote::arg_testnet_on);
+  command_line::add_arg(desc, cryptonote::arg_devnet_on);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+  if (command_line::get_arg(vm, command_line::arg_help) || command_line::get_arg(vm, arg_recording).empty())
+  {
+    std::cout << "Usage: " << argv[0] << " --recording FILE [options]\n\n" << desc << "\n";
+    return 1;
+  }
+
+  const auto nettype =
+    command_line::get_arg(vm, cryptonote::arg_testnet_on) ? cryptonote::TESTNET :
+    command_line::get_arg(vm, cryptonote::arg_devnet_on) ? cryptonote::DEVNET :
+    cryptonote::MAINNET;
+
+  recorded_chain chain;
+  try {
+    chain = load_recording(fs::u8path(command_line::get_arg(vm, arg_recording)));
+  } catch (const std::exception& e) {
+    MERROR("Failed to load recording: " << e.what());
+    return 1;
+  }
+
+  replay_server server{epee::net_utils::e_connection_type_P2P};
+  if (!server.init_server(command_line::get_arg(vm, arg_port), command_line::get_arg(vm, arg_bind_ip)))
+  {
+    MERROR("Failed to listen on " << command_line::get_arg(vm, arg_bind_ip) << ":" << command_line::get_arg(vm, arg_port));
+    return 1;
+  }
+  auto* handler = new replay_handler{chain, server, cryptonote::get_config(nettype).NETWORK_ID, command_line::get_arg(vm, arg_pace)};
+  server.get_config_object().set_handler(handler, [](epee::levin::levin_commands_handler<replay_context>* h) { delete h; });
+  if (!server.run_server(2, false))
+    return 1;
+  MGINFO("Waiting for a daemon on " << command_line::get_arg(vm, arg_bind_ip) << ":" << command_line::get_arg(vm, arg_port)
+      << " (start it with --add-exclusive-node " << command_line::get_arg(vm, arg_bind_ip) << ":" << command_line::get_arg(vm, arg_port) << ")");
+
+  const bool synced = handler->wait(std::chrono::seconds{command_line::get_arg(vm, arg_idle_timeout)});
+  handler->print_report(std::cout);
+  server.send_stop_signal();
+  server.server_stop();
+  return synced ? 0 : 2;
+  CATCH_ENTRY_L0("main", 1);
+}
@@ -85,3 +85,43 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1(), std::chrono::steady_clock::now());
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, first_arrival_wins)
+{
+  cryptonote::block_queue bq;
+  std::vector<crypto::hash> hashes{crypto::rand<crypto::hash>(), crypto::rand<crypto::hash>()};
+  bq.add_blocks(100, 2, uuid1(), std::chrono::steady_clock::now());
+  bq.set_span_hashes(100, uuid1(), hashes);
+  ASSERT_TRUE(bq.set_speculative_fetch(100, uuid2()));
+  ASSERT_FALSE(bq.set_speculative_fetch(100, uuid2()));
+  ASSERT_TRUE(bq.has_speculative_fetch(101));
+
+  ASSERT_TRUE(bq.add_blocks(100, std::vector<cryptonote::block_complete_entry>(2), uuid2(), 1000.f, 500));
+  ASSERT_FALSE(bq.add_blocks(100, std::vector<cryptonote::block_complete_entry>(2), uuid1(), 100.f, 400));
+  ASSERT_EQ(bq.get_num_filled_spans(), 1);
+  ASSERT_EQ(bq.get_data_size(), 500);
+  ASSERT_EQ(bq.get_wasted_bytes(), 400);
+  ASSERT_EQ(bq.get_num_duplicate_spans(), 1);
+  ASSERT_TRUE(bq.have(hashes[0]));
+
+  uint64_t height;
+  std::vector<cryptonote::block_complete_entry> bcel;
+  boost::uuids::uuid connection_id;
+  ASSERT_TRUE(bq.get_next_span(height, bcel, connection_id));
+  ASSERT_EQ(height, 100);
+  ASSERT_EQ(connection_id, uuid2());
+}
+
+TEST(block_queue, speculative_fetch_cleared)
+{
+  cryptonote::block_queue bq;
+  bq.add_blocks(0, 10, uuid1(), std::chrono::steady_clock::now());
+  ASSERT_FALSE(bq.set_speculative_fetch(0, uuid1()));
+  ASSERT_TRUE(bq.set_speculative_fetch(0, uuid2()));
+  bq.flush_spans(uuid2());
+  ASSERT_FALSE(bq.has_speculative_fetch(0));
+  ASSERT_TRUE(bq.set_speculative_fetch(0, uuid2()));
+  bq.flush_stale_spans({uuid1()});
+  ASSERT_FALSE(bq.has_speculative_fetch(0));
+  ASSERT_EQ(bq.get_max_block_height(), 9);
+}
@@ -0,0 +1,192 @@
+#define IN_UNIT_TESTS
+
+#include <random>
+#include "gtest/gtest.h"
+#include "cryptonote_basic/difficulty.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/uptime_proof.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+using cryptonote::difficulty_window;
+using cryptonote::difficulty_calc_mode;
+
+namespace {
+
+constexpr size_t TARGET = 120;
+
+// Generates `n` blocks of timestamps and cumulative difficulties with a bit of noise
+void make_chain(size_t n, std::vector<uint64_t>& timestamps, std::vector<uint64_t>& cumulative_difficulties, uint64_t seed)
+{
+  std::mt19937_64 rng{seed};
+  std::uniform_int_distribution<int64_t> solvetime{-30, 400};
+  std::uniform_int_distribution<uint64_t> difficulty{1'000'000, 2'000'000};
+  uint64_t ts = 1'600'000'000, cd = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    ts += solvetime(rng);
+    cd += difficulty(rng);
+    timestamps.push_back(ts);
+    cumulative_difficulties.push_back(cd);
+  }
+}
+
+// Just enough of a db for difficulty calculations, with batches that can be aborted
+class TestDB : public cryptonote::BaseTestDB
+{
+public:
+  TestDB() { m_open = true; }
+
+  void add_block(const cryptonote::block& blk, size_t, uint64_t, const cryptonote::difficulty_type& cumulative_difficulty,
+      const uint64_t&, uint64_t, const crypto::hash&) override
+  {
+    push(blk.timestamp, cumulative_difficulty);
+  }
+  void push(uint64_t timestamp, cryptonote::difficulty_type cumulative_difficulty)
+  {
+    blocks.push_back({timestamp, cumulative_difficulty, ++generation});
+  }
+  void pop_block(cryptonote::block&, std::vector<cryptonote::transaction>&) override { blocks.pop_back(); }
+
+  bool batch_start(uint64_t, uint64_t) override { batch_height = blocks.size(); return true; }
+  void batch_abort() override { blocks.resize(batch_height); }
+
+  uint64_t height() const override { return blocks.size(); }
+  uint64_t get_block_timestamp(const uint64_t& h) const override { return blocks[h].timestamp; }
+  cryptonote::difficulty_type get_block_cumulative_difficulty(const uint64_t& h) const override { return blocks[h].cumulative_difficulty; }
+  crypto::hash get_block_hash_from_height(const uint64_t& h) const override
+  {
+    // Replacement blocks at the same height get a different hash
+    crypto::hash hash = crypto::null_hash;
+    reinterpret_cast<uint64_t*>(hash.data)[0] = h;
+    reinterpret_cast<uint64_t*>(hash.data)[1] = blocks[h].generation;
+    return hash;
+  }
+  crypto::hash top_block_hash(uint64_t* block_height = nullptr) const override
+  {
+    if (block_height)
+      *block_height = blocks.size() - 1;
+    return blocks.empty() ? crypto::null_hash : get_block_hash_from_height(blocks.size() - 1);
+  }
+
+private:
+  struct block_t
+  {
+    uint64_t timestamp;
+    cryptonote::difficulty_type cumulative_difficulty;
+    uint64_t generation;
+  };
+  std::vector<block_t> blocks;
+  uint64_t generation = 0;
+  uint64_t batch_height = 0;
+};
+
+uint64_t direct(const std::vector<uint64_t>& ts, const std::vector<uint64_t>& cd, size_t end, size_t block_count)
+{
+  size_t begin = std::max<size_t>(end - std::min(end, block_count), 1);
+  return cryptonote::next_difficulty_v2(
+      {ts.begin() + begin, ts.begin() + end}, {cd.begin() + begin, cd.begin() + end}, TARGET, difficulty_calc_mode::normal);
+}
+
+}
+
+TEST(difficulty_window, push_pop)
+{
+  difficulty_window w;
+  w.reset(5);
+  ASSERT_TRUE(w.empty());
+  ASSERT_EQ(w.height(), 5);
+  for (uint64_t i = 0; i < 10; i++)
+    w.push_back(i, i);
+  ASSERT_EQ(w.height(), 15);
+  ASSERT_EQ(w.start_height(), 5);
+  w.push_front(0, 0);
+  ASSERT_EQ(w.start_height(), 4);
+  ASSERT_EQ(w.size(), 11);
+
+  w.truncate(20); // no-op
+  ASSERT_EQ(w.height(), 15);
+  w.truncate(12);
+  ASSERT_EQ(w.height(), 12);
+  ASSERT_EQ(w.size(), 8);
+  w.trim(3);
+  ASSERT_EQ(w.start_height(), 9);
+  ASSERT_EQ(w.height(), 12);
+  w.truncate(2);
+  ASSERT_TRUE(w.empty());
+  ASSERT_EQ(w.height(), 2);
+}
+
+TEST(difficulty_window, matches_next_difficulty_v2)
+{
+  std::vector<uint64_t> ts, cd;
+  make_chain(300, ts, cd, 42);
+  size_t const block_count = DIFFICULTY_BLOCKS_COUNT(true);
+
+  // Grow a window a block at a time, keeping it trimmed like the main chain window
+  difficulty_window w;
+  w.reset(1);
+  for (size_t height = 1; height < ts.size(); height++)
+  {
+    ASSERT_EQ(w.height(), height);
+    ASSERT_EQ(w.next_difficulty(block_count, TARGET, difficulty_calc_mode::normal), direct(ts, cd, height, block_count));
+    w.push_back(ts[height], cd[height]);
+    w.trim(block_count + difficulty_window::SPARE_BLOCKS);
+  }
+
+  // Fork it as an alt chain would: copy, cut back, and push different blocks
+  std::vector<uint64_t> alt_ts{ts.begin(), ts.begin() + 290}, alt_cd{cd.begin(), cd.begin() + 290};
+  make_chain(20, alt_ts, alt_cd, 7);
+  for (size_t i = 290; i < alt_ts.size(); i++)
+    alt_cd[i] += cd[289]; // keep the alt chain's cumulative difficulty increasing
+  difficulty_window alt = w;
+  alt.truncate(290);
+  for (size_t height = 290; height < alt_ts.size(); height++)
+  {
+    ASSERT_EQ(alt.next_difficulty(block_count, TARGET, difficulty_calc_mode::normal), direct(alt_ts, alt_cd, height, block_count));
+    alt.push_back(alt_ts[height], alt_cd[height]);
+  }
+  // ... without affecting the original
+  ASSERT_EQ(w.height(), ts.size());
+  ASSERT_EQ(w.next_difficulty(block_count, TARGET, difficulty_calc_mode::normal), direct(ts, cd, ts.size(), block_count));
+}
+
+TEST(difficulty_window, dropped_on_batch_abort)
+{
+  blockchain_objects_t bc_objects = {};
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{cryptonote::network_version_7, 0}, {cryptonote::network_version_16_pulse, 1}};
+  const cryptonote::test_options test_options{hard_forks, 5000};
+  cryptonote::Blockchain& bc = bc_objects.m_blockchain;
+  ASSERT_TRUE(bc.init(new TestDB(), nullptr /*ons_db*/, cryptonote::FAKECHAIN, true, &test_options, 0));
+  auto& db = static_cast<TestDB&>(bc.get_db());
+
+  std::vector<uint64_t> ts, cd, alt_ts, alt_cd;
+  make_chain(130, ts, cd, 42);
+  make_chain(130, alt_ts, alt_cd, 7);
+  for (size_t i = 1; i < 100; i++)
+    db.push(ts[i], cd[i]);
+  bc.get_difficulty_for_next_block(false);
+
+  // A batch of blocks gets loaded into the difficulty window, then aborted
+  db.batch_start(0, 0);
+  for (size_t i = 100; i < 110; i++)
+    db.push(ts[i], cd[i]);
+  bc.get_difficulty_for_next_block(false);
+  bc_objects.m_mempool.lock();
+  bc.lock();
+  bc.m_batch_success = false;
+  ASSERT_TRUE(bc.cleanup_handle_incoming_blocks());
+  ASSERT_EQ(db.height(), 100);
+
+  // Replacement blocks that don't touch the window (like Pulse blocks) take the chain past the
+  // aborted ones
+  for (size_t i = 100; i < 115; i++)
+    db.push(alt_ts[i], cd[99] + alt_cd[i]);
+  auto diff = bc.get_difficulty_for_next_block(false);
+
+  bc.m_cache.m_difficulty_window.reset(0);
+  bc.m_cache.m_difficulty_for_next_block_top_hash = crypto::null_hash;
+  ASSERT_EQ(diff, bc.get_difficulty_for_next_block(false));
+}
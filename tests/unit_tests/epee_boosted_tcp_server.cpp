@@ -31,6 +31,7 @@
 #include <chrono>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 #include "gtest/gtest.h"
 
@@ -81,6 +82,38 @@ namespace
   };
 
   typedef epee::net_utils::boosted_tcp_server<test_protocol_handler> test_tcp_server;
+
+  // Hands the server side of the first accepted connection to the test
+  struct send_test_protocol_handler_config
+  {
+    std::mutex mutex;
+    std::condition_variable cv;
+    epee::net_utils::i_service_endpoint* endpoint = nullptr;
+  };
+
+  struct send_test_protocol_handler : test_protocol_handler
+  {
+    typedef send_test_protocol_handler_config config_type;
+
+    send_test_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context)
+      : test_protocol_handler{psnd_hndlr, m_dummy_config, conn_context}, m_endpoint{psnd_hndlr}, m_config{config}
+    {
+    }
+
+    void after_init_connection()
+    {
+      std::lock_guard lock{m_config.mutex};
+      if (!m_config.endpoint)
+        m_config.endpoint = m_endpoint;
+      m_config.cv.notify_all();
+    }
+
+    test_protocol_handler_config m_dummy_config;
+    epee::net_utils::i_service_endpoint* m_endpoint;
+    config_type& m_config;
+  };
+
+  typedef epee::net_utils::boosted_tcp_server<send_test_protocol_handler> send_test_tcp_server;
 }
 
 TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
@@ -130,3 +163,74 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.server_stop());
   ASSERT_TRUE(srv.deinit_server());
 }
+
+TEST(boosted_tcp_server, high_priority_send_does_not_split_partly_written_message)
+{
+  // P2P rather than RPC so that the upload limit applies
+  send_test_tcp_server srv(epee::net_utils::e_connection_type_P2P);
+  ASSERT_TRUE(srv.init_server(test_server_port + 1, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+  auto& config = srv.get_config_object();
+
+  // 1MB/s: after the first gathered write (1MB) the rest of the message gets deferred by ~1s
+  epee::net_utils::connection_basic::set_rate_up_limit(1024);
+
+  boost::asio::io_context io;
+  boost::asio::ip::tcp::socket sock{io};
+  sock.connect({boost::asio::ip::make_address(test_server_host), test_server_port + 1});
+
+  epee::net_utils::i_service_endpoint* endpoint;
+  {
+    std::unique_lock lock{config.mutex};
+    ASSERT_TRUE(config.cv.wait_for(lock, 5s, [&] { return config.endpoint != nullptr; }));
+    endpoint = config.endpoint;
+  }
+
+  const std::string bulk(1536 * 1024, 'b'), urgent(100, 'u');
+  std::string received;
+  std::mutex received_mutex;
+  std::thread reader{[&] {
+    char buf[65536];
+    boost::system::error_code ec;
+    while (true)
+    {
+      size_t n = sock.read_some(boost::asio::buffer(buf), ec);
+      if (ec)
+        break;
+      std::lock_guard lock{received_mutex};
+      received.append(buf, n);
+      if (received.size() >= bulk.size() + urgent.size())
+        break;
+    }
+  }};
+
+  // Gets split into 48 chunks, of which the first write takes 32
+  ASSERT_TRUE(endpoint->do_send(epee::shared_sv{std::string{bulk}}));
+  for (int i = 0; i < 500; i++)
+  {
+    std::this_thread::sleep_for(10ms);
+    std::lock_guard lock{received_mutex};
+    if (received.size() >= 1024 * 1024)
+      break;
+  }
+  // Give handle_write time to pop the written chunks; the rest of the message is held back for
+  // the upload limit
+  std::this_thread::sleep_for(100ms);
+  {
+    std::lock_guard lock{received_mutex};
+    ASSERT_LT(received.size(), bulk.size());
+  }
+
+  ASSERT_TRUE(endpoint->do_send_prioritized(epee::shared_sv{std::string{urgent}}, epee::net_utils::send_priority::high));
+  reader.join();
+  epee::net_utils::connection_basic::set_rate_up_limit(0);
+
+  ASSERT_EQ(bulk.size() + urgent.size(), received.size());
+  EXPECT_EQ(bulk.size(), received.find('u'));
+  EXPECT_TRUE(received == bulk + urgent);
+
+  sock.close();
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.server_stop());
+  ASSERT_TRUE(srv.deinit_server());
+}
@@ -28,6 +28,8 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <map>
+#include <optional>
 #include <boost/thread/thread.hpp>
 
 #include "gtest/gtest.h"
@@ -91,6 +93,12 @@ namespace
       //std::cout << "test_levin_commands_handler::on_connection_close()" << std::endl;
     }
 
+    virtual void on_levin_message(int command, size_t bytes, bool outgoing, test_levin_connection_context& context)
+    {
+      std::unique_lock lock{m_mutex};
+      (outgoing ? m_bytes_out : m_bytes_in)[command] += bytes;
+    }
+
     size_t invoke_counter() const { return m_invoke_counter.get(); }
     size_t notify_counter() const { return m_notify_counter.get(); }
     size_t callback_counter() const { return m_callback_counter.get(); }
@@ -105,6 +113,8 @@ namespace
 
     int last_command() const { return m_last_command; }
     const std::string& last_in_buf() const { return m_last_in_buf; }
+    size_t bytes_in(int command) { std::unique_lock lock{m_mutex}; return m_bytes_in[command]; }
+    size_t bytes_out(int command) { std::unique_lock lock{m_mutex}; return m_bytes_out[command]; }
 
   private:
     unit_test::call_counter m_invoke_counter;
@@ -120,6 +130,7 @@ namespace
 
     int m_last_command;
     std::string m_last_in_buf;
+    std::map<int, size_t> m_bytes_in, m_bytes_out;
   };
 
   class test_connection : public epee::net_utils::i_service_endpoint
@@ -147,6 +158,12 @@ namespace
       return m_send_return;
     }
 
+    virtual bool do_send_prioritized(epee::shared_sv message, epee::net_utils::send_priority priority)
+    {
+      m_last_send_priority = priority;
+      return do_send(std::move(message));
+    }
+
     virtual bool close()                              { /*std::cout << "test_connection::close()" << std::endl; */return true; }
     virtual bool send_done()                          { /*std::cout << "test_connection::send_done()" << std::endl; */return true; }
     virtual bool call_run_once_service_io()           { std::cout << "test_connection::call_run_once_service_io()" << std::endl; return true; }
@@ -163,6 +180,8 @@ namespace
     bool send_return() const { return m_send_return; }
     void send_return(bool v) { m_send_return = v; }
 
+    std::optional<epee::net_utils::send_priority> last_send_priority() const { return m_last_send_priority; }
+
   public:
     test_levin_protocol_handler m_protocol_handler;
 
@@ -176,6 +195,7 @@ namespace
     std::string m_last_send_data;
 
     bool m_send_return;
+    std::optional<epee::net_utils::send_priority> m_last_send_priority;
   };
 
   class async_protocol_handler_test : public ::testing::Test
@@ -370,6 +390,8 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   std::string out_data = send_data.substr(sizeof(resp_head));
 
   // Check sent response
+  ASSERT_EQ(buf.size(), m_commands_handler.bytes_in(expected_command));
+  ASSERT_EQ(send_data.size(), m_commands_handler.bytes_out(expected_command));
   ASSERT_EQ(expected_out_data, out_data);
   ASSERT_EQ(LEVIN_SIGNATURE, SWAP64LE(resp_head.m_signature));
   ASSERT_EQ(expected_command, SWAP32LE(resp_head.m_command));
@@ -412,6 +434,42 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_TRUE(conn->last_send_data().empty());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_sends_with_command_priority)
+{
+  const int priority_command = 8233451;
+  const int other_command = 8233452;
+  m_handler_config.m_priority_commands = {priority_command};
+  m_commands_handler.invoke_out_buf(std::string(64, 'p'));
+
+  test_connection_ptr conn = create_connection();
+  const std::string out_data(32, 'n');
+  const auto out_span = epee::strspan<uint8_t>(out_data);
+
+  // Plain notifications may be coalesced; priority ones jump the queue
+  ASSERT_EQ(1, conn->m_protocol_handler.notify(other_command, out_span));
+  ASSERT_EQ(epee::net_utils::send_priority::coalesce, conn->last_send_priority());
+  ASSERT_EQ(1, conn->m_protocol_handler.notify(priority_command, out_span));
+  ASSERT_EQ(epee::net_utils::send_priority::high, conn->last_send_priority());
+
+  // Responses to priority commands are sent with priority too
+  std::string in_data(16, 'q');
+  epee::levin::bucket_head2 req_head;
+  req_head.m_signature = SWAP64LE(LEVIN_SIGNATURE);
+  req_head.m_cb = SWAP64LE(in_data.size());
+  req_head.m_have_to_return_data = true;
+  req_head.m_command = SWAP32LE(priority_command);
+  req_head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST);
+  req_head.m_protocol_version = SWAP32LE(LEVIN_PROTOCOL_VER_1);
+  std::string buf(reinterpret_cast<const char*>(&req_head), sizeof(req_head));
+  buf += in_data;
+
+  conn->reset_last_send_data();
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(buf.data(), buf.size()));
+  ASSERT_EQ(epee::net_utils::send_priority::high, conn->last_send_priority());
+  ASSERT_EQ(sizeof(req_head) + 64, conn->last_send_data().size());
+  ASSERT_EQ(std::string(64, 'p'), conn->last_send_data().substr(sizeof(req_head)));
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_qued_callback)
 {
   test_connection_ptr conn = create_connection();
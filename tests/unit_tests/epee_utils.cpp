@@ -51,6 +51,8 @@
 #include "epee/net/net_utils_base.h"
 #include "epee/net/local_ip.h"
 #include "epee/net/buffer.h"
+#include "epee/net/connection_basic.hpp"
+#include "epee/net/token_bucket.h"
 #include "p2p/net_peerlist_boost_serialization.h"
 #include "epee/span.h"
 #include "epee/string_tools.h"
@@ -856,6 +858,53 @@ TEST(net_buffer, move)
   ASSERT_TRUE(!memcmp(span.data() + 1, std::string(4000, '0').c_str(), 4000));
 }
 
+TEST(token_bucket, basic)
+{
+  using namespace std::literals;
+  epee::net_utils::token_bucket bucket;
+
+  // Unlimited by default
+  EXPECT_EQ(bucket.consume(1'000'000'000), 0s);
+
+  // A fresh bucket starts empty, so any transfer goes into debt
+  bucket.set_rate(1000);
+  EXPECT_EQ(bucket.rate(), 1000u);
+  auto delay = bucket.consume(500);
+  EXPECT_GT(delay, 400ms);
+  EXPECT_LE(delay, 500ms);
+  EXPECT_GT(bucket.delay(), 0s);
+  EXPECT_LE(bucket.delay(), delay);
+
+  // Further transfers add to the debt
+  EXPECT_GT(bucket.consume(1000), 1400ms);
+
+  bucket.set_rate(0);
+  EXPECT_EQ(bucket.consume(1000), 0s);
+  EXPECT_EQ(bucket.delay(), 0s);
+}
+
+TEST(recv_buffer_pool, reuse)
+{
+  using epee::net_utils::recv_buffer_pool;
+
+  std::vector<char> buf = recv_buffer_pool::get(32 * 1024);
+  ASSERT_EQ(buf.size(), 32u * 1024);
+  const char* data = buf.data();
+  recv_buffer_pool::put(std::move(buf));
+
+  // Same size comes back out of the pool; other sizes don't
+  std::vector<char> other = recv_buffer_pool::get(64 * 1024);
+  EXPECT_EQ(other.size(), 64u * 1024);
+  EXPECT_NE(other.data(), data);
+  std::vector<char> again = recv_buffer_pool::get(32 * 1024);
+  EXPECT_EQ(again.data(), data);
+
+  // Buffers of unexpected sizes are just dropped
+  recv_buffer_pool::put(std::vector<char>(1000));
+  recv_buffer_pool::put(std::move(other));
+  recv_buffer_pool::put(std::move(again));
+}
+
 TEST(parsing, isspace)
 {
   ASSERT_FALSE(epee::misc_utils::parse::isspace(0));
@@ -0,0 +1,59 @@
+#include <chrono>
+#include "gtest/gtest.h"
+#include "common/latency_histogram.h"
+
+using namespace std::literals;
+
+TEST(latency_histogram, buckets)
+{
+  using h = tools::latency_histogram;
+  ASSERT_EQ(h::bucket_for(0), 0);
+  ASSERT_EQ(h::bucket_for(1), 1);
+  ASSERT_EQ(h::bucket_for(2), 2);
+  ASSERT_EQ(h::bucket_for(3), 2);
+  ASSERT_EQ(h::bucket_for(4), 3);
+  ASSERT_EQ(h::bucket_for(1023), 10);
+  ASSERT_EQ(h::bucket_for(1024), 11);
+  ASSERT_EQ(h::bucket_for(uint64_t{1} << 40), h::BUCKETS - 1);
+  for (size_t b = 1; b < h::BUCKETS - 1; b++)
+  {
+    ASSERT_EQ(h::bucket_for(h::bucket_upper_us(b) - 1), b);
+    ASSERT_EQ(h::bucket_for(h::bucket_upper_us(b)), b + 1);
+  }
+}
+
+TEST(latency_histogram, snapshot)
+{
+  tools::latency_histogram h;
+  auto empty = h.get();
+  ASSERT_EQ(empty.count, 0);
+  ASSERT_EQ(empty.quantile_us(0.5), 0);
+  ASSERT_EQ(empty.mean_us(), 0);
+
+  for (int i = 0; i < 90; i++)
+    h.add(100us);
+  for (int i = 0; i < 10; i++)
+    h.add(5ms);
+
+  auto s = h.get();
+  ASSERT_EQ(s.count, 100);
+  ASSERT_EQ(s.sum_us, 90*100 + 10*5000);
+  ASSERT_EQ(s.max_us, 5000);
+  ASSERT_EQ(s.mean_us(), 590);
+  // 100µs lands in [64, 128)
+  ASSERT_EQ(s.quantile_us(0.5), 128);
+  ASSERT_EQ(s.quantile_us(0.9), 128);
+  // 5000µs is in [4096, 8192), but the estimate is capped at the largest value seen
+  ASSERT_EQ(s.quantile_us(0.99), 5000);
+  ASSERT_EQ(s.quantile_us(1), 5000);
+
+  auto twice = s;
+  twice += s;
+  ASSERT_EQ(twice.count, 200);
+  ASSERT_EQ(twice.max_us, 5000);
+  ASSERT_EQ(twice.quantile_us(0.5), 128);
+
+  h.reset();
+  ASSERT_EQ(h.get().count, 0);
+  ASSERT_EQ(h.get().max_us, 0);
+}
@@ -659,3 +659,54 @@ TEST_F(levin_notify, noise)
         }
     }
 }
+
+TEST_F(levin_notify, noise_batches_txs)
+{
+    for (unsigned count = 0; count < 10; ++count)
+        add_connection(count % 2 == 0);
+
+    std::vector<cryptonote::blobdata> txs(1);
+    txs[0].resize(300, 'z');
+    std::vector<cryptonote::blobdata> more_txs(2);
+    more_txs[0].resize(200, 'b');
+    more_txs[1].resize(400, 'a');
+
+    const boost::uuids::uuid incoming_id = random_generator_();
+    cryptonote::levin::notify notifier = make_notifier(2048, false);
+    ASSERT_LT(0u, io_service_.poll());
+    EXPECT_TRUE(notifier.get_status().connections_filled);
+
+    // Both sends land in the same noise interval, so they go out as one message per channel
+    EXPECT_TRUE(notifier.send_txs(txs, incoming_id, false));
+    EXPECT_TRUE(notifier.send_txs(more_txs, incoming_id, false));
+    notifier.run_stems();
+    io_service_.reset();
+    ASSERT_LT(0u, io_service_.poll());
+    {
+        std::size_t sent = 0;
+        for (auto& context : contexts_)
+            sent += context.process_send_queue();
+
+        std::vector<cryptonote::blobdata> expected{more_txs[1], more_txs[0], txs[0]};
+        ASSERT_EQ(2u, sent);
+        while (sent--)
+        {
+            auto notification = receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>().second;
+            EXPECT_EQ(expected, notification.txs);
+            EXPECT_TRUE(notification._.empty());
+        }
+    }
+
+    // Nothing is left queued: the next interval is plain noise
+    notifier.run_stems();
+    io_service_.reset();
+    ASSERT_LT(0u, io_service_.poll());
+    {
+        std::size_t sent = 0;
+        for (auto& context : contexts_)
+            sent += context.process_send_queue();
+
+        EXPECT_EQ(2u, sent);
+        EXPECT_EQ(0u, receiver_.notified_size());
+    }
+}
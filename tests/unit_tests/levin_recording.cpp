@@ -0,0 +1,64 @@
+#include <boost/uuid/uuid.hpp>
+#include "gtest/gtest.h"
+#include "p2p/levin_recording.h"
+#include "random_path.h"
+
+using namespace std::literals;
+
+TEST(levin_recording, round_trip)
+{
+  const fs::path path = random_tmp_file();
+  boost::uuids::uuid a{}, b{};
+  b.data[0] = 1;
+  {
+    nodetool::levin_recorder recorder{path};
+    recorder.record(a, 2003, true, "ignored"sv);
+    recorder.record(b, 1001, false);
+    recorder.record(a, 2004, false, "blocks\0here"sv);
+    recorder.flush();
+  }
+
+  nodetool::levin_recording_reader reader{path};
+  nodetool::levin_record rec;
+  ASSERT_TRUE(reader.next(rec));
+  EXPECT_EQ(rec.connection, 0);
+  EXPECT_TRUE(rec.outgoing);
+  EXPECT_EQ(rec.command, 2003);
+  EXPECT_EQ(rec.payload, ""); // outgoing payloads aren't kept
+  const auto first = rec.time;
+
+  ASSERT_TRUE(reader.next(rec));
+  EXPECT_EQ(rec.connection, 1);
+  EXPECT_FALSE(rec.outgoing);
+  EXPECT_EQ(rec.command, 1001);
+  EXPECT_GE(rec.time, first);
+
+  ASSERT_TRUE(reader.next(rec));
+  EXPECT_EQ(rec.connection, 0);
+  EXPECT_EQ(rec.command, 2004);
+  EXPECT_EQ(rec.payload, "blocks\0here"sv);
+
+  EXPECT_FALSE(reader.next(rec));
+  fs::remove(path);
+}
+
+TEST(levin_recording, bad_files)
+{
+  const fs::path path = random_tmp_file();
+  EXPECT_THROW(nodetool::levin_recording_reader{path}, std::runtime_error);
+  {
+    fs::ofstream out{path, std::ios::binary};
+    out << "not a recording";
+  }
+  EXPECT_THROW(nodetool::levin_recording_reader{path}, std::runtime_error);
+
+  {
+    nodetool::levin_recorder recorder{path};
+    recorder.record({}, 2004, false, "payload"sv);
+  }
+  fs::resize_file(path, fs::file_size(path) - 1);
+  nodetool::levin_recording_reader reader{path};
+  nodetool::levin_record rec;
+  EXPECT_THROW(reader.next(rec), std::runtime_error);
+  fs::remove(path);
+}
@@ -31,6 +31,7 @@
 #include "gtest/gtest.h"
 #include "cryptonote_core/masternode_list.h"
 #include "cryptonote_core/masternode_voting.h"
+#include "cryptonote_core/masternode_obligations.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/verification_context.h"
@@ -552,3 +553,105 @@ TEST(masternodes, masternode_get_locked_key_image_unlock_height)
     ASSERT_EQ(unlock_height, expected);
   }
 }
+
+TEST(masternodes, obligations_votes_match_serial_tests)
+{
+  using namespace std::literals;
+  using masternodes::new_state;
+  const auto& netconf = cryptonote::get_config(cryptonote::FAKECHAIN);
+  const uint8_t hf_version = cryptonote::network_version_18;
+  const uint64_t obligations_height = 9990, latest_height = 10000;
+  const uint16_t index_in_group = 3;
+
+  masternodes::masternode_keys keys{};
+  crypto::generate_keys(keys.pub, keys.key);
+
+  // One worker for each way the tests can come out, with the state change we expect to vote for
+  masternodes::participation_history<masternodes::participation_entry> missed_pulses{};
+  for (size_t i = 0; i < masternodes::QUORUM_VOTE_CHECK_COUNT; i++)
+  {
+    masternodes::participation_entry entry{};
+    entry.is_pulse = true;
+    entry.voted = false;
+    missed_pulses.add(entry);
+  }
+
+  struct variant { masternodes::masternode_info info; masternodes::obligations_snapshot snapshot; std::optional<new_state> expected; };
+  std::vector<variant> variants;
+  auto add = [&](int64_t active_since, uint64_t decommission_height, int64_t credit, std::optional<new_state> expected, auto&& change) {
+    auto& v = variants.emplace_back();
+    v.info.total_contributed = v.info.staking_requirement = 1;
+    v.info.active_since_height = active_since;
+    v.info.last_decommission_height = decommission_height;
+    v.info.recommission_credit = credit;
+    change(v.snapshot);
+    v.expected = expected;
+  };
+  auto passing = [](auto&) {};
+  auto stale_proof = [&](auto& s) { s.time_since_last_uptime_proof = std::chrono::duration_cast<std::chrono::seconds>(netconf.UPTIME_PROOF_VALIDITY + 1h); };
+  add(1, 0, masternodes::DECOMMISSION_MAX_CREDIT, std::nullopt, passing);
+  add(1, 0, masternodes::DECOMMISSION_MAX_CREDIT, new_state::ip_change_penalty, [](auto& s) { s.multiple_ips = true; });
+  add(1, 0, masternodes::DECOMMISSION_MAX_CREDIT, new_state::decommission, stale_proof);
+  add(1, 0, masternodes::DECOMMISSION_MAX_CREDIT, new_state::decommission, [&](auto& s) { s.pulse_participation = missed_pulses; });
+  add(latest_height, 0, 0, new_state::deregister, stale_proof);
+  add(-1, latest_height - 10, masternodes::DECOMMISSION_MAX_CREDIT, new_state::recommission, passing);
+  add(-1, latest_height - 10, masternodes::DECOMMISSION_MAX_CREDIT, std::nullopt, stale_proof);
+  add(-int64_t(latest_height - 10), latest_height - 10, 0, new_state::deregister, stale_proof);
+
+  // Enough workers that the parallel path really does spread them over the threadpool
+  std::vector<masternodes::obligations_worker> workers;
+  for (size_t i = 0; i < 10 * variants.size(); i++)
+  {
+    const auto& v = variants[i % variants.size()];
+    auto& worker = workers.emplace_back();
+    worker.node_index = i;
+    crypto::secret_key sec;
+    crypto::generate_keys(worker.pubkey, sec);
+    worker.info = &v.info;
+    worker.snapshot = v.snapshot;
+  }
+
+  auto serial = workers;
+  for (auto& worker : serial)
+  {
+    // What check_masternode would tell us about this worker, given the same proof data
+    masternodes::obligations_log log;
+    auto results = masternodes::check_obligations(netconf, hf_version, worker.pubkey, *worker.info, worker.snapshot, log);
+    masternodes::vote_on_obligations(worker, netconf, hf_version, obligations_height, latest_height, index_in_group, keys);
+    ASSERT_EQ(worker.good, results.passed() && results.single_ip && !worker.info->is_decommissioned());
+  }
+  masternodes::vote_on_obligations(workers, netconf, hf_version, obligations_height, latest_height, index_in_group, keys);
+
+  masternodes::quorum quorum;
+  quorum.validators.resize(index_in_group + 1);
+  quorum.validators[index_in_group] = keys.pub;
+  for (const auto& worker : workers)
+    quorum.workers.push_back(worker.pubkey);
+
+  for (size_t i = 0; i < workers.size(); i++)
+  {
+    SCOPED_TRACE("worker " + std::to_string(i));
+    const auto& expected = variants[i % variants.size()].expected;
+    const auto& w = workers[i];
+    const auto& s = serial[i];
+    ASSERT_EQ(w.good, s.good);
+    ASSERT_EQ(w.log.lines, s.log.lines);
+    ASSERT_EQ(w.vote.has_value(), expected.has_value());
+    ASSERT_EQ(s.vote.has_value(), expected.has_value());
+    if (!expected)
+      continue;
+
+    // The signatures are randomized, so compare what was voted for and check that both are valid
+    for (const auto* vote : {&*w.vote, &*s.vote})
+    {
+      EXPECT_EQ(vote->type, masternodes::quorum_type::obligations);
+      EXPECT_EQ(vote->block_height, obligations_height);
+      EXPECT_EQ(vote->index_in_group, index_in_group);
+      EXPECT_EQ(vote->state_change.worker_index, i);
+      EXPECT_EQ(vote->state_change.state, *expected);
+      cryptonote::vote_verification_context vvc{};
+      EXPECT_TRUE(masternodes::verify_vote_signature(hf_version, *vote, vvc, quorum));
+    }
+    EXPECT_EQ(w.vote->state_change.reason, s.vote->state_change.reason);
+  }
+}
@@ -31,6 +31,7 @@
 #include "gtest/gtest.h"
 #include "cryptonote_core/masternode_swarm.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "common/random.h"
 
 #include <functional>
 #include <iterator>
@@ -626,3 +627,151 @@ TEST(swarm_to_snodes, deterministic_swarm_ids)
   EXPECT_EQ(ids[5046], 18442592317803069438ULL);
   EXPECT_EQ(ids[5047], 18445442251942264830ULL);
 }
+
+// The swarm rebalancing as it was before calc_swarm_changes was made incremental, built from the
+// original (unit test only) helpers; calc_swarm_changes must keep producing exactly its results.
+static void reference_create_new_swarm_from_excess(swarm_snode_map_t& swarm_to_snodes, std::mt19937_64& mt)
+{
+  if (std::any_of(swarm_to_snodes.begin(), swarm_to_snodes.end(), [](auto& pair) { return pair.second.size() < MIN_SWARM_SIZE; }))
+    return;
+
+  std::vector<excess_pool_snode> pool_snodes;
+  while (calc_excess(swarm_to_snodes) >= calc_threshold(swarm_to_snodes))
+  {
+    std::vector<crypto::public_key> new_swarm_snodes;
+    while (new_swarm_snodes.size() < NEW_SWARM_SIZE)
+    {
+      size_t excess;
+      get_excess_pool(EXCESS_BASE, swarm_to_snodes, pool_snodes, excess);
+      if (pool_snodes.empty())
+        return;
+      const auto& random_excess_snode = pick_from_excess_pool(pool_snodes, mt);
+      new_swarm_snodes.push_back(random_excess_snode.public_key);
+      remove_excess_snode_from_swarm(random_excess_snode, swarm_to_snodes);
+    }
+    const auto new_swarm_id = get_new_swarm_id(swarm_to_snodes);
+    swarm_to_snodes.emplace(new_swarm_id, std::move(new_swarm_snodes));
+  }
+}
+
+static void reference_assign_snodes(const std::vector<crypto::public_key>& snode_pubkeys, swarm_snode_map_t& swarm_to_snodes, std::mt19937_64& mt, size_t percentile)
+{
+  std::vector<swarm_size> sorted_swarm_sizes;
+  for (const auto& sn_pk : snode_pubkeys)
+  {
+    calc_swarm_sizes(swarm_to_snodes, sorted_swarm_sizes);
+    const size_t percentile_index = percentile * (sorted_swarm_sizes.size() - 1) / 100;
+    const size_t percentile_value = sorted_swarm_sizes.at(percentile_index).size;
+    size_t upper_index = sorted_swarm_sizes.size() - 1;
+    for (size_t i = percentile_index; i < sorted_swarm_sizes.size(); ++i)
+    {
+      if (sorted_swarm_sizes[i].size > percentile_value)
+      {
+        upper_index = i - 1;
+        break;
+      }
+    }
+    const size_t random_idx = tools::uniform_distribution_portable(mt, upper_index + 1);
+    swarm_to_snodes.at(sorted_swarm_sizes[random_idx].swarm_id).push_back(sn_pk);
+    reference_create_new_swarm_from_excess(swarm_to_snodes, mt);
+  }
+}
+
+static void reference_calc_swarm_changes(swarm_snode_map_t& swarm_to_snodes, uint64_t seed)
+{
+  if (swarm_to_snodes.empty())
+    return;
+
+  std::mt19937_64 mt(seed);
+  std::vector<crypto::public_key> unassigned_snodes;
+  if (auto it = swarm_to_snodes.find(UNASSIGNED_SWARM_ID); it != swarm_to_snodes.end())
+  {
+    unassigned_snodes = it->second;
+    swarm_to_snodes.erase(it);
+  }
+  if (swarm_to_snodes.empty())
+    swarm_to_snodes.insert({get_new_swarm_id({}), {}});
+
+  reference_assign_snodes(unassigned_snodes, swarm_to_snodes, mt, FILL_SWARM_LOWER_PERCENTILE);
+
+  std::vector<swarm_size> sorted_swarm_sizes;
+  calc_swarm_sizes(swarm_to_snodes, sorted_swarm_sizes);
+  for (const auto& swarm : sorted_swarm_sizes)
+  {
+    if (swarm.size >= MIN_SWARM_SIZE)
+      break;
+    auto& poor_swarm_snodes = swarm_to_snodes.at(swarm.swarm_id);
+    bool insufficient_excess = false;
+    do
+    {
+      const size_t percentile_index = STEALING_SWARM_UPPER_PERCENTILE * (sorted_swarm_sizes.size() - 1) / 100;
+      const size_t percentile_value = std::max(MIN_SWARM_SIZE, sorted_swarm_sizes.at(percentile_index).size - 1);
+      size_t excess;
+      std::vector<excess_pool_snode> excess_pool;
+      get_excess_pool(percentile_value, swarm_to_snodes, excess_pool, excess);
+      insufficient_excess = excess < MIN_SWARM_SIZE - poor_swarm_snodes.size();
+      if (insufficient_excess)
+        break;
+      const auto& excess_snode = pick_from_excess_pool(excess_pool, mt);
+      remove_excess_snode_from_swarm(excess_snode, swarm_to_snodes);
+      poor_swarm_snodes.push_back(excess_snode.public_key);
+    } while (poor_swarm_snodes.size() < MIN_SWARM_SIZE);
+    if (insufficient_excess)
+      break;
+  }
+
+  reference_create_new_swarm_from_excess(swarm_to_snodes, mt);
+
+  if (swarm_to_snodes.size() > 1)
+  {
+    for (auto it = swarm_to_snodes.begin(); it != swarm_to_snodes.end(); )
+    {
+      if (it->second.size() >= MIN_SWARM_SIZE)
+      {
+        ++it;
+        continue;
+      }
+      auto decommissioned_snodes = std::move(it->second);
+      swarm_to_snodes.erase(it);
+      reference_assign_snodes(decommissioned_snodes, swarm_to_snodes, mt, DECOMMISSIONED_REDISTRIBUTION_LOWER_PERCENTILE);
+      it = swarm_to_snodes.begin();
+    }
+  }
+}
+
+TEST(swarm_to_snodes, matches_reference_under_churn)
+{
+  std::mt19937_64 rng{42};
+  for (size_t target : {30, 150, 700})
+  {
+    swarm_snode_map_t swarm_to_snodes;
+    size_t num_snodes = 0;
+    for (int block = 0; block < 150; block++)
+    {
+      auto& unassigned = swarm_to_snodes[UNASSIGNED_SWARM_ID];
+      for (size_t i = 0, regs = num_snodes < target ? rng() % 40 : rng() % 4; i < regs; i++, num_snodes++)
+        unassigned.push_back(newPubKey());
+      if (unassigned.empty())
+        swarm_to_snodes.erase(UNASSIGNED_SWARM_ID);
+
+      /// Deregister a few random snodes, and now and then most of a swarm, to exercise stealing and
+      /// decommissioning as well as assignment and new swarm creation.
+      const bool gut_swarm = rng() % 8 == 0;
+      for (size_t i = 0, deregs = rng() % 6 + (gut_swarm ? 1 : 0); i < deregs && swarm_to_snodes.size() > 1; i++)
+      {
+        auto it = std::next(swarm_to_snodes.begin(), rng() % swarm_to_snodes.size());
+        if (it->first == UNASSIGNED_SWARM_ID || it->second.empty())
+          continue;
+        size_t remove = gut_swarm && i == 0 ? it->second.size() - std::min<size_t>(it->second.size(), 2) : 1;
+        for (size_t j = 0; j < remove; j++, num_snodes--)
+          it->second.erase(it->second.begin() + rng() % it->second.size());
+      }
+
+      swarm_snode_map_t expected = swarm_to_snodes;
+      const uint64_t seed = rng();
+      reference_calc_swarm_changes(expected, seed);
+      calc_swarm_changes(swarm_to_snodes, seed);
+      ASSERT_EQ(swarm_to_snodes, expected) << "Mismatch at block " << block << " with target " << target;
+    }
+  }
+}
@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <thread>
+#include "gtest/gtest.h"
+#include "common/perf_timer.h"
+
+#undef QUENERO_DEFAULT_LOG_CATEGORY
+#define QUENERO_DEFAULT_LOG_CATEGORY "unit_tests"
+
+namespace
+{
+  void timed_section()
+  {
+    PERF_TIMER(unit_test_timed_section);
+  }
+
+  const tools::perf_timer_stats* find(const std::vector<tools::perf_timer_stats>& stats, const std::string& name)
+  {
+    auto it = std::find_if(stats.begin(), stats.end(), [&](auto& s) { return s.name == name; });
+    return it == stats.end() ? nullptr : &*it;
+  }
+}
+
+TEST(perf_timer, stats_without_logging)
+{
+  tools::reset_perf_timer_stats();
+  for (int i = 0; i < 10; ++i)
+    timed_section();
+  // Recorded on another thread, which exits before we read the stats
+  std::thread{[] { for (int i = 0; i < 5; ++i) timed_section(); }}.join();
+
+  auto stats = tools::get_perf_timer_stats();
+  auto* s = find(stats, "unit_test_timed_section");
+#ifdef QUENERO_DISABLE_PERF_TIMERS
+  ASSERT_EQ(s, nullptr);
+#else
+  ASSERT_NE(s, nullptr);
+  ASSERT_EQ(s->timing.count, 15);
+  ASSERT_TRUE(std::is_sorted(stats.begin(), stats.end(), [](auto& a, auto& b) { return a.name < b.name; }));
+
+  tools::reset_perf_timer_stats();
+  ASSERT_EQ(find(tools::get_perf_timer_stats(), "unit_test_timed_section"), nullptr);
+  timed_section();
+  stats = tools::get_perf_timer_stats();
+  s = find(stats, "unit_test_timed_section");
+  ASSERT_NE(s, nullptr);
+  ASSERT_EQ(s->timing.count, 1);
+#endif
+}
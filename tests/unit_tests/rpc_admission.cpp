@@ -0,0 +1,77 @@
+#include <chrono>
+#include "gtest/gtest.h"
+#include "rpc/rpc_admission.h"
+
+using namespace std::literals;
+using cryptonote::rpc::rpc_admission;
+using cryptonote::rpc::rpc_lane;
+
+TEST(rpc_admission, lanes)
+{
+  rpc_admission a;
+  ASSERT_EQ(a.lane("get_height"), rpc_lane::fast);
+  ASSERT_EQ(a.lane("get_outs"), rpc_lane::normal);
+
+  // The cost estimates get learned from actual calls:
+  for (int i = 0; i < 50; i++)
+  {
+    rpc_admission::ticket t;
+    a.finished(t, "get_outs", 100us);
+    a.finished(t, "get_height", 50ms);
+  }
+  ASSERT_EQ(a.lane("get_outs"), rpc_lane::fast);
+  ASSERT_EQ(a.lane("get_height"), rpc_lane::normal);
+}
+
+TEST(rpc_admission, expensive_commands)
+{
+  rpc_admission a;
+  ASSERT_EQ(a.lane("get_masternodes"), rpc_lane::normal);
+  ASSERT_EQ(a.cost("get_masternodes"), 20ms);
+  ASSERT_EQ(a.cost("get_alternative_chains"), 20ms);
+  ASSERT_EQ(a.cost("get_blocks.bin"), 20ms);
+  ASSERT_EQ(a.cost("get_height"), 500us);
+}
+
+TEST(rpc_admission, rate_limit)
+{
+  rpc_admission a;
+  // 1ms per second sustained, 30ms burst: enough for one get_outs at its initial estimate of 20ms
+  a.configure({1, 30, 0ms});
+
+  rpc_admission::ticket t1, t2, t3;
+  ASSERT_EQ(a.admit("get_outs", "1.2.3.4", true, t1), rpc_admission::result::admitted);
+  ASSERT_EQ(a.admit("get_outs", "1.2.3.4", true, t2), rpc_admission::result::admitted);
+  // The bucket is now in debt, so the client gets refused even for a cheap call
+  ASSERT_EQ(a.admit("get_height", "1.2.3.4", true, t3), rpc_admission::result::rate_limited);
+  // ... while other clients are unaffected
+  ASSERT_EQ(a.admit("get_outs", "5.6.7.8", true, t3), rpc_admission::result::admitted);
+
+  // The calls turn out to be cheap, which refunds most of the estimate:
+  a.finished(t1, "get_outs", 1ms);
+  a.finished(t2, "get_outs", 1ms);
+  ASSERT_EQ(a.admit("get_height", "1.2.3.4", true, t1), rpc_admission::result::admitted);
+  ASSERT_EQ(a.rate_limited(), 1);
+}
+
+TEST(rpc_admission, load_shedding)
+{
+  rpc_admission a;
+  a.configure({0, 0, 100ms});
+
+  rpc_admission::ticket t1, t2, t3;
+  ASSERT_EQ(a.admit("get_outs", "1.2.3.4", true, t1), rpc_admission::result::admitted);
+  ASSERT_EQ(a.admit("get_outs", "1.2.3.4", true, t2), rpc_admission::result::admitted);
+  ASSERT_EQ(a.admit("get_outs", "1.2.3.4", true, t3), rpc_admission::result::admitted);
+  // Requests are sitting in the queue for far too long:
+  t1.started(5s);
+  ASSERT_EQ(a.admit("get_outs", "5.6.7.8", true, t1), rpc_admission::result::overloaded);
+  // The fast lane isn't backed up, so cheap calls still get through
+  ASSERT_EQ(a.admit("get_height", "5.6.7.8", true, t1), rpc_admission::result::admitted);
+  t1.started(1ms);
+  // Once the normal lane queue drains we stop shedding
+  t2.started(5s);
+  t3.started(1ms);
+  ASSERT_EQ(a.admit("get_outs", "5.6.7.8", true, t1), rpc_admission::result::admitted);
+  ASSERT_EQ(a.shed(), 1);
+}
@@ -0,0 +1,149 @@
+#include <random>
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "rpc/compression.h"
+
+#ifdef ENABLE_RPC_GZIP
+#include <zlib.h>
+#endif
+#ifdef ENABLE_RPC_ZSTD
+#include <zstd.h>
+#endif
+
+using cryptonote::rpc::compression;
+using cryptonote::rpc::compression_supported;
+using cryptonote::rpc::negotiate_compression;
+
+namespace {
+
+  std::string join(const std::vector<std::string>& pieces)
+  {
+    std::string out;
+    for (const auto& p : pieces)
+      out += p;
+    return out;
+  }
+
+  std::string decompress([[maybe_unused]] compression c, [[maybe_unused]] const std::string& data)
+  {
+    std::string out;
+#ifdef ENABLE_RPC_GZIP
+    if (c == compression::gzip)
+    {
+      z_stream zs{};
+      if (inflateInit2(&zs, 15 + 16) != Z_OK)
+        throw std::runtime_error{"inflateInit2 failed"};
+      zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+      zs.avail_in = data.size();
+      int ret;
+      do {
+        char buf[16384];
+        zs.next_out = reinterpret_cast<Bytef*>(buf);
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+      } while (ret == Z_OK);
+      inflateEnd(&zs);
+      if (ret != Z_STREAM_END)
+        throw std::runtime_error{"inflate failed"};
+      return out;
+    }
+#endif
+#ifdef ENABLE_RPC_ZSTD
+    if (c == compression::zstd)
+    {
+      auto size = ZSTD_getFrameContentSize(data.data(), data.size());
+      if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN)
+        throw std::runtime_error{"bad zstd frame"};
+      out.resize(size);
+      auto ret = ZSTD_decompress(out.data(), out.size(), data.data(), data.size());
+      if (ZSTD_isError(ret) || ret != size)
+        throw std::runtime_error{"ZSTD_decompress failed"};
+      return out;
+    }
+#endif
+    throw std::runtime_error{"unsupported compression"};
+  }
+
+  // Compresses `pieces` and checks that it decompresses back to the concatenated input
+  void check_round_trip(compression c, std::vector<std::string> pieces)
+  {
+    auto expected = join(pieces);
+    auto compressed = cryptonote::rpc::compress(c, std::move(pieces));
+    ASSERT_FALSE(compressed.empty());
+    ASSERT_EQ(decompress(c, join(compressed)), expected);
+  }
+
+}
+
+TEST(rpc_compression, negotiate)
+{
+  const bool gzip = compression_supported(compression::gzip), zstd = compression_supported(compression::zstd);
+  const auto best = zstd ? compression::zstd : gzip ? compression::gzip : compression::none;
+
+  ASSERT_EQ(negotiate_compression(""), compression::none);
+  ASSERT_EQ(negotiate_compression("deflate, br"), compression::none);
+  ASSERT_EQ(negotiate_compression("gzip"), gzip ? compression::gzip : compression::none);
+  ASSERT_EQ(negotiate_compression("x-gzip;q=0.5"), gzip ? compression::gzip : compression::none);
+  ASSERT_EQ(negotiate_compression("ZSTD"), zstd ? compression::zstd : compression::none);
+
+  // q=0 excludes an encoding
+  ASSERT_EQ(negotiate_compression("gzip;q=0"), compression::none);
+  ASSERT_EQ(negotiate_compression("zstd;q=0, gzip"), gzip ? compression::gzip : compression::none);
+  ASSERT_EQ(negotiate_compression("gzip;q=0, zstd;q=0"), compression::none);
+
+  // Highest q wins; zstd wins a tie
+  ASSERT_EQ(negotiate_compression("gzip, zstd"), best);
+  ASSERT_EQ(negotiate_compression("zstd;q=0.8, gzip;q=0.8"), best);
+  if (gzip)
+    ASSERT_EQ(negotiate_compression("zstd;q=0.5, gzip;q=0.9"), compression::gzip);
+  if (zstd)
+    ASSERT_EQ(negotiate_compression("gzip;q=0.5, zstd;q=0.9"), compression::zstd);
+
+  // "*" covers whatever isn't listed explicitly, and never overrides an explicit q=0
+  ASSERT_EQ(negotiate_compression("*"), best);
+  ASSERT_EQ(negotiate_compression("*;q=0"), compression::none);
+  ASSERT_EQ(negotiate_compression("gzip;q=0, *"), zstd ? compression::zstd : compression::none);
+  ASSERT_EQ(negotiate_compression("zstd;q=0, *"), gzip ? compression::gzip : compression::none);
+  ASSERT_EQ(negotiate_compression("gzip;q=0, zstd;q=0, *"), compression::none);
+  if (gzip)
+    ASSERT_EQ(negotiate_compression("gzip, *;q=0.5"), compression::gzip);
+}
+
+TEST(rpc_compression, round_trip)
+{
+  // Compressible but not trivially so: random words from a small vocabulary
+  std::mt19937_64 rng{42};
+  const std::string words[] = {"\"height\":", "\"hash\":\"", "deadbeef", "0123456789", ",", "}", "{", "status", "OK"};
+  auto make_piece = [&](size_t size) {
+    std::string s;
+    while (s.size() < size)
+      s += words[rng() % std::size(words)];
+    s.resize(size);
+    return s;
+  };
+
+  for (auto c : {compression::gzip, compression::zstd})
+  {
+    if (!compression_supported(c))
+      continue;
+    SCOPED_TRACE(std::string{cryptonote::rpc::compression_name(c)});
+
+    check_round_trip(c, {make_piece(3000)});
+    check_round_trip(c, {make_piece(1000), "", make_piece(2000), make_piece(10)});
+    // Bigger than a single 64 kiB output piece, in one input piece and in many
+    check_round_trip(c, {make_piece(1024 * 1024)});
+    std::vector<std::string> pieces;
+    for (int i = 0; i < 40; i++)
+      pieces.push_back(make_piece(16 * 1024 + i));
+    check_round_trip(c, std::move(pieces));
+    // Incompressible data, so that the output really does span several pieces
+    std::string random(300 * 1024, '\0');
+    for (auto& ch : random)
+      ch = static_cast<char>(rng());
+    check_round_trip(c, {random.substr(0, 100000), random.substr(100000)});
+  }
+
+  std::vector<std::string> body{"abc", "def"};
+  ASSERT_EQ(cryptonote::rpc::compress(compression::none, std::vector<std::string>{body}), body);
+}
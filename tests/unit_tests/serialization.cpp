@@ -36,6 +36,7 @@
 #include <boost/archive/portable_binary_iarchive.hpp>
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "ringct/rctSigs.h"
 #include "serialization/binary_archive.h"
 #include "serialization/json_archive.h"
@@ -595,6 +596,29 @@ TEST(serialization, serializes_ringct)
   ASSERT_EQ(clsag.D, clsag1.D);
 }
 
+TEST(serialization, block_hashing_blob_nonce_offset)
+{
+  for (uint64_t timestamp : {uint64_t{0}, uint64_t{127}, uint64_t{1600000000}, std::numeric_limits<uint64_t>::max()})
+  {
+    cryptonote::block b;
+    b.major_version = cryptonote::network_version_17;
+    b.minor_version = 200;
+    b.timestamp = timestamp;
+    b.prev_id = crypto::rand<crypto::hash>();
+    b.nonce = 0x12345678;
+
+    std::string blob = cryptonote::get_block_hashing_blob(b);
+    size_t offset = cryptonote::get_block_hashing_blob_nonce_offset(b);
+    ASSERT_LE(offset + 4, blob.size());
+    ASSERT_EQ(blob.substr(offset, 4), "\x78\x56\x34\x12"s);
+
+    // Patching the nonce in place must give the same blob as serializing with that nonce
+    b.nonce = 0xdeadbeef;
+    blob.replace(offset, 4, "\xef\xbe\xad\xde"s);
+    ASSERT_EQ(blob, cryptonote::get_block_hashing_blob(b));
+  }
+}
+
 // TODO(quenero): These tests are broken because they rely on testnet which has
 // since been restarted, and so the genesis block of these predefined wallets
 // are broken
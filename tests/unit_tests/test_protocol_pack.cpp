@@ -53,3 +53,95 @@ TEST(protocol_pack, protocol_pack_command)
     ASSERT_TRUE(r.total_height == 3);
   }
 }
+
+TEST(protocol_pack, flat_storage_matches_portable_storage)
+{
+  cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::request r;
+  r.current_blockchain_height = 123456;
+  r.missed_ids.resize(3, crypto::hash{});
+  r.missed_ids[1].data[5] = 42;
+  for (int i = 0; i < 3; i++)
+  {
+    auto& b = r.blocks.emplace_back();
+    b.block = std::string(100 + i, 'b');
+    b.txs = {std::string(10, 'x'), std::string(), std::string(300, char(i))};
+    auto& blink = b.blinks.emplace_back();
+    blink.tx_hash.data[0] = i;
+    blink.height = 1000 + i;
+    blink.quorum = {0, 1, 0};
+    blink.position = {3, 4, 5};
+    blink.signature.resize(3);
+  }
+
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(r, buff));
+
+  epee::serialization::portable_storage ps;
+  ASSERT_TRUE(ps.load_from_binary(buff));
+  cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::request from_ps;
+  ASSERT_TRUE(from_ps.load(ps));
+
+  epee::serialization::flat_storage fs;
+  ASSERT_TRUE(fs.load_from_binary(buff));
+  cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::request from_fs;
+  ASSERT_TRUE(from_fs.load(fs));
+
+  for (auto* loaded : {&from_ps, &from_fs})
+  {
+    EXPECT_EQ(loaded->current_blockchain_height, r.current_blockchain_height);
+    EXPECT_EQ(loaded->missed_ids, r.missed_ids);
+    ASSERT_EQ(loaded->blocks.size(), r.blocks.size());
+    for (size_t i = 0; i < r.blocks.size(); i++)
+    {
+      EXPECT_EQ(loaded->blocks[i].block, r.blocks[i].block);
+      EXPECT_EQ(loaded->blocks[i].txs, r.blocks[i].txs);
+      ASSERT_EQ(loaded->blocks[i].blinks.size(), 1);
+      EXPECT_EQ(loaded->blocks[i].blinks[0].tx_hash, r.blocks[i].blinks[0].tx_hash);
+      EXPECT_EQ(loaded->blocks[i].blinks[0].height, r.blocks[i].blinks[0].height);
+      EXPECT_EQ(loaded->blocks[i].blinks[0].quorum, r.blocks[i].blinks[0].quorum);
+      EXPECT_EQ(loaded->blocks[i].blinks[0].position, r.blocks[i].blinks[0].position);
+    }
+  }
+
+  // Strings can be read in place, without copying out of the buffer
+  std::string_view block;
+  auto* blocks = fs.get_array<epee::serialization::section>("blocks", nullptr);
+  ASSERT_NE(blocks, nullptr);
+  ASSERT_TRUE(fs.get_value("block", block, &*blocks->begin()));
+  EXPECT_EQ(block, r.blocks[0].block);
+  EXPECT_GE(block.data(), buff.data());
+  EXPECT_LT(block.data(), buff.data() + buff.size());
+
+  // Truncated payloads must be rejected rather than read past the end
+  for (size_t len : {buff.size() / 2, buff.size() - 1})
+    EXPECT_FALSE(fs.load_from_binary(std::string_view{buff}.substr(0, len)));
+}
+
+TEST(protocol_pack, flat_storage_arrays)
+{
+  cryptonote::CORE_SYNC_DATA d{};
+  d.current_height = 10;
+  d.cumulative_difficulty = 1ull << 40;
+  d.top_version = 7;
+  d.blink_blocks = {1, 2, 300, 1ull << 50};
+  d.blink_hash.resize(4, crypto::hash{});
+
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(d, buff));
+  cryptonote::CORE_SYNC_DATA d2{};
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(d2, buff));
+  EXPECT_EQ(d2.current_height, d.current_height);
+  EXPECT_EQ(d2.cumulative_difficulty, d.cumulative_difficulty);
+  EXPECT_EQ(d2.top_version, d.top_version);
+  EXPECT_EQ(d2.blink_blocks, d.blink_blocks);
+  EXPECT_EQ(d2.blink_hash, d.blink_hash);
+
+  // Values that don't fit the target type fail the same way portable_storage does
+  epee::serialization::flat_storage fs;
+  ASSERT_TRUE(fs.load_from_binary(buff));
+  uint8_t small;
+  EXPECT_THROW(fs.get_value("cumulative_difficulty", small, nullptr), std::exception);
+  epee::serialization::storage_entry blinks;
+  ASSERT_TRUE(fs.get_value("blink_blocks", blinks, nullptr));
+  EXPECT_EQ(var::get<epee::serialization::array_t<uint64_t>>(var::get<epee::serialization::array_entry>(blinks)), d.blink_blocks);
+}
@@ -26,10 +26,14 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <array>
 #include <atomic>
+#include <string>
+#include <vector>
 #include "gtest/gtest.h"
 #include "epee/misc_language.h"
 #include "common/threadpool.h"
+#include "common/util.h"
 
 TEST(threadpool, wait_nothing)
 {
@@ -144,3 +148,91 @@ TEST(threadpool, leaf_reentrancy)
   waiter.wait(tpool.get());
   ASSERT_EQ(counter, 500000);
 }
+
+TEST(threadpool, large_task)
+{
+  // Too big to be stored inline in the task
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  tools::threadpool::waiter waiter;
+  std::array<uint64_t, 32> values;
+  values.fill(3);
+  std::atomic<uint64_t> sum(0);
+  for (int i = 0; i < 100; ++i)
+    tpool->submit(&waiter, [values, &sum](){ for (auto v : values) sum += v; });
+  waiter.wait(tpool.get());
+  ASSERT_EQ(sum, 9600);
+}
+
+TEST(threadpool, parallel_for)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  for (size_t n : {0, 1, 7, 100, 10000})
+  {
+    std::vector<std::atomic<int>> hits(n);
+    tpool->parallel_for(size_t{0}, n, [&](size_t i){ ++hits[i]; });
+    for (auto& h : hits)
+      ASSERT_EQ(h, 1);
+  }
+  std::vector<int> out(1000);
+  tpool->parallel_for(-500, 500, [&](int i){ out[i + 500] = i; }, 64);
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_EQ(out[i], i - 500);
+}
+
+TEST(threadpool, parallel_reduce)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  const uint64_t sum = tpool->parallel_reduce(uint64_t{1}, uint64_t{100001}, uint64_t{0},
+      [](uint64_t b, uint64_t e){ uint64_t s = 0; for (; b < e; ++b) s += b; return s; },
+      [](uint64_t a, uint64_t b){ return a + b; });
+  ASSERT_EQ(sum, 5000050000);
+
+  // Chunk results are combined in order
+  const std::string joined = tpool->parallel_reduce(0, 26, std::string{},
+      [](int b, int e){ std::string s; for (; b < e; ++b) s += char('a' + b); return s; },
+      [](std::string a, std::string b){ return a + b; });
+  ASSERT_EQ(joined, "abcdefghijklmnopqrstuvwxyz");
+}
+
+TEST(threadpool, nested_task_groups)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(2));
+  std::atomic<int> counter(0);
+  {
+    tools::task_group outer{*tpool};
+    for (int i = 0; i < 100; ++i)
+      outer.run([&](){
+        tools::task_group inner{*tpool};
+        for (int j = 0; j < 100; ++j)
+          inner.run([&](){ ++counter; });
+        inner.wait();
+        ++counter;
+      });
+  }
+  ASSERT_EQ(counter, 10100);
+}
+
+TEST(threadpool, thread_budget)
+{
+  // Verification gets the whole budget; the I/O pools scale with it but stay bounded
+  for (unsigned total : {0u, 1u, 2u, 4u, 8u, 64u})
+  {
+    const auto b = tools::get_thread_budget(total);
+    ASSERT_EQ(b.verify, std::max(total, 1u));
+    ASSERT_GE(b.p2p, 2u);
+    ASSERT_LE(b.p2p, 10u);
+    ASSERT_GE(b.omq, 1u);
+    ASSERT_LE(b.omq, std::max(total, 1u));
+    ASSERT_GE(b.http, 1u);
+    ASSERT_LE(b.http, 8u);
+  }
+  // The I/O pools come on top of verification, but (with public and admin HTTP RPC listeners)
+  // don't add more than twice as many threads again
+  for (unsigned total : {4u, 8u, 16u, 64u, 256u})
+  {
+    const auto b = tools::get_thread_budget(total);
+    ASSERT_LE(b.verify + b.p2p + b.omq + 2 * b.http, 3 * total);
+  }
+  ASSERT_LT(tools::get_thread_budget(4).p2p, tools::get_thread_budget(64).p2p);
+  ASSERT_LT(tools::get_thread_budget(4).omq, tools::get_thread_budget(64).omq);
+}
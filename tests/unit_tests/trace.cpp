@@ -0,0 +1,84 @@
+#include <thread>
+#include "gtest/gtest.h"
+#include "common/trace.h"
+
+#undef QUENERO_DEFAULT_LOG_CATEGORY
+#define QUENERO_DEFAULT_LOG_CATEGORY "unit_tests"
+
+namespace
+{
+  size_t count(const std::string& haystack, const std::string& needle)
+  {
+    size_t n = 0;
+    for (auto pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1))
+      n++;
+    return n;
+  }
+
+  void traced_section()
+  {
+    TRACE_SPAN(unit_test_outer);
+    TRACE_SPAN(unit_test_inner);
+    TRACE_SPAN_END(unit_test_inner);
+  }
+}
+
+TEST(trace, disabled_records_nothing)
+{
+  tools::trace::set_enabled(false);
+  tools::trace::clear();
+  traced_section();
+  ASSERT_EQ(tools::trace::event_count(), 0);
+  ASSERT_EQ(tools::trace::dump_chrome_json(), R"({"displayTimeUnit":"ms","traceEvents":[]})");
+}
+
+TEST(trace, chrome_json)
+{
+  tools::trace::clear();
+  tools::trace::set_enabled(true);
+  traced_section();
+  std::thread{traced_section}.join();
+  tools::trace::set_enabled(false);
+  traced_section();
+
+  ASSERT_EQ(tools::trace::event_count(), 8);
+  auto json = tools::trace::dump_chrome_json();
+  ASSERT_EQ(json.find(R"({"displayTimeUnit":"ms","traceEvents":[{"name":"unit_test_outer","cat":"unit_tests","ph":"B","ts":)"), 0);
+  ASSERT_EQ(count(json, R"("ph":"B")"), 4);
+  ASSERT_EQ(count(json, R"("ph":"E")"), 4);
+  ASSERT_EQ(count(json, R"("name":"unit_test_inner")"), 4);
+  // The spans of the two threads are tagged with different thread ids
+  auto tid = [&](size_t event) {
+    size_t pos = 0;
+    for (size_t i = 0; i <= event; i++)
+      pos = json.find(R"("tid":)", pos) + 6;
+    return json.substr(pos, json.find('}', pos) - pos);
+  };
+  ASSERT_EQ(tid(0), tid(3));
+  ASSERT_EQ(tid(4), tid(7));
+  ASSERT_NE(tid(0), tid(4));
+
+  tools::trace::clear();
+  ASSERT_EQ(tools::trace::event_count(), 0);
+  ASSERT_EQ(tools::trace::dump_chrome_json(), R"({"displayTimeUnit":"ms","traceEvents":[]})");
+}
+
+TEST(trace, concurrent_writers)
+{
+  tools::trace::clear();
+  tools::trace::set_enabled(true);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+    threads.emplace_back([] { for (int i = 0; i < 1000; i++) traced_section(); });
+  for (int i = 0; i < 10; i++)
+    tools::trace::dump_chrome_json();
+  for (auto& t : threads)
+    t.join();
+  tools::trace::set_enabled(false);
+
+  ASSERT_EQ(tools::trace::event_count(), 16000);
+  auto json = tools::trace::dump_chrome_json();
+  ASSERT_EQ(count(json, R"("ph":"B")"), 8000);
+  ASSERT_EQ(count(json, R"("ph":"E")"), 8000);
+  tools::trace::clear();
+}
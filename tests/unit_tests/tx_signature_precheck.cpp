@@ -0,0 +1,166 @@
+#define IN_UNIT_TESTS
+
+#include <unordered_set>
+#include "gtest/gtest.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/uptime_proof.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+#include "ringct/rctSigs.h"
+#include "device/device.hpp"
+
+namespace
+{
+
+constexpr uint64_t AMOUNT = 1000, FEE = 100;
+constexpr size_t RING_SIZE = 4, REAL_INDEX = 2;
+
+// Serves a set of (amount 0) ringct outputs and spent key images, and counts ring lookups.  The
+// base class's height of 1 (just a genesis block) keeps Blockchain::init from adding a block.
+class TestDB : public cryptonote::BaseTestDB
+{
+public:
+  TestDB() { m_open = true; }
+
+  void get_output_key(const epee::span<const uint64_t>& amounts, const std::vector<uint64_t>& offsets,
+      std::vector<cryptonote::output_data_t>& out, bool allow_partial = false) const override
+  {
+    ++output_lookups;
+    out.clear();
+    for (auto i : offsets)
+    {
+      if (i >= outputs.size())
+        break;
+      out.push_back(outputs[i]);
+    }
+  }
+  bool has_key_image(const crypto::key_image& img) const override { return spent.count(img) > 0; }
+
+  std::vector<cryptonote::output_data_t> outputs;
+  std::unordered_set<crypto::key_image> spent;
+  mutable int output_lookups = 0;
+};
+
+class tx_signature_precheck : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(bc.init(new TestDB(), nullptr /*ons_db*/, cryptonote::FAKECHAIN, true, &test_options, 0));
+    db = &static_cast<TestDB&>(bc.get_db());
+
+    for (size_t i = 0; i < RING_SIZE; i++)
+    {
+      crypto::public_key pub;
+      crypto::generate_keys(pub, secs[i]);
+      masks[i] = rct::skGen();
+      db->outputs.push_back({pub, 0 /*unlock_time*/, 1 /*height*/, rct::commit(AMOUNT, masks[i])});
+    }
+  }
+
+  // Builds a CLSAG transaction spending the output at REAL_INDEX, with a ring of all the outputs
+  cryptonote::transaction make_tx()
+  {
+    const auto& real = db->outputs[REAL_INDEX];
+    cryptonote::transaction tx;
+    tx.version = cryptonote::txversion::v2_ringct;
+    cryptonote::txin_to_key in;
+    in.amount = 0;
+    in.key_offsets.push_back(0);
+    for (size_t i = 1; i < RING_SIZE; i++)
+      in.key_offsets.push_back(1);
+    crypto::generate_key_image(real.pubkey, secs[REAL_INDEX], in.k_image);
+    tx.vin.push_back(in);
+
+    rct::key out_sk, out_pk;
+    rct::skpkGen(out_sk, out_pk);
+    tx.vout.push_back({0, cryptonote::txout_to_key{rct::rct2pk(out_pk)}});
+
+    rct::ctkeyV in_sk{{rct::sk2rct(secs[REAL_INDEX]), masks[REAL_INDEX]}};
+    rct::ctkeyM mix_ring(1);
+    for (const auto& out : db->outputs)
+      mix_ring[0].push_back({rct::pk2rct(out.pubkey), out.commitment});
+    rct::ctkeyV out_masks;
+    const rct::RCTConfig rct_config{rct::RangeProofType::PaddedBulletproof, 3};
+    tx.rct_signatures = rct::genRctSimple(rct::hash2rct(cryptonote::get_transaction_prefix_hash(tx)), in_sk, {out_pk},
+        {AMOUNT}, {AMOUNT - FEE}, FEE, mix_ring, {rct::hash_to_scalar(rct::zero())}, nullptr, nullptr, {REAL_INDEX},
+        out_masks, rct_config, hw::get_device("default"));
+    // The ring and key images are not part of the serialized signatures; the precheck has to
+    // rebuild them from the db and the inputs
+    tx.rct_signatures.mixRing.clear();
+    tx.invalidate_hashes();
+    return tx;
+  }
+
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{cryptonote::network_version_7, 0}, {cryptonote::network_version_16_pulse, 1}};
+  const cryptonote::test_options test_options{hard_forks, 5000};
+  blockchain_objects_t bc_objects;
+  cryptonote::Blockchain& bc = bc_objects.m_blockchain;
+  TestDB* db = nullptr;
+  crypto::secret_key secs[RING_SIZE];
+  rct::key masks[RING_SIZE];
+};
+
+}
+
+TEST_F(tx_signature_precheck, verifies_and_caches)
+{
+  auto tx = make_tx();
+  const auto txid = cryptonote::get_transaction_hash(tx);
+  ASSERT_TRUE(bc.precheck_tx_signatures(tx, txid));
+  EXPECT_EQ(db->output_lookups, 1);
+
+  rct::ctkeyM ring(1);
+  for (const auto& out : db->outputs)
+    ring[0].push_back({rct::pk2rct(out.pubkey), out.commitment});
+  EXPECT_TRUE(bc.m_verified_signatures.contains(txid, cryptonote::verified_signature_cache::ring_digest(ring)));
+}
+
+TEST_F(tx_signature_precheck, rejects_bad_signature)
+{
+  auto tx = make_tx();
+  tx.rct_signatures.p.CLSAGs[0].s[0] = rct::skGen();
+  const auto txid = cryptonote::get_transaction_hash(tx);
+  ASSERT_FALSE(bc.precheck_tx_signatures(tx, txid));
+  EXPECT_EQ(bc.m_verified_signatures.size(), 0);
+}
+
+TEST_F(tx_signature_precheck, spent_key_images_skip_ring_lookup)
+{
+  auto tx = make_tx();
+  db->spent.insert(std::get<cryptonote::txin_to_key>(tx.vin[0]).k_image);
+  ASSERT_FALSE(bc.precheck_tx_signatures(tx, cryptonote::get_transaction_hash(tx)));
+  EXPECT_EQ(db->output_lookups, 0);
+  EXPECT_EQ(bc.m_verified_signatures.size(), 0);
+}
+
+TEST_F(tx_signature_precheck, duplicate_key_images_skip_ring_lookup)
+{
+  auto tx = make_tx();
+  tx.vin.push_back(tx.vin[0]);
+  ASSERT_FALSE(bc.precheck_tx_signatures(tx, cryptonote::get_transaction_hash(tx)));
+  EXPECT_EQ(db->output_lookups, 0);
+}
+
+TEST_F(tx_signature_precheck, missing_ring_members)
+{
+  auto tx = make_tx();
+  db->outputs.pop_back();
+  ASSERT_FALSE(bc.precheck_tx_signatures(tx, cryptonote::get_transaction_hash(tx)));
+  EXPECT_EQ(bc.m_verified_signatures.size(), 0);
+}
+
+TEST_F(tx_signature_precheck, ineligible_txs)
+{
+  auto tx = make_tx();
+  tx.type = cryptonote::txtype::state_change;
+  EXPECT_FALSE(bc.precheck_tx_signatures(tx, cryptonote::get_transaction_hash(tx)));
+
+  tx = make_tx();
+  tx.pruned = true;
+  EXPECT_FALSE(bc.precheck_tx_signatures(tx, cryptonote::get_transaction_hash(tx)));
+  EXPECT_EQ(db->output_lookups, 0);
+}
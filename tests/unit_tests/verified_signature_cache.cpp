@@ -0,0 +1,55 @@
+#include <algorithm>
+#include "gtest/gtest.h"
+#include "cryptonote_core/verified_signature_cache.h"
+#include "ringct/rctOps.h"
+
+using cryptonote::verified_signature_cache;
+
+static crypto::hash make_hash(unsigned char c)
+{
+  crypto::hash h;
+  std::fill(std::begin(h.data), std::end(h.data), c);
+  return h;
+}
+
+TEST(verified_signature_cache, ring_must_match)
+{
+  verified_signature_cache cache;
+  rct::ctkeyM ring{{{rct::identity(), rct::zero()}, {rct::zero(), rct::identity()}}};
+  const auto digest = verified_signature_cache::ring_digest(ring);
+  cache.add(make_hash(1), digest);
+  ASSERT_TRUE(cache.contains(make_hash(1), digest));
+  ASSERT_FALSE(cache.contains(make_hash(2), digest));
+
+  // Same tx against a different ring (e.g. after a reorg changed the referenced outputs) misses
+  ring[0][1].dest = rct::identity();
+  const auto other = verified_signature_cache::ring_digest(ring);
+  ASSERT_NE(digest, other);
+  ASSERT_FALSE(cache.contains(make_hash(1), other));
+
+  cache.remove(make_hash(1));
+  ASSERT_FALSE(cache.contains(make_hash(1), digest));
+  ASSERT_EQ(cache.size(), 0u);
+}
+
+TEST(verified_signature_cache, evicts_least_recently_used)
+{
+  verified_signature_cache cache{3};
+  const auto ring = make_hash(0xff);
+  cache.add(make_hash(1), ring);
+  cache.add(make_hash(2), ring);
+  cache.add(make_hash(3), ring);
+  ASSERT_TRUE(cache.contains(make_hash(1), ring)); // 2 is now the least recently used
+  cache.add(make_hash(4), ring);
+  ASSERT_EQ(cache.size(), 3u);
+  ASSERT_TRUE(cache.contains(make_hash(1), ring));
+  ASSERT_FALSE(cache.contains(make_hash(2), ring));
+  ASSERT_TRUE(cache.contains(make_hash(3), ring));
+  ASSERT_TRUE(cache.contains(make_hash(4), ring));
+
+  // Re-adding an existing tx replaces its ring rather than growing the cache
+  cache.add(make_hash(3), make_hash(0xee));
+  ASSERT_EQ(cache.size(), 3u);
+  ASSERT_FALSE(cache.contains(make_hash(3), ring));
+  ASSERT_TRUE(cache.contains(make_hash(3), make_hash(0xee)));
+}